@@ -0,0 +1,157 @@
+#include "bench_utils.h"
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/**
+ * Random rank queries over a 1GB vector whose words come from `bv_aligned_allocator` (4KB pages)
+ * or from `bv_page_allocator_new` (transparent 2MB pages), and the temporaries of small set operations
+ * with and without a `bv_pool`.
+ *
+ * Where the kernel exposes hardware counters, `dtlb_misses` reports the data-TLB load misses per query;
+ * with 4KB pages nearly every random query misses, with 2MB pages the 1GB vector spans only 512 TLB entries.
+ */
+
+static const uint64_t kTlbBits = 1UL << 33;
+
+enum allocator_kind
+{
+    kAligned,
+    kHugePages,
+};
+
+struct tlb_counter
+{
+    int fd;
+
+    tlb_counter()
+    {
+        perf_event_attr attr = {};
+
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.size = sizeof(attr);
+        attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                      (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+
+    ~tlb_counter()
+    {
+        if (fd >= 0)
+            close(fd);
+    }
+
+    void start()
+    {
+        if (fd >= 0)
+        {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+
+    /* the misses since start(), or -1 without hardware counters */
+    int64_t stop()
+    {
+        uint64_t misses = 0;
+
+        if (fd < 0)
+            return -1;
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        return (read(fd, &misses, sizeof(misses)) == sizeof(misses)) ? (int64_t)misses : -1;
+    }
+};
+
+static bitvector *tlb_bitvector(allocator_kind kind)
+{
+    /** generated once per allocator, since filling 1GB dominates the benchmark otherwise **/
+
+    static const bv_page_options options = {false, -1, false};
+    static const bv_allocator *pages = bv_page_allocator_new(&options);
+    static bitvector *cache[2] = {nullptr, nullptr};
+
+    if (cache[kind] == nullptr)
+    {
+        /* keep at most one 1GB vector alive */
+        if (cache[1 - kind] != nullptr)
+            bv_free(cache[1 - kind]), cache[1 - kind] = nullptr;
+        bv_set_allocator(kind == kHugePages ? pages : nullptr);
+        cache[kind] = bench::random_bitvector(kTlbBits, 500, 42);
+        bv_set_allocator(nullptr);
+        bv_build_rank(cache[kind]);
+    }
+    return cache[kind];
+}
+
+static void BM_RandomAccessPages(benchmark::State &state)
+{
+    bitvector *bv = tlb_bitvector((allocator_kind)state.range(0));
+    std::vector<uint64_t> positions = bench::random_positions(bench::kNumQueries, 0, kTlbBits, false);
+    tlb_counter counter;
+    uint64_t sum = 0;
+    int64_t misses;
+
+    counter.start();
+    for (auto _ : state)
+    {
+        for (uint64_t pos : positions)
+            sum += bv_isset(bv, pos);
+    }
+    misses = counter.stop();
+    benchmark::DoNotOptimize(sum);
+    state.SetItemsProcessed(state.iterations() * positions.size());
+    if (misses >= 0)
+        state.counters["dtlb_misses"] = (double)misses / (state.iterations() * positions.size());
+}
+BENCHMARK(BM_RandomAccessPages)->ArgName("huge_pages")->Arg(kAligned)->Arg(kHugePages);
+
+static void BM_RandomRankPages(benchmark::State &state)
+{
+    bitvector *bv = tlb_bitvector((allocator_kind)state.range(0));
+    std::vector<uint64_t> positions = bench::random_positions(bench::kNumQueries, 0, kTlbBits, false);
+    tlb_counter counter;
+    uint64_t sum = 0;
+    int64_t misses;
+
+    counter.start();
+    for (auto _ : state)
+    {
+        for (uint64_t pos : positions)
+            sum += bv_rank(bv, pos);
+    }
+    misses = counter.stop();
+    benchmark::DoNotOptimize(sum);
+    state.SetItemsProcessed(state.iterations() * positions.size());
+    if (misses >= 0)
+        state.counters["dtlb_misses"] = (double)misses / (state.iterations() * positions.size());
+}
+BENCHMARK(BM_RandomRankPages)->ArgName("huge_pages")->Arg(kAligned)->Arg(kHugePages);
+
+static void BM_SmallXorTemporaries(benchmark::State &state)
+{
+    /** the create-use-free pattern of bv_xor on vectors of a few thousand bits **/
+
+    static bv_pool *pool = bv_pool_new();
+    static const bv_allocator *pooled = bv_pool_allocator(pool);
+    uint64_t size = state.range(1);
+    bitvector *a, *b, *x;
+
+    bv_set_allocator(state.range(0) ? pooled : nullptr);
+    a = bench::random_bitvector(size, 500, 1);
+    b = bench::random_bitvector(size, 500, 2);
+    for (auto _ : state)
+    {
+        x = bv_xor(a, b);
+        benchmark::DoNotOptimize(x->data[0]);
+        bv_free(x);
+    }
+    bv_free(a);
+    bv_free(b);
+    bv_set_allocator(nullptr);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SmallXorTemporaries)->ArgNames({"pool", "bits"})->ArgsProduct({{0, 1}, {512, 4096, 32768}});
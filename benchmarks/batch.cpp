@@ -0,0 +1,85 @@
+#include "bench_utils.h"
+
+/**
+ * Batched rank/select against a loop of single queries over the same kNumQueries random positions.
+ *
+ * Each iteration answers the whole batch; `items_per_second` is the query throughput.
+ * The larger sizes do not fit in cache, which is where prefetching pays off.
+ */
+
+static void batch_args(benchmark::internal::Benchmark *b)
+{
+    b->ArgNames({"bits"});
+    for (int64_t size : {1L << 22, 1L << 26, 1L << 30, 1L << 32})
+        b->Args({size});
+}
+
+static void BM_RankLoop(benchmark::State &state)
+{
+    bitvector *bv = bench::cached_bitvector(state.range(0), 500);
+    std::vector<uint64_t> positions = bench::random_positions(bench::kNumQueries, 0, bv_len(bv) + 1, false);
+    std::vector<uint64_t> out(bench::kNumQueries);
+
+    for (auto _ : state)
+    {
+        for (uint64_t i = 0; i < bench::kNumQueries; i++)
+            out[i] = bv_rank(bv, positions[i]);
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(state.iterations() * bench::kNumQueries);
+}
+BENCHMARK(BM_RankLoop)->Apply(batch_args)->Unit(benchmark::kMicrosecond);
+
+static void BM_RankBatch(benchmark::State &state, unsigned flags)
+{
+    bitvector *bv = bench::cached_bitvector(state.range(0), 500);
+    std::vector<uint64_t> positions = bench::random_positions(bench::kNumQueries, 0, bv_len(bv) + 1, false);
+    std::vector<uint64_t> out(bench::kNumQueries);
+
+    for (auto _ : state)
+    {
+        bv_rank_batch(bv, positions.data(), out.data(), bench::kNumQueries, flags);
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(state.iterations() * bench::kNumQueries);
+}
+BENCHMARK_CAPTURE(BM_RankBatch, serial, BV_BATCH_SERIAL)->Apply(batch_args)->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_RankBatch, sorted_serial, BV_BATCH_SORT | BV_BATCH_SERIAL)
+    ->Apply(batch_args)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_RankBatch, parallel, 0U)->Apply(batch_args)->Unit(benchmark::kMicrosecond);
+
+static void BM_SelectLoop(benchmark::State &state)
+{
+    bitvector *bv = bench::cached_bitvector(state.range(0), 500);
+    std::vector<uint64_t> ks = bench::random_positions(bench::kNumQueries, 1, bv_rank(bv, bv_len(bv)) + 1, false);
+    std::vector<int64_t> out(bench::kNumQueries);
+
+    for (auto _ : state)
+    {
+        for (uint64_t i = 0; i < bench::kNumQueries; i++)
+            out[i] = bv_select(bv, ks[i]);
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(state.iterations() * bench::kNumQueries);
+}
+BENCHMARK(BM_SelectLoop)->Apply(batch_args)->Unit(benchmark::kMicrosecond);
+
+static void BM_SelectBatch(benchmark::State &state, unsigned flags)
+{
+    bitvector *bv = bench::cached_bitvector(state.range(0), 500);
+    std::vector<uint64_t> ks = bench::random_positions(bench::kNumQueries, 1, bv_rank(bv, bv_len(bv)) + 1, false);
+    std::vector<int64_t> out(bench::kNumQueries);
+
+    for (auto _ : state)
+    {
+        bv_select_batch(bv, ks.data(), out.data(), bench::kNumQueries, flags);
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(state.iterations() * bench::kNumQueries);
+}
+BENCHMARK_CAPTURE(BM_SelectBatch, serial, BV_BATCH_SERIAL)->Apply(batch_args)->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_SelectBatch, sorted_serial, BV_BATCH_SORT | BV_BATCH_SERIAL)
+    ->Apply(batch_args)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_SelectBatch, parallel, 0U)->Apply(batch_args)->Unit(benchmark::kMicrosecond);
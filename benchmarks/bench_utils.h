@@ -0,0 +1,129 @@
+/**
+ * @file bench_utils.h
+ * @brief Input generation shared by the RankSelect_bench benchmarks
+ */
+
+#ifndef POPPY_BENCH_UTILS_H
+#define POPPY_BENCH_UTILS_H
+
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+#include "bitvector.h"
+
+namespace bench
+{
+    /** sizes in bits, from 1K to 4G */
+    static const std::vector<int64_t> kSizes = {1L << 10, 1L << 14, 1L << 18, 1L << 22, 1L << 26, 1L << 30, 1L << 32};
+
+    /** densities in parts per thousand, from 0.1% to 99% */
+    static const std::vector<int64_t> kDensities = {1, 10, 100, 500, 900, 990};
+
+    /** number of precomputed query positions, cycled through by the benchmark loops */
+    static const uint64_t kNumQueries = 1UL << 16;
+
+    /**
+     * @brief Generate a bitvector of `size` bits with roughly `density` set bits per thousand
+     */
+    inline bitvector *random_bitvector(uint64_t size, uint64_t density, uint64_t seed)
+    {
+        bitvector *bv = bv_new(size);
+        std::mt19937_64 rng(seed);
+        uint64_t i, pos, nwords = (size + WORD_SIZE - 1) / WORD_SIZE;
+
+        if (density == 500)
+        {
+            for (i = 0; i < nwords; i++)
+                bv->data[i] = rng();
+        }
+        else if (density < 500)
+        {
+            for (i = 0; i < size / 1000 * density + (size % 1000) * density / 1000; i++)
+            {
+                pos = rng() % size;
+                bv->data[pos / WORD_SIZE] |= BIT << (pos % WORD_SIZE);
+            }
+        }
+        else
+        {
+            for (i = 0; i < nwords; i++)
+                bv->data[i] = ALL_ONES_MASK;
+            for (i = 0; i < size / 1000 * (1000 - density) + (size % 1000) * (1000 - density) / 1000; i++)
+            {
+                pos = rng() % size;
+                bv->data[pos / WORD_SIZE] &= ~(BIT << (pos % WORD_SIZE));
+            }
+        }
+        if (size % WORD_SIZE)
+            bv->data[nwords - 1] &= ~(ALL_ONES_MASK << (size % WORD_SIZE));
+        return bv;
+    }
+
+    /**
+     * @brief Get a read-only bitvector with its rank and select directories built
+     *
+     * Generating multi-GB inputs dominates setup time and benchmark functions are invoked several times per
+     * argument set, so the two most recently requested vectors are kept alive.
+     * Callers must not modify the returned vector.
+     */
+    inline bitvector *cached_bitvector(uint64_t size, uint64_t density, uint64_t seed = 42)
+    {
+        struct entry
+        {
+            uint64_t size, density, seed;
+            bitvector *bv;
+        };
+        static entry cache[2] = {{0, 0, 0, nullptr}, {0, 0, 0, nullptr}};
+
+        for (entry &e : cache)
+            if (e.bv != nullptr && e.size == size && e.density == density && e.seed == seed)
+                return e.bv;
+
+        /* evict the older entry before allocating so that two 4G-bit vectors never coexist with a third */
+        if (cache[1].bv != nullptr)
+            bv_free(cache[1].bv);
+        cache[1] = cache[0];
+        cache[0] = {size, density, seed, random_bitvector(size, density, seed)};
+        bv_build_select(cache[0].bv);
+        return cache[0].bv;
+    }
+
+    /**
+     * @brief `n` uniformly random values in [lo, hi), optionally sorted to model a sequential scan
+     */
+    inline std::vector<uint64_t> random_positions(uint64_t n, uint64_t lo, uint64_t hi, bool sorted, uint64_t seed = 7)
+    {
+        std::mt19937_64 rng(seed);
+        std::vector<uint64_t> positions(n);
+        for (uint64_t &p : positions)
+            p = lo + rng() % (hi - lo);
+        if (sorted)
+            std::sort(positions.begin(), positions.end());
+        return positions;
+    }
+
+    /**
+     * @brief Report the size of the rank/select directories relative to the raw bits, in percent
+     */
+    inline void report_index_overhead(benchmark::State &state, bitvector *bv)
+    {
+        state.counters["index_overhead_pct"] = 100.0 * 8 * bv_index_bytes(bv) / (double)bv_len(bv);
+    }
+
+    /** register every (size, density) pair */
+    inline void size_density_args(benchmark::internal::Benchmark *b)
+    {
+        b->ArgNames({"bits", "density_ppt"})->ArgsProduct({kSizes, kDensities});
+    }
+
+    /** register every size at 50% density, for operations whose cost does not depend on the bits */
+    inline void size_args(benchmark::internal::Benchmark *b)
+    {
+        b->ArgNames({"bits"});
+        for (int64_t size : kSizes)
+            b->Args({size});
+    }
+} // namespace bench
+
+#endif // POPPY_BENCH_UTILS_H
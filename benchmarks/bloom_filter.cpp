@@ -0,0 +1,112 @@
+#include "bench_utils.h"
+#include "bloom_filter.h"
+
+/**
+ * Membership tests against a filter sized for 1% false positives, from one that fits in L2 to one far past the LLC.
+ *
+ * The baseline is the hand-rolled filter the blocked one replaces: k = 7 `bv_isset` calls at positions
+ * derived from two hashes of the key, each a potential cache miss. Half the queried keys were inserted.
+ */
+
+static const uint64_t kClassicProbes = 7; // optimal for 1% at 9.6 bits per key
+
+static inline uint64_t mix(uint64_t key)
+{
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    return key ^ (key >> 33);
+}
+
+static std::vector<uint64_t> bloom_keys(uint64_t n)
+{
+    std::vector<uint64_t> keys(n);
+
+    for (uint64_t i = 0; i < n; i++)
+        keys[i] = mix(i + 1);
+    return keys;
+}
+
+static void bloom_args(benchmark::internal::Benchmark *b)
+{
+    b->ArgName("keys")->RangeMultiplier(16)->Range(1L << 14, 1L << 26);
+}
+
+static void BM_ClassicBloomContains(benchmark::State &state)
+{
+    uint64_t n = state.range(0), i, k, h, step, hits = 0;
+    std::vector<uint64_t> keys = bloom_keys(2 * n);
+    bitvector *bv = bv_new(bf_bits_for(n, 0.01));
+
+    for (i = 0; i < n; i++)
+    {
+        h = mix(keys[i]);
+        for (k = 0, step = (h >> 32) | 1; k < kClassicProbes; k++, h += step)
+            bv_set(bv, h % bv_len(bv));
+    }
+    for (auto _ : state)
+    {
+        for (i = 0; i < bench::kNumQueries; i++)
+        {
+            h = mix(keys[(i * 7919) % keys.size()]);
+            bool present = true;
+            for (k = 0, step = (h >> 32) | 1; k < kClassicProbes && present; k++, h += step)
+                present = bv_isset(bv, h % bv_len(bv));
+            hits += present;
+        }
+    }
+    benchmark::DoNotOptimize(hits);
+    state.SetItemsProcessed(state.iterations() * bench::kNumQueries);
+    bv_free(bv);
+}
+BENCHMARK(BM_ClassicBloomContains)->Apply(bloom_args);
+
+static void BM_BloomContains(benchmark::State &state)
+{
+    uint64_t n = state.range(0), i, hits = 0;
+    std::vector<uint64_t> keys = bloom_keys(2 * n);
+    bloom_filter *bf = bf_new_for(n, 0.01);
+
+    bf_insert_batch(bf, keys.data(), n);
+    for (auto _ : state)
+    {
+        for (i = 0; i < bench::kNumQueries; i++)
+            hits += bf_contains(bf, keys[(i * 7919) % keys.size()]);
+    }
+    benchmark::DoNotOptimize(hits);
+    state.SetItemsProcessed(state.iterations() * bench::kNumQueries);
+    state.counters["bits_per_key"] = (double)bv_len(bf->bits) / n;
+    bf_free(bf);
+}
+BENCHMARK(BM_BloomContains)->Apply(bloom_args);
+
+static void BM_BloomContainsBatch(benchmark::State &state)
+{
+    uint64_t n = state.range(0), i;
+    std::vector<uint64_t> keys = bloom_keys(2 * n), queries(bench::kNumQueries);
+    std::vector<uint8_t> out(bench::kNumQueries);
+    bloom_filter *bf = bf_new_for(n, 0.01);
+
+    bf_insert_batch(bf, keys.data(), n);
+    for (i = 0; i < bench::kNumQueries; i++)
+        queries[i] = keys[(i * 7919) % keys.size()];
+    for (auto _ : state)
+        benchmark::DoNotOptimize(bf_contains_batch(bf, queries.data(), queries.size(), (bool *)out.data()));
+    state.SetItemsProcessed(state.iterations() * bench::kNumQueries);
+    bf_free(bf);
+}
+BENCHMARK(BM_BloomContainsBatch)->Apply(bloom_args);
+
+static void BM_BloomInsertBatch(benchmark::State &state)
+{
+    uint64_t n = state.range(0);
+    std::vector<uint64_t> keys = bloom_keys(n);
+    bloom_filter *bf = bf_new_for(n, 0.01);
+
+    for (auto _ : state)
+        bf_insert_batch(bf, keys.data(), n);
+    state.SetItemsProcessed(state.iterations() * n);
+    bf_free(bf);
+}
+BENCHMARK(BM_BloomInsertBatch)->Apply(bloom_args);
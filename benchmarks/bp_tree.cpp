@@ -0,0 +1,92 @@
+#include "bench_utils.h"
+#include "bp_tree.h"
+
+/**
+ * Navigation in random trees of 1M and 16M nodes stored as balanced parentheses.
+ *
+ * `bits_per_node` counts the parentheses, their rank/select directories and the range min-max tree.
+ */
+
+static const std::vector<int64_t> kNodes = {1L << 20, 1L << 24};
+
+static bp_tree *cached_bp_tree(uint64_t nodes)
+{
+    /* a root around a random walk of nodes - 1 opens and closes that never closes the root */
+    static bp_tree *bp = nullptr;
+    static uint64_t cached_nodes = 0;
+
+    if (bp == nullptr || cached_nodes != nodes)
+    {
+        std::mt19937_64 rng(42);
+        bitvector *parens = bv_new(2 * nodes);
+        uint64_t p = 0, opens = nodes - 1, depth = 0;
+
+        bv_set(parens, p++);
+        while (opens > 0 || depth > 0)
+        {
+            if (opens > 0 && (depth == 0 || rng() % 2))
+            {
+                bv_set(parens, p++);
+                opens--, depth++;
+            }
+            else
+                p++, depth--;
+        }
+        bp_free(bp);
+        bp = bp_from_bitvector(parens);
+        bv_free(parens);
+        cached_nodes = nodes;
+    }
+    return bp;
+}
+
+static std::vector<uint64_t> random_nodes(bp_tree *bp)
+{
+    std::vector<uint64_t> nodes(bench::kNumQueries);
+    std::mt19937_64 rng(7);
+
+    for (auto &v : nodes)
+        v = bp_node_pos(bp, rng() % bp_num_nodes(bp));
+    return nodes;
+}
+
+static void BM_BpBuild(benchmark::State &state)
+{
+    bp_tree *cached = cached_bp_tree(state.range(0));
+    bp_tree *bp = nullptr;
+
+    for (auto _ : state)
+    {
+        bp = bp_from_bitvector(cached->parens);
+        state.PauseTiming();
+        state.counters["bits_per_node"] = 8.0 * bp_bytes(bp) / bp_num_nodes(bp);
+        bp_free(bp);
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_BpBuild)->ArgName("nodes")->ArgsProduct({kNodes})->Unit(benchmark::kMillisecond);
+
+#define BP_QUERY_BENCHMARK(NAME, EXPR)                                          \
+    static void BM_Bp##NAME(benchmark::State &state)                            \
+    {                                                                           \
+        bp_tree *bp = cached_bp_tree(state.range(0));                           \
+        std::vector<uint64_t> nodes = random_nodes(bp);                         \
+        uint64_t i = 0, v, w;                                                   \
+                                                                                \
+        for (auto _ : state)                                                    \
+        {                                                                       \
+            v = nodes[i & (bench::kNumQueries - 1)];                            \
+            w = nodes[(i * 7 + 3) & (bench::kNumQueries - 1)];                  \
+            benchmark::DoNotOptimize(EXPR);                                     \
+            benchmark::DoNotOptimize(w);                                        \
+            i++;                                                                \
+        }                                                                       \
+    }                                                                           \
+    BENCHMARK(BM_Bp##NAME)->ArgName("nodes")->ArgsProduct({kNodes});
+
+BP_QUERY_BENCHMARK(FindClose, bp_find_close(bp, v))
+BP_QUERY_BENCHMARK(Parent, bp_parent(bp, v))
+BP_QUERY_BENCHMARK(NextSibling, bp_next_sibling(bp, v))
+BP_QUERY_BENCHMARK(SubtreeSize, bp_subtree_size(bp, v))
+BP_QUERY_BENCHMARK(Lca, bp_lca(bp, v, w))
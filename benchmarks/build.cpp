@@ -0,0 +1,50 @@
+#include "bench_utils.h"
+#include "thread_pool.h"
+
+/**
+ * Directory construction for multi-GB vectors.
+ *
+ * `BM_BuildRankThreads` rebuilds the rank directory and select samples of the same vector with a growing worker pool;
+ * on a machine with enough cores the wall-clock time should drop close to linearly until memory bandwidth saturates.
+ * `BM_BuilderAppend` streams the same bits through `bv_builder`, which indexes them as they arrive.
+ * `bytes_per_second` counts bytes of raw bits.
+ */
+
+static void BM_BuildRankThreads(benchmark::State &state)
+{
+    bitvector *bv = bench::cached_bitvector(state.range(0), 500);
+
+    bv_set_num_threads(state.range(1));
+    for (auto _ : state)
+        bv_build_rank(bv);
+    bv_set_num_threads(0);
+    state.SetBytesProcessed(state.iterations() * (bv_len(bv) / 8));
+}
+BENCHMARK(BM_BuildRankThreads)
+    ->ArgNames({"bits", "threads"})
+    ->ArgsProduct({{1L << 26, 1L << 30, 1L << 32}, {1, 2, 4, 8}})
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+static void BM_BuilderAppend(benchmark::State &state)
+{
+    bitvector *bv = bench::cached_bitvector(state.range(0), 500);
+    uint64_t i, nwords = bv_len(bv) / WORD_SIZE;
+
+    for (auto _ : state)
+    {
+        bv_builder *builder = bv_builder_new(state.range(1) ? bv_len(bv) : 0);
+        for (i = 0; i < nwords; i++)
+            bv_builder_append(builder, bv->data[i], WORD_SIZE);
+        bitvector *built = bv_builder_finish(builder);
+        benchmark::DoNotOptimize(built->rank);
+        state.PauseTiming();
+        bv_free(built);
+        state.ResumeTiming();
+    }
+    state.SetBytesProcessed(state.iterations() * (bv_len(bv) / 8));
+}
+BENCHMARK(BM_BuilderAppend)
+    ->ArgNames({"bits", "presized"})
+    ->ArgsProduct({{1L << 26, 1L << 30, 1L << 32}, {0, 1}})
+    ->Unit(benchmark::kMillisecond);
@@ -0,0 +1,100 @@
+#include "bench_utils.h"
+
+/**
+ * Whole-vector operations.
+ *
+ * `bytes_per_second` counts the bytes of every input operand read by one call.
+ */
+
+/** register every size for each kernel instruction set */
+static void size_isa_args(benchmark::internal::Benchmark *b)
+{
+    b->ArgNames({"bits", "isa"})->ArgsProduct({bench::kSizes, {BV_ISA_SCALAR, BV_ISA_AVX2, BV_ISA_AVX512}});
+}
+
+static void BM_SetAlgebra(benchmark::State &state, bitvector *(*op)(bitvector *, bitvector *))
+{
+    bitvector *a = bench::cached_bitvector(state.range(0), 500, 1);
+    bitvector *b = bench::cached_bitvector(state.range(0), 500, 2);
+
+    if (bv_use_isa((bv_isa)state.range(1)) != state.range(1))
+    {
+        state.SkipWithError("instruction set not supported by this CPU");
+        bv_use_isa(BV_ISA_AUTO);
+        return;
+    }
+    for (auto _ : state)
+    {
+        bitvector *c = op(a, b);
+        benchmark::DoNotOptimize(c->data);
+        bv_free(c);
+    }
+    bv_use_isa(BV_ISA_AUTO);
+    state.SetBytesProcessed(state.iterations() * 2 * (bv_len(a) / 8));
+}
+BENCHMARK_CAPTURE(BM_SetAlgebra, xor, bv_xor)->Apply(size_isa_args);
+BENCHMARK_CAPTURE(BM_SetAlgebra, intersection, bv_intersection)->Apply(size_isa_args);
+BENCHMARK_CAPTURE(BM_SetAlgebra, union, bv_union)->Apply(size_isa_args);
+BENCHMARK_CAPTURE(BM_SetAlgebra, difference, bv_difference)->Apply(size_isa_args);
+
+static void BM_XorInto(benchmark::State &state)
+{
+    bitvector *a = bench::cached_bitvector(state.range(0), 500, 1);
+    bitvector *b = bench::cached_bitvector(state.range(0), 500, 2);
+    bitvector *c = bv_new(bv_len(a));
+
+    for (auto _ : state)
+    {
+        bv_xor_into(c, a, b);
+        benchmark::DoNotOptimize(c->data);
+    }
+    bv_free(c);
+    state.SetBytesProcessed(state.iterations() * 2 * (bv_len(a) / 8));
+}
+BENCHMARK(BM_XorInto)->Apply(bench::size_args);
+
+static void BM_Complement(benchmark::State &state)
+{
+    bitvector *a = bench::cached_bitvector(state.range(0), 500);
+
+    if (bv_use_isa((bv_isa)state.range(1)) != state.range(1))
+    {
+        state.SkipWithError("instruction set not supported by this CPU");
+        bv_use_isa(BV_ISA_AUTO);
+        return;
+    }
+    for (auto _ : state)
+    {
+        bitvector *c = bv_complement(a);
+        benchmark::DoNotOptimize(c->data);
+        bv_free(c);
+    }
+    bv_use_isa(BV_ISA_AUTO);
+    state.SetBytesProcessed(state.iterations() * (bv_len(a) / 8));
+}
+BENCHMARK(BM_Complement)->Apply(size_isa_args);
+
+static void BM_HammingDistance(benchmark::State &state)
+{
+    bitvector *a = bench::cached_bitvector(state.range(0), 500, 1);
+    bitvector *b = bench::cached_bitvector(state.range(0), 500, 2);
+
+    for (auto _ : state)
+        benchmark::DoNotOptimize(bv_hamming_distance(a, b));
+    state.SetBytesProcessed(state.iterations() * 2 * (bv_len(a) / 8));
+}
+BENCHMARK(BM_HammingDistance)->Apply(bench::size_args);
+
+static void BM_Copy(benchmark::State &state)
+{
+    bitvector *a = bench::cached_bitvector(state.range(0), 500);
+
+    for (auto _ : state)
+    {
+        bitvector *c = bv_copy(a);
+        benchmark::DoNotOptimize(c->data);
+        bv_free(c);
+    }
+    state.SetBytesProcessed(state.iterations() * (bv_len(a) / 8));
+}
+BENCHMARK(BM_Copy)->Apply(bench::size_args);
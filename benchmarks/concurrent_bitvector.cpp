@@ -0,0 +1,120 @@
+#include "bench_utils.h"
+#include "concurrent_bitvector.h"
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+/**
+ * Threads marking random positions of a shared 64M-bit visited set.
+ *
+ * The baseline wraps `bv_set` in a mutex, which serializes every thread; the concurrent variants load the word,
+ * and only when the bit changes do one atomic read-modify-write on it plus plain stores to the thread's own counter.
+ * `items_per_second` counts the writes of all threads.
+ */
+
+static const uint64_t kVisitedBits = 1UL << 26;
+static const uint64_t kWritesPerIteration = 1UL << 16;
+
+static const std::vector<uint64_t> &visit_order()
+{
+    static const std::vector<uint64_t> positions =
+        bench::random_positions(bench::kNumQueries, 0, kVisitedBits, false);
+    return positions;
+}
+
+static void BM_MutexSet(benchmark::State &state)
+{
+    static bitvector *bv = nullptr;
+    static std::mutex lock;
+    const std::vector<uint64_t> &positions = visit_order();
+    size_t i = state.thread_index() * kWritesPerIteration;
+
+    if (state.thread_index() == 0)
+        bv = bv_new(kVisitedBits);
+    for (auto _ : state)
+    {
+        for (uint64_t k = 0; k < kWritesPerIteration; k++, i++)
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            bv_set(bv, positions[i % positions.size()]);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * kWritesPerIteration);
+    if (state.thread_index() == 0)
+        bv_free(bv);
+}
+BENCHMARK(BM_MutexSet)->ThreadRange(1, 8)->UseRealTime();
+
+static void BM_ConcurrentTestAndSet(benchmark::State &state)
+{
+    static concurrent_bitvector *cbv = nullptr;
+    const std::vector<uint64_t> &positions = visit_order();
+    cbv_order order = (cbv_order)state.range(0);
+    size_t i = state.thread_index() * kWritesPerIteration;
+    uint64_t fresh = 0;
+    bool old;
+
+    if (state.thread_index() == 0)
+        cbv = cbv_new(kVisitedBits);
+    for (auto _ : state)
+    {
+        for (uint64_t k = 0; k < kWritesPerIteration; k++, i++)
+        {
+            cbv_test_and_set(cbv, positions[i % positions.size()], order, &old);
+            fresh += !old;
+        }
+    }
+    benchmark::DoNotOptimize(fresh);
+    state.SetItemsProcessed(state.iterations() * kWritesPerIteration);
+    if (state.thread_index() == 0)
+        cbv_free(cbv);
+}
+BENCHMARK(BM_ConcurrentTestAndSet)->ArgName("acq_rel")->Arg(CBV_RELAXED)->Arg(CBV_ACQ_REL)->ThreadRange(1, 8)->UseRealTime();
+
+static void BM_ConcurrentCount(benchmark::State &state)
+{
+    concurrent_bitvector *cbv = cbv_new(kVisitedBits);
+
+    for (uint64_t pos : visit_order())
+        cbv_set(cbv, pos, CBV_RELAXED);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(cbv_count(cbv));
+    cbv_free(cbv);
+}
+BENCHMARK(BM_ConcurrentCount);
+
+static void BM_ConcurrentCountUnderWrites(benchmark::State &state)
+{
+    /* the timed thread counts while `writers` other threads toggle random bits without pause */
+    concurrent_bitvector *cbv = cbv_new(kVisitedBits);
+    const std::vector<uint64_t> &positions = visit_order();
+    std::atomic<bool> done{false};
+    std::vector<std::thread> writers;
+
+    for (uint64_t pos : positions)
+        cbv_set(cbv, pos, CBV_RELAXED);
+    for (int64_t t = 0; t < state.range(0); t++)
+        writers.emplace_back([&, t] {
+            for (size_t i = t * kWritesPerIteration; !done.load(std::memory_order_relaxed); i++)
+                cbv_toggle(cbv, positions[i % positions.size()], CBV_RELAXED);
+        });
+    for (auto _ : state)
+        benchmark::DoNotOptimize(cbv_count(cbv));
+    done = true;
+    for (std::thread &writer : writers)
+        writer.join();
+    cbv_free(cbv);
+}
+BENCHMARK(BM_ConcurrentCountUnderWrites)->ArgName("writers")->Arg(1)->Arg(4)->UseRealTime();
+
+static void BM_ConcurrentCountExact(benchmark::State &state)
+{
+    concurrent_bitvector *cbv = cbv_new(kVisitedBits);
+
+    for (uint64_t pos : visit_order())
+        cbv_set(cbv, pos, CBV_RELAXED);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(cbv_count_exact(cbv));
+    cbv_free(cbv);
+}
+BENCHMARK(BM_ConcurrentCountExact);
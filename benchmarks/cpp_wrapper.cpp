@@ -0,0 +1,128 @@
+#include "bench_utils.h"
+#include "bitvector.hpp"
+
+/**
+ * The C++ interface against the C calls it wraps: random reads through `operator[]` and `bv_isset`,
+ * `(a & b) ^ c` as one fused pass against `bv_intersection` then `bv_xor` with a temporary,
+ * and the rank of a fixed-size `rs::bitset` against that of an equally long `bitvector`.
+ */
+
+static void BM_IssetC(benchmark::State &state)
+{
+    bitvector *bv = bench::cached_bitvector(state.range(0), 500);
+    std::vector<uint64_t> positions = bench::random_positions(bench::kNumQueries, 0, state.range(0), false);
+    uint64_t sum = 0;
+
+    for (auto _ : state)
+    {
+        for (uint64_t pos : positions)
+            sum += bv_isset(bv, pos);
+    }
+    benchmark::DoNotOptimize(sum);
+    state.SetItemsProcessed(state.iterations() * positions.size());
+}
+BENCHMARK(BM_IssetC)->ArgName("bits")->Arg(1L << 14)->Arg(1L << 22)->Arg(1L << 30);
+
+static void BM_SubscriptCpp(benchmark::State &state)
+{
+    rs::bitvector bv = rs::bitvector::adopt(bench::random_bitvector(state.range(0), 500, 42));
+    std::vector<uint64_t> positions = bench::random_positions(bench::kNumQueries, 0, state.range(0), false);
+    uint64_t sum = 0;
+
+    for (auto _ : state)
+    {
+        for (uint64_t pos : positions)
+            sum += bv[pos];
+    }
+    benchmark::DoNotOptimize(sum);
+    state.SetItemsProcessed(state.iterations() * positions.size());
+}
+BENCHMARK(BM_SubscriptCpp)->ArgName("bits")->Arg(1L << 14)->Arg(1L << 22)->Arg(1L << 30);
+
+static void BM_AndXorChained(benchmark::State &state)
+{
+    uint64_t size = state.range(0);
+    bitvector *a = bench::random_bitvector(size, 500, 1), *b = bench::random_bitvector(size, 500, 2),
+              *c = bench::random_bitvector(size, 500, 3), *t, *x;
+
+    for (auto _ : state)
+    {
+        t = bv_intersection(a, b);
+        x = bv_xor(t, c);
+        benchmark::DoNotOptimize(x->data[0]);
+        bv_free(t);
+        bv_free(x);
+    }
+    state.SetBytesProcessed(state.iterations() * 3 * (size / 8));
+    bv_free(a);
+    bv_free(b);
+    bv_free(c);
+}
+BENCHMARK(BM_AndXorChained)->ArgName("bits")->RangeMultiplier(16)->Range(1L << 12, 1L << 28);
+
+static void BM_AndXorFused(benchmark::State &state)
+{
+    uint64_t size = state.range(0);
+    rs::bitvector a = rs::bitvector::adopt(bench::random_bitvector(size, 500, 1)),
+                  b = rs::bitvector::adopt(bench::random_bitvector(size, 500, 2)),
+                  c = rs::bitvector::adopt(bench::random_bitvector(size, 500, 3)), x(size);
+
+    for (auto _ : state)
+    {
+        x = (a & b) ^ c;
+        benchmark::DoNotOptimize(x.data()[0]);
+    }
+    state.SetBytesProcessed(state.iterations() * 3 * (size / 8));
+}
+BENCHMARK(BM_AndXorFused)->ArgName("bits")->RangeMultiplier(16)->Range(1L << 12, 1L << 28);
+
+static void BM_AndXorCountFused(benchmark::State &state)
+{
+    uint64_t size = state.range(0);
+    rs::bitvector a = rs::bitvector::adopt(bench::random_bitvector(size, 500, 1)),
+                  b = rs::bitvector::adopt(bench::random_bitvector(size, 500, 2)),
+                  c = rs::bitvector::adopt(bench::random_bitvector(size, 500, 3));
+
+    for (auto _ : state)
+        benchmark::DoNotOptimize(rs::count((a & b) ^ c));
+    state.SetBytesProcessed(state.iterations() * 3 * (size / 8));
+}
+BENCHMARK(BM_AndXorCountFused)->ArgName("bits")->RangeMultiplier(16)->Range(1L << 12, 1L << 28);
+
+static const size_t kFixedBits = 512;
+
+static void BM_FixedRankBitvector(benchmark::State &state)
+{
+    bitvector *bv = bench::random_bitvector(kFixedBits, 500, 42);
+    std::vector<uint64_t> positions = bench::random_positions(bench::kNumQueries, 0, kFixedBits, false);
+    uint64_t sum = 0;
+
+    for (auto _ : state)
+    {
+        for (uint64_t pos : positions)
+            sum += bv_count_range(bv, 1, 0, pos);
+    }
+    benchmark::DoNotOptimize(sum);
+    state.SetItemsProcessed(state.iterations() * positions.size());
+    bv_free(bv);
+}
+BENCHMARK(BM_FixedRankBitvector);
+
+static void BM_FixedRankBitset(benchmark::State &state)
+{
+    rs::bitset<kFixedBits> bits;
+    std::vector<uint64_t> positions = bench::random_positions(bench::kNumQueries, 0, kFixedBits, false);
+    std::vector<uint64_t> set = bench::random_positions(kFixedBits / 2, 0, kFixedBits, false);
+    uint64_t sum = 0;
+
+    for (uint64_t pos : set)
+        bits.set(pos);
+    for (auto _ : state)
+    {
+        for (uint64_t pos : positions)
+            sum += bits.rank(pos);
+    }
+    benchmark::DoNotOptimize(sum);
+    state.SetItemsProcessed(state.iterations() * positions.size());
+}
+BENCHMARK(BM_FixedRankBitset);
@@ -0,0 +1,67 @@
+#include "bench_utils.h"
+
+/**
+ * Enumerating the set bits of a 16M-bit vector.
+ *
+ * `items_per_second` counts decoded positions.
+ */
+
+static const int64_t kDecodeBits = 1L << 24;
+
+static void BM_DecodeIsset(benchmark::State &state)
+{
+    bitvector *bv = bench::cached_bitvector(kDecodeBits, state.range(0));
+    std::vector<uint32_t> out(bv_rank(bv, bv_len(bv)));
+    uint64_t i, count;
+
+    for (auto _ : state)
+    {
+        for (count = 0, i = 0; i < bv_len(bv); i++)
+            if (bv_isset(bv, i))
+                out[count++] = i;
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(state.iterations() * out.size());
+}
+BENCHMARK(BM_DecodeIsset)->ArgName("density_ppt")->ArgsProduct({bench::kDensities})->Unit(benchmark::kMicrosecond);
+
+static void BM_DecodeNextSet(benchmark::State &state)
+{
+    bitvector *bv = bench::cached_bitvector(kDecodeBits, state.range(0));
+    std::vector<uint32_t> out(bv_rank(bv, bv_len(bv)));
+    uint64_t count;
+    int64_t pos;
+
+    for (auto _ : state)
+    {
+        for (count = 0, pos = bv_next_set(bv, 0); pos >= 0; pos = bv_next_set(bv, pos + 1))
+            out[count++] = pos;
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(state.iterations() * out.size());
+}
+BENCHMARK(BM_DecodeNextSet)->ArgName("density_ppt")->ArgsProduct({bench::kDensities})->Unit(benchmark::kMicrosecond);
+
+static void BM_DecodePositions(benchmark::State &state)
+{
+    bitvector *bv = bench::cached_bitvector(kDecodeBits, state.range(0));
+    std::vector<uint32_t> out(bv_rank(bv, bv_len(bv)));
+
+    if (bv_use_isa((bv_isa)state.range(1)) != state.range(1))
+    {
+        state.SkipWithError("instruction set not supported by this CPU");
+        bv_use_isa(BV_ISA_AUTO);
+        return;
+    }
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(bv_decode_positions(bv, 0, bv_len(bv), out.data()));
+        benchmark::DoNotOptimize(out.data());
+    }
+    bv_use_isa(BV_ISA_AUTO);
+    state.SetItemsProcessed(state.iterations() * out.size());
+}
+BENCHMARK(BM_DecodePositions)
+    ->ArgNames({"density_ppt", "isa"})
+    ->ArgsProduct({bench::kDensities, {BV_ISA_SCALAR, BV_ISA_AVX2, BV_ISA_AVX512}})
+    ->Unit(benchmark::kMicrosecond);
@@ -0,0 +1,108 @@
+#include "bench_utils.h"
+#include "dynamic_bitvector.h"
+
+/**
+ * The B+-tree dynamic bitvector against the plain layout.
+ *
+ * Insertions and deletions alternate at random positions so the length stays fixed across iterations;
+ * `BM_PlainInsertDelete` does the same with memmove-style word shifts to show the O(n) baseline.
+ */
+
+static const std::vector<int64_t> kDynamicSizes = {1L << 16, 1L << 20, 1L << 24};
+
+static dynamic_bitvector *cached_dynamic(uint64_t size)
+{
+    static dynamic_bitvector *dbv = nullptr;
+    static uint64_t cached_size = 0;
+
+    if (cached_size != size)
+    {
+        if (dbv != nullptr)
+            dbv_free(dbv);
+        dbv = dbv_from_bitvector(bench::cached_bitvector(size, 500));
+        cached_size = size;
+    }
+    return dbv;
+}
+
+static void BM_DynamicInsertDelete(benchmark::State &state)
+{
+    dynamic_bitvector *dbv = cached_dynamic(state.range(0));
+    std::vector<uint64_t> positions = bench::random_positions(bench::kNumQueries, 0, dbv_len(dbv), false);
+    uint64_t i = 0;
+
+    for (auto _ : state)
+    {
+        dbv_insert(dbv, positions[i], i & 1);
+        dbv_delete(dbv, positions[(i + 1) % bench::kNumQueries]);
+        i = (i + 2) % bench::kNumQueries;
+    }
+    state.SetItemsProcessed(state.iterations() * 2);
+    state.counters["bytes_per_bit"] = (double)dbv_bytes(dbv) / (double)dbv_len(dbv);
+}
+BENCHMARK(BM_DynamicInsertDelete)->ArgName("bits")->ArgsProduct({kDynamicSizes});
+
+static void BM_PlainInsertDelete(benchmark::State &state)
+{
+    bitvector *bv = bench::random_bitvector(state.range(0), 500, 42);
+    std::vector<uint64_t> positions = bench::random_positions(bench::kNumQueries, 0, bv_len(bv), false);
+    uint64_t i = 0, w, p, carry, next, nwords = bv_len(bv) / WORD_SIZE;
+
+    for (auto _ : state)
+    {
+        /* insert a bit at p, dropping the last bit, then delete the bit at the next position and append a zero */
+        p = positions[i];
+        w = p / WORD_SIZE;
+        carry = bv->data[w] >> (WORD_SIZE - 1);
+        bv->data[w] = (bv->data[w] & ((BIT << (p % WORD_SIZE)) - 1)) | ((bv->data[w] << 1) & ~((BIT << (p % WORD_SIZE)) - 1));
+        for (w++; w < nwords; w++)
+        {
+            next = bv->data[w] >> (WORD_SIZE - 1);
+            bv->data[w] = (bv->data[w] << 1) | carry;
+            carry = next;
+        }
+        p = positions[(i + 1) % bench::kNumQueries];
+        w = p / WORD_SIZE;
+        bv->data[w] = (bv->data[w] & ((BIT << (p % WORD_SIZE)) - 1)) | ((bv->data[w] >> 1) & ~((BIT << (p % WORD_SIZE)) - 1));
+        for (w++; w < nwords; w++)
+        {
+            bv->data[w - 1] |= (bv->data[w] & BIT) << (WORD_SIZE - 1);
+            bv->data[w] >>= 1;
+        }
+        benchmark::DoNotOptimize(bv->data);
+        i = (i + 2) % bench::kNumQueries;
+    }
+    state.SetItemsProcessed(state.iterations() * 2);
+    bv_free(bv);
+}
+BENCHMARK(BM_PlainInsertDelete)->ArgName("bits")->ArgsProduct({kDynamicSizes});
+
+static void BM_DynamicRank(benchmark::State &state)
+{
+    dynamic_bitvector *dbv = cached_dynamic(state.range(0));
+    std::vector<uint64_t> positions = bench::random_positions(bench::kNumQueries, 0, dbv_len(dbv) + 1, false);
+    uint64_t i = 0;
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(dbv_rank(dbv, positions[i]));
+        i = (i + 1) % bench::kNumQueries;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_DynamicRank)->ArgName("bits")->ArgsProduct({kDynamicSizes});
+
+static void BM_DynamicSelect(benchmark::State &state)
+{
+    dynamic_bitvector *dbv = cached_dynamic(state.range(0));
+    std::vector<uint64_t> ks = bench::random_positions(bench::kNumQueries, 1, dbv_count(dbv) + 1, false);
+    uint64_t i = 0;
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(dbv_select(dbv, ks[i]));
+        i = (i + 1) % bench::kNumQueries;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_DynamicSelect)->ArgName("bits")->ArgsProduct({kDynamicSizes});
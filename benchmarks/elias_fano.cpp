@@ -0,0 +1,144 @@
+#include "bench_utils.h"
+#include "elias_fano.h"
+
+/**
+ * Elias-Fano against the plain layout on sparse inputs, reporting the bytes used by each.
+ */
+
+static const std::vector<int64_t> kSparseDensities = {1, 10};
+
+static void sparse_args(benchmark::internal::Benchmark *b)
+{
+    b->ArgNames({"bits", "density_ppt"})->ArgsProduct({bench::kSizes, kSparseDensities});
+}
+
+static elias_fano *cached_elias_fano(uint64_t size, uint64_t density)
+{
+    static elias_fano *ef = nullptr;
+    static uint64_t cached_size = 0, cached_density = 0;
+
+    if (ef == nullptr || cached_size != size || cached_density != density)
+    {
+        ef_free(ef);
+        ef = ef_from_bitvector(bench::cached_bitvector(size, density));
+        cached_size = size;
+        cached_density = density;
+    }
+    return ef;
+}
+
+static void report_bytes(benchmark::State &state, bitvector *bv, elias_fano *ef)
+{
+    state.counters["plain_bytes"] = (double)(((bv_len(bv) >> LOG_WORD_SIZE) + BIT) * sizeof(uint64_t) +
+                                             bv_index_bytes(bv));
+    state.counters["ef_bytes"] = (double)ef_bytes(ef);
+}
+
+static void BM_EliasFanoBuild(benchmark::State &state)
+{
+    bitvector *bv = bench::cached_bitvector(state.range(0), state.range(1));
+    elias_fano *ef = nullptr;
+
+    for (auto _ : state)
+    {
+        ef = ef_from_bitvector(bv);
+        benchmark::DoNotOptimize(ef);
+        state.PauseTiming();
+        ef_free(ef);
+        state.ResumeTiming();
+    }
+    state.SetBytesProcessed(state.iterations() * (bv_len(bv) / 8));
+}
+BENCHMARK(BM_EliasFanoBuild)->Apply(sparse_args)->Unit(benchmark::kMillisecond);
+
+static void BM_EliasFanoSelect(benchmark::State &state)
+{
+    bitvector *bv = bench::cached_bitvector(state.range(0), state.range(1));
+    elias_fano *ef = cached_elias_fano(state.range(0), state.range(1));
+    uint64_t ones = ef_count(ef);
+    std::vector<uint64_t> ks = bench::random_positions(bench::kNumQueries, 1, ones + 1, false);
+    uint64_t i = 0;
+
+    if (ones == 0)
+    {
+        state.SkipWithError("no set bits");
+        return;
+    }
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(ef_select(ef, ks[i]));
+        i = (i + 1) % bench::kNumQueries;
+    }
+    state.SetItemsProcessed(state.iterations());
+    report_bytes(state, bv, ef);
+}
+BENCHMARK(BM_EliasFanoSelect)->Apply(sparse_args);
+
+static void BM_PlainSelect(benchmark::State &state)
+{
+    bitvector *bv = bench::cached_bitvector(state.range(0), state.range(1));
+    uint64_t ones = bv_rank(bv, bv_len(bv));
+    std::vector<uint64_t> ks = bench::random_positions(bench::kNumQueries, 1, ones + 1, false);
+    uint64_t i = 0;
+
+    if (ones == 0)
+    {
+        state.SkipWithError("no set bits");
+        return;
+    }
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(bv_select(bv, ks[i]));
+        i = (i + 1) % bench::kNumQueries;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_PlainSelect)->Apply(sparse_args);
+
+static void BM_EliasFanoRank(benchmark::State &state)
+{
+    bitvector *bv = bench::cached_bitvector(state.range(0), state.range(1));
+    elias_fano *ef = cached_elias_fano(state.range(0), state.range(1));
+    std::vector<uint64_t> positions = bench::random_positions(bench::kNumQueries, 0, bv_len(bv) + 1, false);
+    uint64_t i = 0;
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(ef_rank(ef, positions[i]));
+        i = (i + 1) % bench::kNumQueries;
+    }
+    state.SetItemsProcessed(state.iterations());
+    report_bytes(state, bv, ef);
+}
+BENCHMARK(BM_EliasFanoRank)->Apply(sparse_args);
+
+static void BM_PlainRank(benchmark::State &state)
+{
+    bitvector *bv = bench::cached_bitvector(state.range(0), state.range(1));
+    std::vector<uint64_t> positions = bench::random_positions(bench::kNumQueries, 0, bv_len(bv) + 1, false);
+    uint64_t i = 0;
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(bv_rank(bv, positions[i]));
+        i = (i + 1) % bench::kNumQueries;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_PlainRank)->Apply(sparse_args);
+
+static void BM_EliasFanoSuccessor(benchmark::State &state)
+{
+    bitvector *bv = bench::cached_bitvector(state.range(0), state.range(1));
+    elias_fano *ef = cached_elias_fano(state.range(0), state.range(1));
+    std::vector<uint64_t> positions = bench::random_positions(bench::kNumQueries, 0, bv_len(bv), false);
+    uint64_t i = 0;
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(ef_successor(ef, positions[i]));
+        i = (i + 1) % bench::kNumQueries;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_EliasFanoSuccessor)->Apply(sparse_args);
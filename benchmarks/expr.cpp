@@ -0,0 +1,118 @@
+#include "bench_utils.h"
+
+/**
+ * Intersecting K bitvectors of 64M bits: a chain of pairwise `bv_intersection_into` against one tiled `bv_eval`.
+ *
+ * The chain streams an intermediate result of 8MB through memory K - 1 times, while `bv_eval` keeps it in L1
+ * and stops reading operands once a tile is empty, which the sparse densities make likely.
+ * `bytes_per_second` counts the bytes of all K operands.
+ */
+
+static const int64_t kExprBits = 1L << 26;
+
+struct expr_operands
+{
+    std::vector<bitvector *> bvs;
+    std::vector<bv_expr> leaves;
+    std::vector<const bv_expr *> children;
+    bv_expr root;
+
+    expr_operands(int64_t k, int64_t density, bv_expr_op op) : bvs(k), leaves(k), children(k)
+    {
+        for (int64_t i = 0; i < k; i++)
+        {
+            /* not cached: the cache only keeps two vectors alive */
+            bvs[i] = bench::random_bitvector(kExprBits, density, 42 + i);
+            leaves[i] = bv_expr{BV_EXPR_LEAF, bvs[i], 0, nullptr};
+            children[i] = &leaves[i];
+        }
+        root = bv_expr{op, nullptr, (size_t)k, children.data()};
+    }
+
+    ~expr_operands()
+    {
+        for (bitvector *bv : bvs)
+            bv_free(bv);
+    }
+};
+
+static void expr_args(benchmark::internal::Benchmark *b)
+{
+    b->ArgNames({"k", "density_ppt"})->ArgsProduct({{2, 4, 8}, {100, 500, 900}});
+}
+
+static void BM_IntersectChain(benchmark::State &state)
+{
+    expr_operands ops(state.range(0), state.range(1), BV_EXPR_AND);
+    bitvector *dst = bv_new(kExprBits);
+    size_t i;
+
+    for (auto _ : state)
+    {
+        bv_intersection_into(dst, ops.bvs[0], ops.bvs[1]);
+        for (i = 2; i < ops.bvs.size(); i++)
+            bv_intersection_inplace(dst, ops.bvs[i]);
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0) * kExprBits / 8);
+    bv_free(dst);
+}
+BENCHMARK(BM_IntersectChain)->Apply(expr_args)->Unit(benchmark::kMillisecond);
+
+static void BM_EvalAnd(benchmark::State &state)
+{
+    expr_operands ops(state.range(0), state.range(1), BV_EXPR_AND);
+    bitvector *dst = bv_new(kExprBits);
+
+    for (auto _ : state)
+    {
+        bv_eval_into(dst, &ops.root);
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0) * kExprBits / 8);
+    bv_free(dst);
+}
+BENCHMARK(BM_EvalAnd)->Apply(expr_args)->Unit(benchmark::kMillisecond);
+
+static void BM_EvalAndCount(benchmark::State &state)
+{
+    expr_operands ops(state.range(0), state.range(1), BV_EXPR_AND);
+
+    for (auto _ : state)
+        benchmark::DoNotOptimize(bv_eval_count(&ops.root));
+    state.SetBytesProcessed(state.iterations() * state.range(0) * kExprBits / 8);
+}
+BENCHMARK(BM_EvalAndCount)->Apply(expr_args)->Unit(benchmark::kMillisecond);
+
+static void BM_UnionChain(benchmark::State &state)
+{
+    expr_operands ops(state.range(0), state.range(1), BV_EXPR_OR);
+    bitvector *dst = bv_new(kExprBits);
+    size_t i;
+
+    for (auto _ : state)
+    {
+        bv_union_into(dst, ops.bvs[0], ops.bvs[1]);
+        for (i = 2; i < ops.bvs.size(); i++)
+            bv_union_inplace(dst, ops.bvs[i]);
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0) * kExprBits / 8);
+    bv_free(dst);
+}
+BENCHMARK(BM_UnionChain)->Apply(expr_args)->Unit(benchmark::kMillisecond);
+
+static void BM_EvalOr(benchmark::State &state)
+{
+    expr_operands ops(state.range(0), state.range(1), BV_EXPR_OR);
+    bitvector *dst = bv_new(kExprBits);
+
+    for (auto _ : state)
+    {
+        bv_eval_into(dst, &ops.root);
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0) * kExprBits / 8);
+    bv_free(dst);
+}
+BENCHMARK(BM_EvalOr)->Apply(expr_args)->Unit(benchmark::kMillisecond);
@@ -0,0 +1,49 @@
+#include "bench_utils.h"
+#include <cstdio>
+#include <string>
+
+/**
+ * Opening a saved bitvector and querying the zero-copy view.
+ */
+
+static std::string saved_file(uint64_t bits)
+{
+    std::string path = "/tmp/rank_select_bench_" + std::to_string(bits) + ".bv";
+    static uint64_t saved_bits = 0;
+
+    if (saved_bits != bits)
+    {
+        bv_save(bench::cached_bitvector(bits, 500), path.c_str());
+        saved_bits = bits;
+    }
+    return path;
+}
+
+static void BM_MmapOpen(benchmark::State &state)
+{
+    std::string path = saved_file(state.range(0));
+
+    for (auto _ : state)
+    {
+        bitvector *bv = bv_mmap(path.c_str());
+        benchmark::DoNotOptimize(bv_rank(bv, bv_len(bv) / 2));
+        bv_free(bv);
+    }
+}
+BENCHMARK(BM_MmapOpen)->Apply(bench::size_args)->Unit(benchmark::kMicrosecond);
+
+static void BM_MmapRank(benchmark::State &state)
+{
+    bitvector *bv = bv_mmap(saved_file(state.range(0)).c_str());
+    std::vector<uint64_t> positions = bench::random_positions(bench::kNumQueries, 0, bv_len(bv) + 1, false);
+    uint64_t i = 0;
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(bv_rank(bv, positions[i]));
+        i = (i + 1) % bench::kNumQueries;
+    }
+    state.SetItemsProcessed(state.iterations());
+    bv_free(bv);
+}
+BENCHMARK(BM_MmapRank)->Apply(bench::size_args);
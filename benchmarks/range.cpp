@@ -0,0 +1,88 @@
+#include "bench_utils.h"
+
+/**
+ * Setting, flipping and counting a range covering most of a 64M-bit vector.
+ *
+ * The range starts and ends mid-word, so the masked head and tail words are exercised.
+ * `bytes_per_second` counts the bytes of the range.
+ */
+
+static const int64_t kRangeBits = 1L << 26;
+static const uint64_t kRangeFrom = 13, kRangeTo = kRangeBits - 29;
+
+static void BM_RangeSetBitwise(benchmark::State &state)
+{
+    bitvector *bv = bv_new(kRangeBits);
+    uint64_t i;
+
+    for (auto _ : state)
+    {
+        for (i = kRangeFrom; i < kRangeTo; i++)
+            bv_set(bv, i);
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(state.iterations() * (kRangeTo - kRangeFrom) / 8);
+    bv_free(bv);
+}
+BENCHMARK(BM_RangeSetBitwise)->Unit(benchmark::kMillisecond);
+
+static void BM_RangeSet(benchmark::State &state)
+{
+    bitvector *bv = bv_new(kRangeBits);
+    uint8_t bit = 0;
+
+    for (auto _ : state)
+    {
+        bv_range_set(bv, bit ^= 1, kRangeFrom, kRangeTo);
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(state.iterations() * (kRangeTo - kRangeFrom) / 8);
+    bv_free(bv);
+}
+BENCHMARK(BM_RangeSet)->Unit(benchmark::kMillisecond);
+
+static void BM_RangeFlip(benchmark::State &state)
+{
+    bitvector *bv = bv_new(kRangeBits);
+
+    for (auto _ : state)
+    {
+        bv_range_flip(bv, kRangeFrom, kRangeTo);
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(state.iterations() * (kRangeTo - kRangeFrom) / 8);
+    bv_free(bv);
+}
+BENCHMARK(BM_RangeFlip)->Unit(benchmark::kMillisecond);
+
+/* the same range set with a rank directory maintained by each policy, including the first query after it */
+static void BM_RangeSetThenRank(benchmark::State &state)
+{
+    bitvector *bv = bv_new(kRangeBits);
+    uint8_t bit = 0;
+
+    bv_build_rank(bv);
+    bv_set_rank_policy(bv, (bv_rank_policy)state.range(0));
+    for (auto _ : state)
+    {
+        bv_range_set(bv, bit ^= 1, kRangeFrom, kRangeTo);
+        benchmark::DoNotOptimize(bv_rank(bv, kRangeBits / 2));
+    }
+    state.SetBytesProcessed(state.iterations() * (kRangeTo - kRangeFrom) / 8);
+    bv_free(bv);
+}
+BENCHMARK(BM_RangeSetThenRank)
+    ->ArgName("policy")
+    ->Arg(BV_RANK_EAGER)
+    ->Arg(BV_RANK_LAZY)
+    ->Unit(benchmark::kMillisecond);
+
+static void BM_CountRange(benchmark::State &state)
+{
+    bitvector *bv = bench::cached_bitvector(kRangeBits, 500);
+
+    for (auto _ : state)
+        benchmark::DoNotOptimize(bv_count_range(bv, 1, kRangeFrom, kRangeTo));
+    state.SetBytesProcessed(state.iterations() * (kRangeTo - kRangeFrom) / 8);
+}
+BENCHMARK(BM_CountRange)->Unit(benchmark::kMillisecond);
@@ -0,0 +1,39 @@
+#include "bench_utils.h"
+
+/**
+ * Keeping the rank directory current under point writes.
+ *
+ * Each iteration toggles `burst` random bits, then answers one rank query.
+ * `snapshot` rebuilds the whole directory after the burst, the only option before rank policies;
+ * `eager` pays on every write, `lazy` once per burst.
+ * Bits are toggled twice per pair of iterations, so the vector does not drift.
+ */
+
+static void BM_WriteBurstThenRank(benchmark::State &state, bv_rank_policy policy)
+{
+    bitvector *bv = bench::random_bitvector(state.range(0), 500, 42);
+    std::vector<uint64_t> positions = bench::random_positions(bench::kNumQueries, 0, bv_len(bv), false);
+    uint64_t i = 0, w, burst = state.range(1);
+
+    bv_build_rank(bv);
+    bv_set_rank_policy(bv, policy);
+    for (auto _ : state)
+    {
+        for (w = 0; w < burst; w++)
+            bv_toggle(bv, positions[(i + w) % bench::kNumQueries]);
+        if (policy == BV_RANK_SNAPSHOT)
+            bv_build_rank(bv);
+        benchmark::DoNotOptimize(bv_rank(bv, positions[(i + burst) % bench::kNumQueries]));
+        i = (i + burst + 1) % bench::kNumQueries;
+    }
+    state.SetItemsProcessed(state.iterations() * burst);
+    bv_free(bv);
+}
+
+static void policy_args(benchmark::internal::Benchmark *b)
+{
+    b->ArgNames({"bits", "burst"})->ArgsProduct({{1L << 20, 1L << 26, 1L << 30}, {1, 64, 4096}});
+}
+BENCHMARK_CAPTURE(BM_WriteBurstThenRank, snapshot, BV_RANK_SNAPSHOT)->Apply(policy_args)->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_WriteBurstThenRank, eager, BV_RANK_EAGER)->Apply(policy_args)->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_WriteBurstThenRank, lazy, BV_RANK_LAZY)->Apply(policy_args)->Unit(benchmark::kMicrosecond);
@@ -0,0 +1,163 @@
+#include "bench_utils.h"
+
+/**
+ * Rank, select and point-access benchmarks.
+ *
+ * Each iteration answers a single query, so the reported time is ns/op and `items_per_second` is the query throughput.
+ * Run with `--benchmark_out=<file> --benchmark_out_format=json` (or the `bench_json` target) and compare two runs with
+ * Google Benchmark's `tools/compare.py` to catch regressions between releases.
+ */
+
+static void BM_Rank(benchmark::State &state, bool sequential)
+{
+    bitvector *bv = bench::cached_bitvector(state.range(0), state.range(1));
+    std::vector<uint64_t> positions = bench::random_positions(bench::kNumQueries, 0, bv_len(bv) + 1, sequential);
+    uint64_t i = 0;
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(bv_rank(bv, positions[i]));
+        i = (i + 1) % bench::kNumQueries;
+    }
+    state.SetItemsProcessed(state.iterations());
+    bench::report_index_overhead(state, bv);
+}
+BENCHMARK_CAPTURE(BM_Rank, random, false)->Apply(bench::size_density_args);
+BENCHMARK_CAPTURE(BM_Rank, sequential, true)->Apply(bench::size_density_args);
+
+static void BM_PopCount(benchmark::State &state)
+{
+    bitvector *bv = bench::cached_bitvector(state.range(0), state.range(1));
+    std::vector<uint64_t> positions = bench::random_positions(bench::kNumQueries, 0, bv_len(bv), false);
+    uint64_t i = 0;
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(bv_pop_count(bv, positions[i]));
+        i = (i + 1) % bench::kNumQueries;
+    }
+    state.SetItemsProcessed(state.iterations());
+    bench::report_index_overhead(state, bv);
+}
+BENCHMARK(BM_PopCount)->Apply(bench::size_density_args);
+
+static void BM_Select(benchmark::State &state, bool sequential)
+{
+    bitvector *bv = bench::cached_bitvector(state.range(0), state.range(1));
+    uint64_t ones = bv_rank(bv, bv_len(bv));
+    if (ones == 0)
+    {
+        state.SkipWithError("no set bits");
+        return;
+    }
+    std::vector<uint64_t> ranks = bench::random_positions(bench::kNumQueries, 1, ones + 1, sequential);
+    uint64_t i = 0;
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(bv_select(bv, ranks[i]));
+        i = (i + 1) % bench::kNumQueries;
+    }
+    state.SetItemsProcessed(state.iterations());
+    bench::report_index_overhead(state, bv);
+}
+BENCHMARK_CAPTURE(BM_Select, random, false)->Apply(bench::size_density_args);
+BENCHMARK_CAPTURE(BM_Select, sequential, true)->Apply(bench::size_density_args);
+
+static void BM_IsSet(benchmark::State &state, bool sequential)
+{
+    bitvector *bv = bench::cached_bitvector(state.range(0), 500);
+    std::vector<uint64_t> positions = bench::random_positions(bench::kNumQueries, 0, bv_len(bv), sequential);
+    uint64_t i = 0;
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(bv_isset(bv, positions[i]));
+        i = (i + 1) % bench::kNumQueries;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_CAPTURE(BM_IsSet, random, false)->Apply(bench::size_args);
+BENCHMARK_CAPTURE(BM_IsSet, sequential, true)->Apply(bench::size_args);
+
+static void BM_Set(benchmark::State &state, bool sequential)
+{
+    /* bv_set mutates its input, so it gets a private vector */
+    bitvector *bv = bv_new(state.range(0));
+    std::vector<uint64_t> positions = bench::random_positions(bench::kNumQueries, 0, bv_len(bv), sequential);
+    uint64_t i = 0;
+
+    for (auto _ : state)
+    {
+        bv_set(bv, positions[i]);
+        i = (i + 1) % bench::kNumQueries;
+    }
+    benchmark::DoNotOptimize(bv->data);
+    state.SetItemsProcessed(state.iterations());
+    bv_free(bv);
+}
+BENCHMARK_CAPTURE(BM_Set, random, false)->Apply(bench::size_args);
+BENCHMARK_CAPTURE(BM_Set, sequential, true)->Apply(bench::size_args);
+
+static void BM_IsSetLoop(benchmark::State &state, bool checked)
+{
+    /* a whole batch per iteration, so the inline accessor can be vectorized into gathers */
+    bitvector *bv = bench::cached_bitvector(state.range(0), 500);
+    std::vector<uint64_t> positions = bench::random_positions(bench::kNumQueries, 0, bv_len(bv), false);
+    uint64_t sum = 0;
+
+    for (auto _ : state)
+    {
+        if (checked)
+        {
+            for (uint64_t pos : positions)
+                sum += bv_isset(bv, pos);
+        }
+        else
+        {
+            for (uint64_t pos : positions)
+                sum += bv_isset_unchecked(bv, pos);
+        }
+    }
+    benchmark::DoNotOptimize(sum);
+    state.SetItemsProcessed(state.iterations() * bench::kNumQueries);
+}
+BENCHMARK_CAPTURE(BM_IsSetLoop, checked, true)->Apply(bench::size_args);
+BENCHMARK_CAPTURE(BM_IsSetLoop, unchecked, false)->Apply(bench::size_args);
+
+static void BM_SetLoop(benchmark::State &state, bool checked)
+{
+    bitvector *bv = bv_new(state.range(0));
+    std::vector<uint64_t> positions = bench::random_positions(bench::kNumQueries, 0, bv_len(bv), true);
+
+    for (auto _ : state)
+    {
+        if (checked)
+        {
+            for (uint64_t pos : positions)
+                bv_set(bv, pos);
+        }
+        else
+        {
+            for (uint64_t pos : positions)
+                bv_set_unchecked(bv, pos);
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * bench::kNumQueries);
+    bv_free(bv);
+}
+BENCHMARK_CAPTURE(BM_SetLoop, checked, true)->Apply(bench::size_args);
+BENCHMARK_CAPTURE(BM_SetLoop, unchecked, false)->Apply(bench::size_args);
+
+static void BM_BuildIndex(benchmark::State &state)
+{
+    bitvector *bv = bench::cached_bitvector(state.range(0), 500);
+
+    /* the cached vector already has select samples, so this rebuilds both directories */
+    for (auto _ : state)
+        bv_build_rank(bv);
+    state.SetBytesProcessed(state.iterations() * (bv_len(bv) / 8));
+    bench::report_index_overhead(state, bv);
+}
+BENCHMARK(BM_BuildIndex)->Apply(bench::size_args)->Unit(benchmark::kMillisecond);
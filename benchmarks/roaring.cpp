@@ -0,0 +1,177 @@
+#include "bench_utils.h"
+#include "roaring.h"
+
+/**
+ * Roaring bitmaps against the plain layout on inputs mixing empty, sparse, run-heavy and dense 64K chunks.
+ */
+
+static const std::vector<int64_t> kMixedSizes = {1L << 20, 1L << 24, 1L << 28};
+
+static bitvector *mixed_bitvector(uint64_t size, uint64_t seed)
+{
+    bitvector *bv = bv_new(size);
+    std::mt19937_64 rng(seed);
+    uint64_t chunk, lo, hi, i, start, length;
+
+    for (chunk = 0; chunk * RB_CHUNK_BITS < size; chunk++)
+    {
+        lo = chunk * RB_CHUNK_BITS;
+        hi = std::min(lo + RB_CHUNK_BITS, size);
+        switch (rng() % 4)
+        {
+        case 0: // empty
+            break;
+        case 1: // sparse scatter
+            for (i = 0; i < 64; i++)
+                bv_set(bv, lo + rng() % (hi - lo));
+            break;
+        case 2: // a few long runs
+            for (i = 0; i < 8; i++)
+            {
+                start = lo + rng() % (hi - lo);
+                length = rng() % 4096;
+                for (; start < hi && length-- > 0; start++)
+                    bv_set(bv, start);
+            }
+            break;
+        default: // dense noise
+            for (i = lo / WORD_SIZE; i < (hi + WORD_SIZE - 1) / WORD_SIZE; i++)
+                bv->data[i] = rng();
+            if (hi % WORD_SIZE)
+                bv->data[hi / WORD_SIZE] &= ~(ALL_ONES_MASK << (hi % WORD_SIZE));
+        }
+    }
+    return bv;
+}
+
+struct mixed_inputs
+{
+    bitvector *a, *b;
+    roaring_bitmap *ra, *rb;
+};
+
+static mixed_inputs &cached_inputs(uint64_t size)
+{
+    static mixed_inputs inputs = {nullptr, nullptr, nullptr, nullptr};
+    static uint64_t cached_size = 0;
+
+    if (cached_size != size)
+    {
+        if (inputs.a != nullptr)
+        {
+            bv_free(inputs.a);
+            bv_free(inputs.b);
+            rb_free(inputs.ra);
+            rb_free(inputs.rb);
+        }
+        inputs.a = mixed_bitvector(size, 1);
+        inputs.b = mixed_bitvector(size, 2);
+        bv_build_select(inputs.a);
+        inputs.ra = rb_from_bitvector(inputs.a);
+        inputs.rb = rb_from_bitvector(inputs.b);
+        cached_size = size;
+    }
+    return inputs;
+}
+
+static void report_bytes(benchmark::State &state, mixed_inputs &in)
+{
+    state.counters["plain_bytes"] = (double)(((bv_len(in.a) >> LOG_WORD_SIZE) + BIT) * sizeof(uint64_t));
+    state.counters["roaring_bytes"] = (double)rb_bytes(in.ra);
+}
+
+static void BM_RoaringFromBitvector(benchmark::State &state)
+{
+    mixed_inputs &in = cached_inputs(state.range(0));
+
+    for (auto _ : state)
+    {
+        roaring_bitmap *rb = rb_from_bitvector(in.a);
+        benchmark::DoNotOptimize(rb);
+        state.PauseTiming();
+        rb_free(rb);
+        state.ResumeTiming();
+    }
+    state.SetBytesProcessed(state.iterations() * (bv_len(in.a) / 8));
+    report_bytes(state, in);
+}
+BENCHMARK(BM_RoaringFromBitvector)->ArgName("bits")->ArgsProduct({kMixedSizes})->Unit(benchmark::kMillisecond);
+
+template <roaring_bitmap *(*op)(roaring_bitmap *, roaring_bitmap *)>
+static void BM_RoaringOp(benchmark::State &state)
+{
+    mixed_inputs &in = cached_inputs(state.range(0));
+
+    for (auto _ : state)
+    {
+        roaring_bitmap *rb = op(in.ra, in.rb);
+        benchmark::DoNotOptimize(rb);
+        rb_free(rb);
+    }
+    report_bytes(state, in);
+}
+BENCHMARK_TEMPLATE(BM_RoaringOp, rb_intersection)->ArgName("bits")->ArgsProduct({kMixedSizes})->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_RoaringOp, rb_union)->ArgName("bits")->ArgsProduct({kMixedSizes})->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_RoaringOp, rb_xor)->ArgName("bits")->ArgsProduct({kMixedSizes})->Unit(benchmark::kMicrosecond);
+
+template <bv_status (*op)(bitvector *, bitvector *, bitvector *)>
+static void BM_PlainOp(benchmark::State &state)
+{
+    mixed_inputs &in = cached_inputs(state.range(0));
+    bitvector *dst = bv_new(bv_len(in.a));
+
+    for (auto _ : state)
+    {
+        op(dst, in.a, in.b);
+        benchmark::DoNotOptimize(dst->data);
+    }
+    bv_free(dst);
+}
+BENCHMARK_TEMPLATE(BM_PlainOp, bv_intersection_into)->ArgName("bits")->ArgsProduct({kMixedSizes})->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_PlainOp, bv_union_into)->ArgName("bits")->ArgsProduct({kMixedSizes})->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_PlainOp, bv_xor_into)->ArgName("bits")->ArgsProduct({kMixedSizes})->Unit(benchmark::kMicrosecond);
+
+static void BM_RoaringRank(benchmark::State &state)
+{
+    mixed_inputs &in = cached_inputs(state.range(0));
+    std::vector<uint64_t> positions = bench::random_positions(bench::kNumQueries, 0, bv_len(in.a) + 1, false);
+    uint64_t i = 0;
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(rb_rank(in.ra, positions[i]));
+        i = (i + 1) % bench::kNumQueries;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_RoaringRank)->ArgName("bits")->ArgsProduct({kMixedSizes});
+
+static void BM_RoaringSelect(benchmark::State &state)
+{
+    mixed_inputs &in = cached_inputs(state.range(0));
+    std::vector<uint64_t> ks = bench::random_positions(bench::kNumQueries, 1, rb_count(in.ra) + 1, false);
+    uint64_t i = 0;
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(rb_select(in.ra, ks[i]));
+        i = (i + 1) % bench::kNumQueries;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_RoaringSelect)->ArgName("bits")->ArgsProduct({kMixedSizes});
+
+static void BM_PlainMixedSelect(benchmark::State &state)
+{
+    mixed_inputs &in = cached_inputs(state.range(0));
+    std::vector<uint64_t> ks = bench::random_positions(bench::kNumQueries, 1, rb_count(in.ra) + 1, false);
+    uint64_t i = 0;
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(bv_select(in.a, ks[i]));
+        i = (i + 1) % bench::kNumQueries;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_PlainMixedSelect)->ArgName("bits")->ArgsProduct({kMixedSizes});
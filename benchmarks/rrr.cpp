@@ -0,0 +1,110 @@
+#include "bench_utils.h"
+#include "rrr.h"
+
+/**
+ * RRR against the plain layout across densities and block sizes, reporting the bytes used by each.
+ */
+
+static const std::vector<int64_t> kBlockBits = {15, 31, 63};
+
+static void rrr_args(benchmark::internal::Benchmark *b)
+{
+    b->ArgNames({"bits", "density_ppt", "block_bits"})
+        ->ArgsProduct({{1L << 22, 1L << 26}, bench::kDensities, kBlockBits});
+}
+
+static rrr_vector *cached_rrr(uint64_t size, uint64_t density, uint32_t block_bits)
+{
+    static rrr_vector *rrr = nullptr;
+    static uint64_t cached_size = 0, cached_density = 0;
+    static uint32_t cached_block_bits = 0;
+
+    if (rrr == nullptr || cached_size != size || cached_density != density || cached_block_bits != block_bits)
+    {
+        rrr_free(rrr);
+        rrr = rrr_from_bitvector(bench::cached_bitvector(size, density), block_bits, RRR_DEFAULT_SAMPLE_RATE);
+        cached_size = size;
+        cached_density = density;
+        cached_block_bits = block_bits;
+    }
+    return rrr;
+}
+
+static void report_bytes(benchmark::State &state, bitvector *bv, rrr_vector *rrr)
+{
+    state.counters["plain_bytes"] = (double)(((bv_len(bv) >> LOG_WORD_SIZE) + BIT) * sizeof(uint64_t) +
+                                             bv_index_bytes(bv));
+    state.counters["rrr_bytes"] = (double)rrr_bytes(rrr);
+}
+
+static void BM_RRRBuild(benchmark::State &state)
+{
+    bitvector *bv = bench::cached_bitvector(state.range(0), state.range(1));
+    rrr_vector *rrr = nullptr;
+
+    for (auto _ : state)
+    {
+        rrr = rrr_from_bitvector(bv, state.range(2), RRR_DEFAULT_SAMPLE_RATE);
+        benchmark::DoNotOptimize(rrr);
+        state.PauseTiming();
+        rrr_free(rrr);
+        state.ResumeTiming();
+    }
+    state.SetBytesProcessed(state.iterations() * (bv_len(bv) / 8));
+}
+BENCHMARK(BM_RRRBuild)->Apply(rrr_args)->Unit(benchmark::kMillisecond);
+
+static void BM_RRRRank(benchmark::State &state)
+{
+    bitvector *bv = bench::cached_bitvector(state.range(0), state.range(1));
+    rrr_vector *rrr = cached_rrr(state.range(0), state.range(1), state.range(2));
+    std::vector<uint64_t> positions = bench::random_positions(bench::kNumQueries, 0, bv_len(bv) + 1, false);
+    uint64_t i = 0;
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(rrr_rank(rrr, positions[i]));
+        i = (i + 1) % bench::kNumQueries;
+    }
+    state.SetItemsProcessed(state.iterations());
+    report_bytes(state, bv, rrr);
+}
+BENCHMARK(BM_RRRRank)->Apply(rrr_args);
+
+static void BM_RRRSelect(benchmark::State &state)
+{
+    bitvector *bv = bench::cached_bitvector(state.range(0), state.range(1));
+    rrr_vector *rrr = cached_rrr(state.range(0), state.range(1), state.range(2));
+    std::vector<uint64_t> ks = bench::random_positions(bench::kNumQueries, 1, rrr->ones + 1, false);
+    uint64_t i = 0;
+
+    if (rrr->ones == 0)
+    {
+        state.SkipWithError("no set bits");
+        return;
+    }
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(rrr_select(rrr, ks[i]));
+        i = (i + 1) % bench::kNumQueries;
+    }
+    state.SetItemsProcessed(state.iterations());
+    report_bytes(state, bv, rrr);
+}
+BENCHMARK(BM_RRRSelect)->Apply(rrr_args);
+
+static void BM_RRRIsSet(benchmark::State &state)
+{
+    bitvector *bv = bench::cached_bitvector(state.range(0), state.range(1));
+    rrr_vector *rrr = cached_rrr(state.range(0), state.range(1), state.range(2));
+    std::vector<uint64_t> positions = bench::random_positions(bench::kNumQueries, 0, bv_len(bv), false);
+    uint64_t i = 0;
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(rrr_isset(rrr, positions[i]));
+        i = (i + 1) % bench::kNumQueries;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_RRRIsSet)->Apply(rrr_args);
@@ -0,0 +1,91 @@
+#include "bench_utils.h"
+
+/**
+ * Shifting, rotating and concatenating a 64M-bit vector by amounts that are not multiples of 64.
+ *
+ * `bytes_per_second` counts the bytes of the shifted vector.
+ */
+
+static const int64_t kShiftBits = 1L << 26;
+static const uint64_t kShiftBy = 1000003;
+
+static void BM_ShiftBitwise(benchmark::State &state)
+{
+    bitvector *bv = bv_copy(bench::cached_bitvector(kShiftBits, 500));
+    uint64_t i;
+
+    for (auto _ : state)
+    {
+        for (i = kShiftBits; i-- > kShiftBy;)
+        {
+            if (bv_isset(bv, i - kShiftBy))
+                bv_set(bv, i);
+            else
+                bv_clear(bv, i);
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(state.iterations() * kShiftBits / 8);
+    bv_free(bv);
+}
+BENCHMARK(BM_ShiftBitwise)->Unit(benchmark::kMillisecond);
+
+static void BM_Shift(benchmark::State &state)
+{
+    bitvector *bv = bv_copy(bench::cached_bitvector(kShiftBits, 500));
+
+    if (bv_use_isa((bv_isa)state.range(1)) != state.range(1))
+    {
+        state.SkipWithError("instruction set not supported by this CPU");
+        bv_use_isa(BV_ISA_AUTO);
+        bv_free(bv);
+        return;
+    }
+    for (auto _ : state)
+    {
+        if (state.range(0))
+            bv_lshift_inplace(bv, kShiftBy);
+        else
+            bv_rshift_inplace(bv, kShiftBy);
+        benchmark::ClobberMemory();
+    }
+    bv_use_isa(BV_ISA_AUTO);
+    state.SetBytesProcessed(state.iterations() * kShiftBits / 8);
+    bv_free(bv);
+}
+BENCHMARK(BM_Shift)
+    ->ArgNames({"left", "isa"})
+    ->ArgsProduct({{0, 1}, {BV_ISA_SCALAR, BV_ISA_AVX2, BV_ISA_AVX512}})
+    ->Unit(benchmark::kMillisecond);
+
+static void BM_Rotate(benchmark::State &state)
+{
+    bitvector *bv = bv_copy(bench::cached_bitvector(kShiftBits, 500));
+
+    for (auto _ : state)
+    {
+        bv_rotate_inplace(bv, kShiftBy);
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(state.iterations() * kShiftBits / 8);
+    bv_free(bv);
+}
+BENCHMARK(BM_Rotate)->Unit(benchmark::kMillisecond);
+
+/* a sliding window: drop the oldest `range(0)` bits and append as many new ones */
+static void BM_SlideWindow(benchmark::State &state)
+{
+    bitvector *window = bv_copy(bench::cached_bitvector(kShiftBits, 500));
+    bitvector *update = bv_copy(bench::cached_bitvector(state.range(0), 500));
+
+    for (auto _ : state)
+    {
+        bv_rshift_inplace(window, state.range(0));
+        bv_copy_range(window, kShiftBits - state.range(0), update, 0, state.range(0));
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(state.iterations() * kShiftBits / 8);
+    bv_free(window);
+    bv_free(update);
+}
+BENCHMARK(BM_SlideWindow)->ArgName("bits")->Arg(67)->Arg(4099)->Unit(benchmark::kMillisecond);
@@ -0,0 +1,99 @@
+#include "bench_utils.h"
+#include "similarity.h"
+#include "thread_pool.h"
+#include "word_kernels.h"
+
+/**
+ * Fingerprint similarity search.
+ *
+ * `items_per_second` counts candidate comparisons; `bytes_per_second` counts candidate bytes scanned.
+ */
+
+/** a pool of fingerprints, rebuilt only when the shape changes */
+static std::vector<bitvector *> &fingerprints(uint64_t count, uint64_t bits)
+{
+    static std::vector<bitvector *> pool;
+    static uint64_t pool_bits = 0;
+
+    if (pool.size() != count || pool_bits != bits)
+    {
+        for (bitvector *bv : pool)
+            bv_free(bv);
+        pool.clear();
+        for (uint64_t i = 0; i < count; i++)
+            pool.push_back(bench::random_bitvector(bits, 500, i + 1));
+        pool_bits = bits;
+    }
+    return pool;
+}
+
+static void BM_HammingBatch(benchmark::State &state)
+{
+    std::vector<bitvector *> &candidates = fingerprints(state.range(0), state.range(1));
+    bitvector *query = bench::random_bitvector(state.range(1), 500, 0);
+    std::vector<uint64_t> distances(candidates.size());
+
+    bv_set_num_threads(state.range(2));
+    for (auto _ : state)
+    {
+        bv_hamming_batch(query, candidates.data(), candidates.size(), distances.data());
+        benchmark::DoNotOptimize(distances.data());
+    }
+    bv_set_num_threads(0);
+    bv_free(query);
+    state.SetItemsProcessed(state.iterations() * candidates.size());
+    state.SetBytesProcessed(state.iterations() * candidates.size() * (state.range(1) / 8));
+}
+BENCHMARK(BM_HammingBatch)
+    ->ArgNames({"candidates", "bits", "threads"})
+    ->ArgsProduct({{1 << 16, 1 << 20}, {256, 1024, 4096}, {1, 2, 4, 8}})
+    ->UseRealTime();
+
+static void BM_HammingTopK(benchmark::State &state)
+{
+    std::vector<bitvector *> &candidates = fingerprints(state.range(0), 1024);
+    bitvector *query = bench::random_bitvector(1024, 500, 0);
+    std::vector<size_t> indices(state.range(1));
+
+    for (auto _ : state)
+        benchmark::DoNotOptimize(
+            bv_hamming_top_k(query, candidates.data(), candidates.size(), state.range(1), indices.data(), NULL));
+    bv_free(query);
+    state.SetItemsProcessed(state.iterations() * candidates.size());
+}
+BENCHMARK(BM_HammingTopK)->ArgNames({"candidates", "k"})->ArgsProduct({{1 << 16, 1 << 20}, {10, 100}})->UseRealTime();
+
+static void BM_JaccardMatrix(benchmark::State &state)
+{
+    std::vector<bitvector *> &candidates = fingerprints(state.range(0), 1024);
+    std::vector<bitvector *> queries(candidates.begin(), candidates.begin() + state.range(1));
+    std::vector<double> similarities(queries.size() * candidates.size());
+
+    for (auto _ : state)
+    {
+        bv_jaccard_matrix(queries.data(), queries.size(), candidates.data(), candidates.size(), similarities.data());
+        benchmark::DoNotOptimize(similarities.data());
+    }
+    state.SetItemsProcessed(state.iterations() * queries.size() * candidates.size());
+}
+BENCHMARK(BM_JaccardMatrix)->ArgNames({"candidates", "queries"})->ArgsProduct({{1 << 16}, {16, 64}})->UseRealTime();
+
+static void BM_XorPopcount(benchmark::State &state)
+{
+    bitvector *a = bench::cached_bitvector(state.range(0), 500, 1);
+    bitvector *b = bench::cached_bitvector(state.range(0), 500, 2);
+
+    if (bv_use_isa((bv_isa)state.range(1)) != state.range(1))
+    {
+        state.SkipWithError("instruction set not supported by this CPU");
+        bv_use_isa(BV_ISA_AUTO);
+        return;
+    }
+    for (auto _ : state)
+        benchmark::DoNotOptimize(words_xor_popcount(a->data, b->data, bv_len(a) / WORD_SIZE));
+    bv_use_isa(BV_ISA_AUTO);
+    state.SetBytesProcessed(state.iterations() * 2 * (bv_len(a) / 8));
+}
+BENCHMARK(BM_XorPopcount)
+    ->ArgNames({"bits", "isa"})
+    ->ArgsProduct({{1 << 14, 1 << 20, 1 << 26}, {BV_ISA_SCALAR, BV_ISA_AVX2, BV_ISA_AVX512}});
@@ -0,0 +1,150 @@
+#include "bench_utils.h"
+#include "thread_pool.h"
+#include "wavelet_matrix.h"
+
+/**
+ * Wavelet matrix construction and queries over 16M Zipf-like symbols, for alphabets from 2^8 to 2^20.
+ */
+
+static const uint64_t kSymbols = 1UL << 24;
+static const std::vector<int64_t> kAlphabetBits = {8, 14, 20};
+
+static std::vector<uint32_t> &cached_symbols(uint64_t sigma)
+{
+    /* skewed towards small symbols, as with log tokens: the product of two uniform draws */
+    static std::vector<uint32_t> symbols;
+    static uint64_t cached_sigma = 0;
+
+    if (cached_sigma != sigma)
+    {
+        std::mt19937_64 rng(42);
+        symbols.resize(kSymbols);
+        for (auto &s : symbols)
+            s = (uint32_t)((rng() % sigma) * (rng() % sigma) / sigma);
+        cached_sigma = sigma;
+    }
+    return symbols;
+}
+
+static wavelet_matrix *cached_wavelet_matrix(uint64_t sigma)
+{
+    static wavelet_matrix *wm = nullptr;
+    static uint64_t cached_sigma = 0;
+
+    if (wm == nullptr || cached_sigma != sigma)
+    {
+        wm_free(wm);
+        wm = wm_new(cached_symbols(sigma).data(), kSymbols, sigma);
+        cached_sigma = sigma;
+    }
+    return wm;
+}
+
+static void BM_WaveletMatrixBuild(benchmark::State &state)
+{
+    uint64_t sigma = 1UL << state.range(0);
+    std::vector<uint32_t> &symbols = cached_symbols(sigma);
+    wavelet_matrix *wm = nullptr;
+
+    bv_set_num_threads(state.range(1));
+    for (auto _ : state)
+    {
+        wm = wm_new(symbols.data(), kSymbols, sigma);
+        state.PauseTiming();
+        state.counters["bytes"] = (double)wm_bytes(wm);
+        wm_free(wm);
+        state.ResumeTiming();
+    }
+    bv_set_num_threads(0);
+    state.SetItemsProcessed(state.iterations() * kSymbols);
+}
+BENCHMARK(BM_WaveletMatrixBuild)
+    ->ArgNames({"sigma_bits", "threads"})
+    ->ArgsProduct({kAlphabetBits, {1, 2, 4}})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+static void BM_WaveletMatrixAccess(benchmark::State &state)
+{
+    wavelet_matrix *wm = cached_wavelet_matrix(1UL << state.range(0));
+    std::vector<uint64_t> positions(bench::kNumQueries);
+    std::mt19937_64 rng(7);
+    uint64_t i = 0;
+
+    for (auto &p : positions)
+        p = rng() % kSymbols;
+    for (auto _ : state)
+        benchmark::DoNotOptimize(wm_access(wm, positions[i++ & (bench::kNumQueries - 1)]));
+}
+BENCHMARK(BM_WaveletMatrixAccess)->ArgName("sigma_bits")->ArgsProduct({kAlphabetBits});
+
+static void BM_WaveletMatrixRank(benchmark::State &state)
+{
+    uint64_t sigma = 1UL << state.range(0);
+    wavelet_matrix *wm = cached_wavelet_matrix(sigma);
+    std::vector<uint64_t> positions(bench::kNumQueries);
+    std::mt19937_64 rng(7);
+    uint64_t i = 0;
+
+    for (auto &p : positions)
+        p = rng() % kSymbols;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(wm_rank(wm, (uint32_t)(positions[i & (bench::kNumQueries - 1)] % sigma),
+                                         positions[i & (bench::kNumQueries - 1)]));
+        i++;
+    }
+}
+BENCHMARK(BM_WaveletMatrixRank)->ArgName("sigma_bits")->ArgsProduct({kAlphabetBits});
+
+static void BM_WaveletMatrixSelect(benchmark::State &state)
+{
+    uint64_t sigma = 1UL << state.range(0);
+    wavelet_matrix *wm = cached_wavelet_matrix(sigma);
+    std::vector<uint32_t> &symbols = cached_symbols(sigma);
+    std::vector<uint64_t> positions(bench::kNumQueries);
+    std::mt19937_64 rng(7);
+    uint64_t i = 0;
+
+    /* query the first occurrence of the symbol at a random position, so every select succeeds */
+    for (auto &p : positions)
+        p = rng() % kSymbols;
+    for (auto _ : state)
+        benchmark::DoNotOptimize(wm_select(wm, symbols[positions[i++ & (bench::kNumQueries - 1)]], 1));
+}
+BENCHMARK(BM_WaveletMatrixSelect)->ArgName("sigma_bits")->ArgsProduct({kAlphabetBits});
+
+static void BM_WaveletMatrixQuantile(benchmark::State &state)
+{
+    wavelet_matrix *wm = cached_wavelet_matrix(1UL << state.range(0));
+    std::vector<uint64_t> positions(bench::kNumQueries);
+    std::mt19937_64 rng(7);
+    uint64_t i = 0, from;
+
+    for (auto &p : positions)
+        p = rng() % (kSymbols - 4096);
+    for (auto _ : state)
+    {
+        from = positions[i++ & (bench::kNumQueries - 1)];
+        benchmark::DoNotOptimize(wm_quantile(wm, from, from + 4096, 2048));
+    }
+}
+BENCHMARK(BM_WaveletMatrixQuantile)->ArgName("sigma_bits")->ArgsProduct({kAlphabetBits});
+
+static void BM_WaveletMatrixRangeCount(benchmark::State &state)
+{
+    uint64_t sigma = 1UL << state.range(0);
+    wavelet_matrix *wm = cached_wavelet_matrix(sigma);
+    std::vector<uint64_t> positions(bench::kNumQueries);
+    std::mt19937_64 rng(7);
+    uint64_t i = 0, from;
+
+    for (auto &p : positions)
+        p = rng() % (kSymbols - 4096);
+    for (auto _ : state)
+    {
+        from = positions[i++ & (bench::kNumQueries - 1)];
+        benchmark::DoNotOptimize(wm_range_count(wm, from, from + 4096, sigma / 8, sigma / 2));
+    }
+}
+BENCHMARK(BM_WaveletMatrixRangeCount)->ArgName("sigma_bits")->ArgsProduct({kAlphabetBits});
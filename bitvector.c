@@ -1,56 +1,32 @@
 #include <stdlib.h>
 #include "bitvector.h"
+#include "word_ops.h"
+#include "word_kernels.h"
+#include <string.h>
+#include <sys/mman.h>
 #include <stdio.h>
 #include <stdbool.h>
-#include <math.h>
-
-static uint64_t bv_get_block(bitvector *bv, uint64_t pos);
 
 /**
- * @brief
+ * @brief The first and last words touched by bv[from:to], with the masks selecting the range's bits within them
  *
- * @param x the WORD_SIZE-bit integer whose kth bit we should set
- * @param k the position which is 0 <= k < 64
- * @return uint64_t
+ * @param from the start (inclusive) of a nonempty range
+ * @param to the end (exclusive) of the range
  */
-static inline uint64_t word_set(uint64_t x, uint8_t k)
-{
-    return x | (BIT << k);
-}
-
-static inline uint64_t word_clear(uint64_t x, uint8_t k)
-{
-    return x & ~(BIT << k);
-}
-
-static inline uint64_t word_isset(uint64_t x, uint8_t k)
-{
-    return (x & (BIT << k));
-}
-
-static inline uint64_t word_toggle(uint64_t x, uint8_t k)
+static inline void bv_range_masks(uint64_t from, uint64_t to, uint64_t *first, uint64_t *last, uint64_t *head,
+                                  uint64_t *tail)
 {
-    return x ^ (BIT << k);
+    *first = from / WORD_SIZE;
+    *last = (to - 1) / WORD_SIZE;
+    *head = ALL_ONES_MASK << (from % WORD_SIZE);
+    *tail = ALL_ONES_MASK >> ((WORD_SIZE - to % WORD_SIZE) % WORD_SIZE);
 }
 
-static inline uint64_t popcnt(uint64_t i)
-{
-    return __builtin_popcountll(i);
-}
-
-#define BV_CHECK_NONNULL(bv)                                                                                           \
-    do                                                                                                                 \
-    {                                                                                                                  \
-        if (bv == NULL)                                                                                                \
-        {                                                                                                              \
-            BV_REPORT_ERROR_AND_EXIT(bv == NULL, __FILE__, __PRETTY_FUNCTION__, __LINE__, "null pointer encountered"); \
-        }                                                                                                              \
-    } while (0)
-
 bitvector *bv_new(size_t size)
 {
     const uint64_t num_ints = (size >> LOG_WORD_SIZE) + BIT;
-    uint64_t *data = calloc(num_ints, WORD_SIZE);
+    const bv_allocator *allocator = bv_get_allocator();
+    uint64_t *data = allocator->alloc(allocator->ctx, num_ints * sizeof(uint64_t));
     if (data == NULL)
     {
         BV_REPORT_ERROR_AND_EXIT(data == NULL, __FILE__, __PRETTY_FUNCTION__, __LINE__, "could not allocate data array");
@@ -62,7 +38,7 @@ bitvector *bv_new(size_t size)
         BV_REPORT_ERROR_AND_EXIT(bv == NULL, __FILE__, __PRETTY_FUNCTION__, __LINE__, "could not allocate bitvector");
     }
     *bv = (bitvector){
-        data, size, (num_ints) * (BIT << LOG_WORD_SIZE)};
+        .data = data, .size = size, .allocated = (num_ints) * (BIT << LOG_WORD_SIZE), .allocator = allocator};
     return bv;
 }
 
@@ -110,136 +86,126 @@ void bv_print(bitvector *bv)
     free(super_string);
 }
 
-void bv_set(bitvector *bv, uint64_t pos)
+bv_status bv_set(bitvector *bv, uint64_t pos)
 {
     /** sets the bit at index pos to 1 **/
 
-    bv_check_index(bv, pos);
-    uint64_t block, block_index;
-    uint8_t k;
+    if (RS_CHECKED && pos >= bv_len(bv))
+        return BV_EINDEX;
+    if (RS_CHECKED && bv->mapping != NULL)
+        return BV_EREADONLY;
+    bv_set_unchecked(bv, pos);
+    return BV_OK;
+}
 
-    block_index = (uint64_t)pos / WORD_SIZE;
-    block = bv_get_block(bv, block_index);
-    k = pos % WORD_SIZE;
+static bv_status bv_check_range(bitvector *bv, uint64_t from, uint64_t to)
+{
+    /** a range whose end wrapped around is caught by from > to **/
 
-    block = word_set(block, k);
-    bv->data[block_index] = block;
+    return (from <= to && to <= bv_len(bv)) ? BV_OK : BV_EINDEX;
 }
 
-static inline uint64_t bv_get_block(bitvector *bv, uint64_t block_index)
+static bv_status bv_check_write_range(bitvector *bv, uint64_t from, uint64_t to)
 {
-    return bv->data[block_index];
+    /** the pages of a bv_mmap view are mapped read-only, so a store to them would fault **/
+
+    if (bv_check_range(bv, from, to) != BV_OK)
+        return BV_EINDEX;
+    return (bv->mapping == NULL) ? BV_OK : BV_EREADONLY;
 }
 
-void bv_check_index(bitvector *bv, uint64_t pos)
+bv_status bv_check_index(bitvector *bv, uint64_t pos)
 {
-    if (pos >= bv_len(bv))
-    {
-        fprintf(stderr, "IndexError: bitvector index out of bounds. The size of this bit_vector is %zu.\n", bv_len(bv));
-        exit(0);
-    }
+    return (pos < bv_len(bv)) ? BV_OK : BV_EINDEX;
 }
 
-void bv_clear(bitvector *bv, uint64_t pos)
+bv_status bv_clear(bitvector *bv, uint64_t pos)
 {
     /** clears the bit at the pos **/
 
-    bv_check_index(bv, pos);
-    uint64_t block, block_index;
-    uint8_t k;
-
-    block_index = (uint64_t)pos / WORD_SIZE;
-    block = bv_get_block(bv, block_index);
-    k = pos % WORD_SIZE;
-
-    block = word_clear(block, k);
-    bv->data[block_index] = block;
+    if (RS_CHECKED && pos >= bv_len(bv))
+        return BV_EINDEX;
+    if (RS_CHECKED && bv->mapping != NULL)
+        return BV_EREADONLY;
+    bv_clear_unchecked(bv, pos);
+    return BV_OK;
 }
 
 uint64_t bv_pop_count(bitvector *bv, uint64_t pos)
 {
-    /** return the number of 1's in the bitvector **/
+    /** return the number of 1's in bv[:pos + 1] **/
 
     if (bv_len(bv) == 0 || pos > bv_len(bv))
     {
         return 0;
     }
+    return bv_rank(bv, pos + 1);
+}
 
-    ++pos;
+uint64_t bv_count_range(bitvector *bv, uint8_t bit, uint64_t from, uint64_t to)
+{
+    /** popcount the masked first and last words and the whole words between them **/
 
-    uint64_t i, card, block, block_count, remainder;
-    block_count = ceil((double)pos / WORD_SIZE) - 1;
-    remainder = pos % WORD_SIZE;
+    uint64_t first, last, head, tail, card;
 
-    card = 0;
-    for (i = 0; i < block_count; i++)
-    {
-        if (bv->data[i])
-            card += popcnt(bv->data[i]);
-    }
-    block = bv->data[block_count];
-    if (remainder > 0)
-    {
-        block = ~(ALL_ONES_MASK << remainder) & block;
-        card += popcnt(block);
-    }
-    return card;
+    BV_CHECK_NONNULL(bv);
+    if (to > bv_len(bv))
+        to = bv_len(bv);
+    if (from >= to)
+        return 0;
+
+    bv_range_masks(from, to, &first, &last, &head, &tail);
+    if (first == last)
+        card = popcnt(bv->data[first] & head & tail);
+    else
+        card = popcnt(bv->data[first] & head) + words_popcount(bv->data + first + 1, last - first - 1) +
+               popcnt(bv->data[last] & tail);
+    return bit ? card : (to - from) - card;
 }
 
-void bv_resize(bitvector *bv, size_t new_size)
+bv_status bv_resize(bitvector *bv, size_t new_size)
 {
     /** resize the bit vector accordingly **/
 
-    uint64_t i, curr_size;
-    uint64_t j, last_partial_block, remainder, new_actual_size;
+    uint64_t curr_size, curr_words, new_words, remainder;
+    uint64_t *new_vector;
 
     curr_size = bv_len(bv);
     if (curr_size == new_size)
-        return;
+        return BV_OK;
+    if (bv->mapping != NULL)
+        return BV_EREADONLY;
+
+    /* the rank directory no longer matches the data */
+    bv_drop_rank(bv);
+
+    /* like bv_new, always keep one word past the last occupied one */
+    curr_words = bv->allocated / WORD_SIZE;
+    new_words = (new_size >> LOG_WORD_SIZE) + BIT;
 
     /*shrink a bit vector*/
     if (curr_size > new_size)
     {
-
-        j = ((int64_t)new_size - 1) / (int64_t)WORD_SIZE;
+        /* bits past the end must stay cleared */
         remainder = new_size % WORD_SIZE;
-        last_partial_block = bv->data[j];
-        last_partial_block = ~(ALL_ONES_MASK << remainder) & last_partial_block;
-        bv->data[j] = last_partial_block;
-
-        new_actual_size = ceil((double)new_size / WORD_SIZE);
-        if (new_actual_size < bv->allocated)
-        {
-            /** shrink the underlying array */
-            uint64_t *new_vector = realloc(bv->data, new_actual_size * WORD_SIZE);
-            bv->data = new_vector;
-        }
+        bv->data[new_size / WORD_SIZE] &= ~(ALL_ONES_MASK << remainder);
     }
-    else
-    {
-        /** extend the bitvector **/
-        uint64_t additional_size, last_block_index;
 
-        new_actual_size = ceil((double)new_size / WORD_SIZE);
-        if (new_actual_size != bv->allocated)
-        {
-            /** grow the underlying array */
-            uint64_t *new_vector = realloc(bv->data, new_actual_size * WORD_SIZE);
-            bv->data = new_vector;
-        }
-        if (new_size > bv->allocated)
+    /* the allocator zeroes the newly grown words */
+    if (new_words != curr_words)
+    {
+        new_vector = bv->allocator->realloc(bv->allocator->ctx, bv->data, curr_words * sizeof(uint64_t),
+                                            new_words * sizeof(uint64_t));
+        if (new_vector == NULL)
         {
-            last_block_index = (curr_size - 1) / WORD_SIZE + 1;
-            additional_size = new_actual_size - bv->allocated;
-            for (i = 0; i < additional_size; i++)
-            {
-                bv->data[last_block_index + i] = 0;
-            }
+            BV_REPORT_ERROR_AND_EXIT(new_vector == NULL, __FILE__, __PRETTY_FUNCTION__, __LINE__, "could not resize data array");
         }
+        bv->data = new_vector;
     }
 
-    bv->allocated = new_actual_size * WORD_SIZE;
+    bv->allocated = new_words * WORD_SIZE;
     bv->size = new_size;
+    return BV_OK;
 }
 
 size_t bv_len(bitvector *bv)
@@ -250,15 +216,9 @@ size_t bv_len(bitvector *bv)
 
 bool bv_isset(bitvector *bv, uint64_t pos)
 {
-    bv_check_index(bv, pos);
-    uint64_t block, block_index;
-    uint8_t k;
-
-    block_index = (uint64_t)pos / WORD_SIZE;
-    block = bv_get_block(bv, block_index);
-    k = pos % WORD_SIZE;
-
-    return word_isset(block, k);
+    if (RS_CHECKED && pos >= bv_len(bv))
+        return false;
+    return bv_isset_unchecked(bv, pos);
 }
 
 static inline bitvector *bv_shorter(bitvector *a, bitvector *b)
@@ -291,29 +251,541 @@ void bv_print_dec(bitvector *bv)
     }
 }
 
+static inline uint64_t bv_num_words(bitvector *bv)
+{
+    /** the number of words backing bv, including the spare word bv_new always allocates */
+    return (bv_len(bv) >> LOG_WORD_SIZE) + BIT;
+}
+
+static inline void bv_clear_tail(bitvector *bv)
+{
+    /** clear the bits at and past bv_len(bv) in the last word */
+    bv->data[bv_len(bv) >> LOG_WORD_SIZE] &= ~(ALL_ONES_MASK << (bv_len(bv) % WORD_SIZE));
+}
+
+typedef void (*binary_kernel)(uint64_t *, const uint64_t *, const uint64_t *, size_t);
+
+static bv_status bv_binary_op_into(bitvector *dst, bitvector *a, bitvector *b, binary_kernel kernel,
+                                   bool keep_a_tail, bool keep_b_tail)
+{
+    /** apply `kernel` to the common words, then take the tail of the longer operand if op(x, 0) == x for it,
+     * otherwise clear it. dst may alias a or b **/
+
+    BV_CHECK_NONNULL(dst);
+    BV_CHECK_NONNULL(a);
+    BV_CHECK_NONNULL(b);
+    if (dst->mapping != NULL)
+        return BV_EREADONLY;
+
+    /* measure before resizing, dst may be one of the operands */
+    bitvector *longer = (bv_len(a) >= bv_len(b)) ? a : b;
+    uint64_t common = bv_num_words(bv_shorter(a, b));
+    uint64_t total = bv_num_words(longer);
+    bool keep_tail = (longer == a) ? keep_a_tail : keep_b_tail;
+
+    bv_drop_rank(dst);
+    bv_resize(dst, bv_len(longer));
+
+    kernel(dst->data, a->data, b->data, common);
+    if (!keep_tail)
+        memset(dst->data + common, 0, (total - common) * sizeof(uint64_t));
+    else if (longer != dst)
+        memcpy(dst->data + common, longer->data + common, (total - common) * sizeof(uint64_t));
+    return BV_OK;
+}
+
+static bitvector *bv_binary_op(bitvector *a, bitvector *b, binary_kernel kernel, bool keep_a_tail, bool keep_b_tail)
+{
+    BV_CHECK_NONNULL(a);
+    BV_CHECK_NONNULL(b);
+
+    bitvector *bv = bv_new(max(bv_len(a), bv_len(b)));
+    bv_binary_op_into(bv, a, b, kernel, keep_a_tail, keep_b_tail);
+    return bv;
+}
+
+static inline uint64_t bits_at(const uint64_t *data, uint64_t pos, uint64_t n)
+{
+    /** the n (1 to 64) bits data[pos:pos + n], reading no word past the one holding the last of them **/
+
+    uint64_t w = pos / WORD_SIZE, k = pos % WORD_SIZE, x = data[w] >> k;
+
+    if (k + n > WORD_SIZE)
+        x |= data[w + 1] << (WORD_SIZE - k);
+    return (n == WORD_SIZE) ? x : x & ~(ALL_ONES_MASK << n);
+}
+
+static inline void put_bits(uint64_t *data, uint64_t pos, uint64_t bits, uint64_t n)
+{
+    /** overwrite data[pos:pos + n] with the low n bits of `bits`; the range must not cross a word boundary **/
+
+    uint64_t w = pos / WORD_SIZE, k = pos % WORD_SIZE;
+    uint64_t mask = ((n == WORD_SIZE) ? ALL_ONES_MASK : ~(ALL_ONES_MASK << n)) << k;
+
+    data[w] = (data[w] & ~mask) | ((bits << k) & mask);
+}
+
+static void copy_bits(uint64_t *dst, uint64_t to, const uint64_t *src, uint64_t from, uint64_t n)
+{
+    /**
+     * memmove for bits: dst[to:to + n] = src[from:from + n], where the two ranges may overlap.
+     * The partial first and last words of the destination are masked in separately; the whole words between
+     * them are a single funnel shift of the source words, run upwards when the bits move down and downwards
+     * when they move up, so that no source word is overwritten before it has been read.
+     **/
+
+    uint64_t head, tail, words, mid, sh, w;
+
+    if (n == 0)
+        return;
+    head = (WORD_SIZE - to % WORD_SIZE) % WORD_SIZE;
+    head = (head < n) ? head : n;
+    words = (n - head) / WORD_SIZE;
+    tail = n - head - words * WORD_SIZE;
+    mid = from + head;
+    sh = mid % WORD_SIZE;
+    w = (to + head) / WORD_SIZE;
+
+    if (to <= from && head > 0)
+        put_bits(dst, to, bits_at(src, from, head), head);
+    else if (to > from && tail > 0)
+        put_bits(dst, to + n - tail, bits_at(src, from + n - tail, tail), tail);
+
+    if (words > 0)
+    {
+        if (sh == 0)
+            memmove(dst + w, src + mid / WORD_SIZE, words * sizeof(uint64_t));
+        else if (to <= from)
+            words_shr(dst + w, src + mid / WORD_SIZE, words, sh);
+        else
+            words_shl(dst + w, src + mid / WORD_SIZE + 1, words, WORD_SIZE - sh);
+    }
+
+    if (to <= from && tail > 0)
+        put_bits(dst, to + n - tail, bits_at(src, from + n - tail, tail), tail);
+    else if (to > from && head > 0)
+        put_bits(dst, to, bits_at(src, from, head), head);
+}
+
+bv_status bv_copy_range(bitvector *dst, uint64_t to, bitvector *src, uint64_t from, uint64_t n)
+{
+    bv_status status;
+
+    BV_CHECK_NONNULL(dst);
+    BV_CHECK_NONNULL(src);
+    if (bv_check_range(src, from, from + n) != BV_OK)
+        return BV_EINDEX;
+    if ((status = bv_check_write_range(dst, to, to + n)) != BV_OK)
+        return status;
+
+    copy_bits(dst->data, to, src->data, from, n);
+    bv_rank_update_range(dst, to, to + n);
+    return BV_OK;
+}
+
+bv_status bv_lshift_into(bitvector *dst, bitvector *bv, uint64_t k)
+{
+    /** dst[i] = bv[i - k] for i >= k, and 0 below k **/
+
+    BV_CHECK_NONNULL(dst);
+    BV_CHECK_NONNULL(bv);
+    if (dst->mapping != NULL)
+        return BV_EREADONLY;
+
+    uint64_t n = bv_len(bv);
+
+    k = (k < n) ? k : n;
+    bv_drop_rank(dst);
+    bv_resize(dst, n);
+    copy_bits(dst->data, k, bv->data, 0, n - k);
+    bv_range_set(dst, 0, 0, k);
+    return BV_OK;
+}
+
+bv_status bv_rshift_into(bitvector *dst, bitvector *bv, uint64_t k)
+{
+    /** dst[i] = bv[i + k] for i < n - k, and 0 from n - k on **/
+
+    BV_CHECK_NONNULL(dst);
+    BV_CHECK_NONNULL(bv);
+    if (dst->mapping != NULL)
+        return BV_EREADONLY;
+
+    uint64_t n = bv_len(bv);
+
+    k = (k < n) ? k : n;
+    bv_drop_rank(dst);
+    bv_resize(dst, n);
+    copy_bits(dst->data, 0, bv->data, k, n - k);
+    bv_range_set(dst, 0, n - k, n);
+    return BV_OK;
+}
+
+bv_status bv_rotate_into(bitvector *dst, bitvector *bv, uint64_t k)
+{
+    /**
+     * dst[(i + k) % n] = bv[i]. In place, the shorter of the two pieces is parked in a scratch buffer
+     * while the longer one is moved over it
+     **/
+
+    BV_CHECK_NONNULL(dst);
+    BV_CHECK_NONNULL(bv);
+    if (dst->mapping != NULL)
+        return BV_EREADONLY;
+
+    uint64_t n = bv_len(bv), r, *tmp;
+
+    bv_drop_rank(dst);
+    if (n == 0)
+    {
+        bv_resize(dst, 0);
+        return BV_OK;
+    }
+    k %= n;
+    if (dst != bv)
+    {
+        bv_resize(dst, n);
+        copy_bits(dst->data, k, bv->data, 0, n - k);
+        copy_bits(dst->data, 0, bv->data, n - k, k);
+        return BV_OK;
+    }
+    if (k == 0)
+        return BV_OK;
+
+    /* the scratch buffer comes from the vector's own allocator */
+    r = (k <= n - k) ? k : n - k;
+    tmp = bv->allocator->alloc(bv->allocator->ctx, (r / WORD_SIZE + 1) * sizeof(uint64_t));
+    if (tmp == NULL)
+    {
+        BV_REPORT_ERROR_AND_EXIT(tmp == NULL, __FILE__, __PRETTY_FUNCTION__, __LINE__, "could not allocate rotation buffer");
+    }
+    if (r == k)
+    {
+        copy_bits(tmp, 0, bv->data, n - k, k);
+        copy_bits(bv->data, k, bv->data, 0, n - k);
+        copy_bits(bv->data, 0, tmp, 0, k);
+    }
+    else
+    {
+        copy_bits(tmp, 0, bv->data, 0, r);
+        copy_bits(bv->data, 0, bv->data, r, k);
+        copy_bits(bv->data, k, tmp, 0, r);
+    }
+    bv->allocator->free(bv->allocator->ctx, tmp, (r / WORD_SIZE + 1) * sizeof(uint64_t));
+    return BV_OK;
+}
+
+bv_status bv_extend_into(bitvector *dst, bitvector *a, bitvector *b)
+{
+    /** dst = a followed by b. When dst is b alone, b's bits are first moved up to make room for a's **/
+
+    BV_CHECK_NONNULL(dst);
+    BV_CHECK_NONNULL(a);
+    BV_CHECK_NONNULL(b);
+    if (dst->mapping != NULL)
+        return BV_EREADONLY;
+
+    uint64_t la = bv_len(a), lb = bv_len(b);
+
+    bv_drop_rank(dst);
+    bv_resize(dst, la + lb);
+    if (dst == b && dst != a)
+    {
+        copy_bits(dst->data, la, dst->data, 0, lb);
+        copy_bits(dst->data, 0, a->data, 0, la);
+    }
+    else
+    {
+        if (dst != a)
+            copy_bits(dst->data, 0, a->data, 0, la);
+        copy_bits(dst->data, la, b->data, 0, lb);
+    }
+    return BV_OK;
+}
+
+bv_status bv_lshift_inplace(bitvector *bv, uint64_t k)
+{
+    return bv_lshift_into(bv, bv, k);
+}
+
+bv_status bv_rshift_inplace(bitvector *bv, uint64_t k)
+{
+    return bv_rshift_into(bv, bv, k);
+}
+
+bv_status bv_rotate_inplace(bitvector *bv, uint64_t k)
+{
+    return bv_rotate_into(bv, bv, k);
+}
+
+bv_status bv_extend_inplace(bitvector *a, bitvector *b)
+{
+    return bv_extend_into(a, a, b);
+}
+
+bitvector *bv_lshift(bitvector *bv, uint64_t k)
+{
+    BV_CHECK_NONNULL(bv);
+
+    bitvector *shifted = bv_new(bv_len(bv));
+    bv_lshift_into(shifted, bv, k);
+    return shifted;
+}
+
+bitvector *bv_rshift(bitvector *bv, uint64_t k)
+{
+    BV_CHECK_NONNULL(bv);
+
+    bitvector *shifted = bv_new(bv_len(bv));
+    bv_rshift_into(shifted, bv, k);
+    return shifted;
+}
+
+bitvector *bv_rotate(bitvector *bv, uint64_t k)
+{
+    BV_CHECK_NONNULL(bv);
+
+    bitvector *rotated = bv_new(bv_len(bv));
+    bv_rotate_into(rotated, bv, k);
+    return rotated;
+}
+
+bitvector *bv_extend(bitvector *a, bitvector *b)
+{
+    BV_CHECK_NONNULL(a);
+    BV_CHECK_NONNULL(b);
+
+    bitvector *extended = bv_new(bv_len(a) + bv_len(b));
+    bv_extend_into(extended, a, b);
+    return extended;
+}
+
 bitvector *bv_xor(bitvector *a, bitvector *b)
 {
-    /* assumes that the shorter vector is padded with 0's*/
+    return bv_binary_op(a, b, words_xor, true, true);
+}
 
-    if (bv_len(a) != bv_len(b))
+bitvector *bv_intersection(bitvector *a, bitvector *b)
+{
+    return bv_binary_op(a, b, words_and, false, false);
+}
+
+bitvector *bv_union(bitvector *a, bitvector *b)
+{
+    return bv_binary_op(a, b, words_or, true, true);
+}
+
+bitvector *bv_difference(bitvector *a, bitvector *b)
+{
+    return bv_binary_op(a, b, words_andnot, true, false);
+}
+
+bv_status bv_xor_into(bitvector *dst, bitvector *a, bitvector *b)
+{
+    return bv_binary_op_into(dst, a, b, words_xor, true, true);
+}
+
+bv_status bv_intersection_into(bitvector *dst, bitvector *a, bitvector *b)
+{
+    return bv_binary_op_into(dst, a, b, words_and, false, false);
+}
+
+bv_status bv_union_into(bitvector *dst, bitvector *a, bitvector *b)
+{
+    return bv_binary_op_into(dst, a, b, words_or, true, true);
+}
+
+bv_status bv_difference_into(bitvector *dst, bitvector *a, bitvector *b)
+{
+    return bv_binary_op_into(dst, a, b, words_andnot, true, false);
+}
+
+bv_status bv_xor_inplace(bitvector *a, bitvector *b)
+{
+    return bv_binary_op_into(a, a, b, words_xor, true, true);
+}
+
+bv_status bv_intersection_inplace(bitvector *a, bitvector *b)
+{
+    return bv_binary_op_into(a, a, b, words_and, false, false);
+}
+
+bv_status bv_union_inplace(bitvector *a, bitvector *b)
+{
+    return bv_binary_op_into(a, a, b, words_or, true, true);
+}
+
+bv_status bv_difference_inplace(bitvector *a, bitvector *b)
+{
+    return bv_binary_op_into(a, a, b, words_andnot, true, false);
+}
+
+typedef struct
+{
+    uint64_t *buffers; // one tile of scratch per level of the expression, then one for the result
+    uint64_t first;    // the first word of the current tile
+    uint64_t count;    // the number of words in the current tile
+} expr_tile;
+
+static uint64_t expr_depth(const bv_expr *expr, uint64_t *size)
+{
+    /** the height of the tree, checking its nodes on the way and collecting the length of the longest operand **/
+
+    uint64_t i, depth = 0;
+
+    BV_CHECK_NONNULL(expr);
+    if (expr->op == BV_EXPR_LEAF)
+    {
+        BV_CHECK_NONNULL(expr->bv);
+        *size = max(*size, bv_len(expr->bv));
+        return 0;
+    }
+    if (expr->op > BV_EXPR_ANDNOT || expr->num_children == 0 || expr->children == NULL)
     {
-        bitvector *shorter = bv_shorter(a, b);
-        uint64_t max_length = max(bv_len(a), bv_len(b));
-        bv_resize(shorter, max_length);
+        BV_REPORT_ERROR_AND_EXIT(expr->num_children == 0, __FILE__, __PRETTY_FUNCTION__, __LINE__,
+                                 "operator %d needs to be AND, OR or ANDNOT with at least one child", expr->op);
     }
+    for (i = 0; i < expr->num_children; i++)
+        depth = max(depth, expr_depth(expr->children[i], size) + 1);
+    return depth;
+}
 
-    uint64_t nbv, i;
-    bitvector *bv;
+static inline bool tile_is_zero(const uint64_t *tile, uint64_t n)
+{
+    uint64_t i, any = 0;
+
+    for (i = 0; i < n; i++)
+        any |= tile[i];
+    return any == 0;
+}
+
+static const uint64_t *expr_eval_tile(const bv_expr *expr, expr_tile *tile, uint64_t level, uint64_t *out)
+{
+    /**
+     * The current tile of `expr`, or NULL when it is all 0's.
+     * A leaf points straight into its operand, unless the operand ends inside the tile and is padded into `out`.
+     * An operator folds its children into `out`: the first child may write there directly,
+     * the others write to this level's scratch tile, which is free again once they have been folded in
+     **/
+
+    const uint64_t *acc, *operand;
+    uint64_t i, available, *scratch = tile->buffers + level * BV_EXPR_TILE_WORDS;
+
+    if (expr->op == BV_EXPR_LEAF)
+    {
+        available = bv_num_words(expr->bv);
+        if (tile->first >= available)
+            return NULL;
+        if (tile->first + tile->count <= available)
+            return expr->bv->data + tile->first;
+        memcpy(out, expr->bv->data + tile->first, (available - tile->first) * sizeof(uint64_t));
+        memset(out + available - tile->first, 0, (tile->first + tile->count - available) * sizeof(uint64_t));
+        return out;
+    }
+
+    acc = expr_eval_tile(expr->children[0], tile, level + 1, out);
+    for (i = 1; i < expr->num_children; i++)
+    {
+        /* only an OR can recover from an empty tile */
+        if (acc == NULL && expr->op != BV_EXPR_OR)
+            return NULL;
+        operand = expr_eval_tile(expr->children[i], tile, level + 1, scratch);
+        if (operand == NULL)
+        {
+            if (expr->op == BV_EXPR_AND)
+                return NULL;
+            continue;
+        }
+        if (acc == NULL)
+        {
+            /* the next child reuses the scratch tile */
+            if (operand == scratch)
+                memcpy(out, scratch, tile->count * sizeof(uint64_t));
+            acc = (operand == scratch) ? out : operand;
+            continue;
+        }
+        if (expr->op == BV_EXPR_AND)
+            words_and(out, acc, operand, tile->count);
+        else if (expr->op == BV_EXPR_OR)
+            words_or(out, acc, operand, tile->count);
+        else
+            words_andnot(out, acc, operand, tile->count);
+        acc = out;
+        if (expr->op != BV_EXPR_OR && tile_is_zero(out, tile->count))
+            return NULL;
+    }
+    return acc;
+}
+
+static uint64_t expr_eval(const bv_expr *expr, uint64_t *dst, uint64_t size)
+{
+    /**
+     * Evaluate the first size bits tile by tile into dst, or only count them when dst is NULL.
+     * Every tile is built in a buffer of its own and only then copied out, since dst may be one of the operands
+     **/
+
+    expr_tile tile;
+    const uint64_t *result;
+    uint64_t *root, card = 0, words = (size >> LOG_WORD_SIZE) + BIT, depth = expr_depth(expr, &size);
+
+    tile.buffers = malloc((depth + 1) * BV_EXPR_TILE_WORDS * sizeof(uint64_t));
+    if (tile.buffers == NULL)
+    {
+        BV_REPORT_ERROR_AND_EXIT(tile.buffers == NULL, __FILE__, __PRETTY_FUNCTION__, __LINE__,
+                                 "could not allocate tile buffers");
+    }
+    root = tile.buffers + depth * BV_EXPR_TILE_WORDS;
 
-    nbv = bv_len(a) / WORD_SIZE;
-    bv = bv_new(bv_len(a));
+    for (tile.first = 0; tile.first < words; tile.first += BV_EXPR_TILE_WORDS)
+    {
+        tile.count = (words - tile.first < BV_EXPR_TILE_WORDS) ? words - tile.first : BV_EXPR_TILE_WORDS;
+        result = expr_eval_tile(expr, &tile, 0, root);
+        if (dst == NULL)
+            card += (result != NULL) ? words_popcount(result, tile.count) : 0;
+        else if (result == NULL)
+            memset(dst + tile.first, 0, tile.count * sizeof(uint64_t));
+        else if (result != dst + tile.first)
+            memcpy(dst + tile.first, result, tile.count * sizeof(uint64_t));
+    }
+    free(tile.buffers);
+    return card;
+}
 
-    for (i = 0; i <= nbv; i++)
-        bv->data[i] = a->data[i] ^ b->data[i];
+bitvector *bv_eval(const bv_expr *expr)
+{
+    uint64_t size = 0;
+    bitvector *bv;
 
+    expr_depth(expr, &size);
+    bv = bv_new(size);
+    expr_eval(expr, bv->data, size);
     return bv;
 }
 
+bv_status bv_eval_into(bitvector *dst, const bv_expr *expr)
+{
+    /** measure before resizing, dst may be one of the operands **/
+
+    uint64_t size = 0;
+
+    BV_CHECK_NONNULL(dst);
+    if (dst->mapping != NULL)
+        return BV_EREADONLY;
+    expr_depth(expr, &size);
+    bv_drop_rank(dst);
+    bv_resize(dst, size);
+    expr_eval(expr, dst->data, size);
+    return BV_OK;
+}
+
+uint64_t bv_eval_count(const bv_expr *expr)
+{
+    uint64_t size = 0;
+
+    expr_depth(expr, &size);
+    return expr_eval(expr, NULL, size);
+}
+
 bool bv_equal(bitvector *a, bitvector *b)
 {
     BV_CHECK_NONNULL(a);
@@ -326,7 +798,7 @@ bool bv_equal(bitvector *a, bitvector *b)
     uint64_t *ap = a->data;
     uint64_t *bp = b->data;
 
-    for (uint64_t i = 0; i < a->size; i++)
+    for (uint64_t i = 0; i <= a->size / WORD_SIZE; i++)
         if (*ap++ != *bp++)
             return false;
 
@@ -337,24 +809,28 @@ bitvector *bv_complement(bitvector *bv)
 {
     /* return the complement of the bit-vector bv such that for each bit in bv,
      * bv_reversed = ~bit. **/
-    bv = bv_copy(bv);
+    bitvector *complement = bv_new(bv_len(bv));
+    bv_complement_into(complement, bv);
+    return complement;
+}
 
-    if (!bv_len(bv))
-    {
-        return bv;
-    }
-    else
-    {
-        uint64_t i, block, nb;
-        nb = bv_len(bv) / WORD_SIZE;
-        for (i = 0; i <= nb; i++)
-        {
-            block = bv_get_block(bv, i);
-            block = ~block;
-            bv->data[block] = block;
-        }
-    }
-    return bv;
+bv_status bv_complement_into(bitvector *dst, bitvector *bv)
+{
+    BV_CHECK_NONNULL(dst);
+    BV_CHECK_NONNULL(bv);
+    if (dst->mapping != NULL)
+        return BV_EREADONLY;
+
+    bv_drop_rank(dst);
+    bv_resize(dst, bv_len(bv));
+    words_not(dst->data, bv->data, bv_num_words(bv));
+    bv_clear_tail(dst);
+    return BV_OK;
+}
+
+bv_status bv_complement_inplace(bitvector *bv)
+{
+    return bv_complement_into(bv, bv);
 }
 
 bool bv_is(bitvector *a, bitvector *b)
@@ -366,12 +842,25 @@ bitvector *bv_copy(bitvector *bv)
 {
     /** deepcopy a bitvector **/
     bitvector *copy = bv_new(bv_len(bv));
-    uint64_t i, nb;
-    for (i = 0, nb = bv_len(bv) / WORD_SIZE; i <= nb; i++)
-        copy->data[i] = bv->data[i];
+    bv_copy_into(copy, bv);
     return copy;
 }
 
+bv_status bv_copy_into(bitvector *dst, bitvector *bv)
+{
+    BV_CHECK_NONNULL(dst);
+    BV_CHECK_NONNULL(bv);
+    if (dst->mapping != NULL)
+        return BV_EREADONLY;
+
+    if (dst == bv)
+        return BV_OK;
+    bv_drop_rank(dst);
+    bv_resize(dst, bv_len(bv));
+    memcpy(dst->data, bv->data, bv_num_words(bv) * sizeof(uint64_t));
+    return BV_OK;
+}
+
 uint64_t reverse_bits(uint64_t x)
 {
     /** reverse the bits in a 64-bit word
@@ -388,122 +877,154 @@ uint64_t reverse_bits(uint64_t x)
 
 short signed int kth_bit(uint64_t x, uint64_t k)
 {
-    /** find the position of the kth set bit in x in O(w) where w = word size**/
-    /** can be optimized to use binary search **/
+    /** find the position of the kth (1-indexed) set bit in x, or -1 if x has fewer than k set bits **/
 
-    unsigned short int c = 0;
-    short int i = 0;
+    if (k == 0 || popcnt(x) < k)
+        return -1;
+    return word_select(x, k - 1);
+}
 
-    while (x)
-    {
-        if (x & BIT)
-            c++;
-        if (c == k)
-            return i;
-        i++;
-        x = x >> BIT;
-    }
-    return -1;
+bitvector *bv_reverse(bitvector *bv)
+{
+    bitvector *bv_reversed = bv_new(bv_len(bv));
+    bv_reverse_into(bv_reversed, bv);
+    return bv_reversed;
 }
 
-int64_t bv_select(bitvector *bv, uint64_t k)
+bv_status bv_reverse_into(bitvector *dst, bitvector *bv)
 {
-    /** find the position of the k'th set bit **/
+    /** reverse the occupied words and their bits, then shift the padding of the last word back out **/
 
-    bv_check_index(bv, k);
-    int64_t card, i, nb;
-    int8_t remainder, in_block_popcnt;
-    int8_t pos_lblock;
-    uint64_t block;
+    BV_CHECK_NONNULL(dst);
+    BV_CHECK_NONNULL(bv);
+    if (dst->mapping != NULL)
+        return BV_EREADONLY;
 
-    card = 0;
-    nb = bv_len(bv) / WORD_SIZE;
-    for (i = 0; i < nb; i++)
-    {
-        block = bv_get_block(bv, i);
-        in_block_popcnt = popcnt(block);
-        if ((uint64_t)in_block_popcnt < k)
-        {
-            card += WORD_SIZE;
-            k -= in_block_popcnt;
-        }
-        else
-        {
-            return card + kth_bit(block, k);
-        }
-    }
+    uint64_t i, tmp, nwords, pad;
+
+    nwords = (bv_len(bv) + WORD_SIZE - 1) >> LOG_WORD_SIZE;
+    pad = (nwords << LOG_WORD_SIZE) - bv_len(bv);
 
-    // last step, checking for remainder
-    remainder = (bv_len(bv) - 1) % WORD_SIZE;
-    if (remainder > 0)
+    bv_drop_rank(dst);
+    if (dst == bv)
     {
-        pos_lblock = kth_bit(bv_get_block(bv, nb), k);
-        if (pos_lblock == -1 || pos_lblock >= remainder)
+        for (i = 0; i < nwords / 2; i++)
         {
-            return -1;
-        }
-        else
-        {
-            return card + pos_lblock;
+            tmp = reverse_bits(dst->data[i]);
+            dst->data[i] = reverse_bits(dst->data[nwords - 1 - i]);
+            dst->data[nwords - 1 - i] = tmp;
         }
+        if (nwords % 2)
+            dst->data[nwords / 2] = reverse_bits(dst->data[nwords / 2]);
     }
-    return -1;
-}
-
-bitvector *bv_reverse(bitvector *bv)
-{
-    /* works only for multiples of 64 **/
-
-    if (bv_len(bv) < 2)
+    else
     {
-        return bv_copy(bv);
+        bv_resize(dst, bv_len(bv));
+        for (i = 0; i < nwords; i++)
+            dst->data[i] = reverse_bits(bv->data[nwords - 1 - i]);
     }
-    bitvector *bv_reversed = bv_new(bv_len(bv));
 
-    uint64_t j, i;
-    j = bv_len(bv) / WORD_SIZE; /*index of last-occupied block */
-
-    for (i = 0; i < j; i++)
+    if (pad > 0)
     {
-        /** minor optimization **/
-        if (!bv->data[i])
-        {
-            bv_reversed->data[i] = 0;
-        }
-        else
-        {
-            bv_reversed->data[i] = reverse_bits(bv->data[i]);
-        }
+        for (i = 0; i + 1 < nwords; i++)
+            dst->data[i] = (dst->data[i] >> pad) | (dst->data[i + 1] << (WORD_SIZE - pad));
+        dst->data[nwords - 1] >>= pad;
     }
-    bv_reversed->data[j] = reverse_bits(bv->data[i]);
-    return bv_reversed;
+    bv_clear_tail(dst);
+    return BV_OK;
+}
+
+bv_status bv_reverse_inplace(bitvector *bv)
+{
+    return bv_reverse_into(bv, bv);
 }
 
 void bv_free(bitvector *bv)
 {
-    free(bv->data);
+    bv_drop_rank(bv);
+    if (bv->mapping != NULL)
+        munmap(bv->mapping, bv->mapping_bytes);
+    else
+        bv->allocator->free(bv->allocator->ctx, bv->data, (bv->allocated / WORD_SIZE) * sizeof(uint64_t));
     free(bv);
 }
 
 uint64_t bv_hamming_distance(bitvector *a, bitvector *b)
 {
-    bitvector *bv_xored = bv_xor(a, b);
-    const uint64_t hamming_weight = bv_pop_count(bv_xored, bv_len(bv_xored));
-    free(bv_xored);
-    return hamming_weight;
+    /** popcount(a ^ b) without materializing a ^ b; the tail of the longer vector is xor-ed with 0's **/
+
+    BV_CHECK_NONNULL(a);
+    BV_CHECK_NONNULL(b);
+
+    bitvector *longer = (bv_len(a) >= bv_len(b)) ? a : b;
+    uint64_t common = bv_num_words(bv_shorter(a, b));
+
+    return words_xor_popcount(a->data, b->data, common) + words_popcount(longer->data + common, bv_num_words(longer) - common);
 }
 
 bool bv_toggle(bitvector *bv, uint64_t pos)
 {
-    bv_check_index(bv, pos);
+    return bv_toggle_checked(bv, pos) == BV_OK;
+}
 
-    uint64_t block_index, k, block;
-    block_index = pos / WORD_SIZE;
-    k = pos % WORD_SIZE;
-    block = bv_get_block(bv, block_index);
-    block = word_toggle(block, k);
-    bv->data[block_index] = block;
-    return true;
+bv_status bv_toggle_checked(bitvector *bv, uint64_t pos)
+{
+    if (RS_CHECKED && pos >= bv_len(bv))
+        return BV_EINDEX;
+    if (RS_CHECKED && bv->mapping != NULL)
+        return BV_EREADONLY;
+    bv_toggle_unchecked(bv, pos);
+    return BV_OK;
+}
+
+bv_status bv_range_set(bitvector *bv, uint8_t bit, size_t from, size_t to)
+{
+    /** mask the first and last words, memset the whole words between them **/
+
+    uint64_t first, last, head, tail;
+    bv_status status;
+
+    if ((status = bv_check_write_range(bv, from, to)) != BV_OK)
+        return status;
+    if (from == to)
+        return BV_OK;
+
+    bv_range_masks(from, to, &first, &last, &head, &tail);
+    if (first == last)
+        head &= tail;
+    bv->data[first] = bit ? bv->data[first] | head : bv->data[first] & ~head;
+    if (first != last)
+    {
+        memset(bv->data + first + 1, bit ? 0xFF : 0, (last - first - 1) * sizeof(uint64_t));
+        bv->data[last] = bit ? bv->data[last] | tail : bv->data[last] & ~tail;
+    }
+    bv_rank_update_range(bv, from, to);
+    return BV_OK;
+}
+
+bv_status bv_range_flip(bitvector *bv, size_t from, size_t to)
+{
+    /** xor the first and last words with their masks, complement the whole words between them in place **/
+
+    uint64_t first, last, head, tail;
+    bv_status status;
+
+    if ((status = bv_check_write_range(bv, from, to)) != BV_OK)
+        return status;
+    if (from == to)
+        return BV_OK;
+
+    bv_range_masks(from, to, &first, &last, &head, &tail);
+    if (first == last)
+        head &= tail;
+    bv->data[first] ^= head;
+    if (first != last)
+    {
+        words_not(bv->data + first + 1, bv->data + first + 1, last - first - 1);
+        bv->data[last] ^= tail;
+    }
+    bv_rank_update_range(bv, from, to);
+    return BV_OK;
 }
 
 uint64_t msb(uint64_t v)
@@ -12,16 +12,33 @@
 #ifndef POPPY_BITVECTOR_H
 #define POPPY_BITVECTOR_H
 
-#endif // POPPY_BITVECTOR_H
-
 #include <stdlib.h>
+#include <stdint.h>
 #include <stdbool.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 #define ALL_ONES_MASK (0xffffffffffffffffUL)
 #define BIT (1UL)
 #define WORD_SIZE (64)
 #define LOG_WORD_SIZE (6UL)
 
+/** Poppy rank directory geometry */
+#define LOG_BASIC_BLOCK_SIZE (9UL)  // 512 bits, one cache line
+#define LOG_L1_BLOCK_SIZE (11UL)    // 2048 bits, four basic blocks
+#define LOG_L0_BLOCK_SIZE (32UL)    // 2^32 bits
+#define WORDS_PER_BASIC_BLOCK (8UL)
+#define WORDS_PER_L1_BLOCK (32UL)
+#define L2_FIELD_WIDTH (10UL)
+#define LOG_SELECT_SAMPLE_RATE (13UL) // sample every 8192nd set bit
+
+/** 0 drops the bounds and read-only checks of bv_set, bv_clear, bv_toggle and bv_isset; see the RS_CHECKED option */
+#ifndef RS_CHECKED
+#define RS_CHECKED (1)
+#endif
+
 #define GET_FAILURE_TEXT(s) "\x1b[31m" s "\033[m"
 #define GET_SUCCESS_TEXT(s) "\x1b[32m" s "\033[m"
 
@@ -35,11 +52,114 @@
     exit(EXIT_FAILURE);                                                        \
   } while (0)
 
+#define BV_CHECK_NONNULL(bv)                                                                                           \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        if (bv == NULL)                                                                                                \
+        {                                                                                                              \
+            BV_REPORT_ERROR_AND_EXIT(bv == NULL, __FILE__, __PRETTY_FUNCTION__, __LINE__, "null pointer encountered"); \
+        }                                                                                                              \
+    } while (0)
+
+/**
+ * @brief What the checked point accessors and the range, `_into`, `_inplace` and resizing writers return instead of
+ *        exiting on a bad position or faulting on a read-only view
+ */
+typedef enum
+{
+    BV_OK = 0,
+    BV_EINDEX, // the position is not below bv_len(bv), or the range is not within it; nothing was written
+    BV_EREADONLY, // the bitvector is a read-only view opened by bv_mmap; nothing was written
+} bv_status;
+
+/**
+ * @brief Poppy rank directory (Zhou, Andersen & Kaminsky, 2013)
+ *
+ * The bits are split into L0 blocks of 2^32 bits, L1 blocks of 2048 bits and basic blocks of 512 bits.
+ * Each L0 block stores the absolute number of ones before it.
+ * Each L1 block stores a single interleaved 64-bit entry:
+ * the low 32 bits hold the number of ones before the L1 block relative to its L0 block,
+ * and the next three 10-bit fields hold the popcounts of its first three basic blocks.
+ * A rank query therefore touches one L1 entry and at most one basic block of data.
+ *
+ * @note the directory takes 64 bits per 2048 bits, i.e 3.125% extra space
+ */
+typedef struct
+{
+    uint64_t *l0;      // absolute number of ones before each L0 block
+    uint64_t *l1l2;    // one interleaved L1/L2 entry per L1 block, from the allocator of the bitvector
+    uint64_t num_l0;   // number of L0 entries
+    uint64_t num_l1;   // number of L1/L2 entries
+    uint64_t ones;     // total number of set bits when the directory was built
+    uint64_t *dirty;      // one bit per L1 block written under BV_RANK_LAZY since the last repair, NULL until needed
+    uint64_t num_dirty;   // the number of L1 blocks marked in `dirty`
+    uint64_t dirty_from;  // the first L1 block marked in `dirty`
+    bool stale;           // written under BV_RANK_SNAPSHOT since the build, so the counters may be wrong
+} rank_directory;
+
+/**
+ * @brief CS-Poppy select samples
+ *
+ * For every 8192nd set bit (and every 8192nd cleared bit), the index of the L1 block containing it.
+ * A select query binary searches the L1 entries between two consecutive samples,
+ * walks the L2 fields of the L1 block and finishes with an in-word select.
+ */
+typedef struct
+{
+    uint32_t *samples;     // L1 block index of set bits 0, 8192, 16384, ...
+    uint64_t num_samples;  // number of samples
+    uint32_t *samples0;    // L1 block index of cleared bits 0, 8192, 16384, ...
+    uint64_t num_samples0; // number of samples0
+    bool stale;            // a point write moved the samples; rebuilt by the next select
+} select_directory;
+
+/**
+ * @brief How `bv_set`, `bv_clear`, `bv_toggle` and the range writes treat a built rank directory
+ *
+ * BV_RANK_SNAPSHOT leaves it untouched, so it must be rebuilt after writes.
+ * BV_RANK_EAGER adds the change to every later counter on each write: O(1) for the L2 field,
+ * plus one add per later L1 entry in the same L0 block and per later L0 entry. That is O(n / 2048) per write,
+ * up to 2^21 adds in a full 2^32-bit L0 block, so write-heavy workloads should prefer BV_RANK_LAZY.
+ * BV_RANK_LAZY only marks the L1 block dirty; the next query recounts the dirty blocks and shifts the later
+ * counters once, so a burst of writes pays for a single pass over the directory.
+ * Under both, select samples are rebuilt by the first select after a write.
+ */
+typedef enum
+{
+    BV_RANK_SNAPSHOT = 0,
+    BV_RANK_EAGER,
+    BV_RANK_LAZY,
+} bv_rank_policy;
+
+#define BV_DATA_ALIGNMENT (64UL) // every allocator hands out words starting on a cache line
+
+/**
+ * @brief Where the words of bitvectors come from
+ *
+ * All three functions get `ctx` back as their first argument. Memory from `alloc` must be zeroed
+ * and aligned to BV_DATA_ALIGNMENT, and `realloc` must keep the first min(old_bytes, new_bytes) bytes
+ * and zero the rest. Either may return NULL when out of memory, which the bitvector reports as it does a failed
+ * malloc. A bitvector keeps a pointer to the allocator that made its words and frees them through it,
+ * so an allocator must outlive every vector it allocated for.
+ */
+typedef struct bv_allocator
+{
+    void *(*alloc)(void *ctx, size_t bytes);
+    void *(*realloc)(void *ctx, void *ptr, size_t old_bytes, size_t new_bytes);
+    void (*free)(void *ctx, void *ptr, size_t bytes);
+    void *ctx;
+} bv_allocator;
+
 /**
  * @brief A bit vector / bit array is composed of 
  * 1) an array of words
  * 2) the number of bits specified by the user
  * 3) the number of bits allocated
+ * 4) an optional rank directory, built on demand by `bv_build_rank`
+ * 5) optional select samples, built on demand by `bv_build_select`
+ * 6) the file mapping backing a read-only view opened by `bv_mmap`
+ * 7) how point writes maintain the rank directory, see `bv_set_rank_policy`
+ * 8) the allocator owning the words, see `bv_set_allocator`
  * 
  * @note allocated >= size
  * 
@@ -49,15 +169,100 @@ typedef struct
     uint64_t *data; // a pointer to words
     uint64_t size; // the number of bits in the bit array
     uint64_t allocated; // how many bits were allocated. Must be a multiple of the word size
+    rank_directory *rank; // NULL until `bv_build_rank` is called
+    select_directory *select; // NULL until `bv_build_select` is called
+    void *mapping; // NULL unless data and directories live in a read-only file mapping
+    size_t mapping_bytes; // the length of the mapping
+    bv_rank_policy rank_policy; // BV_RANK_SNAPSHOT unless set by `bv_set_rank_policy`
+    const bv_allocator *allocator; // the allocator of data and of rank->l1l2; NULL for a mapping
 } bitvector;
 
 /**
  * @brief creates a new bit vector of the requested size
  * 
+ * The words come from the allocator set by `bv_set_allocator`.
+ *
  * @return bitvector* a new bitvector with the requested size
  */
 bitvector *bv_new(size_t);
 
+/**
+ * @brief The default allocator: calloc-like, but aligned to BV_DATA_ALIGNMENT
+ */
+extern const bv_allocator bv_aligned_allocator;
+
+/**
+ * @brief Choose the allocator of the vectors created from now on, including the results of the set operations
+ *
+ * Vectors keep the allocator they were created with, also when resized.
+ * The setting is process-wide; change it while no other thread is creating vectors.
+ *
+ * @param allocator the allocator, or NULL for `bv_aligned_allocator`
+ */
+void bv_set_allocator(const bv_allocator *allocator);
+
+/**
+ * @brief The allocator of the vectors created from now on
+ */
+const bv_allocator *bv_get_allocator(void);
+
+/**
+ * @brief How `bv_page_allocator_new` maps the words of large vectors
+ */
+typedef struct
+{
+    bool hugetlb;    // try explicit huge pages (MAP_HUGETLB) first; they must have been reserved by the administrator
+    int numa_node;   // bind the pages to this node, or -1 to let the kernel place them
+    bool interleave; // spread the pages round-robin over all nodes, for vectors every thread reads; overrides numa_node
+} bv_page_options;
+
+/**
+ * @brief An allocator mapping vectors of at least BV_HUGE_PAGE_BYTES straight from the kernel
+ *
+ * Mappings are rounded up to and aligned on 2MB huge pages. Unless explicit huge pages were asked for and are
+ * available, the range is advised with MADV_HUGEPAGE so transparent huge pages back it, and one TLB entry covers
+ * 2MB instead of 4KB: random rank and select queries over gigabytes of bits then mostly hit the TLB.
+ * NUMA placement is a best-effort hint applied with mbind before the pages are touched.
+ * Smaller vectors come from `bv_aligned_allocator`.
+ *
+ * @param options copied into the allocator
+ * @return const bv_allocator* a new allocator, released by `bv_page_allocator_free` once its vectors are freed
+ */
+const bv_allocator *bv_page_allocator_new(const bv_page_options *options);
+
+/**
+ * @brief Release an allocator made by `bv_page_allocator_new`; every vector allocated from it must have been freed
+ */
+void bv_page_allocator_free(const bv_allocator *allocator);
+
+#define BV_HUGE_PAGE_BYTES (BIT << 21)
+
+/**
+ * @brief A pool of fixed-size chunks recycling the words of small vectors
+ */
+typedef struct bv_pool bv_pool;
+
+/**
+ * @brief Create a pool serving allocations of up to BV_POOL_MAX_BYTES from 64KB slabs
+ *
+ * Each power-of-two size class keeps a free list, so the temporaries created and freed by
+ * `bv_xor`, `bv_copy` and friends reuse the same chunks instead of going through malloc every time.
+ * Larger allocations fall through to `bv_aligned_allocator`. The pool is thread-safe.
+ */
+bv_pool *bv_pool_new(void);
+
+#define BV_POOL_MAX_BYTES (4096UL)
+
+/**
+ * @brief Release the slabs of a pool; every vector allocated from it must have been freed
+ */
+void bv_pool_free(bv_pool *pool);
+
+/**
+ * @brief The allocator drawing from `pool`, owned by the pool and valid until `bv_pool_free`
+ */
+const bv_allocator *bv_pool_allocator(bv_pool *pool);
+
 
 /**
  * @brief Free up a bitvector from memory
@@ -65,13 +270,180 @@ bitvector *bv_new(size_t);
  */
 void bv_free(bitvector *);
 
+/**
+ * @brief The number of positions at which a and b differ, the shorter one padded with 0's
+ *
+ * Fuses the xor with the popcount, so no intermediate bitvector is allocated.
+ */
 uint64_t bv_hamming_distance(bitvector *, bitvector *);
 
-bitvector *bv_xor(bitvector *, bitvector *);
+/**
+ * @brief Instruction sets the bulk bitwise kernels can be dispatched to
+ */
+typedef enum
+{
+    BV_ISA_AUTO,   // the widest instruction set supported by the running CPU
+    BV_ISA_SCALAR,
+    BV_ISA_AVX2,
+    BV_ISA_AVX512
+} bv_isa;
 
-bitvector *bv_complement(bitvector *);
+/**
+ * @brief Choose the instruction set used by the bulk bitwise operations
+ *
+ * By default the widest instruction set supported by the CPU is picked on first use.
+ * Requesting an instruction set the CPU does not support falls back to the widest one it does.
+ *
+ * @param isa the requested instruction set
+ * @return bv_isa the instruction set now in use
+ */
+bv_isa bv_use_isa(bv_isa isa);
 
-bitvector *bv_intersection(bitvector *, bitvector *);
+/**
+ * @brief Get the instruction set currently used by the bulk bitwise operations
+ */
+bv_isa bv_current_isa(void);
+
+/**
+ * The set-algebra operations below return a new bitvector as long as the longer operand.
+ * The shorter operand is treated as if it were padded with 0's; neither operand is modified.
+ */
+
+/**
+ * @brief a ^ b, the symmetric difference of a and b
+ */
+bitvector *bv_xor(bitvector *a, bitvector *b);
+
+/**
+ * @brief ~bv, with bits past bv_len(bv) left cleared
+ */
+bitvector *bv_complement(bitvector *bv);
+
+/**
+ * @brief a & b, the intersection of a and b
+ */
+bitvector *bv_intersection(bitvector *a, bitvector *b);
+
+/**
+ * @brief a | b, the union of a and b
+ */
+bitvector *bv_union(bitvector *a, bitvector *b);
+
+/**
+ * @brief a & ~b, the elements of a that are not in b
+ */
+bitvector *bv_difference(bitvector *a, bitvector *b);
+
+/**
+ * Allocation-free forms of the operations above.
+ * The `_into` forms write the result to an existing `dst`, which is resized to the length of the result and may
+ * alias either operand; no memory is allocated when dst already has that length.
+ * The `_inplace` forms compute `a op= b`.
+ * Both drop the rank directory of the bitvector they write to, and return BV_EREADONLY without writing anything when
+ * it is a bv_mmap view, BV_OK otherwise.
+ */
+
+bv_status bv_xor_into(bitvector *dst, bitvector *a, bitvector *b);
+
+bv_status bv_intersection_into(bitvector *dst, bitvector *a, bitvector *b);
+
+bv_status bv_union_into(bitvector *dst, bitvector *a, bitvector *b);
+
+bv_status bv_difference_into(bitvector *dst, bitvector *a, bitvector *b);
+
+bv_status bv_complement_into(bitvector *dst, bitvector *bv);
+
+bv_status bv_copy_into(bitvector *dst, bitvector *bv);
+
+bv_status bv_reverse_into(bitvector *dst, bitvector *bv);
+
+bv_status bv_lshift_into(bitvector *dst, bitvector *bv, uint64_t k);
+
+bv_status bv_rshift_into(bitvector *dst, bitvector *bv, uint64_t k);
+
+bv_status bv_rotate_into(bitvector *dst, bitvector *bv, uint64_t k);
+
+bv_status bv_extend_into(bitvector *dst, bitvector *a, bitvector *b);
+
+bv_status bv_xor_inplace(bitvector *a, bitvector *b);
+
+bv_status bv_intersection_inplace(bitvector *a, bitvector *b);
+
+bv_status bv_union_inplace(bitvector *a, bitvector *b);
+
+bv_status bv_difference_inplace(bitvector *a, bitvector *b);
+
+bv_status bv_complement_inplace(bitvector *bv);
+
+bv_status bv_reverse_inplace(bitvector *bv);
+
+bv_status bv_lshift_inplace(bitvector *bv, uint64_t k);
+
+bv_status bv_rshift_inplace(bitvector *bv, uint64_t k);
+
+/**
+ * @brief Rotate in place; allocates a scratch buffer of min(k, bv_len(bv) - k) bits
+ */
+bv_status bv_rotate_inplace(bitvector *bv, uint64_t k);
+
+/**
+ * @brief Append the bits of b to a
+ */
+bv_status bv_extend_inplace(bitvector *a, bitvector *b);
+
+#define BV_EXPR_TILE_WORDS (512UL) // 4KB of each operand per tile
+
+/**
+ * @brief The operators of a `bv_expr`
+ */
+typedef enum
+{
+    BV_EXPR_LEAF = 0, // a bitvector operand
+    BV_EXPR_AND,      // children[0] & children[1] & ...
+    BV_EXPR_OR,       // children[0] | children[1] | ...
+    BV_EXPR_ANDNOT,   // children[0] & ~children[1] & ~children[2] & ...
+} bv_expr_op;
+
+/**
+ * @brief An expression tree over bitvectors, evaluated in one pass by `bv_eval`
+ *
+ * Nodes are plain structs, so a tree can be written with compound literals:
+ *
+ *     bv_expr a = {.op = BV_EXPR_LEAF, .bv = x}, b = {.op = BV_EXPR_LEAF, .bv = y}, c = {.op = BV_EXPR_LEAF, .bv = z};
+ *     bv_expr q = {.op = BV_EXPR_AND, .num_children = 3, .children = (const bv_expr *[]){&a, &b, &c}};
+ *
+ * Operands shorter than the longest one are padded with 0's.
+ * The children of AND and ANDNOT are evaluated in order and the rest are skipped as soon as a tile is empty,
+ * so list the most selective operand first.
+ */
+typedef struct bv_expr
+{
+    bv_expr_op op;
+    bitvector *bv;                         // the operand of a BV_EXPR_LEAF
+    size_t num_children;                   // at least 1 for the operators
+    const struct bv_expr *const *children; // the operands of an operator
+} bv_expr;
+
+/**
+ * @brief Evaluate an expression into a new bitvector as long as its longest operand
+ *
+ * Works through the operands in tiles of BV_EXPR_TILE_WORDS words that stay in L1 cache:
+ * every operand is read once, intermediate results never leave the tile buffers,
+ * and operands of an AND are not read at all for tiles that are already empty.
+ */
+bitvector *bv_eval(const bv_expr *expr);
+
+/**
+ * @brief Like `bv_eval`, but into an existing dst, which may be one of the operands
+ *
+ * @return bv_status BV_EREADONLY if dst is a bv_mmap view, and nothing is written; BV_OK otherwise
+ */
+bv_status bv_eval_into(bitvector *dst, const bv_expr *expr);
+
+/**
+ * @brief The number of set bits of the result of `expr`, without materializing it
+ */
+uint64_t bv_eval_count(const bv_expr *expr);
 
 /**
  * @brief Check for value equality between to bitvectors
@@ -97,36 +469,93 @@ bool bv_is(bitvector *, bitvector *);
  */
 size_t bv_len(bitvector *);
 
-void bv_resize(bitvector *, size_t);
+/**
+ * @brief Grow or shrink the bitvector to `new_size` bits; grown bits are 0
+ *
+ * @return bv_status BV_EREADONLY if the size changes and bv is a bv_mmap view, which is left alone; BV_OK otherwise
+ */
+bv_status bv_resize(bitvector *, size_t);
 
-void bv_set(bitvector *, uint64_t pos);
+/**
+ * @brief Set the bit at `pos` to `1`
+ *
+ * @param bv a nonnull bitvector
+ * @param pos the index of the bit to set
+ * @return bv_status BV_EINDEX if RS_CHECKED and pos >= bv_len(bv),
+ *         BV_EREADONLY if RS_CHECKED and bv is a bv_mmap view, BV_OK otherwise
+ */
+bv_status bv_set(bitvector *, uint64_t pos);
 
-void bv_range_set(bitvector *bv, uint8_t bit, size_t from, size_t to);
+/**
+ * @brief Set every bit in bv[from:to] to `bit`
+ *
+ * Masks the first and last words and fills the words between them with memset,
+ * then hands the whole range to `bv_rank_update_range` once.
+ *
+ * @param bv a nonnull bitvector
+ * @param bit 0 or 1
+ * @param from the start (inclusive) of the range
+ * @param to the end (exclusive) of the range, at most bv_len(bv)
+ * @return bv_status BV_EINDEX if from > to or to > bv_len(bv), BV_EREADONLY if bv is a bv_mmap view,
+ *         BV_OK otherwise
+ */
+bv_status bv_range_set(bitvector *bv, uint8_t bit, size_t from, size_t to);
 
 /**
  * @brief Set the bit at `pos` to `0`
  * 
  * @param bv a nonnull bitvector
  * @param pos the index of the bit to clear
+ * @return bv_status BV_EINDEX if RS_CHECKED and pos >= bv_len(bv),
+ *         BV_EREADONLY if RS_CHECKED and bv is a bv_mmap view, BV_OK otherwise
  */
-void bv_clear(bitvector *bv, uint64_t pos);
+bv_status bv_clear(bitvector *bv, uint64_t pos);
 
+/**
+ * @brief Flip the bit at `pos`
+ *
+ * @param bv a nonnull bitvector
+ * @param pos the index of the bit to flip
+ * @return true if the bit was flipped, false if RS_CHECKED and pos >= bv_len(bv) or bv is a bv_mmap view
+ */
 bool bv_toggle(bitvector *bv, uint64_t pos);
 
+/**
+ * @brief Flip the bit at `pos`, reporting why it was not flipped
+ *
+ * @param bv a nonnull bitvector
+ * @param pos the index of the bit to flip
+ * @return bv_status BV_EINDEX if RS_CHECKED and pos >= bv_len(bv),
+ *         BV_EREADONLY if RS_CHECKED and bv is a bv_mmap view, BV_OK otherwise
+ */
+bv_status bv_toggle_checked(bitvector *bv, uint64_t pos);
+
+/**
+ * @brief Toggle every bit in bv[from:to]
+ *
+ * @param bv a nonnull bitvector
+ * @param from the start (inclusive) of the range
+ * @param to the end (exclusive) of the range, at most bv_len(bv)
+ * @return bv_status BV_EINDEX if from > to or to > bv_len(bv), BV_EREADONLY if bv is a bv_mmap view,
+ *         BV_OK otherwise
+ */
+bv_status bv_range_flip(bitvector *bv, size_t from, size_t to);
+
 /**
  * @brief Checks that a index to a bitvector is within range, i,e 0 <= pos < bv_len(bv)
  * 
  * @param bv a nonnull bitvector
  * @param pos the index to check
+ * @return bv_status BV_OK if pos < bv_len(bv), BV_EINDEX otherwise
  */
-void bv_check_index(bitvector *bv, uint64_t pos);
+bv_status bv_check_index(bitvector *bv, uint64_t pos);
 
 /**
- * @brief Counts the number of set bits up to pos
+ * @brief Counts the number of set bits up to and including pos
  * 
  * @param bv a nonnull bitvector
- * @param pos last (exclusive) index to consider
- * @return uint64_t the number of set bits in bv[:pos]
+ * @param pos last (inclusive) index to consider
+ * @return uint64_t the number of set bits in bv[:pos + 1]
  */
 uint64_t bv_pop_count(bitvector *bv, uint64_t pos);
 
@@ -136,29 +565,381 @@ uint64_t bv_pop_count(bitvector *bv, uint64_t pos);
  * @param bv a nonnull bitvector
  * @param pos the target position.
  * @return true if the bit at index `pos` is set
- * @return false otherwise
+ * @return false otherwise, including for pos >= bv_len(bv) if RS_CHECKED
  */
 bool bv_isset(bitvector *bv, uint64_t pos);
 
 bitvector *bv_copy(bitvector *bv);
 
-bitvector *bv_extend(bitvector *, bitvector *);
+/**
+ * Shifts, rotations and concatenation move whole words with a funnel shift (see `words_shr`, `words_shl`),
+ * so they handle any length and any bit offset at close to memcpy speed.
+ * Bit i is the i'th bit from the start: shifting left moves bits towards higher positions, like `<<` on an integer.
+ */
+
+/**
+ * @brief Concatenation: the bits of a followed by the bits of b
+ */
+bitvector *bv_extend(bitvector *a, bitvector *b);
+
+/**
+ * @brief result[i] = bv[i + k], with the k highest positions zeroed; the length is unchanged
+ */
+bitvector *bv_rshift(bitvector *bv, uint64_t k);
 
-bitvector *bv_rshift(bitvector *, bitvector *);
+/**
+ * @brief result[i] = bv[i - k], with the k lowest positions zeroed; the length is unchanged
+ */
+bitvector *bv_lshift(bitvector *bv, uint64_t k);
 
-bitvector *bv_lshift(bitvector *, bitvector *);
+/**
+ * @brief result[(i + k) % bv_len(bv)] = bv[i], a left rotation by k
+ *
+ * Rotating right by k is a left rotation by bv_len(bv) - k.
+ */
+bitvector *bv_rotate(bitvector *bv, uint64_t k);
 
-bitvector *bv_rotate(bitvector *);
+/**
+ * @brief dst[to:to + n] = src[from:from + n], like memmove: src may be dst and the ranges may overlap
+ *
+ * Both ranges must lie within their bitvectors; otherwise nothing is copied and BV_EINDEX is returned.
+ * A dst opened by `bv_mmap` is not written and BV_EREADONLY is returned; a mapped src is fine.
+ * Reports the change to the rank directory of dst through `bv_rank_update_range`.
+ */
+bv_status bv_copy_range(bitvector *dst, uint64_t to, bitvector *src, uint64_t from, uint64_t n);
 
+/**
+ * @brief Reverse the order of the bits of a bitvector, bv_reversed[i] = bv[bv_len(bv) - 1 - i]
+ */
 bitvector *bv_reverse(bitvector *);
 
 void bv_print(bitvector *);
 
 void bv_print_dec(bitvector *);
 
+/**
+ * @brief Find the position of the kth set bit
+ *
+ * Runs in O(log(sample gap)) once `bv_build_select` has been called, otherwise falls back to a linear word scan.
+ *
+ * @param bv a nonnull bitvector
+ * @param k the (1-indexed) rank of the set bit to find
+ * @return int64_t the index of the kth set bit, or -1 if bv has fewer than k set bits
+ */
 int64_t bv_select(bitvector *, uint64_t);
 
+/**
+ * @brief Find the position of the kth cleared bit
+ *
+ * Uses the same directories as `bv_select`.
+ *
+ * @param bv a nonnull bitvector
+ * @param k the (1-indexed) rank of the cleared bit to find
+ * @return int64_t the index of the kth cleared bit, or -1 if bv has fewer than k cleared bits
+ */
+int64_t bv_select0(bitvector *, uint64_t);
+
+/**
+ * @brief Find the first set bit at or after pos
+ *
+ * Scans the words of the current 2048-bit L1 block, then jumps with rank/select if the rank directory is built
+ * and current, so long runs of zeros cost O(log n) instead of a scan. A BV_RANK_SNAPSHOT directory written since
+ * its build is not trusted, and the scan goes on to the end.
+ *
+ * @param bv a nonnull bitvector
+ * @param pos the first position to consider
+ * @return int64_t the smallest set position >= pos, or -1 if there is none
+ */
+int64_t bv_next_set(bitvector *bv, uint64_t pos);
+
+/**
+ * @brief Find the last set bit at or before pos
+ *
+ * @param bv a nonnull bitvector
+ * @param pos the last position to consider, clamped to bv_len(bv) - 1
+ * @return int64_t the largest set position <= pos, or -1 if there is none
+ */
+int64_t bv_prev_set(bitvector *bv, uint64_t pos);
+
+/**
+ * @brief Write pos - from for every set position pos in [from, to), in increasing order
+ *
+ * Runs the tzcnt/blsr, BMI2 or AVX-512 compress kernel selected by `bv_use_isa` over the whole words of the range.
+ * Offsets are 32-bit, so to - from must not exceed 2^32.
+ *
+ * @param bv a nonnull bitvector
+ * @param from the first position to decode
+ * @param to the end (exclusive) of the range, clamped to bv_len(bv)
+ * @param out receives the offsets; must have room for bv_rank(bv, to) - bv_rank(bv, from) entries
+ * @return size_t the number of offsets written
+ */
+size_t bv_decode_positions(bitvector *bv, uint64_t from, uint64_t to, uint32_t *out);
+
+/**
+ * @brief Build (or rebuild) the Poppy rank directory of a bitvector
+ *
+ * Under the default BV_RANK_SNAPSHOT policy the directory is a snapshot of `bv->data` and must be rebuilt after
+ * the bitvector is modified; see `bv_set_rank_policy` for keeping it current under point writes.
+ * Chunks of 1 MiB are counted independently on the worker pool of thread_pool.h, then stitched together by a
+ * prefix sum over the chunk totals, so construction scales with `bv_set_num_threads`.
+ *
+ * @param bv a nonnull bitvector
+ */
+void bv_build_rank(bitvector *bv);
+
+/**
+ * @brief Build (or rebuild) the select samples of a bitvector
+ *
+ * Builds the rank directory first if it is missing.
+ * Rebuilding the rank directory with `bv_build_rank` also rebuilds existing select samples.
+ *
+ * @param bv a nonnull bitvector
+ */
+void bv_build_select(bitvector *bv);
+
+/**
+ * @brief Free the rank directory and select samples of a bitvector, if any
+ *
+ * @param bv a nonnull bitvector
+ */
+void bv_drop_rank(bitvector *bv);
+
+/**
+ * @brief Choose how point writes maintain the rank directory and select samples
+ *
+ * Pending lazy repairs are applied before switching.
+ * Under BV_RANK_EAGER every write shifts all later counters, O(n / 2048) in the worst case; interleaved writes and
+ * queries that can tolerate a repair on the next query are cheaper under BV_RANK_LAZY.
+ * Under BV_RANK_LAZY queries repair the directory, so they must not run concurrently with each other after a write;
+ * call `bv_sync_rank` before handing the bitvector to concurrent readers.
+ *
+ * @param bv a nonnull bitvector
+ * @param policy one of BV_RANK_SNAPSHOT, BV_RANK_EAGER or BV_RANK_LAZY
+ */
+void bv_set_rank_policy(bitvector *bv, bv_rank_policy policy);
 
+/**
+ * @brief Record that the bit at `pos` was just changed to `bit`, according to the rank policy of `bv`
+ *
+ * `bv_set`, `bv_clear` and `bv_toggle` call this themselves; callers writing `bv->data` directly may call it
+ * for every bit they change.
+ *
+ * @param bv a nonnull bitvector
+ * @param pos the position of the bit that changed
+ * @param bit its new value
+ */
+void bv_rank_update(bitvector *bv, uint64_t pos, bool bit);
+
+/**
+ * @brief Record that any of the bits in bv[from:to] may have changed, according to the rank policy of `bv`
+ *
+ * Marks the covered L1 blocks dirty; under BV_RANK_EAGER they are recounted at once, in a single pass that also
+ * shifts the later counters. `bv_range_set` and `bv_range_flip` call this themselves.
+ *
+ * @param bv a nonnull bitvector
+ * @param from the start (inclusive) of the range
+ * @param to the end (exclusive) of the range
+ */
+void bv_rank_update_range(bitvector *bv, uint64_t from, uint64_t to);
+
+/**
+ * @brief Apply pending BV_RANK_LAZY repairs and rebuild stale select samples
+ *
+ * @param bv a nonnull bitvector
+ */
+void bv_sync_rank(bitvector *bv);
+
+/**
+ * Unchecked point accessors, inlined into the caller: no bounds check and no call, so loops over them can keep
+ * `bv->data` in a register and vectorize. `pos` must be below bv_len(bv), and the writes need a bv that is not a
+ * bv_mmap view; the checked functions above are these plus those comparisons. The writes keep a built rank
+ * directory current through `bv_rank_update`.
+ */
+
+static inline bool bv_isset_unchecked(const bitvector *bv, uint64_t pos)
+{
+    return (bv->data[pos >> LOG_WORD_SIZE] >> (pos % WORD_SIZE)) & BIT;
+}
+
+static inline void bv_set_unchecked(bitvector *bv, uint64_t pos)
+{
+    uint64_t word = bv->data[pos >> LOG_WORD_SIZE];
+
+    bv->data[pos >> LOG_WORD_SIZE] = word | (BIT << (pos % WORD_SIZE));
+    if (bv->rank != NULL && !((word >> (pos % WORD_SIZE)) & BIT))
+        bv_rank_update(bv, pos, true);
+}
+
+static inline void bv_clear_unchecked(bitvector *bv, uint64_t pos)
+{
+    uint64_t word = bv->data[pos >> LOG_WORD_SIZE];
+
+    bv->data[pos >> LOG_WORD_SIZE] = word & ~(BIT << (pos % WORD_SIZE));
+    if (bv->rank != NULL && ((word >> (pos % WORD_SIZE)) & BIT))
+        bv_rank_update(bv, pos, false);
+}
+
+static inline void bv_toggle_unchecked(bitvector *bv, uint64_t pos)
+{
+    uint64_t word = bv->data[pos >> LOG_WORD_SIZE] ^ (BIT << (pos % WORD_SIZE));
+
+    bv->data[pos >> LOG_WORD_SIZE] = word;
+    if (bv->rank != NULL)
+        bv_rank_update(bv, pos, (word >> (pos % WORD_SIZE)) & BIT);
+}
+
+/**
+ * Streaming construction: bits are appended in order and the rank directory entry of every 2048-bit L1 block is
+ * written as soon as the block is complete, so the directory is ready without a second pass over the data.
+ */
+typedef struct bv_builder bv_builder;
+
+/**
+ * @brief Create an empty builder
+ *
+ * @param expected_bits a capacity hint, the builder grows past it as needed
+ * @return bv_builder* a builder to be consumed by `bv_builder_finish`
+ */
+bv_builder *bv_builder_new(uint64_t expected_bits);
+
+/**
+ * @brief Append the low `nbits` bits of `bits`, least significant first
+ *
+ * @param builder a nonnull builder
+ * @param bits the bits to append
+ * @param nbits how many bits to append, at most WORD_SIZE
+ */
+void bv_builder_append(bv_builder *builder, uint64_t bits, unsigned nbits);
+
+/**
+ * @brief Append a single bit
+ */
+void bv_builder_push(bv_builder *builder, bool bit);
+
+/**
+ * @brief Turn a builder into a bitvector whose rank directory is already built
+ *
+ * The builder is consumed and must not be used afterwards.
+ *
+ * @param builder a nonnull builder
+ * @return bitvector* a bitvector holding every appended bit
+ */
+bitvector *bv_builder_finish(bv_builder *builder);
+
+/**
+ * @brief Counts the number of set bits strictly before pos
+ *
+ * Runs in O(1) once `bv_build_rank` has been called, otherwise falls back to a linear scan.
+ *
+ * @param bv a nonnull bitvector
+ * @param pos last (exclusive) index to consider, clamped to bv_len(bv)
+ * @return uint64_t the number of set bits in bv[:pos]
+ */
+uint64_t bv_rank(bitvector *bv, uint64_t pos);
+
+/**
+ * @brief Counts the number of set bits in bv[from:to] as bv_rank(bv, to) - bv_rank(bv, from)
+ *
+ * @param bv a nonnull bitvector
+ * @param from the start (inclusive) of the range
+ * @param to the end (exclusive) of the range, clamped to bv_len(bv)
+ * @return uint64_t 0 when from >= to
+ */
+uint64_t bv_rank_range(bitvector *bv, uint64_t from, uint64_t to);
+
+/**
+ * @brief Counts the bits equal to `bit` in bv[from:to] by popcounting the words of the range
+ *
+ * Never touches the rank directory, so it needs none and does not trigger lazy repairs;
+ * prefer it to `bv_rank_range` for ranges of a few L1 blocks.
+ *
+ * @param bv a nonnull bitvector
+ * @param bit 0 or 1
+ * @param from the start (inclusive) of the range
+ * @param to the end (exclusive) of the range, clamped to bv_len(bv)
+ */
+uint64_t bv_count_range(bitvector *bv, uint8_t bit, uint64_t from, uint64_t to);
+
+#define BV_BATCH_SORT (1U << 0)   // evaluate the queries in increasing order, so that neighbouring queries share lines
+#define BV_BATCH_SERIAL (1U << 1) // stay on the calling thread
+
+/**
+ * @brief out[i] = bv_rank(bv, positions[i]) for 0 <= i < n
+ *
+ * Keeps several queries in flight by prefetching the directory entry and data words of a query a few iterations
+ * before resolving it, and splits large batches across the worker pool of thread_pool.h.
+ * Builds the rank directory first if it is missing.
+ *
+ * @param bv a nonnull bitvector
+ * @param positions the query positions
+ * @param out receives the ranks
+ * @param n the number of queries
+ * @param flags a combination of BV_BATCH_SORT and BV_BATCH_SERIAL, or 0
+ */
+void bv_rank_batch(bitvector *bv, const uint64_t *positions, uint64_t *out, size_t n, unsigned flags);
+
+/**
+ * @brief out[i] = bv_select(bv, ks[i]) for 0 <= i < n
+ *
+ * Resolves groups of queries stage by stage (samples, L1 entries, L2 counts, words), prefetching for the whole group
+ * between stages so that the dependent cache misses of different queries overlap.
+ * Returns -1 for k == 0 and for k larger than the number of set bits.
+ * Builds the select samples first if they are missing.
+ *
+ * @param flags a combination of BV_BATCH_SORT and BV_BATCH_SERIAL, or 0
+ */
+void bv_select_batch(bitvector *bv, const uint64_t *ks, int64_t *out, size_t n, unsigned flags);
+
+/**
+ * @brief Get the number of bytes used by the rank/select directories of a bitvector
+ *
+ * @param bv a nonnull bitvector
+ * @return size_t the size in bytes of the directories, 0 if none were built
+ */
+size_t bv_index_bytes(bitvector *bv);
+
+
+
+/**
+ * On-disk format, written by `bv_save` and opened by `bv_mmap` (version 1, native byte order):
+ *
+ *   offset 0     128-byte header: magic "POPPYBV", version, byte-order mark, size, number of ones,
+ *                and the (offset, count) of every section below
+ *   data         the words of the bitvector, including the spare word past the end
+ *   l0           the L0 entries of the rank directory
+ *   l1l2         the interleaved L1/L2 entries of the rank directory
+ *   samples      the select samples (uint32_t)
+ *   samples0     the select0 samples (uint32_t)
+ *
+ * Every section starts on a 64-byte boundary so the view keeps the cache-line alignment of the directories.
+ */
+#define BV_FILE_VERSION (1U)
+
+/**
+ * @brief Write a bitvector and its rank/select directories to a file
+ *
+ * Rebuilds the directories first, so that the file never carries a stale BV_RANK_SNAPSHOT directory.
+ *
+ * @param bv a nonnull bitvector
+ * @param path the file to create or truncate
+ * @return int 0 on success, -1 on failure with errno set
+ */
+int bv_save(bitvector *bv, const char *path);
+
+/**
+ * @brief Open a file written by `bv_save` as a zero-copy, read-only bitvector
+ *
+ * The data and the rank/select directories are used in place from the mapping. Opening reads only the header,
+ * the L0 entries and the select samples, which it validates: sorted, and within the rank directory. The L1/L2
+ * entries are not checked, so that opening stays independent of the size; a corrupted entry gives wrong answers,
+ * but select never reads or answers past the vector. Other pages are faulted in on first access.
+ * The view answers every read-only query. The checked writers, the `_into` and `_inplace` forms and `bv_resize`
+ * return BV_EREADONLY for it; the unchecked ones fault. Release it with `bv_free`.
+ *
+ * @param path the file to open
+ * @return bitvector* the view, or NULL with errno set if the file cannot be mapped or is not a valid file
+ */
+bitvector *bv_mmap(const char *path);
 
 void word_bin_rep(char *string, uint64_t x, size_t nx);
 
@@ -173,3 +954,9 @@ void string_reverse(char *string, size_t ns);
 uint64_t reverse_bits(uint64_t x);
 
 uint64_t msb(uint64_t v);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // POPPY_BITVECTOR_H
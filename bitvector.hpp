@@ -0,0 +1,550 @@
+/**
+ * @file bitvector.hpp
+ * @brief Header-only C++ interface: an owning rs::bitvector with fused bitwise expressions, and rs::bitset<N>
+ */
+
+#ifndef POPPY_BITVECTOR_HPP
+#define POPPY_BITVECTOR_HPP
+
+#include "bitvector.h"
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+namespace rs
+{
+    class bitvector;
+
+    namespace detail
+    {
+        /** the words bv_new allocates for `bits` bits: one past the last occupied one */
+        constexpr size_t num_words(size_t bits) noexcept
+        {
+            return (bits >> LOG_WORD_SIZE) + 1;
+        }
+
+        constexpr size_t min(size_t a, size_t b) noexcept
+        {
+            return a < b ? a : b;
+        }
+
+        constexpr size_t max(size_t a, size_t b) noexcept
+        {
+            return a > b ? a : b;
+        }
+
+        /**
+         * @brief The base of every node of a bitwise expression
+         *
+         * A node answers three questions: the length in bits of its result, `size()`; how many leading words
+         * every operand has, `common_words()`; and its ith word, either for i < common_words() without bounds
+         * checks, `word_unchecked(i)`, or for any i, operands being padded with 0's, `word(i)`.
+         * Nodes are small and held by value, so an expression can outlive the statement that built it,
+         * though not the bitvectors it reads.
+         */
+        template <class E>
+        struct expr
+        {
+            const E &self() const noexcept
+            {
+                return static_cast<const E &>(*this);
+            }
+        };
+
+        /** a bitvector inside an expression */
+        class leaf : public expr<leaf>
+        {
+            const ::bitvector *bv_; // read through on every access, so the destination may be resized first
+
+        public:
+            explicit leaf(const ::bitvector *bv) noexcept : bv_(bv) {}
+
+            size_t size() const noexcept { return bv_->size; }
+            size_t common_words() const noexcept { return num_words(bv_->size); }
+            uint64_t word_unchecked(size_t i) const noexcept { return bv_->data[i]; }
+            uint64_t word(size_t i) const noexcept { return i < num_words(bv_->size) ? bv_->data[i] : 0; }
+        };
+
+        template <class Op, class L, class R>
+        class binary : public expr<binary<Op, L, R>>
+        {
+            L l_;
+            R r_;
+
+        public:
+            binary(const L &l, const R &r) noexcept : l_(l), r_(r) {}
+
+            size_t size() const noexcept { return max(l_.size(), r_.size()); }
+            size_t common_words() const noexcept { return min(l_.common_words(), r_.common_words()); }
+            uint64_t word_unchecked(size_t i) const noexcept { return Op::apply(l_.word_unchecked(i), r_.word_unchecked(i)); }
+            uint64_t word(size_t i) const noexcept { return Op::apply(l_.word(i), r_.word(i)); }
+        };
+
+        /** the complement sets the bits past the end of its operand too; materializing clears them */
+        template <class E>
+        class complement : public expr<complement<E>>
+        {
+            E e_;
+
+        public:
+            explicit complement(const E &e) noexcept : e_(e) {}
+
+            size_t size() const noexcept { return e_.size(); }
+            size_t common_words() const noexcept { return e_.common_words(); }
+            uint64_t word_unchecked(size_t i) const noexcept { return ~e_.word_unchecked(i); }
+            uint64_t word(size_t i) const noexcept { return ~e_.word(i); }
+        };
+
+        struct and_op
+        {
+            static uint64_t apply(uint64_t a, uint64_t b) noexcept { return a & b; }
+        };
+
+        struct or_op
+        {
+            static uint64_t apply(uint64_t a, uint64_t b) noexcept { return a | b; }
+        };
+
+        struct xor_op
+        {
+            static uint64_t apply(uint64_t a, uint64_t b) noexcept { return a ^ b; }
+        };
+
+        template <class T>
+        struct is_operand : std::integral_constant<bool, std::is_base_of<expr<T>, T>::value ||
+                                                             std::is_same<T, rs::bitvector>::value>
+        {
+        };
+
+        template <class E>
+        const E &as_expr(const expr<E> &e) noexcept
+        {
+            return e.self();
+        }
+
+        inline leaf as_expr(const rs::bitvector &bv) noexcept;
+
+        template <class T>
+        using node_t = typename std::decay<decltype(as_expr(std::declval<const T &>()))>::type;
+
+        /** the mask of the bits of the last word below `bits` */
+        constexpr uint64_t tail_mask(size_t bits) noexcept
+        {
+            return (bits % WORD_SIZE) ? (ALL_ONES_MASK >> (WORD_SIZE - bits % WORD_SIZE)) : 0;
+        }
+
+        template <class E>
+        void materialize(::bitvector *dst, const expr<E> &e)
+        {
+            /**
+             * size dst first, then write every word in one pass: the words all operands have without bounds checks,
+             * so that the loop vectorizes, then the rest. dst may be an operand; its size only grows,
+             * and word i is read before it is written
+             **/
+
+            const E &node = e.self();
+            size_t i, n = node.size(), words = num_words(n), common = min(node.common_words(), words);
+
+            if (dst->mapping != NULL)
+                throw std::logic_error("rs::bitvector: cannot assign to a read-only mapping");
+            bv_drop_rank(dst);
+            bv_resize(dst, n);
+            for (i = 0; i < common; i++)
+                dst->data[i] = node.word_unchecked(i);
+            for (; i < words; i++)
+                dst->data[i] = node.word(i);
+            dst->data[words - 1] &= tail_mask(n);
+        }
+    } // namespace detail
+
+    /**
+     * @brief An owning, move-only handle on a `::bitvector`
+     *
+     * `operator[]` and the `_unchecked` writes are the inline accessors of bitvector.h, without bounds checks;
+     * `test`, `set`, `reset` and `flip` check and throw std::out_of_range (the writes only if built with RS_CHECKED).
+     * All writes keep a built rank directory up to date.
+     * `&`, `|`, `^` and `~` build expression templates rather than bitvectors: assigning one evaluates
+     * the whole expression word by word in a single pass, and `rs::count` counts its bits without storing them.
+     * Results are as long as the longest operand.
+     */
+    class bitvector
+    {
+        ::bitvector *bv_;
+
+        struct adopt_tag
+        {
+        };
+
+        bitvector(adopt_tag, ::bitvector *bv) noexcept : bv_(bv) {}
+
+        static void check(bv_status status, const char *what)
+        {
+            if (status == BV_EINDEX)
+                throw std::out_of_range(std::string(what) + ": position out of range");
+            if (status == BV_EREADONLY)
+                throw std::logic_error(std::string(what) + ": bitvector is a read-only mapping");
+        }
+
+    public:
+        explicit bitvector(size_t bits = 0) : bv_(bv_new(bits)) {}
+
+        /** take ownership of a vector from the C API; named, since a constructor would make bitvector(0) ambiguous */
+        static bitvector adopt(::bitvector *bv) noexcept
+        {
+            return bitvector(adopt_tag{}, bv);
+        }
+
+        template <class E>
+        bitvector(const detail::expr<E> &e) : bv_(bv_new(0))
+        {
+            detail::materialize(bv_, e);
+        }
+
+        bitvector(const bitvector &) = delete;
+        bitvector &operator=(const bitvector &) = delete;
+
+        bitvector(bitvector &&other) noexcept : bv_(other.bv_)
+        {
+            other.bv_ = nullptr;
+        }
+
+        bitvector &operator=(bitvector &&other) noexcept
+        {
+            std::swap(bv_, other.bv_);
+            return *this;
+        }
+
+        template <class E>
+        bitvector &operator=(const detail::expr<E> &e)
+        {
+            detail::materialize(bv_, e);
+            return *this;
+        }
+
+        ~bitvector()
+        {
+            if (bv_ != nullptr)
+                bv_free(bv_);
+        }
+
+        /** a deep copy, spelled out since copies of large vectors should be visible */
+        bitvector clone() const
+        {
+            return adopt(bv_copy(bv_));
+        }
+
+        ::bitvector *get() const noexcept { return bv_; }
+
+        /** give up ownership; the caller frees the result with bv_free */
+        ::bitvector *release() noexcept
+        {
+            ::bitvector *bv = bv_;
+            bv_ = nullptr;
+            return bv;
+        }
+
+        size_t size() const noexcept { return bv_->size; }
+        size_t num_words() const noexcept { return detail::num_words(bv_->size); }
+        const uint64_t *data() const noexcept { return bv_->data; }
+
+        bool operator[](size_t pos) const noexcept
+        {
+            return bv_isset_unchecked(bv_, pos);
+        }
+
+        bool test(size_t pos) const
+        {
+            if (pos >= size())
+                throw std::out_of_range("rs::bitvector::test: position out of range");
+            return (*this)[pos];
+        }
+
+        void set(size_t pos) { check(bv_set(bv_, pos), "rs::bitvector::set"); }
+        void reset(size_t pos) { check(bv_clear(bv_, pos), "rs::bitvector::reset"); }
+        void flip(size_t pos) { check(bv_toggle_checked(bv_, pos), "rs::bitvector::flip"); }
+
+        void assign(size_t pos, bool bit)
+        {
+            if (bit)
+                set(pos);
+            else
+                reset(pos);
+        }
+
+        void set_unchecked(size_t pos) noexcept { bv_set_unchecked(bv_, pos); }
+        void reset_unchecked(size_t pos) noexcept { bv_clear_unchecked(bv_, pos); }
+        void flip_unchecked(size_t pos) noexcept { bv_toggle_unchecked(bv_, pos); }
+
+        void resize(size_t bits) { check(bv_resize(bv_, bits), "rs::bitvector::resize"); }
+
+        uint64_t count() const { return bv_count_range(bv_, 1, 0, size()); }
+
+        void build_rank() { bv_build_rank(bv_); }
+        void build_select() { bv_build_select(bv_); }
+
+        /** the number of set bits before pos; O(1) once `build_rank` has been called, a linear scan otherwise */
+        uint64_t rank(size_t pos) const { return bv_rank(bv_, pos); }
+
+        /** the position of the kth (1-indexed) set bit, or -1 */
+        int64_t select(uint64_t k) const { return bv_select(bv_, k); }
+
+        bitvector &operator&=(const bitvector &other)
+        {
+            check(bv_intersection_inplace(bv_, other.bv_), "rs::bitvector::operator&=");
+            return *this;
+        }
+
+        bitvector &operator|=(const bitvector &other)
+        {
+            check(bv_union_inplace(bv_, other.bv_), "rs::bitvector::operator|=");
+            return *this;
+        }
+
+        bitvector &operator^=(const bitvector &other)
+        {
+            check(bv_xor_inplace(bv_, other.bv_), "rs::bitvector::operator^=");
+            return *this;
+        }
+
+        friend bool operator==(const bitvector &a, const bitvector &b) { return bv_equal(a.bv_, b.bv_); }
+        friend bool operator!=(const bitvector &a, const bitvector &b) { return !bv_equal(a.bv_, b.bv_); }
+    };
+
+    inline detail::leaf detail::as_expr(const rs::bitvector &bv) noexcept
+    {
+        return detail::leaf(bv.get());
+    }
+
+    template <class L, class R, class = typename std::enable_if<detail::is_operand<L>::value && detail::is_operand<R>::value>::type>
+    detail::binary<detail::and_op, detail::node_t<L>, detail::node_t<R>> operator&(const L &l, const R &r) noexcept
+    {
+        return {detail::as_expr(l), detail::as_expr(r)};
+    }
+
+    template <class L, class R, class = typename std::enable_if<detail::is_operand<L>::value && detail::is_operand<R>::value>::type>
+    detail::binary<detail::or_op, detail::node_t<L>, detail::node_t<R>> operator|(const L &l, const R &r) noexcept
+    {
+        return {detail::as_expr(l), detail::as_expr(r)};
+    }
+
+    template <class L, class R, class = typename std::enable_if<detail::is_operand<L>::value && detail::is_operand<R>::value>::type>
+    detail::binary<detail::xor_op, detail::node_t<L>, detail::node_t<R>> operator^(const L &l, const R &r) noexcept
+    {
+        return {detail::as_expr(l), detail::as_expr(r)};
+    }
+
+    template <class E, class = typename std::enable_if<detail::is_operand<E>::value>::type>
+    detail::complement<detail::node_t<E>> operator~(const E &e) noexcept
+    {
+        return detail::complement<detail::node_t<E>>(detail::as_expr(e));
+    }
+
+    /**
+     * @brief The number of set bits in the result of an expression, without materializing it
+     */
+    template <class E, class = typename std::enable_if<detail::is_operand<E>::value>::type>
+    uint64_t count(const E &e) noexcept
+    {
+        const auto node = detail::as_expr(e);
+        size_t i, n = node.size(), words = detail::num_words(n), common = detail::min(node.common_words(), words - 1);
+        uint64_t card = 0;
+
+        for (i = 0; i < common; i++)
+            card += __builtin_popcountll(node.word_unchecked(i));
+        for (; i + 1 < words; i++)
+            card += __builtin_popcountll(node.word(i));
+        return card + __builtin_popcountll(node.word(words - 1) & detail::tail_mask(n));
+    }
+
+    namespace detail
+    {
+        /* found by argument-dependent lookup on expressions with no rs::bitvector operand, such as ~(a | b) */
+        using rs::operator&;
+        using rs::operator|;
+        using rs::operator^;
+        using rs::operator~;
+        using rs::count;
+    } // namespace detail
+
+    /**
+     * @brief N bits in an inline array of words, usable in constant expressions
+     *
+     * The number of words is a compile-time constant, so the loops of `count`, `rank`, the bitwise operators and
+     * comparisons unroll completely for small N. Bits past N are kept 0, and select is 1-indexed as in `bv_select`.
+     */
+    template <size_t N>
+    class bitset
+    {
+    public:
+        static constexpr size_t num_words = N ? (N + WORD_SIZE - 1) / WORD_SIZE : 1;
+
+    private:
+        uint64_t words_[num_words];
+
+        static constexpr uint64_t last_mask() noexcept
+        {
+            return (N % WORD_SIZE) ? (ALL_ONES_MASK >> (WORD_SIZE - N % WORD_SIZE)) : (N ? ALL_ONES_MASK : 0);
+        }
+
+    public:
+        constexpr bitset() noexcept : words_{} {}
+
+        /** the low bits of `value`, truncated to N */
+        constexpr explicit bitset(uint64_t value) noexcept : words_{}
+        {
+            words_[0] = value & (num_words == 1 ? last_mask() : ALL_ONES_MASK);
+        }
+
+        static constexpr size_t size() noexcept { return N; }
+        constexpr const uint64_t *data() const noexcept { return words_; }
+
+        constexpr bool operator[](size_t pos) const noexcept
+        {
+            return (words_[pos / WORD_SIZE] >> (pos % WORD_SIZE)) & 1;
+        }
+
+        constexpr bool test(size_t pos) const
+        {
+            return pos < N ? (*this)[pos] : throw std::out_of_range("rs::bitset::test: position out of range");
+        }
+
+        constexpr bitset &set(size_t pos, bool bit = true) noexcept
+        {
+            words_[pos / WORD_SIZE] = (words_[pos / WORD_SIZE] & ~(BIT << (pos % WORD_SIZE))) |
+                                      ((uint64_t)bit << (pos % WORD_SIZE));
+            return *this;
+        }
+
+        constexpr bitset &reset(size_t pos) noexcept { return set(pos, false); }
+
+        constexpr bitset &flip(size_t pos) noexcept
+        {
+            words_[pos / WORD_SIZE] ^= BIT << (pos % WORD_SIZE);
+            return *this;
+        }
+
+        constexpr bitset &set() noexcept
+        {
+            for (size_t i = 0; i < num_words; i++)
+                words_[i] = ALL_ONES_MASK;
+            words_[num_words - 1] = last_mask();
+            return *this;
+        }
+
+        constexpr bitset &reset() noexcept
+        {
+            for (size_t i = 0; i < num_words; i++)
+                words_[i] = 0;
+            return *this;
+        }
+
+        constexpr bitset &flip() noexcept
+        {
+            for (size_t i = 0; i < num_words; i++)
+                words_[i] = ~words_[i];
+            words_[num_words - 1] &= last_mask();
+            return *this;
+        }
+
+        constexpr size_t count() const noexcept
+        {
+            size_t card = 0;
+
+            for (size_t i = 0; i < num_words; i++)
+                card += __builtin_popcountll(words_[i]);
+            return card;
+        }
+
+        constexpr bool any() const noexcept { return count() != 0; }
+        constexpr bool none() const noexcept { return count() == 0; }
+        constexpr bool all() const noexcept { return count() == N; }
+
+        /** the number of set bits strictly before pos, for pos <= N; every word is masked without branches, so the loop unrolls */
+        constexpr size_t rank(size_t pos) const noexcept
+        {
+            size_t card = 0;
+            uint64_t below = 0, at = 0, partial = (BIT << (pos % WORD_SIZE)) - 1;
+
+            for (size_t i = 0; i < num_words; i++)
+            {
+                below = i < pos / WORD_SIZE;
+                at = i == pos / WORD_SIZE;
+                card += __builtin_popcountll(words_[i] & ((0 - below) | ((0 - at) & partial)));
+            }
+            return card;
+        }
+
+        /** the position of the kth (1-indexed) set bit, or -1 */
+        constexpr int64_t select(size_t k) const noexcept
+        {
+            uint64_t w = 0;
+            size_t c = 0;
+
+            for (size_t i = 0; i < num_words && k > 0; i++)
+            {
+                c = __builtin_popcountll(words_[i]);
+                if (k > c)
+                {
+                    k -= c;
+                    continue;
+                }
+                for (w = words_[i]; --k > 0;)
+                    w &= w - 1;
+                return (int64_t)(i * WORD_SIZE + __builtin_ctzll(w));
+            }
+            return -1;
+        }
+
+        constexpr bitset &operator&=(const bitset &other) noexcept
+        {
+            for (size_t i = 0; i < num_words; i++)
+                words_[i] &= other.words_[i];
+            return *this;
+        }
+
+        constexpr bitset &operator|=(const bitset &other) noexcept
+        {
+            for (size_t i = 0; i < num_words; i++)
+                words_[i] |= other.words_[i];
+            return *this;
+        }
+
+        constexpr bitset &operator^=(const bitset &other) noexcept
+        {
+            for (size_t i = 0; i < num_words; i++)
+                words_[i] ^= other.words_[i];
+            return *this;
+        }
+
+        constexpr bitset operator~() const noexcept { return bitset(*this).flip(); }
+
+        friend constexpr bitset operator&(bitset a, const bitset &b) noexcept { return a &= b; }
+        friend constexpr bitset operator|(bitset a, const bitset &b) noexcept { return a |= b; }
+        friend constexpr bitset operator^(bitset a, const bitset &b) noexcept { return a ^= b; }
+
+        friend constexpr bool operator==(const bitset &a, const bitset &b) noexcept
+        {
+            for (size_t i = 0; i < num_words; i++)
+                if (a.words_[i] != b.words_[i])
+                    return false;
+            return true;
+        }
+
+        friend constexpr bool operator!=(const bitset &a, const bitset &b) noexcept { return !(a == b); }
+
+        /** a heap copy for the rank/select directories of the C API */
+        rs::bitvector to_bitvector() const
+        {
+            rs::bitvector bv(N);
+
+            for (size_t i = 0; i < num_words; i++)
+                bv.get()->data[i] = words_[i];
+            return bv;
+        }
+    };
+} // namespace rs
+
+#endif // POPPY_BITVECTOR_HPP
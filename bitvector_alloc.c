@@ -0,0 +1,329 @@
+#include "bitvector.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define POOL_MIN_BYTES BV_DATA_ALIGNMENT
+#define POOL_NUM_CLASSES (7UL)        // 64, 128, ..., BV_POOL_MAX_BYTES
+#define POOL_SLAB_BYTES (BIT << 16)
+
+/* the mbind modes of <numaif.h>, which would otherwise pull in libnuma */
+#define BV_MPOL_BIND (2)
+#define BV_MPOL_INTERLEAVE (3)
+
+_Static_assert(POOL_MIN_BYTES << (POOL_NUM_CLASSES - 1) == BV_POOL_MAX_BYTES, "size classes must end at BV_POOL_MAX_BYTES");
+
+static inline size_t round_up(size_t bytes, size_t multiple)
+{
+    return (bytes + multiple - 1) / multiple * multiple;
+}
+
+static void *aligned_alloc_zeroed(void *ctx, size_t bytes)
+{
+    /** aligned_alloc wants a multiple of the alignment **/
+
+    void *ptr = aligned_alloc(BV_DATA_ALIGNMENT, round_up(bytes ? bytes : 1, BV_DATA_ALIGNMENT));
+
+    (void)ctx;
+    if (ptr == NULL)
+    {
+        BV_REPORT_ERROR_AND_EXIT(ptr == NULL, __FILE__, __PRETTY_FUNCTION__, __LINE__, "could not allocate %zu bytes", bytes);
+    }
+    return memset(ptr, 0, bytes);
+}
+
+static void aligned_free(void *ctx, void *ptr, size_t bytes)
+{
+    (void)ctx, (void)bytes;
+    free(ptr);
+}
+
+static void *move_words(const bv_allocator *allocator, void *ptr, size_t old_bytes, size_t new_bytes)
+{
+    /** a realloc that always moves: allocate zeroed, copy what is kept, free the old block **/
+
+    void *moved = allocator->alloc(allocator->ctx, new_bytes);
+
+    memcpy(moved, ptr, (old_bytes < new_bytes) ? old_bytes : new_bytes);
+    allocator->free(allocator->ctx, ptr, old_bytes);
+    return moved;
+}
+
+static void *aligned_realloc(void *ctx, void *ptr, size_t old_bytes, size_t new_bytes)
+{
+    /** C has no aligned realloc, but the rounding of aligned_alloc_zeroed often leaves room to grow in place **/
+
+    if (round_up(new_bytes, BV_DATA_ALIGNMENT) == round_up(old_bytes, BV_DATA_ALIGNMENT))
+    {
+        if (new_bytes > old_bytes)
+            memset((char *)ptr + old_bytes, 0, new_bytes - old_bytes);
+        return ptr;
+    }
+    (void)ctx;
+    return move_words(&bv_aligned_allocator, ptr, old_bytes, new_bytes);
+}
+
+const bv_allocator bv_aligned_allocator = {aligned_alloc_zeroed, aligned_realloc, aligned_free, NULL};
+
+static const bv_allocator *current_allocator = &bv_aligned_allocator;
+
+void bv_set_allocator(const bv_allocator *allocator)
+{
+    current_allocator = (allocator != NULL) ? allocator : &bv_aligned_allocator;
+}
+
+const bv_allocator *bv_get_allocator(void)
+{
+    return current_allocator;
+}
+
+static void place_pages(void *ptr, size_t bytes, const bv_page_options *options)
+{
+    /** ask the kernel to place the pages before anything touches them; failure only costs locality **/
+
+    unsigned long nodemask;
+
+    if (options->interleave)
+    {
+        /* the kernel drops nodes without memory or outside the cpuset */
+        nodemask = ~0UL;
+        syscall(SYS_mbind, ptr, bytes, BV_MPOL_INTERLEAVE, &nodemask, sizeof(nodemask) * 8 + 1, 0);
+    }
+    else if (options->numa_node >= 0 && options->numa_node < (int)(sizeof(nodemask) * 8))
+    {
+        nodemask = BIT << options->numa_node;
+        syscall(SYS_mbind, ptr, bytes, BV_MPOL_BIND, &nodemask, sizeof(nodemask) * 8 + 1, 0);
+    }
+}
+
+typedef struct
+{
+    bv_allocator allocator; // first, so a pointer to it is a pointer to the whole
+    bv_page_options options;
+} page_allocator;
+
+static void *map_pages(void *ctx, size_t bytes)
+{
+    /**
+     * Explicit huge pages come aligned. Otherwise map one huge page more than needed and trim both ends,
+     * so that transparent huge pages can back the whole range and not just its aligned middle
+     **/
+
+    const bv_page_options *options = &((const page_allocator *)ctx)->options;
+    size_t length;
+    char *ptr = MAP_FAILED, *aligned;
+
+    if (bytes < BV_HUGE_PAGE_BYTES)
+        return aligned_alloc_zeroed(NULL, bytes);
+
+    length = round_up(bytes, BV_HUGE_PAGE_BYTES);
+#ifdef MAP_HUGETLB
+    if (options->hugetlb)
+        ptr = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+    if (ptr == MAP_FAILED)
+    {
+        ptr = mmap(NULL, length + BV_HUGE_PAGE_BYTES, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ptr == MAP_FAILED)
+        {
+            BV_REPORT_ERROR_AND_EXIT(ptr == MAP_FAILED, __FILE__, __PRETTY_FUNCTION__, __LINE__,
+                                     "could not map %zu bytes", length);
+        }
+        aligned = (char *)round_up((uintptr_t)ptr, BV_HUGE_PAGE_BYTES);
+        if (aligned > ptr)
+            munmap(ptr, aligned - ptr);
+        munmap(aligned + length, ptr + BV_HUGE_PAGE_BYTES - aligned);
+        ptr = aligned;
+#ifdef MADV_HUGEPAGE
+        madvise(ptr, length, MADV_HUGEPAGE);
+#endif
+    }
+    place_pages(ptr, length, options);
+    return ptr;
+}
+
+static void unmap_pages(void *ctx, void *ptr, size_t bytes)
+{
+    (void)ctx;
+    if (bytes < BV_HUGE_PAGE_BYTES)
+        free(ptr);
+    else
+        munmap(ptr, round_up(bytes, BV_HUGE_PAGE_BYTES));
+}
+
+static void *remap_pages(void *ctx, void *ptr, size_t old_bytes, size_t new_bytes)
+{
+    /** shrinking a mapping unmaps its tail in place; growing moves, which keeps new mappings aligned and placed **/
+
+    size_t old_length = round_up(old_bytes, BV_HUGE_PAGE_BYTES), new_length = round_up(new_bytes, BV_HUGE_PAGE_BYTES);
+    const page_allocator *pages = ctx;
+
+    if (old_bytes < BV_HUGE_PAGE_BYTES && new_bytes < BV_HUGE_PAGE_BYTES)
+        return aligned_realloc(NULL, ptr, old_bytes, new_bytes);
+    if (old_bytes >= BV_HUGE_PAGE_BYTES && new_bytes >= BV_HUGE_PAGE_BYTES && new_length <= old_length)
+    {
+        if (new_length < old_length)
+            munmap((char *)ptr + new_length, old_length - new_length);
+        /* an earlier shrink may have left data past old_bytes */
+        if (new_bytes > old_bytes)
+            memset((char *)ptr + old_bytes, 0, new_bytes - old_bytes);
+        return ptr;
+    }
+    return move_words(&pages->allocator, ptr, old_bytes, new_bytes);
+}
+
+const bv_allocator *bv_page_allocator_new(const bv_page_options *options)
+{
+    page_allocator *pages;
+
+    BV_CHECK_NONNULL(options);
+    pages = malloc(sizeof(page_allocator));
+    if (pages == NULL)
+    {
+        BV_REPORT_ERROR_AND_EXIT(pages == NULL, __FILE__, __PRETTY_FUNCTION__, __LINE__, "could not allocate allocator");
+    }
+    pages->options = *options;
+    pages->allocator = (bv_allocator){map_pages, remap_pages, unmap_pages, pages};
+    return &pages->allocator;
+}
+
+void bv_page_allocator_free(const bv_allocator *allocator)
+{
+    if (allocator == NULL)
+        return;
+    free(allocator->ctx);
+}
+
+typedef struct pool_chunk
+{
+    struct pool_chunk *next;
+} pool_chunk;
+
+typedef struct pool_slab
+{
+    struct pool_slab *next;
+} pool_slab;
+
+struct bv_pool
+{
+    bv_allocator allocator;                   // drawing from this pool, handed out by bv_pool_allocator
+    pthread_mutex_t lock;
+    pool_chunk *free_lists[POOL_NUM_CLASSES]; // recycled chunks of each size class
+    pool_slab *slabs;                         // every slab, to release them all at once
+    char *cursor, *end;                       // the unused part of the newest slab
+};
+
+static inline uint64_t size_class(size_t bytes)
+{
+    /** the smallest class holding `bytes`: class c holds POOL_MIN_BYTES << c **/
+
+    return (bytes <= POOL_MIN_BYTES) ? 0 : WORD_SIZE - __builtin_clzll((bytes - 1) / POOL_MIN_BYTES);
+}
+
+static void *pool_alloc(void *ctx, size_t bytes)
+{
+    /** pop a recycled chunk, or carve one from the newest slab, the slab's header taking its first cache line **/
+
+    bv_pool *pool = ctx;
+    uint64_t c;
+    size_t chunk_bytes;
+    void *chunk;
+    pool_slab *slab;
+
+    if (bytes > BV_POOL_MAX_BYTES)
+        return aligned_alloc_zeroed(NULL, bytes);
+
+    c = size_class(bytes);
+    chunk_bytes = POOL_MIN_BYTES << c;
+    pthread_mutex_lock(&pool->lock);
+    if (pool->free_lists[c] != NULL)
+    {
+        chunk = pool->free_lists[c];
+        pool->free_lists[c] = pool->free_lists[c]->next;
+    }
+    else
+    {
+        if (pool->cursor == NULL || (size_t)(pool->end - pool->cursor) < chunk_bytes)
+        {
+            slab = aligned_alloc_zeroed(NULL, POOL_SLAB_BYTES);
+            slab->next = pool->slabs;
+            pool->slabs = slab;
+            pool->cursor = (char *)slab + BV_DATA_ALIGNMENT;
+            pool->end = (char *)slab + POOL_SLAB_BYTES;
+        }
+        chunk = pool->cursor;
+        pool->cursor += chunk_bytes;
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return memset(chunk, 0, bytes);
+}
+
+static void pool_release(void *ctx, void *ptr, size_t bytes)
+{
+    bv_pool *pool = ctx;
+    pool_chunk *chunk = ptr;
+    uint64_t c;
+
+    if (bytes > BV_POOL_MAX_BYTES)
+    {
+        free(ptr);
+        return;
+    }
+    c = size_class(bytes);
+    pthread_mutex_lock(&pool->lock);
+    chunk->next = pool->free_lists[c];
+    pool->free_lists[c] = chunk;
+    pthread_mutex_unlock(&pool->lock);
+}
+
+static void *pool_realloc(void *ctx, void *ptr, size_t old_bytes, size_t new_bytes)
+{
+    bv_pool *pool = ctx;
+
+    if (old_bytes <= BV_POOL_MAX_BYTES && new_bytes <= BV_POOL_MAX_BYTES && size_class(old_bytes) == size_class(new_bytes))
+    {
+        if (new_bytes > old_bytes)
+            memset((char *)ptr + old_bytes, 0, new_bytes - old_bytes);
+        return ptr;
+    }
+    if (old_bytes > BV_POOL_MAX_BYTES && new_bytes > BV_POOL_MAX_BYTES)
+        return aligned_realloc(NULL, ptr, old_bytes, new_bytes);
+    return move_words(&pool->allocator, ptr, old_bytes, new_bytes);
+}
+
+bv_pool *bv_pool_new(void)
+{
+    bv_pool *pool = calloc(1, sizeof(bv_pool));
+
+    if (pool == NULL)
+    {
+        BV_REPORT_ERROR_AND_EXIT(pool == NULL, __FILE__, __PRETTY_FUNCTION__, __LINE__, "could not allocate pool");
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pool->allocator = (bv_allocator){pool_alloc, pool_realloc, pool_release, pool};
+    return pool;
+}
+
+void bv_pool_free(bv_pool *pool)
+{
+    pool_slab *slab, *next;
+
+    if (pool == NULL)
+        return;
+    for (slab = pool->slabs; slab != NULL; slab = next)
+    {
+        next = slab->next;
+        free(slab);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    free(pool);
+}
+
+const bv_allocator *bv_pool_allocator(bv_pool *pool)
+{
+    BV_CHECK_NONNULL(pool);
+    return &pool->allocator;
+}
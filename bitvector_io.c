@@ -0,0 +1,233 @@
+#include "bitvector.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define BV_FILE_MAGIC "POPPYBV"
+#define BV_FILE_BYTE_ORDER (0x0102030405060708UL)
+#define BV_FILE_ALIGNMENT (64UL)
+
+typedef struct
+{
+    char magic[8];           // BV_FILE_MAGIC, NUL-terminated
+    uint32_t version;        // BV_FILE_VERSION
+    uint32_t header_bytes;   // sizeof(bv_file_header)
+    uint64_t byte_order;     // BV_FILE_BYTE_ORDER as written by the producer
+    uint64_t size;           // the number of bits
+    uint64_t ones;           // the number of set bits
+    uint64_t data_offset, num_words;
+    uint64_t l0_offset, num_l0;
+    uint64_t l1l2_offset, num_l1;
+    uint64_t samples_offset, num_samples;
+    uint64_t samples0_offset, num_samples0;
+    uint8_t reserved[8];
+} bv_file_header;
+
+_Static_assert(sizeof(bv_file_header) == 128, "the file header must span two cache lines");
+
+static inline uint64_t align_up(uint64_t offset)
+{
+    return (offset + BV_FILE_ALIGNMENT - 1) & ~(BV_FILE_ALIGNMENT - 1);
+}
+
+static int write_section(FILE *fp, const void *src, uint64_t bytes, uint64_t offset)
+{
+    /** pad with zeros up to `offset`, then write the section **/
+
+    static const uint8_t zeros[BV_FILE_ALIGNMENT] = {0};
+    long pos = ftell(fp);
+
+    if (pos < 0 || (uint64_t)pos > offset)
+        return -1;
+    if (fwrite(zeros, 1, offset - pos, fp) != offset - pos)
+        return -1;
+    if (bytes > 0 && fwrite(src, 1, bytes, fp) != bytes)
+        return -1;
+    return 0;
+}
+
+int bv_save(bitvector *bv, const char *path)
+{
+    bv_file_header header;
+    FILE *fp;
+    int saved_errno;
+
+    BV_CHECK_NONNULL(bv);
+    BV_CHECK_NONNULL(path);
+
+    /* under BV_RANK_SNAPSHOT the directories may predate the last writes, so always write freshly built ones */
+    bv_build_rank(bv);
+    if (bv->select == NULL)
+        bv_build_select(bv);
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BV_FILE_MAGIC, sizeof(BV_FILE_MAGIC));
+    header.version = BV_FILE_VERSION;
+    header.header_bytes = sizeof(header);
+    header.byte_order = BV_FILE_BYTE_ORDER;
+    header.size = bv_len(bv);
+    header.ones = bv->rank->ones;
+    header.num_words = (bv_len(bv) >> LOG_WORD_SIZE) + BIT;
+    header.num_l0 = bv->rank->num_l0;
+    header.num_l1 = bv->rank->num_l1;
+    header.num_samples = bv->select->num_samples;
+    header.num_samples0 = bv->select->num_samples0;
+
+    header.data_offset = align_up(sizeof(header));
+    header.l0_offset = align_up(header.data_offset + header.num_words * sizeof(uint64_t));
+    header.l1l2_offset = align_up(header.l0_offset + header.num_l0 * sizeof(uint64_t));
+    header.samples_offset = align_up(header.l1l2_offset + header.num_l1 * sizeof(uint64_t));
+    header.samples0_offset = align_up(header.samples_offset + header.num_samples * sizeof(uint32_t));
+
+    fp = fopen(path, "wb");
+    if (fp == NULL)
+        return -1;
+
+    if (write_section(fp, &header, sizeof(header), 0) != 0 ||
+        write_section(fp, bv->data, header.num_words * sizeof(uint64_t), header.data_offset) != 0 ||
+        write_section(fp, bv->rank->l0, header.num_l0 * sizeof(uint64_t), header.l0_offset) != 0 ||
+        write_section(fp, bv->rank->l1l2, header.num_l1 * sizeof(uint64_t), header.l1l2_offset) != 0 ||
+        write_section(fp, bv->select->samples, header.num_samples * sizeof(uint32_t), header.samples_offset) != 0 ||
+        write_section(fp, bv->select->samples0, header.num_samples0 * sizeof(uint32_t), header.samples0_offset) != 0)
+    {
+        saved_errno = errno ? errno : EIO;
+        fclose(fp);
+        errno = saved_errno;
+        return -1;
+    }
+    return (fclose(fp) == 0) ? 0 : -1;
+}
+
+static bool section_fits(uint64_t offset, uint64_t count, uint64_t item_bytes, uint64_t file_bytes)
+{
+    return offset % BV_FILE_ALIGNMENT == 0 && offset <= file_bytes && count <= (file_bytes - offset) / item_bytes;
+}
+
+static bool header_is_valid(const bv_file_header *header, uint64_t file_bytes)
+{
+    uint64_t zeros = header->size - header->ones;
+
+    return memcmp(header->magic, BV_FILE_MAGIC, sizeof(BV_FILE_MAGIC)) == 0 &&
+           header->version == BV_FILE_VERSION &&
+           header->header_bytes == sizeof(bv_file_header) &&
+           header->byte_order == BV_FILE_BYTE_ORDER &&
+           header->num_words == (header->size >> LOG_WORD_SIZE) + BIT &&
+           header->num_l0 == (header->size >> LOG_L0_BLOCK_SIZE) + 1 &&
+           header->num_l1 == (header->size >> LOG_L1_BLOCK_SIZE) + 1 &&
+           header->ones <= header->size &&
+           header->num_samples == (header->ones + (BIT << LOG_SELECT_SAMPLE_RATE) - 1) >> LOG_SELECT_SAMPLE_RATE &&
+           header->num_samples0 == (zeros + (BIT << LOG_SELECT_SAMPLE_RATE) - 1) >> LOG_SELECT_SAMPLE_RATE &&
+           section_fits(header->data_offset, header->num_words, sizeof(uint64_t), file_bytes) &&
+           section_fits(header->l0_offset, header->num_l0, sizeof(uint64_t), file_bytes) &&
+           section_fits(header->l1l2_offset, header->num_l1, sizeof(uint64_t), file_bytes) &&
+           section_fits(header->samples_offset, header->num_samples, sizeof(uint32_t), file_bytes) &&
+           section_fits(header->samples0_offset, header->num_samples0, sizeof(uint32_t), file_bytes);
+}
+
+static bool samples_are_valid(const uint32_t *samples, uint64_t num_samples, uint64_t num_l1)
+{
+    /** select starts its search at samples[s] and ends it at samples[s + 1], so they must be sorted L1 indices **/
+
+    for (uint64_t s = 0; s < num_samples; s++)
+        if (samples[s] >= num_l1 || (s > 0 && samples[s] < samples[s - 1]))
+            return false;
+    return true;
+}
+
+static bool directories_are_valid(const uint8_t *base, const bv_file_header *header)
+{
+    /**
+     * the L1/L2 entries are left unread, O(n) at open; rank only adds them up, and select bounds its word scan
+     * by the length of the vector
+     **/
+
+    const uint64_t *l0 = (const uint64_t *)(base + header->l0_offset);
+
+    for (uint64_t b = 1; b < header->num_l0; b++)
+        if (l0[b] < l0[b - 1])
+            return false;
+    return l0[header->num_l0 - 1] <= header->ones &&
+           samples_are_valid((const uint32_t *)(base + header->samples_offset), header->num_samples, header->num_l1) &&
+           samples_are_valid((const uint32_t *)(base + header->samples0_offset), header->num_samples0, header->num_l1);
+}
+
+bitvector *bv_mmap(const char *path)
+{
+    int fd, saved_errno;
+    struct stat st;
+    void *mapping;
+    uint8_t *base;
+    const bv_file_header *header;
+    bitvector *bv;
+
+    BV_CHECK_NONNULL(path);
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+    if (fstat(fd, &st) != 0)
+    {
+        saved_errno = errno;
+        close(fd);
+        errno = saved_errno;
+        return NULL;
+    }
+    if ((uint64_t)st.st_size < sizeof(bv_file_header))
+    {
+        close(fd);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    mapping = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    saved_errno = errno;
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        errno = saved_errno;
+        return NULL;
+    }
+
+    base = mapping;
+    header = mapping;
+    if (!header_is_valid(header, st.st_size) || !directories_are_valid(base, header))
+    {
+        munmap(mapping, st.st_size);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    bv = calloc(1, sizeof(bitvector));
+    if (bv == NULL)
+    {
+        BV_REPORT_ERROR_AND_EXIT(bv == NULL, __FILE__, __PRETTY_FUNCTION__, __LINE__, "could not allocate bitvector");
+    }
+    bv->rank = malloc(sizeof(rank_directory));
+    bv->select = malloc(sizeof(select_directory));
+    if (bv->rank == NULL || bv->select == NULL)
+    {
+        BV_REPORT_ERROR_AND_EXIT(bv->select == NULL, __FILE__, __PRETTY_FUNCTION__, __LINE__, "could not allocate directories");
+    }
+
+    bv->data = (uint64_t *)(base + header->data_offset);
+    bv->size = header->size;
+    bv->allocated = header->num_words * WORD_SIZE;
+    bv->mapping = mapping;
+    bv->mapping_bytes = st.st_size;
+    *bv->rank = (rank_directory){
+        .l0 = (uint64_t *)(base + header->l0_offset),
+        .l1l2 = (uint64_t *)(base + header->l1l2_offset),
+        .num_l0 = header->num_l0,
+        .num_l1 = header->num_l1,
+        .ones = header->ones};
+    *bv->select = (select_directory){
+        .samples = (uint32_t *)(base + header->samples_offset),
+        .num_samples = header->num_samples,
+        .samples0 = (uint32_t *)(base + header->samples0_offset),
+        .num_samples0 = header->num_samples0};
+    return bv;
+}
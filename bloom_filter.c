@@ -0,0 +1,324 @@
+#include "bloom_filter.h"
+#include <stdio.h>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#define BF_MAX_BLOCKS (BIT << 32) // the block is picked with a 32-bit multiply-shift
+#define BF_BATCH (16UL)           // keys hashed and prefetched ahead of their probes
+#define BF_MAX_KEYS_PER_BLOCK (600.0) // past this the filter answers yes to everything anyway
+
+_Static_assert(BV_DATA_ALIGNMENT % BF_BLOCK_BYTES == 0, "blocks must not straddle cache lines");
+
+/* one odd multiplier per word of a block, the same ones as Parquet's split-block filters */
+static const uint32_t salts[BF_NUM_PROBES] = {0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+                                              0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U};
+
+typedef void (*insert_kernel)(uint64_t *block, uint32_t h);
+typedef bool (*contains_kernel)(const uint64_t *block, uint32_t h);
+
+static inline uint64_t hash64(uint64_t key)
+{
+    /** the murmur3 finalizer: every bit of the key flips each bit of the hash with probability about 1/2 **/
+
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+    return key;
+}
+
+static inline uint64_t *block_of(bloom_filter *bf, uint64_t h)
+{
+    /** multiply-shift maps the high half of the hash onto [0, num_blocks) without a division **/
+
+    return bf->blocks + (((h >> 32) * bf->num_blocks) >> 32) * BF_BLOCK_WORDS;
+}
+
+static void insert_scalar(uint64_t *block, uint32_t h)
+{
+    uint64_t i;
+
+    for (i = 0; i < BF_NUM_PROBES; i++)
+        block[i] |= BIT << ((uint32_t)(h * salts[i]) >> 26);
+}
+
+static bool contains_scalar(const uint64_t *block, uint32_t h)
+{
+    uint64_t i, missing = 0;
+
+    for (i = 0; i < BF_NUM_PROBES; i++)
+        missing |= ~block[i] & (BIT << ((uint32_t)(h * salts[i]) >> 26));
+    return missing == 0;
+}
+
+#if defined(__x86_64__)
+/**
+ * _mm*_mul_epu32 multiplies the low 32 bits of every 64-bit lane into a 64-bit product,
+ * whose low 32 bits are the scalar h * salt; shifting them to the top and back leaves its 6 high bits,
+ * the bit to probe in that lane's word
+ */
+__attribute__((target("avx2"))) static inline void masks_avx2(uint32_t h, __m256i *lo, __m256i *hi)
+{
+    const __m256i salts_lo = _mm256_setr_epi64x(salts[0], salts[1], salts[2], salts[3]);
+    const __m256i salts_hi = _mm256_setr_epi64x(salts[4], salts[5], salts[6], salts[7]);
+    const __m256i ones = _mm256_set1_epi64x(1);
+    __m256i hv = _mm256_set1_epi64x(h);
+
+    *lo = _mm256_sllv_epi64(ones, _mm256_srli_epi64(_mm256_slli_epi64(_mm256_mul_epu32(hv, salts_lo), 32), 58));
+    *hi = _mm256_sllv_epi64(ones, _mm256_srli_epi64(_mm256_slli_epi64(_mm256_mul_epu32(hv, salts_hi), 32), 58));
+}
+
+__attribute__((target("avx2"))) static void insert_avx2(uint64_t *block, uint32_t h)
+{
+    __m256i lo, hi;
+
+    masks_avx2(h, &lo, &hi);
+    _mm256_store_si256((__m256i *)block, _mm256_or_si256(_mm256_load_si256((const __m256i *)block), lo));
+    _mm256_store_si256((__m256i *)block + 1, _mm256_or_si256(_mm256_load_si256((const __m256i *)block + 1), hi));
+}
+
+__attribute__((target("avx2"))) static bool contains_avx2(const uint64_t *block, uint32_t h)
+{
+    __m256i lo, hi;
+
+    masks_avx2(h, &lo, &hi);
+    return _mm256_testc_si256(_mm256_load_si256((const __m256i *)block), lo) &
+           _mm256_testc_si256(_mm256_load_si256((const __m256i *)block + 1), hi);
+}
+
+__attribute__((target("avx512f"))) static inline __m512i masks_avx512(uint32_t h)
+{
+    const __m512i salt = _mm512_setr_epi64(salts[0], salts[1], salts[2], salts[3], salts[4], salts[5], salts[6],
+                                           salts[7]);
+
+    return _mm512_sllv_epi64(_mm512_set1_epi64(1), _mm512_srli_epi64(
+                                 _mm512_slli_epi64(_mm512_mul_epu32(_mm512_set1_epi64(h), salt), 32), 58));
+}
+
+__attribute__((target("avx512f"))) static void insert_avx512(uint64_t *block, uint32_t h)
+{
+    _mm512_store_si512(block, _mm512_or_si512(_mm512_load_si512(block), masks_avx512(h)));
+}
+
+__attribute__((target("avx512f"))) static bool contains_avx512(const uint64_t *block, uint32_t h)
+{
+    __m512i missing = _mm512_andnot_si512(_mm512_load_si512(block), masks_avx512(h));
+
+    return _mm512_test_epi64_mask(missing, missing) == 0;
+}
+#endif
+
+static void get_kernels(insert_kernel *insert, contains_kernel *contains)
+{
+    /** follow the instruction set chosen for the word kernels **/
+
+    switch (bv_current_isa())
+    {
+#if defined(__x86_64__)
+    case BV_ISA_AVX512:
+        *insert = insert_avx512;
+        *contains = contains_avx512;
+        break;
+    case BV_ISA_AVX2:
+        *insert = insert_avx2;
+        *contains = contains_avx2;
+        break;
+#endif
+    default:
+        *insert = insert_scalar;
+        *contains = contains_scalar;
+        break;
+    }
+}
+
+static uint64_t blocks_for(uint64_t num_bits)
+{
+    uint64_t num_blocks = (num_bits + BF_BLOCK_SIZE - 1) >> BF_LOG_BLOCK_SIZE;
+
+    return (num_blocks == 0) ? 1 : num_blocks;
+}
+
+double bf_expected_fpr(uint64_t num_bits, uint64_t num_keys)
+{
+    /**
+     * The keys per block are Poisson with mean lambda = num_keys / num_blocks, and a block holding i keys
+     * gives a false positive when all its probed bits are set: (1 - (63/64)^i)^8.
+     * The Poisson weights lambda^i / i! are summed unnormalized next to the rate and divided out at the end,
+     * which avoids computing e^-lambda
+     **/
+
+    double lambda = (double)num_keys / (double)blocks_for(num_bits);
+    double weight = 1.0, total = 0.0, fpr = 0.0, miss = 1.0, word_fpr, p;
+    uint64_t i, j, last = 2 * (uint64_t)lambda + 64;
+
+    if (num_keys == 0)
+        return 0.0;
+    if (lambda > BF_MAX_KEYS_PER_BLOCK)
+        return 1.0;
+
+    for (i = 0; i <= last; i++)
+    {
+        /* miss = (63/64)^i, the chance that a word's probed bit is clear in a block of i keys */
+        word_fpr = 1.0 - miss;
+        for (p = 1.0, j = 0; j < BF_NUM_PROBES; j++)
+            p *= word_fpr;
+        fpr += weight * p;
+        total += weight;
+        weight *= lambda / (double)(i + 1);
+        miss *= 1.0 - 1.0 / WORD_SIZE;
+    }
+    return fpr / total;
+}
+
+uint64_t bf_bits_for(uint64_t num_keys, double fpr)
+{
+    /** the rate falls as blocks are added, so double the blocks until it is low enough and bisect back **/
+
+    uint64_t lo = 0, hi = 1, mid;
+
+    if (!(fpr > 0.0 && fpr < 1.0))
+    {
+        BV_REPORT_ERROR_AND_EXIT(!(fpr > 0.0 && fpr < 1.0), __FILE__, __PRETTY_FUNCTION__, __LINE__,
+                                 "target false-positive rate %g is not in (0, 1)", fpr);
+    }
+    while (bf_expected_fpr(hi << BF_LOG_BLOCK_SIZE, num_keys) > fpr)
+    {
+        if (hi >= BF_MAX_BLOCKS)
+        {
+            BV_REPORT_ERROR_AND_EXIT(hi >= BF_MAX_BLOCKS, __FILE__, __PRETTY_FUNCTION__, __LINE__,
+                                     "%lu keys need more than %lu blocks for a rate of %g", num_keys,
+                                     BF_MAX_BLOCKS, fpr);
+        }
+        lo = hi;
+        hi <<= 1;
+    }
+    /* invariant: lo blocks are too few, hi blocks are enough */
+    while (hi - lo > 1)
+    {
+        mid = lo + (hi - lo) / 2;
+        if (bf_expected_fpr(mid << BF_LOG_BLOCK_SIZE, num_keys) > fpr)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    return hi << BF_LOG_BLOCK_SIZE;
+}
+
+bloom_filter *bf_new(uint64_t num_bits)
+{
+    /** every allocator aligns the words of a bitvector to a cache line, and so the blocks **/
+
+    bloom_filter *bf;
+    uint64_t num_blocks = blocks_for(num_bits);
+
+    if (num_blocks > BF_MAX_BLOCKS)
+    {
+        BV_REPORT_ERROR_AND_EXIT(num_blocks > BF_MAX_BLOCKS, __FILE__, __PRETTY_FUNCTION__, __LINE__,
+                                 "%lu bits is more than %lu blocks", num_bits, BF_MAX_BLOCKS);
+    }
+    bf = malloc(sizeof(bloom_filter));
+    if (bf == NULL)
+    {
+        BV_REPORT_ERROR_AND_EXIT(bf == NULL, __FILE__, __PRETTY_FUNCTION__, __LINE__, "could not allocate bloom filter");
+    }
+    bf->bits = bv_new(num_blocks << BF_LOG_BLOCK_SIZE);
+    bf->blocks = bf->bits->data;
+    bf->num_blocks = num_blocks;
+    bf->num_keys = 0;
+    return bf;
+}
+
+bloom_filter *bf_new_for(uint64_t num_keys, double fpr)
+{
+    return bf_new(bf_bits_for(num_keys, fpr));
+}
+
+void bf_free(bloom_filter *bf)
+{
+    if (bf == NULL)
+        return;
+    bv_free(bf->bits);
+    free(bf);
+}
+
+void bf_insert(bloom_filter *bf, uint64_t key)
+{
+    insert_kernel insert;
+    contains_kernel contains;
+    uint64_t h = hash64(key);
+
+    BV_CHECK_NONNULL(bf);
+    get_kernels(&insert, &contains);
+    insert(block_of(bf, h), (uint32_t)h);
+    bf->num_keys++;
+}
+
+bool bf_contains(bloom_filter *bf, uint64_t key)
+{
+    insert_kernel insert;
+    contains_kernel contains;
+    uint64_t h = hash64(key);
+
+    BV_CHECK_NONNULL(bf);
+    get_kernels(&insert, &contains);
+    return contains(block_of(bf, h), (uint32_t)h);
+}
+
+void bf_insert_batch(bloom_filter *bf, const uint64_t *keys, size_t n)
+{
+    insert_kernel insert;
+    contains_kernel contains;
+    uint64_t h[BF_BATCH], *blocks[BF_BATCH];
+    size_t i, j, m;
+
+    BV_CHECK_NONNULL(bf);
+    get_kernels(&insert, &contains);
+    for (i = 0; i < n; i += m)
+    {
+        m = (n - i < BF_BATCH) ? n - i : BF_BATCH;
+        for (j = 0; j < m; j++)
+        {
+            h[j] = hash64(keys[i + j]);
+            blocks[j] = block_of(bf, h[j]);
+            __builtin_prefetch(blocks[j], 1);
+        }
+        for (j = 0; j < m; j++)
+            insert(blocks[j], (uint32_t)h[j]);
+    }
+    bf->num_keys += n;
+}
+
+size_t bf_contains_batch(bloom_filter *bf, const uint64_t *keys, size_t n, bool *out)
+{
+    insert_kernel insert;
+    contains_kernel contains;
+    uint64_t h[BF_BATCH], *blocks[BF_BATCH];
+    size_t i, j, m, hits = 0;
+
+    BV_CHECK_NONNULL(bf);
+    get_kernels(&insert, &contains);
+    for (i = 0; i < n; i += m)
+    {
+        m = (n - i < BF_BATCH) ? n - i : BF_BATCH;
+        for (j = 0; j < m; j++)
+        {
+            h[j] = hash64(keys[i + j]);
+            blocks[j] = block_of(bf, h[j]);
+            __builtin_prefetch(blocks[j], 0);
+        }
+        for (j = 0; j < m; j++)
+        {
+            out[i + j] = contains(blocks[j], (uint32_t)h[j]);
+            hits += out[i + j];
+        }
+    }
+    return hits;
+}
+
+size_t bf_bytes(bloom_filter *bf)
+{
+    BV_CHECK_NONNULL(bf);
+    return sizeof(bloom_filter) + sizeof(bitvector) + ((bv_len(bf->bits) >> LOG_WORD_SIZE) + BIT) * sizeof(uint64_t);
+}
@@ -0,0 +1,97 @@
+/**
+ * @file bloom_filter.h
+ * @brief Cache-line-blocked Bloom filter stored in a bitvector
+ */
+
+#ifndef POPPY_BLOOM_FILTER_H
+#define POPPY_BLOOM_FILTER_H
+
+#include "bitvector.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BF_LOG_BLOCK_SIZE (9UL)                   // one 64-byte cache line
+#define BF_BLOCK_SIZE (BIT << BF_LOG_BLOCK_SIZE)
+#define BF_BLOCK_BYTES (BF_BLOCK_SIZE / 8)
+#define BF_BLOCK_WORDS (BF_BLOCK_SIZE / WORD_SIZE)
+#define BF_NUM_PROBES BF_BLOCK_WORDS              // one probe in every word of the block
+
+/**
+ * @brief A blocked Bloom filter (Putze, Sanders & Singler, 2007) of 64-bit keys
+ *
+ * A key is hashed once: the high half of the hash picks a block of BF_BLOCK_SIZE bits, aligned to a cache line,
+ * and the low half, multiplied by one odd constant per word, picks one bit in each of its BF_NUM_PROBES words.
+ * An insert or a lookup thus touches a single cache line, and the eight probes are computed and applied
+ * together with the AVX2 or AVX-512 kernels selected by `bv_use_isa`.
+ * Keeping every key in one block costs some accuracy against a classic Bloom filter of the same size,
+ * which `bf_bits_for` accounts for. Hash strings and other keys to 64 bits first.
+ */
+typedef struct
+{
+    bitvector *bits;     // the storage, aligned to BV_DATA_ALIGNMENT like every bitvector
+    uint64_t *blocks;    // bits->data
+    uint64_t num_blocks; // at most 2^32
+    uint64_t num_keys;   // the number of inserts
+} bloom_filter;
+
+/**
+ * @brief The false-positive rate of a filter of `num_bits` bits (rounded up to whole blocks) holding `num_keys` keys
+ */
+double bf_expected_fpr(uint64_t num_bits, uint64_t num_keys);
+
+/**
+ * @brief The fewest bits, in whole blocks, for which `bf_expected_fpr(bits, num_keys) <= fpr`
+ *
+ * @param fpr the target false-positive rate, in (0, 1)
+ */
+uint64_t bf_bits_for(uint64_t num_keys, double fpr);
+
+/**
+ * @brief Create an empty filter of `num_bits` bits, rounded up to whole blocks
+ */
+bloom_filter *bf_new(uint64_t num_bits);
+
+/**
+ * @brief Create an empty filter sized by `bf_bits_for(num_keys, fpr)`
+ */
+bloom_filter *bf_new_for(uint64_t num_keys, double fpr);
+
+void bf_free(bloom_filter *bf);
+
+/**
+ * @brief Add `key` to the filter
+ */
+void bf_insert(bloom_filter *bf, uint64_t key);
+
+/**
+ * @brief Check if `key` may have been added; false means it certainly was not
+ */
+bool bf_contains(bloom_filter *bf, uint64_t key);
+
+/**
+ * @brief Add keys[0:n] to the filter
+ *
+ * Hashes a group of keys and prefetches their blocks before setting any of them,
+ * so the cache misses of the group overlap.
+ */
+void bf_insert_batch(bloom_filter *bf, const uint64_t *keys, size_t n);
+
+/**
+ * @brief out[i] = bf_contains(bf, keys[i]) for 0 <= i < n, prefetching like `bf_insert_batch`
+ *
+ * @return size_t the number of keys that may have been added
+ */
+size_t bf_contains_batch(bloom_filter *bf, const uint64_t *keys, size_t n, bool *out);
+
+/**
+ * @brief The number of bytes used by the filter
+ */
+size_t bf_bytes(bloom_filter *bf);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // POPPY_BLOOM_FILTER_H
@@ -0,0 +1,390 @@
+#include "bp_tree.h"
+#include <pthread.h>
+#include <stdio.h>
+
+/**
+ * Excess lookup tables over the 8 parentheses of a byte, least significant bit first.
+ * A step is +1 for an open parenthesis and -1 for a close one.
+ **/
+static int8_t byte_total[256]; // the sum of the 8 steps
+static int8_t byte_fwd[256];   // the minimum over k = 1..8 of the sum of the first k steps
+static int8_t byte_bwd[256];   // the minimum over k = 0..7 of minus the sum of steps k..7
+static pthread_once_t tables_once = PTHREAD_ONCE_INIT;
+
+static void build_tables(void)
+{
+    int b, k, sum, min;
+
+    for (b = 0; b < 256; b++)
+    {
+        for (sum = 0, min = 8, k = 0; k < 8; k++)
+        {
+            sum += ((b >> k) & 1) ? 1 : -1;
+            min = (sum < min) ? sum : min;
+        }
+        byte_total[b] = (int8_t)sum;
+        byte_fwd[b] = (int8_t)min;
+        for (sum = 0, min = 8, k = 7; k >= 0; k--)
+        {
+            sum -= ((b >> k) & 1) ? 1 : -1;
+            min = (sum < min) ? sum : min;
+        }
+        byte_bwd[b] = (int8_t)min;
+    }
+}
+
+static inline uint8_t byte_at(const uint64_t *data, int64_t pos)
+{
+    return ((const uint8_t *)data)[pos >> 3];
+}
+
+static inline int64_t step(const uint64_t *data, int64_t pos)
+{
+    return ((data[pos >> LOG_WORD_SIZE] >> (pos & (WORD_SIZE - 1))) & 1) ? 1 : -1;
+}
+
+static inline int64_t excess(bp_tree *bp, int64_t pos)
+{
+    /** E(pos), with E(-1) = 0 **/
+
+    return 2 * (int64_t)bv_rank(bp->parens, pos + 1) - (pos + 1);
+}
+
+static inline uint64_t num_blocks(bp_tree *bp)
+{
+    return (bv_len(bp->parens) + BP_BLOCK_SIZE - 1) >> LOG_BP_BLOCK_SIZE;
+}
+
+static inline int64_t block_last(bp_tree *bp, uint64_t k)
+{
+    /** the last position of block k **/
+
+    uint64_t last = ((k + 1) << LOG_BP_BLOCK_SIZE) - 1;
+    return (int64_t)((last < bv_len(bp->parens)) ? last : bv_len(bp->parens) - 1);
+}
+
+static bool fwd_scan(const uint64_t *data, int64_t *q, int64_t hi, int64_t *e, int64_t target)
+{
+    /**
+     * Walk *q up to the smallest p in (*q, hi] with E(p) <= target, given *e = E(*q).
+     * Whole bytes are skipped when their minimum stays above the target.
+     **/
+
+    while (*q < hi)
+    {
+        if (((*q + 1) & 7) == 0 && *q + 8 <= hi && *e + byte_fwd[byte_at(data, *q + 1)] > target)
+        {
+            *e += byte_total[byte_at(data, *q + 1)];
+            *q += 8;
+            continue;
+        }
+        *e += step(data, ++*q);
+        if (*e <= target)
+            return true;
+    }
+    return false;
+}
+
+static bool bwd_scan(const uint64_t *data, int64_t *q, int64_t lo, int64_t *e, int64_t target)
+{
+    /** walk *q down to the largest p in [lo, *q) with E(p) <= target, given *e = E(*q) **/
+
+    while (*q > lo)
+    {
+        if (((*q + 1) & 7) == 0 && *q - 8 >= lo && *e + byte_bwd[byte_at(data, *q - 7)] > target)
+        {
+            *e -= byte_total[byte_at(data, *q - 7)];
+            *q -= 8;
+            continue;
+        }
+        *e -= step(data, (*q)--);
+        if (*e <= target)
+            return true;
+    }
+    return false;
+}
+
+static int64_t scan_min(const uint64_t *data, int64_t q, int64_t hi, int64_t e)
+{
+    /** the minimum of E(p) for p in (q, hi], given e = E(q) **/
+
+    int64_t min = INT64_MAX;
+
+    while (q < hi)
+    {
+        if (((q + 1) & 7) == 0 && q + 8 <= hi)
+        {
+            min = (e + byte_fwd[byte_at(data, q + 1)] < min) ? e + byte_fwd[byte_at(data, q + 1)] : min;
+            e += byte_total[byte_at(data, q + 1)];
+            q += 8;
+            continue;
+        }
+        e += step(data, ++q);
+        min = (e < min) ? e : min;
+    }
+    return min;
+}
+
+bp_tree *bp_from_bitvector(bitvector *parens)
+{
+    /** copy the parentheses, index them, then fill the leaves of the range min-max tree and the nodes above them **/
+
+    bp_tree *bp;
+    uint64_t k, v, n;
+    int64_t e;
+
+    BV_CHECK_NONNULL(parens);
+    pthread_once(&tables_once, build_tables);
+
+    bp = malloc(sizeof(bp_tree));
+    if (bp == NULL)
+    {
+        BV_REPORT_ERROR_AND_EXIT(bp == NULL, __FILE__, __PRETTY_FUNCTION__, __LINE__, "could not allocate bp_tree");
+    }
+    bp->parens = bv_copy(parens);
+    bv_build_rank(bp->parens);
+    bv_build_select(bp->parens);
+    n = bv_len(bp->parens);
+
+    for (bp->num_leaves = 1; bp->num_leaves < num_blocks(bp); bp->num_leaves <<= 1)
+        ;
+    bp->mins = malloc(2 * bp->num_leaves * sizeof(int64_t));
+    if (bp->mins == NULL)
+    {
+        BV_REPORT_ERROR_AND_EXIT(bp->mins == NULL, __FILE__, __PRETTY_FUNCTION__, __LINE__, "could not allocate range min-max tree");
+    }
+
+    for (e = 0, k = 0; k < bp->num_leaves; k++)
+    {
+        if (k < num_blocks(bp))
+        {
+            bp->mins[bp->num_leaves + k] = scan_min(bp->parens->data, (int64_t)(k << LOG_BP_BLOCK_SIZE) - 1,
+                                                    block_last(bp, k), e);
+            e = excess(bp, block_last(bp, k));
+        }
+        else
+            bp->mins[bp->num_leaves + k] = INT64_MAX;
+    }
+    for (v = bp->num_leaves - 1; v > 0; v--)
+        bp->mins[v] = (bp->mins[2 * v] < bp->mins[2 * v + 1]) ? bp->mins[2 * v] : bp->mins[2 * v + 1];
+
+    if (n % 2 != 0 || e != 0 || (n > 0 && bp->mins[1] < 0))
+    {
+        BV_REPORT_ERROR_AND_EXIT(n % 2 != 0 || e != 0 || (n > 0 && bp->mins[1] < 0), __FILE__, __PRETTY_FUNCTION__,
+                                 __LINE__, "parentheses are not balanced");
+    }
+    return bp;
+}
+
+void bp_free(bp_tree *bp)
+{
+    if (bp == NULL)
+        return;
+    bv_free(bp->parens);
+    free(bp->mins);
+    free(bp);
+}
+
+uint64_t bp_num_nodes(bp_tree *bp)
+{
+    BV_CHECK_NONNULL(bp);
+    return bv_len(bp->parens) / 2;
+}
+
+static int64_t fwd_search(bp_tree *bp, int64_t q, int64_t target)
+{
+    /**
+     * The smallest p > q with E(p) <= target, or -1: scan the rest of the block holding q + 1,
+     * climb to the nearest node to the right whose minimum reaches the target, descend to its leftmost such leaf
+     * and scan that block
+     **/
+
+    int64_t e = excess(bp, q);
+    uint64_t v;
+
+    if (q + 1 >= (int64_t)bv_len(bp->parens))
+        return -1;
+    if (fwd_scan(bp->parens->data, &q, block_last(bp, (uint64_t)(q + 1) >> LOG_BP_BLOCK_SIZE), &e, target))
+        return q;
+
+    /* the rightmost node of a level, 2^k - 1, has nothing to its right */
+    for (v = bp->num_leaves + ((uint64_t)q >> LOG_BP_BLOCK_SIZE);; v >>= 1)
+    {
+        if (((v + 1) & v) == 0)
+            return -1;
+        if (!(v & 1) && bp->mins[v + 1] <= target)
+            break;
+    }
+    for (v++; v < bp->num_leaves;)
+        v = (bp->mins[2 * v] <= target) ? 2 * v : 2 * v + 1;
+
+    q = (int64_t)((v - bp->num_leaves) << LOG_BP_BLOCK_SIZE) - 1;
+    e = excess(bp, q);
+    fwd_scan(bp->parens->data, &q, block_last(bp, v - bp->num_leaves), &e, target);
+    return q;
+}
+
+static int64_t bwd_search(bp_tree *bp, int64_t q, int64_t target)
+{
+    /** the largest p < q with E(p) <= target, counting E(-1) = 0, or -2; the mirror image of fwd_search **/
+
+    int64_t e, lo;
+    uint64_t v;
+
+    if (q <= 0)
+        return (q == 0 && target >= 0) ? -1 : -2;
+    e = excess(bp, q);
+    lo = (int64_t)(((uint64_t)(q - 1) >> LOG_BP_BLOCK_SIZE) << LOG_BP_BLOCK_SIZE);
+    if (bwd_scan(bp->parens->data, &q, lo, &e, target))
+        return q;
+
+    /* the leftmost node of a level, 2^k, has nothing to its left */
+    for (v = bp->num_leaves + ((uint64_t)lo >> LOG_BP_BLOCK_SIZE);; v >>= 1)
+    {
+        if ((v & (v - 1)) == 0)
+            return (target >= 0) ? -1 : -2;
+        if ((v & 1) && bp->mins[v - 1] <= target)
+            break;
+    }
+    for (v--; v < bp->num_leaves;)
+        v = (bp->mins[2 * v + 1] <= target) ? 2 * v + 1 : 2 * v;
+
+    q = block_last(bp, v - bp->num_leaves);
+    e = excess(bp, q);
+    if (e <= target)
+        return q;
+    bwd_scan(bp->parens->data, &q, (int64_t)((v - bp->num_leaves) << LOG_BP_BLOCK_SIZE), &e, target);
+    return q;
+}
+
+static int64_t range_min(bp_tree *bp, int64_t from, int64_t to)
+{
+    /** the minimum of E(p) for p in [from, to]: scan the partial blocks at the ends, read the full ones off the tree **/
+
+    uint64_t first = (uint64_t)from >> LOG_BP_BLOCK_SIZE, last = (uint64_t)to >> LOG_BP_BLOCK_SIZE, l, r;
+    int64_t min, tail, start = (int64_t)(last << LOG_BP_BLOCK_SIZE);
+
+    if (first == last)
+        return scan_min(bp->parens->data, from - 1, to, excess(bp, from - 1));
+
+    min = scan_min(bp->parens->data, from - 1, block_last(bp, first), excess(bp, from - 1));
+    for (l = bp->num_leaves + first + 1, r = bp->num_leaves + last - 1; l <= r; l = (l + 1) >> 1, r = (r - 1) >> 1)
+    {
+        if ((l & 1) && bp->mins[l] < min)
+            min = bp->mins[l];
+        if (!(r & 1) && bp->mins[r] < min)
+            min = bp->mins[r];
+        if (l == r)
+            break;
+    }
+    tail = scan_min(bp->parens->data, start - 1, to, excess(bp, start - 1));
+    return (tail < min) ? tail : min;
+}
+
+static inline void check_open(bp_tree *bp, uint64_t pos)
+{
+    if (pos >= bv_len(bp->parens) || !bv_isset_unchecked(bp->parens, pos))
+    {
+        BV_REPORT_ERROR_AND_EXIT(pos >= bv_len(bp->parens) || !bv_isset_unchecked(bp->parens, pos), __FILE__,
+                                 __PRETTY_FUNCTION__, __LINE__, "%lu is not the position of an open parenthesis", pos);
+    }
+}
+
+int64_t bp_find_close(bp_tree *bp, uint64_t pos)
+{
+    BV_CHECK_NONNULL(bp);
+    check_open(bp, pos);
+    return fwd_search(bp, (int64_t)pos, excess(bp, (int64_t)pos) - 1);
+}
+
+int64_t bp_find_open(bp_tree *bp, uint64_t pos)
+{
+    BV_CHECK_NONNULL(bp);
+    if (pos >= bv_len(bp->parens) || bv_isset_unchecked(bp->parens, pos))
+    {
+        BV_REPORT_ERROR_AND_EXIT(pos >= bv_len(bp->parens) || bv_isset_unchecked(bp->parens, pos), __FILE__,
+                                 __PRETTY_FUNCTION__, __LINE__, "%lu is not the position of a close parenthesis", pos);
+    }
+    return bwd_search(bp, (int64_t)pos, excess(bp, (int64_t)pos)) + 1;
+}
+
+int64_t bp_enclose(bp_tree *bp, uint64_t pos)
+{
+    int64_t p;
+
+    BV_CHECK_NONNULL(bp);
+    check_open(bp, pos);
+    p = bwd_search(bp, (int64_t)pos, excess(bp, (int64_t)pos) - 2);
+    return (p == -2) ? -1 : p + 1;
+}
+
+int64_t bp_parent(bp_tree *bp, uint64_t v)
+{
+    return bp_enclose(bp, v);
+}
+
+int64_t bp_first_child(bp_tree *bp, uint64_t v)
+{
+    BV_CHECK_NONNULL(bp);
+    check_open(bp, v);
+    return bv_isset_unchecked(bp->parens, v + 1) ? (int64_t)v + 1 : -1;
+}
+
+int64_t bp_next_sibling(bp_tree *bp, uint64_t v)
+{
+    uint64_t close = (uint64_t)bp_find_close(bp, v);
+
+    return (close + 1 < bv_len(bp->parens) && bv_isset_unchecked(bp->parens, close + 1)) ? (int64_t)close + 1 : -1;
+}
+
+uint64_t bp_subtree_size(bp_tree *bp, uint64_t v)
+{
+    return ((uint64_t)bp_find_close(bp, v) - v + 1) / 2;
+}
+
+uint64_t bp_depth(bp_tree *bp, uint64_t v)
+{
+    BV_CHECK_NONNULL(bp);
+    check_open(bp, v);
+    return (uint64_t)excess(bp, (int64_t)v);
+}
+
+int64_t bp_lca(bp_tree *bp, uint64_t u, uint64_t v)
+{
+    /**
+     * Unless one contains the other, the lowest excess between u and v is reached at the close parenthesis of
+     * a child of their LCA, the child holding u; the LCA is the parent of the sibling that follows it
+     **/
+
+    uint64_t tmp;
+    int64_t min;
+
+    if (u > v)
+        tmp = u, u = v, v = tmp;
+    if (v <= (uint64_t)bp_find_close(bp, u))
+        return (int64_t)u;
+    check_open(bp, v);
+
+    min = range_min(bp, (int64_t)u, (int64_t)v);
+    return bp_enclose(bp, (uint64_t)fwd_search(bp, (int64_t)u - 1, min) + 1);
+}
+
+uint64_t bp_node_id(bp_tree *bp, uint64_t v)
+{
+    BV_CHECK_NONNULL(bp);
+    check_open(bp, v);
+    return bv_rank(bp->parens, v);
+}
+
+int64_t bp_node_pos(bp_tree *bp, uint64_t id)
+{
+    BV_CHECK_NONNULL(bp);
+    return bv_select(bp->parens, id + 1);
+}
+
+size_t bp_bytes(bp_tree *bp)
+{
+    BV_CHECK_NONNULL(bp);
+    return sizeof(bp_tree) + sizeof(bitvector) + ((bv_len(bp->parens) >> LOG_WORD_SIZE) + BIT) * sizeof(uint64_t) +
+           bv_index_bytes(bp->parens) + 2 * bp->num_leaves * sizeof(int64_t);
+}
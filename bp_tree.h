@@ -0,0 +1,114 @@
+/**
+ * @file bp_tree.h
+ * @brief Succinct ordinal trees as balanced parentheses, navigated with a range min-max tree
+ */
+
+#ifndef POPPY_BP_TREE_H
+#define POPPY_BP_TREE_H
+
+#include "bitvector.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LOG_BP_BLOCK_SIZE (11UL)                  // one range min-max tree leaf per L1 block
+#define BP_BLOCK_SIZE (BIT << LOG_BP_BLOCK_SIZE)
+
+/**
+ * @brief An ordinal tree of n nodes stored as 2n balanced parentheses
+ *
+ * A depth-first traversal writes a 1 (open) when it enters a node and a 0 (close) when it leaves it,
+ * and a node is identified by the position of its open parenthesis.
+ * The excess E(i), opens minus closes in parens[0:i + 1], is the depth of the node opened at i and is read off
+ * the rank directory of `parens`. Navigation reduces to finding the nearest position to the left or right
+ * whose excess drops to a target. The range min-max tree (Navarro & Sadakane, 2014) answers that in O(log n):
+ * a heap over blocks of BP_BLOCK_SIZE parentheses holding the minimum excess of each node's blocks,
+ * with blocks scanned a byte at a time through lookup tables.
+ * Preorder numbers are the rank of the open parenthesis, so `bp_node_id` and `bp_node_pos` are one rank or select.
+ * The whole structure takes about 2.2 bits per node.
+ */
+typedef struct
+{
+    bitvector *parens;   // 1 for open, 0 for close, with its rank and select directories
+    uint64_t num_leaves; // leaves of the range min-max tree, a power of two
+    int64_t *mins;       // mins[v] for 1 <= v < 2 * num_leaves, heap-ordered; leaf k covers block k
+} bp_tree;
+
+/**
+ * @brief Build a tree from a copy of its parentheses, which must be balanced
+ */
+bp_tree *bp_from_bitvector(bitvector *parens);
+
+void bp_free(bp_tree *bp);
+
+/**
+ * @brief The number of nodes
+ */
+uint64_t bp_num_nodes(bp_tree *bp);
+
+/**
+ * @brief The position of the close parenthesis matching the open one at `pos`
+ */
+int64_t bp_find_close(bp_tree *bp, uint64_t pos);
+
+/**
+ * @brief The position of the open parenthesis matching the close one at `pos`
+ */
+int64_t bp_find_open(bp_tree *bp, uint64_t pos);
+
+/**
+ * @brief The open parenthesis of the tightest pair strictly enclosing the one opened at `pos`, or -1
+ */
+int64_t bp_enclose(bp_tree *bp, uint64_t pos);
+
+/**
+ * @brief The parent of node v, or -1 for a root
+ */
+int64_t bp_parent(bp_tree *bp, uint64_t v);
+
+/**
+ * @brief The first child of node v, or -1 for a leaf
+ */
+int64_t bp_first_child(bp_tree *bp, uint64_t v);
+
+/**
+ * @brief The next sibling of node v, or -1 for a last child
+ */
+int64_t bp_next_sibling(bp_tree *bp, uint64_t v);
+
+/**
+ * @brief The number of nodes in the subtree rooted at v, v included
+ */
+uint64_t bp_subtree_size(bp_tree *bp, uint64_t v);
+
+/**
+ * @brief The depth of node v; roots have depth 1
+ */
+uint64_t bp_depth(bp_tree *bp, uint64_t v);
+
+/**
+ * @brief The lowest common ancestor of nodes u and v, or -1 if they are in different trees of a forest
+ */
+int64_t bp_lca(bp_tree *bp, uint64_t u, uint64_t v);
+
+/**
+ * @brief The preorder number (0-indexed) of node v
+ */
+uint64_t bp_node_id(bp_tree *bp, uint64_t v);
+
+/**
+ * @brief The node with preorder number id, or -1 if id >= bp_num_nodes(bp)
+ */
+int64_t bp_node_pos(bp_tree *bp, uint64_t id);
+
+/**
+ * @brief The number of bytes used by the parentheses, their directories and the range min-max tree
+ */
+size_t bp_bytes(bp_tree *bp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // POPPY_BP_TREE_H
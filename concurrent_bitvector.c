@@ -0,0 +1,297 @@
+#include "concurrent_bitvector.h"
+#include "word_ops.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+
+#define SHARED_COUNTER CBV_NUM_COUNTERS
+
+static const memory_order load_order[] = {memory_order_relaxed, memory_order_acquire};
+static const memory_order store_order[] = {memory_order_relaxed, memory_order_acq_rel};
+
+/* the counter slots of live writer threads, taken on a thread's first write and given back when it exits */
+static _Atomic uint64_t slots_taken;
+static pthread_once_t slot_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t slot_key;
+static _Thread_local uint64_t thread_slot = UINT64_MAX;
+
+_Static_assert(CBV_NUM_COUNTERS == WORD_SIZE, "one bit of slots_taken per counter");
+
+static void release_slot(void *slot)
+{
+    atomic_fetch_and_explicit(&slots_taken, ~(BIT << ((uintptr_t)slot - 1)), memory_order_release);
+}
+
+static void create_slot_key(void)
+{
+    if (pthread_key_create(&slot_key, release_slot) != 0)
+    {
+        BV_REPORT_ERROR_AND_EXIT(true, __FILE__, __PRETTY_FUNCTION__, __LINE__, "could not create thread slot key");
+    }
+}
+
+static uint64_t claim_slot(void)
+{
+    /** the lowest free slot, or the shared counter once all are taken; the key gives it back at thread exit **/
+
+    uint64_t taken = atomic_load_explicit(&slots_taken, memory_order_relaxed), slot;
+
+    pthread_once(&slot_key_once, create_slot_key);
+    while (~taken != 0)
+    {
+        slot = __builtin_ctzll(~taken);
+        if (atomic_compare_exchange_weak_explicit(&slots_taken, &taken, taken | (BIT << slot), memory_order_acquire,
+                                                  memory_order_relaxed))
+        {
+            pthread_setspecific(slot_key, (void *)(uintptr_t)(slot + 1));
+            return slot;
+        }
+    }
+    return SHARED_COUNTER;
+}
+
+static inline cbv_counter *my_counter(concurrent_bitvector *cbv)
+{
+    if (thread_slot == UINT64_MAX)
+        thread_slot = claim_slot();
+    return &cbv->counters[thread_slot];
+}
+
+static inline _Atomic uint64_t *word_at(concurrent_bitvector *cbv, uint64_t block_index)
+{
+    return (_Atomic uint64_t *)&cbv->data[block_index];
+}
+
+static inline void begin_write(cbv_counter *c, bool shared)
+{
+    /** the fence keeps the word and counter updates after the tally, for a reader that sees them to see it too **/
+
+    _Atomic uint64_t *started = (_Atomic uint64_t *)&c->started;
+
+    if (shared)
+        atomic_fetch_add_explicit(started, 1, memory_order_relaxed);
+    else
+        atomic_store_explicit(started, atomic_load_explicit(started, memory_order_relaxed) + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+}
+
+static inline void end_write(cbv_counter *c, bool shared, int64_t delta)
+{
+    _Atomic int64_t *ones = (_Atomic int64_t *)&c->ones;
+    _Atomic uint64_t *finished = (_Atomic uint64_t *)&c->finished;
+
+    if (shared)
+    {
+        if (delta != 0)
+            atomic_fetch_add_explicit(ones, delta, memory_order_relaxed);
+        atomic_fetch_add_explicit(finished, 1, memory_order_release);
+    }
+    else
+    {
+        if (delta != 0)
+            atomic_store_explicit(ones, atomic_load_explicit(ones, memory_order_relaxed) + delta, memory_order_relaxed);
+        atomic_store_explicit(finished, atomic_load_explicit(finished, memory_order_relaxed) + 1, memory_order_release);
+    }
+}
+
+static inline bool fetch_set(concurrent_bitvector *cbv, uint64_t pos, cbv_order order)
+{
+    /** a bit already set is left alone; otherwise the old word tells whether this call set it, so only changes count **/
+
+    uint64_t old, block_index = pos >> LOG_WORD_SIZE, mask = BIT << (pos % WORD_SIZE);
+    cbv_counter *c;
+
+    if (atomic_load_explicit(word_at(cbv, block_index), load_order[order]) & mask)
+        return true;
+    c = my_counter(cbv);
+    begin_write(c, c == &cbv->counters[SHARED_COUNTER]);
+    old = atomic_fetch_or_explicit(word_at(cbv, block_index), mask, store_order[order]);
+    end_write(c, c == &cbv->counters[SHARED_COUNTER], (old & mask) ? 0 : 1);
+    return (old & mask) != 0;
+}
+
+static inline bool fetch_clear(concurrent_bitvector *cbv, uint64_t pos, cbv_order order)
+{
+    uint64_t old, block_index = pos >> LOG_WORD_SIZE, mask = BIT << (pos % WORD_SIZE);
+    cbv_counter *c;
+
+    if (!(atomic_load_explicit(word_at(cbv, block_index), load_order[order]) & mask))
+        return false;
+    c = my_counter(cbv);
+    begin_write(c, c == &cbv->counters[SHARED_COUNTER]);
+    old = atomic_fetch_and_explicit(word_at(cbv, block_index), ~mask, store_order[order]);
+    end_write(c, c == &cbv->counters[SHARED_COUNTER], (old & mask) ? -1 : 0);
+    return (old & mask) != 0;
+}
+
+static void *alloc_lines(size_t bytes)
+{
+    /** zeroed memory starting on a cache line, rounded up to whole lines as aligned_alloc requires **/
+
+    void *p;
+
+    bytes = (bytes + CBV_CACHE_LINE_BYTES - 1) & ~(CBV_CACHE_LINE_BYTES - 1);
+    p = aligned_alloc(CBV_CACHE_LINE_BYTES, bytes);
+    if (p == NULL)
+    {
+        BV_REPORT_ERROR_AND_EXIT(p == NULL, __FILE__, __PRETTY_FUNCTION__, __LINE__, "could not allocate %zu bytes", bytes);
+    }
+    return memset(p, 0, bytes);
+}
+
+concurrent_bitvector *cbv_new(uint64_t size)
+{
+    concurrent_bitvector *cbv = malloc(sizeof(concurrent_bitvector));
+
+    if (cbv == NULL)
+    {
+        BV_REPORT_ERROR_AND_EXIT(cbv == NULL, __FILE__, __PRETTY_FUNCTION__, __LINE__, "could not allocate bitvector");
+    }
+    cbv->size = size;
+    cbv->data = alloc_lines(((size >> LOG_WORD_SIZE) + BIT) * sizeof(uint64_t));
+    cbv->counters = alloc_lines((CBV_NUM_COUNTERS + 1) * sizeof(cbv_counter));
+    return cbv;
+}
+
+concurrent_bitvector *cbv_from_bitvector(bitvector *bv)
+{
+    concurrent_bitvector *cbv;
+    uint64_t i, num_words;
+
+    BV_CHECK_NONNULL(bv);
+    cbv = cbv_new(bv_len(bv));
+    num_words = (bv_len(bv) >> LOG_WORD_SIZE) + BIT;
+    memcpy(cbv->data, bv->data, num_words * sizeof(uint64_t));
+    for (i = 0; i < num_words; i++)
+        cbv->counters[SHARED_COUNTER].ones += popcnt(bv->data[i]);
+    return cbv;
+}
+
+bitvector *cbv_to_bitvector(concurrent_bitvector *cbv)
+{
+    bitvector *bv;
+    uint64_t i, num_words;
+
+    BV_CHECK_NONNULL(cbv);
+    bv = bv_new(cbv->size);
+    num_words = (cbv->size >> LOG_WORD_SIZE) + BIT;
+    for (i = 0; i < num_words; i++)
+        bv->data[i] = atomic_load_explicit(word_at(cbv, i), memory_order_relaxed);
+    return bv;
+}
+
+void cbv_free(concurrent_bitvector *cbv)
+{
+    if (cbv == NULL)
+        return;
+    free(cbv->data);
+    free(cbv->counters);
+    free(cbv);
+}
+
+uint64_t cbv_len(concurrent_bitvector *cbv)
+{
+    BV_CHECK_NONNULL(cbv);
+    return cbv->size;
+}
+
+bool cbv_isset(concurrent_bitvector *cbv, uint64_t pos, cbv_order order)
+{
+    if (RS_CHECKED && pos >= cbv->size)
+        return false;
+    return (atomic_load_explicit(word_at(cbv, pos >> LOG_WORD_SIZE), load_order[order]) >> (pos % WORD_SIZE)) & BIT;
+}
+
+bv_status cbv_test_and_set(concurrent_bitvector *cbv, uint64_t pos, cbv_order order, bool *old)
+{
+    if (RS_CHECKED && pos >= cbv->size)
+        return BV_EINDEX;
+    *old = fetch_set(cbv, pos, order);
+    return BV_OK;
+}
+
+bv_status cbv_test_and_clear(concurrent_bitvector *cbv, uint64_t pos, cbv_order order, bool *old)
+{
+    if (RS_CHECKED && pos >= cbv->size)
+        return BV_EINDEX;
+    *old = fetch_clear(cbv, pos, order);
+    return BV_OK;
+}
+
+bv_status cbv_set(concurrent_bitvector *cbv, uint64_t pos, cbv_order order)
+{
+    if (RS_CHECKED && pos >= cbv->size)
+        return BV_EINDEX;
+    fetch_set(cbv, pos, order);
+    return BV_OK;
+}
+
+bv_status cbv_clear(concurrent_bitvector *cbv, uint64_t pos, cbv_order order)
+{
+    if (RS_CHECKED && pos >= cbv->size)
+        return BV_EINDEX;
+    fetch_clear(cbv, pos, order);
+    return BV_OK;
+}
+
+bv_status cbv_toggle(concurrent_bitvector *cbv, uint64_t pos, cbv_order order)
+{
+    uint64_t old, block_index = pos >> LOG_WORD_SIZE, mask = BIT << (pos % WORD_SIZE);
+    cbv_counter *c;
+
+    if (RS_CHECKED && pos >= cbv->size)
+        return BV_EINDEX;
+    c = my_counter(cbv);
+    begin_write(c, c == &cbv->counters[SHARED_COUNTER]);
+    old = atomic_fetch_xor_explicit(word_at(cbv, block_index), mask, store_order[order]);
+    end_write(c, c == &cbv->counters[SHARED_COUNTER], (old & mask) ? -1 : 1);
+    return BV_OK;
+}
+
+uint64_t cbv_count(concurrent_bitvector *cbv)
+{
+    /**
+     * Double collect: if every write begun before the first pass had ended by the check, and none began before the
+     * second pass, no counter moved in between, and the sum is the count at the instant of the check.
+     * A counter may sit below zero when its thread clears bits another set, and the plain sum may dip below zero
+     * for a moment when a clear is counted before the set it undoes, so that one is clamped
+     **/
+
+    uint64_t started[CBV_NUM_COUNTERS + 1], c, round;
+    int64_t ones = 0;
+    bool quiet;
+
+    BV_CHECK_NONNULL(cbv);
+    for (round = 0; round < CBV_COUNT_RETRIES; round++)
+    {
+        for (c = 0; c <= CBV_NUM_COUNTERS; c++)
+            started[c] = atomic_load_explicit((_Atomic uint64_t *)&cbv->counters[c].started, memory_order_acquire);
+        quiet = true;
+        for (c = 0; c <= CBV_NUM_COUNTERS && quiet; c++)
+            quiet = atomic_load_explicit((_Atomic uint64_t *)&cbv->counters[c].finished, memory_order_acquire) ==
+                    started[c];
+
+        ones = 0;
+        for (c = 0; c <= CBV_NUM_COUNTERS; c++)
+            ones += atomic_load_explicit((_Atomic int64_t *)&cbv->counters[c].ones, memory_order_relaxed);
+        atomic_thread_fence(memory_order_acquire);
+        for (c = 0; c <= CBV_NUM_COUNTERS && quiet; c++)
+            quiet = atomic_load_explicit((_Atomic uint64_t *)&cbv->counters[c].started, memory_order_relaxed) ==
+                    started[c];
+        if (quiet)
+            return (uint64_t)ones;
+    }
+    return (ones > 0) ? (uint64_t)ones : 0;
+}
+
+uint64_t cbv_count_exact(concurrent_bitvector *cbv)
+{
+    uint64_t i, num_words, ones = 0;
+
+    BV_CHECK_NONNULL(cbv);
+    num_words = (cbv->size >> LOG_WORD_SIZE) + BIT;
+    for (i = 0; i < num_words; i++)
+        ones += popcnt(atomic_load_explicit(word_at(cbv, i), memory_order_relaxed));
+    return ones;
+}
@@ -0,0 +1,154 @@
+/**
+ * @file concurrent_bitvector.h
+ * @brief Fixed-size bitvector whose bits can be written by many threads at once without locks
+ */
+
+#ifndef POPPY_CONCURRENT_BITVECTOR_H
+#define POPPY_CONCURRENT_BITVECTOR_H
+
+#include "bitvector.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CBV_CACHE_LINE_BYTES (64UL)
+#define CBV_NUM_COUNTERS (64UL) // writer threads with a counter of their own; later threads share one more
+#define CBV_COUNT_RETRIES (16UL) // rounds `cbv_count` tries for a snapshot before settling for a plain sum
+
+/**
+ * @brief The memory ordering of a single operation
+ *
+ * CBV_RELAXED only makes the operation itself atomic, which is enough for a visited set or a dedup filter.
+ * CBV_ACQ_REL also orders the surrounding memory accesses, so a bit can publish the data it guards:
+ * writes release, reads acquire, and read-modify-writes do both. A set or clear that finds the bit already in place
+ * is only a read, so it acquires without releasing.
+ */
+typedef enum
+{
+    CBV_RELAXED = 0,
+    CBV_ACQ_REL,
+} cbv_order;
+
+/**
+ * @brief The set bits changed by one writer, alone on its cache line, with the number of its writes begun and ended
+ */
+typedef struct
+{
+    int64_t ones;
+    uint64_t started;  // writes that have begun under this counter
+    uint64_t finished; // writes whose word and counter updates are both done
+    uint8_t pad[CBV_CACHE_LINE_BYTES - 3 * sizeof(uint64_t)];
+} cbv_counter;
+
+/**
+ * @brief A bitvector of fixed size shared between threads
+ *
+ * Every change is a single atomic fetch-or, fetch-and or fetch-xor on the word holding the bit,
+ * so concurrent writers never lose each other's bits, and a writer learns from the old word whether it changed the bit.
+ * A set or clear that finds the bit already in place returns after one load, without writing anything.
+ * Changes are counted per writer thread: each of the first CBV_NUM_COUNTERS live threads to write owns a counter
+ * on its own cache line, which only it writes, with plain stores, so writers share no line but the data they touch.
+ * Threads past those share one more counter, updated with read-modify-writes.
+ * The words are cache-line aligned, so no word straddles two lines.
+ * There is no rank or select directory; `cbv_to_bitvector` takes a copy to build one on.
+ */
+typedef struct
+{
+    uint64_t size;          // the number of bits
+    uint64_t *data;         // size / 64 + 1 words, only ever accessed atomically
+    cbv_counter *counters;  // CBV_NUM_COUNTERS + 1 counters of set bits, the last one shared
+} concurrent_bitvector;
+
+/**
+ * @brief Create a concurrent bitvector of `size` cleared bits
+ */
+concurrent_bitvector *cbv_new(uint64_t size);
+
+/**
+ * @brief Create a concurrent bitvector holding a copy of the bits of `bv`
+ */
+concurrent_bitvector *cbv_from_bitvector(bitvector *bv);
+
+/**
+ * @brief Copy the bits into a plain bitvector
+ *
+ * Each word is read atomically, but writes racing with the copy may or may not be in it.
+ */
+bitvector *cbv_to_bitvector(concurrent_bitvector *cbv);
+
+void cbv_free(concurrent_bitvector *cbv);
+
+/**
+ * @brief The number of bits
+ */
+uint64_t cbv_len(concurrent_bitvector *cbv);
+
+/**
+ * @brief Check if the bit at position `pos` is set; false for pos >= cbv_len(cbv) if RS_CHECKED
+ */
+bool cbv_isset(concurrent_bitvector *cbv, uint64_t pos, cbv_order order);
+
+/**
+ * @brief Set the bit at position `pos` to 1
+ *
+ * @return bv_status BV_EINDEX if RS_CHECKED and pos >= cbv_len(cbv), BV_OK otherwise
+ */
+bv_status cbv_set(concurrent_bitvector *cbv, uint64_t pos, cbv_order order);
+
+/**
+ * @brief Set the bit at position `pos` to 0
+ *
+ * @return bv_status BV_EINDEX if RS_CHECKED and pos >= cbv_len(cbv), BV_OK otherwise
+ */
+bv_status cbv_clear(concurrent_bitvector *cbv, uint64_t pos, cbv_order order);
+
+/**
+ * @brief Flip the bit at position `pos`
+ *
+ * @return bv_status BV_EINDEX if RS_CHECKED and pos >= cbv_len(cbv), BV_OK otherwise
+ */
+bv_status cbv_toggle(concurrent_bitvector *cbv, uint64_t pos, cbv_order order);
+
+/**
+ * @brief Set the bit at position `pos` to 1, storing its old value in `*old`
+ *
+ * Among threads racing to set the same bit, exactly one sees false.
+ *
+ * @return bv_status BV_EINDEX if RS_CHECKED and pos >= cbv_len(cbv), and `*old` is left alone; BV_OK otherwise
+ */
+bv_status cbv_test_and_set(concurrent_bitvector *cbv, uint64_t pos, cbv_order order, bool *old);
+
+/**
+ * @brief Set the bit at position `pos` to 0, storing its old value in `*old`
+ *
+ * @return bv_status BV_EINDEX if RS_CHECKED and pos >= cbv_len(cbv), and `*old` is left alone; BV_OK otherwise
+ */
+bv_status cbv_test_and_clear(concurrent_bitvector *cbv, uint64_t pos, cbv_order order, bool *old);
+
+/**
+ * @brief The number of set bits, summed from the counters: a snapshot when the writers leave it a moment
+ *
+ * Each round collects the begun and ended writes of every counter, sums the counters and collects again. A round
+ * that finds no write in flight and none begun returns the number of set bits at one instant during the call.
+ * After CBV_COUNT_RETRIES rounds interrupted by writes it returns the last sum instead, which may include a write
+ * and miss an earlier one, so under a steady stream of writes its cost stays bounded but its count is approximate.
+ * With no write in flight, e.g. after joining the writers, it is exact, and while threads only set bits
+ * it never decreases between calls.
+ */
+uint64_t cbv_count(concurrent_bitvector *cbv);
+
+/**
+ * @brief The number of set bits, popcounted from the words
+ *
+ * Not a snapshot, for callers that stop the writers first: with no write in flight, the count is the popcount of
+ * exactly the bits `cbv_to_bitvector` would copy. It reads every word, so it is linear in the size where `cbv_count`
+ * reads the counters alone.
+ */
+uint64_t cbv_count_exact(concurrent_bitvector *cbv);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // POPPY_CONCURRENT_BITVECTOR_H
@@ -0,0 +1,636 @@
+#include "dynamic_bitvector.h"
+#include "word_ops.h"
+#include <stdio.h>
+#include <string.h>
+
+#define MIN_LEAF_BITS (DBV_LEAF_BITS / 4)
+#define MIN_CHILDREN (DBV_FANOUT / 4)
+#define LOAD_LEAF_WORDS (DBV_LEAF_WORDS * 3 / 4) // bulk-loaded leaves are left a quarter empty
+#define LOAD_FANOUT (DBV_FANOUT * 3 / 4)
+
+typedef struct
+{
+    uint64_t words[DBV_LEAF_WORDS]; // bits past the size of the leaf are always zero
+} dbv_leaf;
+
+typedef struct
+{
+    uint64_t n;                     // the number of children
+    uint64_t sizes[DBV_FANOUT];     // the number of bits below each child
+    uint64_t ones[DBV_FANOUT];      // the number of set bits below each child
+    void *children[DBV_FANOUT];     // leaves one level above the leaves, inner nodes otherwise
+} dbv_inner;
+
+static inline uint64_t min(uint64_t a, uint64_t b)
+{
+    return a < b ? a : b;
+}
+
+static void *alloc_node(size_t bytes)
+{
+    void *node = calloc(1, bytes);
+    if (node == NULL)
+    {
+        BV_REPORT_ERROR_AND_EXIT(node == NULL, __FILE__, __PRETTY_FUNCTION__, __LINE__, "could not allocate tree node");
+    }
+    return node;
+}
+
+static void free_node(void *node, uint64_t height)
+{
+    uint64_t i;
+    dbv_inner *inner = node;
+
+    if (height > 0)
+        for (i = 0; i < inner->n; i++)
+            free_node(inner->children[i], height - 1);
+    free(node);
+}
+
+static inline uint64_t get_bits(const uint64_t *words, uint64_t pos, uint64_t k)
+{
+    /** the k <= WORD_SIZE bits starting at pos, never reading a word past the last one they touch **/
+
+    uint64_t w = pos >> LOG_WORD_SIZE, off = pos & (WORD_SIZE - 1), x = words[w] >> off;
+
+    if (off && off + k > WORD_SIZE)
+        x |= words[w + 1] << (WORD_SIZE - off);
+    return k < WORD_SIZE ? x & ((BIT << k) - 1) : x;
+}
+
+static void append_bits(uint64_t *dst, uint64_t dst_size, const uint64_t *src, uint64_t src_from, uint64_t n)
+{
+    /** append src[src_from : src_from + n] to dst[:dst_size], whose later bits must be zero **/
+
+    uint64_t k, x, w, off;
+
+    while (n > 0)
+    {
+        k = min(n, WORD_SIZE);
+        x = get_bits(src, src_from, k);
+        w = dst_size >> LOG_WORD_SIZE;
+        off = dst_size & (WORD_SIZE - 1);
+        dst[w] |= x << off;
+        if (off && off + k > WORD_SIZE)
+            dst[w + 1] |= x >> (WORD_SIZE - off);
+        dst_size += k;
+        src_from += k;
+        n -= k;
+    }
+}
+
+static void leaf_insert(dbv_leaf *leaf, uint64_t size, uint64_t pos, bool bit)
+{
+    /** shift bits [pos, size) up by one through the carries of the following words, size < DBV_LEAF_BITS **/
+
+    uint64_t i, w = pos >> LOG_WORD_SIZE, mask = (BIT << (pos & (WORD_SIZE - 1))) - 1;
+    uint64_t carry = leaf->words[w] >> (WORD_SIZE - 1), next;
+
+    leaf->words[w] = (leaf->words[w] & mask) | ((uint64_t)bit << (pos & (WORD_SIZE - 1))) |
+                     ((leaf->words[w] & ~mask) << 1);
+    for (i = w + 1; i <= (size >> LOG_WORD_SIZE); i++)
+    {
+        next = leaf->words[i] >> (WORD_SIZE - 1);
+        leaf->words[i] = (leaf->words[i] << 1) | carry;
+        carry = next;
+    }
+}
+
+static bool leaf_delete(dbv_leaf *leaf, uint64_t size, uint64_t pos)
+{
+    /** shift bits (pos, size) down by one, returning the removed bit **/
+
+    uint64_t i, w = pos >> LOG_WORD_SIZE, mask = (BIT << (pos & (WORD_SIZE - 1))) - 1;
+    bool bit = (leaf->words[w] >> (pos & (WORD_SIZE - 1))) & BIT;
+
+    leaf->words[w] = (leaf->words[w] & mask) | ((leaf->words[w] >> 1) & ~mask);
+    for (i = w + 1; i <= ((size - 1) >> LOG_WORD_SIZE); i++)
+    {
+        leaf->words[i - 1] |= (leaf->words[i] & BIT) << (WORD_SIZE - 1);
+        leaf->words[i] >>= 1;
+    }
+    return bit;
+}
+
+static void insert_entry(dbv_inner *parent, uint64_t i, void *child, uint64_t size, uint64_t ones)
+{
+    memmove(parent->children + i + 1, parent->children + i, (parent->n - i) * sizeof(void *));
+    memmove(parent->sizes + i + 1, parent->sizes + i, (parent->n - i) * sizeof(uint64_t));
+    memmove(parent->ones + i + 1, parent->ones + i, (parent->n - i) * sizeof(uint64_t));
+    parent->children[i] = child;
+    parent->sizes[i] = size;
+    parent->ones[i] = ones;
+    parent->n++;
+}
+
+static void remove_entry(dbv_inner *parent, uint64_t i)
+{
+    parent->n--;
+    memmove(parent->children + i, parent->children + i + 1, (parent->n - i) * sizeof(void *));
+    memmove(parent->sizes + i, parent->sizes + i + 1, (parent->n - i) * sizeof(uint64_t));
+    memmove(parent->ones + i, parent->ones + i + 1, (parent->n - i) * sizeof(uint64_t));
+}
+
+static void sum_entries(dbv_inner *inner, uint64_t *size, uint64_t *ones)
+{
+    uint64_t i;
+
+    for (*size = 0, *ones = 0, i = 0; i < inner->n; i++)
+    {
+        *size += inner->sizes[i];
+        *ones += inner->ones[i];
+    }
+}
+
+static inline bool child_full(dbv_inner *parent, uint64_t i, uint64_t child_height)
+{
+    if (child_height == 0)
+        return parent->sizes[i] == DBV_LEAF_BITS;
+    return ((dbv_inner *)parent->children[i])->n == DBV_FANOUT;
+}
+
+static inline bool child_minimal(dbv_inner *parent, uint64_t i, uint64_t child_height)
+{
+    if (child_height == 0)
+        return parent->sizes[i] <= MIN_LEAF_BITS;
+    return ((dbv_inner *)parent->children[i])->n <= MIN_CHILDREN;
+}
+
+static void split_child(dbv_inner *parent, uint64_t i, uint64_t child_height)
+{
+    /** move the upper half of the full child i into a new sibling at i + 1; the parent must not be full **/
+
+    uint64_t size, ones;
+    dbv_leaf *leaf, *right_leaf;
+    dbv_inner *inner, *right_inner;
+
+    if (child_height == 0)
+    {
+        leaf = parent->children[i];
+        right_leaf = alloc_node(sizeof(dbv_leaf));
+        memcpy(right_leaf->words, leaf->words + DBV_LEAF_WORDS / 2, DBV_LEAF_WORDS / 2 * sizeof(uint64_t));
+        memset(leaf->words + DBV_LEAF_WORDS / 2, 0, DBV_LEAF_WORDS / 2 * sizeof(uint64_t));
+        size = DBV_LEAF_BITS / 2;
+        ones = popcnt_words(right_leaf->words, 0, DBV_LEAF_WORDS / 2);
+        insert_entry(parent, i + 1, right_leaf, size, ones);
+    }
+    else
+    {
+        inner = parent->children[i];
+        right_inner = alloc_node(sizeof(dbv_inner));
+        right_inner->n = inner->n - inner->n / 2;
+        inner->n /= 2;
+        memcpy(right_inner->children, inner->children + inner->n, right_inner->n * sizeof(void *));
+        memcpy(right_inner->sizes, inner->sizes + inner->n, right_inner->n * sizeof(uint64_t));
+        memcpy(right_inner->ones, inner->ones + inner->n, right_inner->n * sizeof(uint64_t));
+        sum_entries(right_inner, &size, &ones);
+        insert_entry(parent, i + 1, right_inner, size, ones);
+    }
+    parent->sizes[i] -= size;
+    parent->ones[i] -= ones;
+}
+
+static void join_leaves(dbv_inner *parent, uint64_t l)
+{
+    /** merge leaves l and l + 1 if they fit in one, otherwise split their bits evenly at a word boundary **/
+
+    uint64_t buf[2 * DBV_LEAF_WORDS] = {0}, total, left;
+    dbv_leaf *a = parent->children[l], *b = parent->children[l + 1];
+
+    memcpy(buf, a->words, sizeof(a->words));
+    append_bits(buf, parent->sizes[l], b->words, 0, parent->sizes[l + 1]);
+    total = parent->sizes[l] + parent->sizes[l + 1];
+
+    if (total <= DBV_LEAF_BITS)
+    {
+        memcpy(a->words, buf, sizeof(a->words));
+        parent->sizes[l] = total;
+        parent->ones[l] += parent->ones[l + 1];
+        free(b);
+        remove_entry(parent, l + 1);
+        return;
+    }
+    left = (total / 2) & ~(WORD_SIZE - 1);
+    memset(a->words, 0, sizeof(a->words));
+    memset(b->words, 0, sizeof(b->words));
+    memcpy(a->words, buf, (left >> LOG_WORD_SIZE) * sizeof(uint64_t));
+    memcpy(b->words, buf + (left >> LOG_WORD_SIZE), ((total - left + WORD_SIZE - 1) >> LOG_WORD_SIZE) * sizeof(uint64_t));
+    parent->ones[l + 1] = popcnt_words(b->words, 0, DBV_LEAF_WORDS);
+    parent->ones[l] = popcnt_words(a->words, 0, DBV_LEAF_WORDS);
+    parent->sizes[l] = left;
+    parent->sizes[l + 1] = total - left;
+}
+
+static void join_inners(dbv_inner *parent, uint64_t l)
+{
+    /** merge inner nodes l and l + 1 if they fit in one, otherwise split their children evenly **/
+
+    dbv_inner *a = parent->children[l], *b = parent->children[l + 1];
+    uint64_t total = a->n + b->n, move;
+
+    if (total <= DBV_FANOUT)
+    {
+        memcpy(a->children + a->n, b->children, b->n * sizeof(void *));
+        memcpy(a->sizes + a->n, b->sizes, b->n * sizeof(uint64_t));
+        memcpy(a->ones + a->n, b->ones, b->n * sizeof(uint64_t));
+        a->n = total;
+        parent->sizes[l] += parent->sizes[l + 1];
+        parent->ones[l] += parent->ones[l + 1];
+        free(b);
+        remove_entry(parent, l + 1);
+        return;
+    }
+    if (a->n < total / 2)
+    {
+        /* move the first children of b to the end of a */
+        move = total / 2 - a->n;
+        memcpy(a->children + a->n, b->children, move * sizeof(void *));
+        memcpy(a->sizes + a->n, b->sizes, move * sizeof(uint64_t));
+        memcpy(a->ones + a->n, b->ones, move * sizeof(uint64_t));
+        b->n -= move;
+        memmove(b->children, b->children + move, b->n * sizeof(void *));
+        memmove(b->sizes, b->sizes + move, b->n * sizeof(uint64_t));
+        memmove(b->ones, b->ones + move, b->n * sizeof(uint64_t));
+    }
+    else
+    {
+        /* move the last children of a to the front of b */
+        move = a->n - total / 2;
+        memmove(b->children + move, b->children, b->n * sizeof(void *));
+        memmove(b->sizes + move, b->sizes, b->n * sizeof(uint64_t));
+        memmove(b->ones + move, b->ones, b->n * sizeof(uint64_t));
+        a->n -= move;
+        memcpy(b->children, a->children + a->n, move * sizeof(void *));
+        memcpy(b->sizes, a->sizes + a->n, move * sizeof(uint64_t));
+        memcpy(b->ones, a->ones + a->n, move * sizeof(uint64_t));
+    }
+    a->n = total / 2;
+    b->n = total - a->n;
+    sum_entries(a, &parent->sizes[l], &parent->ones[l]);
+    sum_entries(b, &parent->sizes[l + 1], &parent->ones[l + 1]);
+}
+
+static void refill_child(dbv_inner *parent, uint64_t *i, uint64_t *pos, uint64_t child_height)
+{
+    /** join the minimal child *i with a sibling, then relocate the child holding *pos **/
+
+    uint64_t l = (*i + 1 < parent->n) ? *i : *i - 1;
+
+    if (*i > l)
+        *pos += parent->sizes[l];
+    if (child_height == 0)
+        join_leaves(parent, l);
+    else
+        join_inners(parent, l);
+
+    *i = l;
+    if (l + 1 < parent->n && *pos >= parent->sizes[l])
+    {
+        *pos -= parent->sizes[l];
+        *i = l + 1;
+    }
+}
+
+dynamic_bitvector *dbv_new(void)
+{
+    dynamic_bitvector *dbv = alloc_node(sizeof(dynamic_bitvector));
+    dbv->root = alloc_node(sizeof(dbv_leaf));
+    return dbv;
+}
+
+dynamic_bitvector *dbv_from_bitvector(bitvector *bv)
+{
+    /** cut the words into leaves three quarters full, then group every level into parents three quarters full **/
+
+    uint64_t nwords, count, groups, g, c, k, w, take;
+    uint64_t *sizes, *ones;
+    void **nodes;
+    dbv_leaf *leaf;
+    dbv_inner *inner;
+    dynamic_bitvector *dbv;
+
+    BV_CHECK_NONNULL(bv);
+    if (bv_len(bv) == 0)
+        return dbv_new();
+
+    nwords = (bv_len(bv) + WORD_SIZE - 1) >> LOG_WORD_SIZE;
+    count = (nwords + LOAD_LEAF_WORDS - 1) / LOAD_LEAF_WORDS;
+    nodes = malloc(count * sizeof(void *));
+    sizes = malloc(count * sizeof(uint64_t));
+    ones = malloc(count * sizeof(uint64_t));
+    if (nodes == NULL || sizes == NULL || ones == NULL)
+    {
+        BV_REPORT_ERROR_AND_EXIT(nodes == NULL, __FILE__, __PRETTY_FUNCTION__, __LINE__, "could not allocate tree level");
+    }
+
+    /* spread the words evenly so that no leaf, and below no inner node, ends up under a quarter full */
+    for (w = 0, c = 0; c < count; c++)
+    {
+        take = nwords / count + (c < nwords % count);
+        leaf = alloc_node(sizeof(dbv_leaf));
+        memcpy(leaf->words, bv->data + w, take * sizeof(uint64_t));
+        nodes[c] = leaf;
+        sizes[c] = min(take << LOG_WORD_SIZE, bv_len(bv) - (w << LOG_WORD_SIZE));
+        ones[c] = popcnt_words(leaf->words, 0, take);
+        w += take;
+    }
+
+    dbv = alloc_node(sizeof(dynamic_bitvector));
+    for (; count > 1; dbv->height++)
+    {
+        groups = (count + LOAD_FANOUT - 1) / LOAD_FANOUT;
+        for (c = 0, g = 0; g < groups; g++)
+        {
+            take = count / groups + (g < count % groups);
+            inner = alloc_node(sizeof(dbv_inner));
+            for (k = 0; k < take; k++)
+                insert_entry(inner, k, nodes[c + k], sizes[c + k], ones[c + k]);
+            c += take;
+            nodes[g] = inner;
+            sum_entries(inner, &sizes[g], &ones[g]);
+        }
+        count = groups;
+    }
+    dbv->root = nodes[0];
+    dbv->size = bv_len(bv);
+    dbv->ones = ones[0];
+    free(nodes);
+    free(sizes);
+    free(ones);
+    return dbv;
+}
+
+static void copy_out(void *node, uint64_t height, uint64_t size, bitvector *bv, uint64_t *offset)
+{
+    uint64_t i;
+    dbv_inner *inner = node;
+
+    if (height == 0)
+    {
+        append_bits(bv->data, *offset, ((dbv_leaf *)node)->words, 0, size);
+        *offset += size;
+        return;
+    }
+    for (i = 0; i < inner->n; i++)
+        copy_out(inner->children[i], height - 1, inner->sizes[i], bv, offset);
+}
+
+bitvector *dbv_to_bitvector(dynamic_bitvector *dbv)
+{
+    uint64_t offset = 0;
+    bitvector *bv;
+
+    BV_CHECK_NONNULL(dbv);
+    bv = bv_new(dbv->size);
+    copy_out(dbv->root, dbv->height, dbv->size, bv, &offset);
+    return bv;
+}
+
+void dbv_free(dynamic_bitvector *dbv)
+{
+    BV_CHECK_NONNULL(dbv);
+    free_node(dbv->root, dbv->height);
+    free(dbv);
+}
+
+uint64_t dbv_len(dynamic_bitvector *dbv)
+{
+    BV_CHECK_NONNULL(dbv);
+    return dbv->size;
+}
+
+uint64_t dbv_count(dynamic_bitvector *dbv)
+{
+    BV_CHECK_NONNULL(dbv);
+    return dbv->ones;
+}
+
+static void check_index(uint64_t pos, uint64_t end)
+{
+    if (pos >= end)
+    {
+        BV_REPORT_ERROR_AND_EXIT(pos >= end, __FILE__, __PRETTY_FUNCTION__, __LINE__,
+                                 "index %lu out of range [0, %lu)", pos, end);
+    }
+}
+
+static dbv_leaf *descend(dynamic_bitvector *dbv, uint64_t *pos, int64_t delta)
+{
+    /** find the leaf holding *pos, making *pos relative to it and adding delta to the set bits counted above it **/
+
+    uint64_t i, h;
+    dbv_inner *inner;
+    void *node = dbv->root;
+
+    for (h = dbv->height; h > 0; h--)
+    {
+        inner = node;
+        for (i = 0; *pos >= inner->sizes[i]; i++)
+            *pos -= inner->sizes[i];
+        inner->ones[i] += delta;
+        node = inner->children[i];
+    }
+    return node;
+}
+
+bool dbv_isset(dynamic_bitvector *dbv, uint64_t pos)
+{
+    dbv_leaf *leaf;
+
+    BV_CHECK_NONNULL(dbv);
+    check_index(pos, dbv->size);
+    leaf = descend(dbv, &pos, 0);
+    return (leaf->words[pos >> LOG_WORD_SIZE] >> (pos & (WORD_SIZE - 1))) & BIT;
+}
+
+void dbv_assign(dynamic_bitvector *dbv, uint64_t pos, bool bit)
+{
+    /** a second descent fixes the counts on the path only when the bit actually changes **/
+
+    dbv_leaf *leaf;
+
+    if (dbv_isset(dbv, pos) == bit)
+        return;
+    leaf = descend(dbv, &pos, bit ? 1 : -1);
+    leaf->words[pos >> LOG_WORD_SIZE] ^= BIT << (pos & (WORD_SIZE - 1));
+    dbv->ones += bit ? 1 : -1;
+}
+
+void dbv_insert(dynamic_bitvector *dbv, uint64_t pos, bool bit)
+{
+    /** split full nodes on the way down, so that every split finds room in its parent **/
+
+    uint64_t i, h, size;
+    dbv_inner *inner;
+    void *node;
+
+    BV_CHECK_NONNULL(dbv);
+    check_index(pos, dbv->size + 1);
+
+    if (dbv->height == 0 ? dbv->size == DBV_LEAF_BITS : ((dbv_inner *)dbv->root)->n == DBV_FANOUT)
+    {
+        inner = alloc_node(sizeof(dbv_inner));
+        insert_entry(inner, 0, dbv->root, dbv->size, dbv->ones);
+        split_child(inner, 0, dbv->height);
+        dbv->root = inner;
+        dbv->height++;
+    }
+
+    node = dbv->root;
+    size = dbv->size;
+    for (h = dbv->height; h > 0; h--)
+    {
+        inner = node;
+        for (i = 0; i + 1 < inner->n && pos > inner->sizes[i]; i++)
+            pos -= inner->sizes[i];
+        if (child_full(inner, i, h - 1))
+        {
+            split_child(inner, i, h - 1);
+            if (pos > inner->sizes[i])
+                pos -= inner->sizes[i++];
+        }
+        size = inner->sizes[i]++;
+        inner->ones[i] += bit;
+        node = inner->children[i];
+    }
+    leaf_insert(node, size, pos, bit);
+    dbv->size++;
+    dbv->ones += bit;
+}
+
+bool dbv_delete(dynamic_bitvector *dbv, uint64_t pos)
+{
+    /** refill minimal nodes on the way down, so that no node drops under a quarter full, then collapse the root **/
+
+    uint64_t i, h, size;
+    dbv_inner *inner;
+    void *node;
+    bool bit = dbv_isset(dbv, pos);
+
+    node = dbv->root;
+    size = dbv->size;
+    for (h = dbv->height; h > 0; h--)
+    {
+        inner = node;
+        for (i = 0; pos >= inner->sizes[i]; i++)
+            pos -= inner->sizes[i];
+        if (inner->n > 1 && child_minimal(inner, i, h - 1))
+            refill_child(inner, &i, &pos, h - 1);
+        size = inner->sizes[i]--;
+        inner->ones[i] -= bit;
+        node = inner->children[i];
+    }
+    leaf_delete(node, size, pos);
+    dbv->size--;
+    dbv->ones -= bit;
+
+    while (dbv->height > 0 && ((dbv_inner *)dbv->root)->n == 1)
+    {
+        node = ((dbv_inner *)dbv->root)->children[0];
+        free(dbv->root);
+        dbv->root = node;
+        dbv->height--;
+    }
+    return bit;
+}
+
+void dbv_push(dynamic_bitvector *dbv, bool bit)
+{
+    BV_CHECK_NONNULL(dbv);
+    dbv_insert(dbv, dbv->size, bit);
+}
+
+uint64_t dbv_rank(dynamic_bitvector *dbv, uint64_t pos)
+{
+    uint64_t i, h, rank = 0;
+    dbv_inner *inner;
+    dbv_leaf *leaf;
+    void *node;
+
+    BV_CHECK_NONNULL(dbv);
+    if (pos >= dbv->size)
+        return dbv->ones;
+
+    node = dbv->root;
+    for (h = dbv->height; h > 0; h--)
+    {
+        inner = node;
+        for (i = 0; pos >= inner->sizes[i]; i++)
+        {
+            pos -= inner->sizes[i];
+            rank += inner->ones[i];
+        }
+        node = inner->children[i];
+    }
+    leaf = node;
+    return rank + popcnt_words(leaf->words, 0, pos >> LOG_WORD_SIZE) +
+           popcnt(leaf->words[pos >> LOG_WORD_SIZE] & ((BIT << (pos & (WORD_SIZE - 1))) - 1));
+}
+
+static int64_t select_bit(dynamic_bitvector *dbv, uint64_t k, bool bit)
+{
+    /** descend by the counts of `bit`s below each child, then select within the leaf words **/
+
+    uint64_t i, h, c, w, x, pos = 0;
+    dbv_inner *inner;
+    dbv_leaf *leaf;
+    void *node;
+
+    BV_CHECK_NONNULL(dbv);
+    if (k == 0 || k > (bit ? dbv->ones : dbv->size - dbv->ones))
+        return -1;
+
+    node = dbv->root;
+    for (h = dbv->height; h > 0; h--)
+    {
+        inner = node;
+        for (i = 0;; i++)
+        {
+            c = bit ? inner->ones[i] : inner->sizes[i] - inner->ones[i];
+            if (k <= c)
+                break;
+            k -= c;
+            pos += inner->sizes[i];
+        }
+        node = inner->children[i];
+    }
+    leaf = node;
+    for (w = 0;; w++)
+    {
+        /* the kth `bit` lies within the leaf, so the unset bits past its end are never selected */
+        x = bit ? leaf->words[w] : ~leaf->words[w];
+        c = popcnt(x);
+        if (k <= c)
+            return (int64_t)(pos + (w << LOG_WORD_SIZE) + word_select(x, k - 1));
+        k -= c;
+    }
+}
+
+int64_t dbv_select(dynamic_bitvector *dbv, uint64_t k)
+{
+    return select_bit(dbv, k, true);
+}
+
+int64_t dbv_select0(dynamic_bitvector *dbv, uint64_t k)
+{
+    return select_bit(dbv, k, false);
+}
+
+static size_t node_bytes(void *node, uint64_t height)
+{
+    uint64_t i;
+    size_t bytes;
+    dbv_inner *inner = node;
+
+    if (height == 0)
+        return sizeof(dbv_leaf);
+    for (bytes = sizeof(dbv_inner), i = 0; i < inner->n; i++)
+        bytes += node_bytes(inner->children[i], height - 1);
+    return bytes;
+}
+
+size_t dbv_bytes(dynamic_bitvector *dbv)
+{
+    BV_CHECK_NONNULL(dbv);
+    return sizeof(dynamic_bitvector) + node_bytes(dbv->root, dbv->height);
+}
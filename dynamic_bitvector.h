@@ -0,0 +1,115 @@
+/**
+ * @file dynamic_bitvector.h
+ * @brief Dynamic bitvector supporting insertion and deletion of bits, backed by a B+-tree of word leaves
+ */
+
+#ifndef POPPY_DYNAMIC_BITVECTOR_H
+#define POPPY_DYNAMIC_BITVECTOR_H
+
+#include "bitvector.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DBV_LEAF_WORDS (16UL)                        // words per leaf
+#define DBV_LEAF_BITS (DBV_LEAF_WORDS * WORD_SIZE)   // a leaf holds up to 1024 bits
+#define DBV_FANOUT (16UL)                            // children per inner node
+
+/**
+ * @brief A bitvector whose bits can be inserted and deleted anywhere
+ *
+ * Leaves hold up to DBV_LEAF_BITS bits packed from the start of their words.
+ * Inner nodes hold, next to each child pointer, the number of bits and set bits below that child, so access, rank,
+ * select, insert and delete descend a single root-to-leaf path and all run in O(log n).
+ * Nodes other than the root are kept at least a quarter full by merging or rebalancing with a sibling.
+ */
+typedef struct
+{
+    void *root;       // a leaf when height == 0, an inner node otherwise
+    uint64_t height;  // the number of inner levels
+    uint64_t size;    // the number of bits
+    uint64_t ones;    // the number of set bits
+} dynamic_bitvector;
+
+/**
+ * @brief Create an empty dynamic bitvector
+ */
+dynamic_bitvector *dbv_new(void);
+
+/**
+ * @brief Bulk-load the bits of a bitvector, leaving room in every node for later insertions
+ */
+dynamic_bitvector *dbv_from_bitvector(bitvector *bv);
+
+/**
+ * @brief Copy the bits into a plain bitvector
+ */
+bitvector *dbv_to_bitvector(dynamic_bitvector *dbv);
+
+void dbv_free(dynamic_bitvector *dbv);
+
+/**
+ * @brief The number of bits
+ */
+uint64_t dbv_len(dynamic_bitvector *dbv);
+
+/**
+ * @brief The number of set bits
+ */
+uint64_t dbv_count(dynamic_bitvector *dbv);
+
+/**
+ * @brief Check if the bit at position `pos` is set
+ */
+bool dbv_isset(dynamic_bitvector *dbv, uint64_t pos);
+
+/**
+ * @brief Overwrite the bit at position `pos`
+ */
+void dbv_assign(dynamic_bitvector *dbv, uint64_t pos, bool bit);
+
+/**
+ * @brief Insert a bit before position `pos`, shifting the bits at and after `pos` one position up
+ *
+ * @param pos in [0, dbv_len(dbv)]; dbv_len(dbv) appends
+ */
+void dbv_insert(dynamic_bitvector *dbv, uint64_t pos, bool bit);
+
+/**
+ * @brief Remove the bit at position `pos`, shifting the bits after it one position down
+ *
+ * @return bool the removed bit
+ */
+bool dbv_delete(dynamic_bitvector *dbv, uint64_t pos);
+
+/**
+ * @brief Append a bit
+ */
+void dbv_push(dynamic_bitvector *dbv, bool bit);
+
+/**
+ * @brief The number of set bits strictly before pos, clamped to dbv_len(dbv)
+ */
+uint64_t dbv_rank(dynamic_bitvector *dbv, uint64_t pos);
+
+/**
+ * @brief The position of the kth (1-indexed) set bit, or -1 if there are fewer than k
+ */
+int64_t dbv_select(dynamic_bitvector *dbv, uint64_t k);
+
+/**
+ * @brief The position of the kth (1-indexed) unset bit, or -1 if there are fewer than k
+ */
+int64_t dbv_select0(dynamic_bitvector *dbv, uint64_t k);
+
+/**
+ * @brief The number of bytes used by the nodes of the tree
+ */
+size_t dbv_bytes(dynamic_bitvector *dbv);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // POPPY_DYNAMIC_BITVECTOR_H
@@ -0,0 +1,251 @@
+#include "elias_fano.h"
+#include "word_kernels.h"
+#include <stdio.h>
+
+static inline uint64_t ef_low_bits(uint64_t n, uint64_t size)
+{
+    /** floor(log2(size / n)), the split that minimizes the total size of the encoding **/
+
+    if (size <= n)
+        return 0;
+    return (WORD_SIZE - 1) - __builtin_clzll(n ? size / n : size);
+}
+
+static inline uint64_t ef_get_low(elias_fano *ef, uint64_t i)
+{
+    /** the low bits of the ith position, which may straddle two words **/
+
+    uint64_t offset = i * ef->low_bits;
+    uint64_t word = offset >> LOG_WORD_SIZE, shift = offset & (WORD_SIZE - 1);
+    uint64_t value = ef->low[word] >> shift;
+
+    if (shift + ef->low_bits > WORD_SIZE)
+        value |= ef->low[word + 1] << (WORD_SIZE - shift);
+    return value & ((BIT << ef->low_bits) - 1);
+}
+
+static inline void ef_put_low(elias_fano *ef, uint64_t i, uint64_t value)
+{
+    /** the low array is zero-initialized and written once per position, so or-ing is enough **/
+
+    uint64_t offset = i * ef->low_bits;
+    uint64_t word = offset >> LOG_WORD_SIZE, shift = offset & (WORD_SIZE - 1);
+
+    if (ef->low_bits == 0)
+        return;
+    ef->low[word] |= value << shift;
+    if (shift + ef->low_bits > WORD_SIZE)
+        ef->low[word + 1] |= value >> (WORD_SIZE - shift);
+}
+
+static inline bool ef_high_isset(elias_fano *ef, uint64_t p)
+{
+    return (ef->high->data[p >> LOG_WORD_SIZE] >> (p & (WORD_SIZE - 1))) & BIT;
+}
+
+elias_fano *ef_new(uint64_t n, uint64_t size)
+{
+    elias_fano *ef;
+    uint64_t low_bits = ef_low_bits(n, size);
+
+    if (n > size)
+    {
+        BV_REPORT_ERROR_AND_EXIT(n > size, __FILE__, __PRETTY_FUNCTION__, __LINE__,
+                                 "cannot encode %lu positions in %lu bits", n, size);
+    }
+
+    ef = malloc(sizeof(elias_fano));
+    if (ef == NULL)
+    {
+        BV_REPORT_ERROR_AND_EXIT(ef == NULL, __FILE__, __PRETTY_FUNCTION__, __LINE__, "could not allocate elias_fano");
+    }
+    *ef = (elias_fano){
+        .size = size,
+        .capacity = n,
+        .ones = 0,
+        .low_bits = low_bits,
+        /* one spare word so that ef_get_low can always read two words */
+        .low = calloc(((n * low_bits) >> LOG_WORD_SIZE) + 2, sizeof(uint64_t)),
+        .high = bv_new(n + (size >> low_bits) + 1),
+        .last = -1};
+    if (ef->low == NULL)
+    {
+        BV_REPORT_ERROR_AND_EXIT(ef->low == NULL, __FILE__, __PRETTY_FUNCTION__, __LINE__, "could not allocate low bits");
+    }
+    return ef;
+}
+
+void ef_push(elias_fano *ef, uint64_t pos)
+{
+    BV_CHECK_NONNULL(ef);
+    if (pos >= ef->size || (int64_t)pos <= ef->last || ef->ones == ef->capacity)
+    {
+        BV_REPORT_ERROR_AND_EXIT(pos >= ef->size || (int64_t)pos <= ef->last || ef->ones == ef->capacity, __FILE__,
+                                 __PRETTY_FUNCTION__, __LINE__,
+                                 "position %lu out of order, out of range or over capacity", pos);
+    }
+
+    ef_put_low(ef, ef->ones, pos & ((BIT << ef->low_bits) - 1));
+    bv_set_unchecked(ef->high, ef->ones + (pos >> ef->low_bits));
+    ef->ones++;
+    ef->last = (int64_t)pos;
+}
+
+void ef_seal(elias_fano *ef)
+{
+    BV_CHECK_NONNULL(ef);
+    bv_build_select(ef->high);
+}
+
+elias_fano *ef_from_positions(const uint64_t *positions, uint64_t n, uint64_t size)
+{
+    elias_fano *ef = ef_new(n, size);
+    uint64_t i;
+
+    for (i = 0; i < n; i++)
+        ef_push(ef, positions[i]);
+    ef_seal(ef);
+    return ef;
+}
+
+elias_fano *ef_from_bitvector(bitvector *bv)
+{
+    /** count the set bits, then push them word by word, peeling off the lowest set bit with tzcnt/blsr **/
+
+    elias_fano *ef;
+    uint64_t i, word, num_words;
+
+    BV_CHECK_NONNULL(bv);
+    num_words = (bv_len(bv) >> LOG_WORD_SIZE) + BIT;
+    ef = ef_new(words_popcount(bv->data, num_words), bv_len(bv));
+
+    for (i = 0; i < num_words; i++)
+    {
+        for (word = bv->data[i]; word; word &= word - 1)
+            ef_push(ef, (i << LOG_WORD_SIZE) + __builtin_ctzll(word));
+    }
+    ef_seal(ef);
+    return ef;
+}
+
+bitvector *ef_to_bitvector(elias_fano *ef)
+{
+    bitvector *bv;
+    uint64_t i, p;
+
+    BV_CHECK_NONNULL(ef);
+    bv = bv_new(ef->size);
+
+    /* walk the high bits once instead of calling ef_select for every position */
+    for (i = 0, p = 0; i < ef->ones; p++)
+    {
+        if (ef_high_isset(ef, p))
+        {
+            bv_set_unchecked(bv, ((p - i) << ef->low_bits) | ef_get_low(ef, i));
+            i++;
+        }
+    }
+    return bv;
+}
+
+void ef_free(elias_fano *ef)
+{
+    if (ef == NULL)
+        return;
+    bv_free(ef->high);
+    free(ef->low);
+    free(ef);
+}
+
+uint64_t ef_len(elias_fano *ef)
+{
+    BV_CHECK_NONNULL(ef);
+    return ef->size;
+}
+
+uint64_t ef_count(elias_fano *ef)
+{
+    BV_CHECK_NONNULL(ef);
+    return ef->ones;
+}
+
+int64_t ef_select(elias_fano *ef, uint64_t k)
+{
+    /** the kth one of the high bits sits at (k - 1) + (high part of the kth position) **/
+
+    int64_t p;
+
+    BV_CHECK_NONNULL(ef);
+    if (k == 0 || k > ef->ones)
+        return -1;
+    p = bv_select(ef->high, k);
+    return (int64_t)((((uint64_t)p - (k - 1)) << ef->low_bits) | ef_get_low(ef, k - 1));
+}
+
+uint64_t ef_rank(elias_fano *ef, uint64_t pos)
+{
+    /**
+     * Every position with high part h lies between the (h)th and (h + 1)th zero of the high bits.
+     * Jump to the start of the bucket of pos with select0, then scan the bucket comparing low bits.
+     **/
+
+    uint64_t h, i, p, low, high_bits;
+    int64_t p0;
+
+    BV_CHECK_NONNULL(ef);
+    if (pos >= ef->size)
+        return ef->ones;
+
+    h = pos >> ef->low_bits;
+    low = pos & ((BIT << ef->low_bits) - 1);
+    if (h == 0)
+    {
+        i = 0;
+        p = 0;
+    }
+    else
+    {
+        p0 = bv_select0(ef->high, h);
+        p = (uint64_t)p0 + 1;
+        i = p - h;
+    }
+
+    high_bits = bv_len(ef->high);
+    while (p < high_bits && ef_high_isset(ef, p) && ef_get_low(ef, i) < low)
+    {
+        i++;
+        p++;
+    }
+    return i;
+}
+
+int64_t ef_successor(elias_fano *ef, uint64_t pos)
+{
+    uint64_t k = ef_rank(ef, pos);
+    return (k < ef->ones) ? ef_select(ef, k + 1) : -1;
+}
+
+int64_t ef_predecessor(elias_fano *ef, uint64_t pos)
+{
+    uint64_t k;
+
+    BV_CHECK_NONNULL(ef);
+    if (ef->size == 0)
+        return -1;
+    if (pos >= ef->size)
+        pos = ef->size - 1;
+    k = ef_rank(ef, pos + 1);
+    return (k > 0) ? ef_select(ef, k) : -1;
+}
+
+bool ef_isset(elias_fano *ef, uint64_t pos)
+{
+    return ef_successor(ef, pos) == (int64_t)pos;
+}
+
+size_t ef_bytes(elias_fano *ef)
+{
+    BV_CHECK_NONNULL(ef);
+    return sizeof(elias_fano) + (((ef->capacity * ef->low_bits) >> LOG_WORD_SIZE) + 2) * sizeof(uint64_t) +
+           ((bv_len(ef->high) >> LOG_WORD_SIZE) + BIT) * sizeof(uint64_t) + bv_index_bytes(ef->high);
+}
@@ -0,0 +1,112 @@
+/**
+ * @file elias_fano.h
+ * @brief Elias-Fano encoded sparse bitvector with rank/select
+ */
+
+#ifndef POPPY_ELIAS_FANO_H
+#define POPPY_ELIAS_FANO_H
+
+#include "bitvector.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief An Elias-Fano encoding of the n set positions of a bitvector of `size` bits
+ *
+ * Each position is split into its `low_bits` low bits, stored verbatim in a packed array,
+ * and its high bits, stored in unary in the `high` bitvector: the ith position sets bit (i + (position >> low_bits)).
+ * With low_bits = floor(log2(size / n)) this takes at most 2 + log2(size / n) bits per set bit.
+ * select uses the CS-Poppy select samples of `high`; rank and successor use its select0 samples.
+ */
+typedef struct
+{
+    uint64_t size;      // the number of bits of the encoded bitvector
+    uint64_t capacity;  // the number of set positions the encoding was sized for
+    uint64_t ones;      // the number of set positions pushed so far
+    uint64_t low_bits;  // the number of low bits stored per position
+    uint64_t *low;      // ones * low_bits packed low bits
+    bitvector *high;    // unary-coded high bits, ones + (size >> low_bits) + 1 bits
+    int64_t last;       // the last position pushed, -1 if none
+} elias_fano;
+
+/**
+ * @brief Create an empty encoding for up to n strictly increasing positions in [0, size)
+ *
+ * Fill it with `ef_push`, then call `ef_seal` before querying.
+ */
+elias_fano *ef_new(uint64_t n, uint64_t size);
+
+/**
+ * @brief Append a position, which must be larger than every position pushed before it
+ */
+void ef_push(elias_fano *ef, uint64_t pos);
+
+/**
+ * @brief Build the select directories of the high bits; call once after the last `ef_push`
+ */
+void ef_seal(elias_fano *ef);
+
+/**
+ * @brief Encode n sorted, distinct positions in [0, size)
+ */
+elias_fano *ef_from_positions(const uint64_t *positions, uint64_t n, uint64_t size);
+
+/**
+ * @brief Encode the set bits of a bitvector
+ */
+elias_fano *ef_from_bitvector(bitvector *bv);
+
+/**
+ * @brief Decode an encoding back into a plain bitvector
+ */
+bitvector *ef_to_bitvector(elias_fano *ef);
+
+void ef_free(elias_fano *ef);
+
+/**
+ * @brief The number of bits of the encoded bitvector
+ */
+uint64_t ef_len(elias_fano *ef);
+
+/**
+ * @brief The number of set bits
+ */
+uint64_t ef_count(elias_fano *ef);
+
+/**
+ * @brief The number of set bits strictly before pos, i.e bv_rank of the encoded bitvector
+ */
+uint64_t ef_rank(elias_fano *ef, uint64_t pos);
+
+/**
+ * @brief The position of the kth (1-indexed) set bit, or -1 if there are fewer than k
+ */
+int64_t ef_select(elias_fano *ef, uint64_t k);
+
+/**
+ * @brief The smallest set position >= pos, or -1 if there is none
+ */
+int64_t ef_successor(elias_fano *ef, uint64_t pos);
+
+/**
+ * @brief The largest set position <= pos, or -1 if there is none
+ */
+int64_t ef_predecessor(elias_fano *ef, uint64_t pos);
+
+/**
+ * @brief Check if the bit at position `pos` is set
+ */
+bool ef_isset(elias_fano *ef, uint64_t pos);
+
+/**
+ * @brief The number of bytes used by the encoding, including the directories of the high bits
+ */
+size_t ef_bytes(elias_fano *ef);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // POPPY_ELIAS_FANO_H
@@ -0,0 +1,1043 @@
+#include "bitvector.h"
+#include "thread_pool.h"
+#include "word_kernels.h"
+#include "word_ops.h"
+#include <stdio.h>
+#include <string.h>
+
+#define L1_PER_L0 (BIT << (LOG_L0_BLOCK_SIZE - LOG_L1_BLOCK_SIZE))
+#define L1_MASK (0xffffffffUL)
+#define L2_MASK ((BIT << L2_FIELD_WIDTH) - 1)
+#define SELECT_SAMPLE_RATE (BIT << LOG_SELECT_SAMPLE_RATE)
+#define BATCH_PREFETCH_DISTANCE (16UL)
+#define BATCH_GRAIN (4096UL)
+#define SELECT_GROUP (16UL)
+#define BUILD_CHUNK_L1 (4096UL)       // L1 blocks per task of the parallel rank build, 1 MiB of data
+#define BUILD_SAMPLES_GRAIN (1024UL)  // select samples per task
+
+static inline uint64_t l1_count(uint64_t entry)
+{
+    return entry & L1_MASK;
+}
+
+static inline uint64_t l2_count(uint64_t entry, uint64_t k)
+{
+    return (entry >> (32 + L2_FIELD_WIDTH * k)) & L2_MASK;
+}
+
+/**
+ * @brief the absolute number of ones before the jth L1 block
+ */
+static inline uint64_t l1_rank(rank_directory *rd, uint64_t j)
+{
+    return rd->l0[j / L1_PER_L0] + l1_count(rd->l1l2[j]);
+}
+
+static inline uint64_t bv_num_words(bitvector *bv)
+{
+    return (bv_len(bv) + WORD_SIZE - 1) >> LOG_WORD_SIZE;
+}
+
+static void bv_drop_select(bitvector *bv)
+{
+    if (bv->select == NULL)
+        return;
+    /* the directories of a memory-mapped bitvector live in the mapping */
+    if (bv->mapping == NULL)
+    {
+        free(bv->select->samples);
+        free(bv->select->samples0);
+    }
+    free(bv->select);
+    bv->select = NULL;
+}
+
+void bv_drop_rank(bitvector *bv)
+{
+    bv_drop_select(bv);
+    if (bv->rank == NULL)
+        return;
+    if (bv->mapping == NULL)
+    {
+        free(bv->rank->l0);
+        bv->allocator->free(bv->allocator->ctx, bv->rank->l1l2, bv->rank->num_l1 * sizeof(uint64_t));
+    }
+    free(bv->rank->dirty);
+    free(bv->rank);
+    bv->rank = NULL;
+}
+
+static inline uint64_t l2_fields(const uint64_t *data, uint64_t nwords, uint64_t j, uint64_t *ones)
+{
+    /** the L2 fields of the jth L1 block, with the number of ones in the whole block stored in `ones` **/
+
+    uint64_t i, k, lo, hi, count, entry = 0;
+
+    *ones = 0;
+    for (k = 0; k < WORDS_PER_L1_BLOCK / WORDS_PER_BASIC_BLOCK; k++)
+    {
+        lo = j * WORDS_PER_L1_BLOCK + k * WORDS_PER_BASIC_BLOCK;
+        hi = lo + WORDS_PER_BASIC_BLOCK;
+        lo = (lo < nwords) ? lo : nwords;
+        hi = (hi < nwords) ? hi : nwords;
+        for (count = 0, i = lo; i < hi; i++)
+            count += popcnt(data[i]);
+        if (k < 3)
+            entry |= count << (32 + L2_FIELD_WIDTH * k);
+        *ones += count;
+    }
+    return entry;
+}
+
+typedef struct
+{
+    bitvector *bv;
+    rank_directory *rd;
+    uint64_t *chunk_ones; // the ones in each chunk, then the ones before each chunk
+} build_job;
+
+static void count_chunks_task(void *arg, size_t begin, size_t end)
+{
+    /** fill the L1/L2 entries of chunks [begin, end) with L1 counts relative to the start of their chunk **/
+
+    build_job *job = arg;
+    uint64_t c, j, j_end, local, ones, nwords = bv_num_words(job->bv);
+
+    for (c = begin; c < end; c++)
+    {
+        j_end = (c + 1) * BUILD_CHUNK_L1;
+        j_end = (j_end < job->rd->num_l1) ? j_end : job->rd->num_l1;
+        for (local = 0, j = c * BUILD_CHUNK_L1; j < j_end; j++)
+        {
+            job->rd->l1l2[j] = l2_fields(job->bv->data, nwords, j, &ones) | local;
+            local += ones;
+        }
+        job->chunk_ones[c] = local;
+    }
+}
+
+static void rebase_chunks_task(void *arg, size_t begin, size_t end)
+{
+    /** turn the chunk-relative L1 counts of chunks [begin, end) into counts relative to their L0 block **/
+
+    build_job *job = arg;
+    rank_directory *rd = job->rd;
+    uint64_t c, j, j_end;
+
+    for (c = begin; c < end; c++)
+    {
+        j_end = (c + 1) * BUILD_CHUNK_L1;
+        j_end = (j_end < rd->num_l1) ? j_end : rd->num_l1;
+        for (j = c * BUILD_CHUNK_L1; j < j_end; j++)
+            rd->l1l2[j] = (rd->l1l2[j] & ~L1_MASK) |
+                          (job->chunk_ones[c] + l1_count(rd->l1l2[j]) - rd->l0[j / L1_PER_L0]);
+    }
+}
+
+void bv_build_rank(bitvector *bv)
+{
+    /**
+     * Three passes, the first and last spread over the worker pool:
+     * 1) count every chunk of BUILD_CHUNK_L1 L1 blocks independently, writing chunk-relative L1 counts
+     * 2) prefix-sum the chunk counts and derive the L0 entries
+     * 3) rebase every L1 count onto its L0 block
+     * The last pass only touches the directory, about 3% of the bytes of the first.
+     **/
+
+    uint64_t c, b, num_chunks, total, ones;
+    rank_directory *rd;
+    build_job job;
+    bool had_select = (bv->select != NULL);
+
+    /* a memory-mapped view carries its directories and cannot be modified */
+    if (bv->mapping != NULL)
+        return;
+    bv_drop_rank(bv);
+    rd = calloc(1, sizeof(rank_directory));
+    if (rd == NULL)
+    {
+        BV_REPORT_ERROR_AND_EXIT(rd == NULL, __FILE__, __PRETTY_FUNCTION__, __LINE__, "could not allocate rank directory");
+    }
+
+    /* one extra entry so that bv_rank(bv, bv_len(bv)) never reads out of bounds */
+    rd->num_l0 = (bv_len(bv) >> LOG_L0_BLOCK_SIZE) + 1;
+    rd->num_l1 = (bv_len(bv) >> LOG_L1_BLOCK_SIZE) + 1;
+    rd->l0 = malloc(rd->num_l0 * sizeof(uint64_t));
+    /* the entries are read as often as the words, so they come from the same allocator */
+    rd->l1l2 = bv->allocator->alloc(bv->allocator->ctx, rd->num_l1 * sizeof(uint64_t));
+    num_chunks = (rd->num_l1 + BUILD_CHUNK_L1 - 1) / BUILD_CHUNK_L1;
+    job = (build_job){bv, rd, malloc(num_chunks * sizeof(uint64_t))};
+    if (rd->l0 == NULL || rd->l1l2 == NULL || job.chunk_ones == NULL)
+    {
+        BV_REPORT_ERROR_AND_EXIT(rd->l1l2 == NULL, __FILE__, __PRETTY_FUNCTION__, __LINE__, "could not allocate rank directory");
+    }
+
+    bv_parallel_for(num_chunks, 1, count_chunks_task, &job);
+
+    for (total = 0, c = 0; c < num_chunks; c++)
+    {
+        ones = job.chunk_ones[c];
+        job.chunk_ones[c] = total;
+        total += ones;
+    }
+    for (b = 0; b < rd->num_l0; b++)
+    {
+        c = (b * L1_PER_L0) / BUILD_CHUNK_L1;
+        rd->l0[b] = job.chunk_ones[c] + l1_count(rd->l1l2[b * L1_PER_L0]);
+    }
+
+    bv_parallel_for(num_chunks, 1, rebase_chunks_task, &job);
+    free(job.chunk_ones);
+
+    rd->ones = total;
+    bv->rank = rd;
+
+    if (had_select)
+        bv_build_select(bv);
+}
+
+struct bv_builder
+{
+    const bv_allocator *allocator; // of data and l1l2, which the finished bitvector takes over
+    uint64_t *data;
+    uint64_t size;      // bits appended so far
+    uint64_t capacity;  // words allocated for data, of which [0, size / WORD_SIZE] are initialized
+    uint64_t *l0;
+    uint64_t *l1l2;
+    uint64_t l0_capacity;
+    uint64_t l1_capacity;
+    uint64_t next_l1;   // the first L1 block without a directory entry
+    uint64_t ones;      // the ones in blocks [0, next_l1)
+};
+
+static void *grow(void *ptr, uint64_t *capacity, uint64_t needed, size_t elem_size)
+{
+    /** at least double `ptr` until it holds `needed` elements **/
+
+    uint64_t new_capacity = *capacity;
+    void *grown;
+
+    if (needed <= *capacity)
+        return ptr;
+    while (new_capacity < needed)
+        new_capacity = new_capacity ? new_capacity << 1 : 1;
+    grown = realloc(ptr, new_capacity * elem_size);
+    if (grown == NULL)
+    {
+        BV_REPORT_ERROR_AND_EXIT(grown == NULL, __FILE__, __PRETTY_FUNCTION__, __LINE__, "could not grow builder");
+    }
+    *capacity = new_capacity;
+    return grown;
+}
+
+static void grow_words(bv_builder *builder, uint64_t **words, uint64_t *capacity, uint64_t needed)
+{
+    /** like `grow`, but through the allocator the finished bitvector will free the words and its L1/L2 entries with **/
+
+    uint64_t new_capacity = *capacity;
+
+    if (needed <= *capacity)
+        return;
+    while (new_capacity < needed)
+        new_capacity = new_capacity ? new_capacity << 1 : 1;
+    *words = (*words == NULL) ? builder->allocator->alloc(builder->allocator->ctx, new_capacity * sizeof(uint64_t))
+                              : builder->allocator->realloc(builder->allocator->ctx, *words, *capacity * sizeof(uint64_t),
+                                                            new_capacity * sizeof(uint64_t));
+    if (*words == NULL)
+    {
+        BV_REPORT_ERROR_AND_EXIT(*words == NULL, __FILE__, __PRETTY_FUNCTION__, __LINE__, "could not grow builder");
+    }
+    *capacity = new_capacity;
+}
+
+static void builder_emit(bv_builder *builder, uint64_t nwords)
+{
+    /** write the directory entry of L1 block `next_l1`, reading at most `nwords` words of data **/
+
+    uint64_t j = builder->next_l1, ones;
+
+    grow_words(builder, &builder->l1l2, &builder->l1_capacity, j + 1);
+    if (j % L1_PER_L0 == 0)
+    {
+        builder->l0 = grow(builder->l0, &builder->l0_capacity, j / L1_PER_L0 + 1, sizeof(uint64_t));
+        builder->l0[j / L1_PER_L0] = builder->ones;
+    }
+    builder->l1l2[j] = l2_fields(builder->data, nwords, j, &ones) | (builder->ones - builder->l0[j / L1_PER_L0]);
+    builder->ones += ones;
+    builder->next_l1++;
+}
+
+bv_builder *bv_builder_new(uint64_t expected_bits)
+{
+    /** preallocate the data and directory for `expected_bits` bits **/
+
+    bv_builder *builder = calloc(1, sizeof(bv_builder));
+    if (builder == NULL)
+    {
+        BV_REPORT_ERROR_AND_EXIT(builder == NULL, __FILE__, __PRETTY_FUNCTION__, __LINE__, "could not allocate builder");
+    }
+
+    builder->allocator = bv_get_allocator();
+    grow_words(builder, &builder->data, &builder->capacity, (expected_bits >> LOG_WORD_SIZE) + 2);
+    grow_words(builder, &builder->l1l2, &builder->l1_capacity, (expected_bits >> LOG_L1_BLOCK_SIZE) + 1);
+    builder->l0 = grow(NULL, &builder->l0_capacity, (expected_bits >> LOG_L0_BLOCK_SIZE) + 1, sizeof(uint64_t));
+    builder->data[0] = 0;
+    return builder;
+}
+
+void bv_builder_append(bv_builder *builder, uint64_t bits, unsigned nbits)
+{
+    /** store the bits, zeroing the rest of the last word they touch, then index every L1 block they complete **/
+
+    uint64_t word = builder->size >> LOG_WORD_SIZE, shift = builder->size & (WORD_SIZE - 1);
+
+    if (nbits == 0)
+        return;
+    if (nbits < WORD_SIZE)
+        bits &= (BIT << nbits) - 1;
+
+    /* one spare word for the spill and one for the trailing word of bv_new's layout */
+    grow_words(builder, &builder->data, &builder->capacity, word + 2);
+    builder->data[word] |= bits << shift;
+    builder->data[word + 1] = shift ? bits >> (WORD_SIZE - shift) : 0;
+    builder->size += nbits;
+
+    while ((builder->size >> LOG_L1_BLOCK_SIZE) > builder->next_l1)
+        builder_emit(builder, (builder->next_l1 + 1) * WORDS_PER_L1_BLOCK);
+}
+
+void bv_builder_push(bv_builder *builder, bool bit)
+{
+    bv_builder_append(builder, bit, 1);
+}
+
+bitvector *bv_builder_finish(bv_builder *builder)
+{
+    /** index the trailing partial block, trim the arrays to the sizes `bv_build_rank` would allocate **/
+
+    uint64_t num_words = (builder->size >> LOG_WORD_SIZE) + BIT;
+    rank_directory *rd = calloc(1, sizeof(rank_directory));
+    bitvector *bv = malloc(sizeof(bitvector));
+    if (rd == NULL || bv == NULL)
+    {
+        BV_REPORT_ERROR_AND_EXIT(bv == NULL, __FILE__, __PRETTY_FUNCTION__, __LINE__, "could not allocate bitvector");
+    }
+
+    grow_words(builder, &builder->data, &builder->capacity, num_words);
+    while (builder->next_l1 <= (builder->size >> LOG_L1_BLOCK_SIZE))
+        builder_emit(builder, (builder->size + WORD_SIZE - 1) >> LOG_WORD_SIZE);
+
+    rd->num_l0 = (builder->size >> LOG_L0_BLOCK_SIZE) + 1;
+    rd->num_l1 = builder->next_l1;
+    rd->ones = builder->ones;
+    rd->l0 = realloc(builder->l0, rd->num_l0 * sizeof(uint64_t));
+    rd->l1l2 = builder->allocator->realloc(builder->allocator->ctx, builder->l1l2, builder->l1_capacity * sizeof(uint64_t),
+                                           rd->num_l1 * sizeof(uint64_t));
+    *bv = (bitvector){.data = builder->allocator->realloc(builder->allocator->ctx, builder->data,
+                                                          builder->capacity * sizeof(uint64_t),
+                                                          num_words * sizeof(uint64_t)),
+                      .size = builder->size,
+                      .allocated = num_words * WORD_SIZE,
+                      .rank = rd,
+                      .allocator = builder->allocator};
+    if (rd->l0 == NULL || rd->l1l2 == NULL || bv->data == NULL)
+    {
+        BV_REPORT_ERROR_AND_EXIT(bv->data == NULL, __FILE__, __PRETTY_FUNCTION__, __LINE__, "could not trim bitvector");
+    }
+    free(builder);
+    return bv;
+}
+
+/**
+ * @brief the absolute number of `bit`s before the jth L1 block
+ */
+static inline uint64_t l1_rank_bit(rank_directory *rd, uint64_t j, bool bit)
+{
+    return bit ? l1_rank(rd, j) : (j << LOG_L1_BLOCK_SIZE) - l1_rank(rd, j);
+}
+
+typedef struct
+{
+    rank_directory *rd;
+    uint32_t *samples;
+    bool bit;
+} samples_job;
+
+static void build_samples_task(void *arg, size_t begin, size_t end)
+{
+    /** binary search the L1 block of the first sample, then advance linearly through the rest **/
+
+    samples_job *job = arg;
+    rank_directory *rd = job->rd;
+    uint64_t s, lo = 0, hi = rd->num_l1 - 1, mid;
+
+    while (lo < hi)
+    {
+        mid = lo + ((hi - lo + 1) >> 1);
+        if (l1_rank_bit(rd, mid, job->bit) <= (begin << LOG_SELECT_SAMPLE_RATE))
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    for (s = begin; s < end; s++)
+    {
+        /* advance to the last L1 block with fewer than s * SELECT_SAMPLE_RATE + 1 `bit`s before it */
+        while (lo + 1 < rd->num_l1 && l1_rank_bit(rd, lo + 1, job->bit) <= (s << LOG_SELECT_SAMPLE_RATE))
+            lo++;
+        job->samples[s] = lo;
+    }
+}
+
+static uint32_t *build_samples(rank_directory *rd, uint64_t num_samples, bool bit)
+{
+    /** record the L1 block holding every SELECT_SAMPLE_RATE-th `bit` **/
+
+    samples_job job = {rd, malloc((num_samples + 1) * sizeof(uint32_t)), bit};
+    if (job.samples == NULL)
+    {
+        BV_REPORT_ERROR_AND_EXIT(job.samples == NULL, __FILE__, __PRETTY_FUNCTION__, __LINE__, "could not allocate select samples");
+    }
+
+    bv_parallel_for(num_samples, BUILD_SAMPLES_GRAIN, build_samples_task, &job);
+    return job.samples;
+}
+
+void bv_build_select(bitvector *bv)
+{
+    rank_directory *rd;
+    select_directory *sd;
+
+    if (bv->mapping != NULL)
+        return;
+    if (bv->rank == NULL)
+        bv_build_rank(bv);
+    bv_drop_select(bv);
+
+    rd = bv->rank;
+    sd = calloc(1, sizeof(select_directory));
+    if (sd == NULL)
+    {
+        BV_REPORT_ERROR_AND_EXIT(sd == NULL, __FILE__, __PRETTY_FUNCTION__, __LINE__, "could not allocate select directory");
+    }
+    sd->num_samples = (rd->ones + SELECT_SAMPLE_RATE - 1) >> LOG_SELECT_SAMPLE_RATE;
+    sd->samples = build_samples(rd, sd->num_samples, true);
+    sd->num_samples0 = (bv_len(bv) - rd->ones + SELECT_SAMPLE_RATE - 1) >> LOG_SELECT_SAMPLE_RATE;
+    sd->samples0 = build_samples(rd, sd->num_samples0, false);
+    bv->select = sd;
+}
+
+static uint64_t next_dirty(rank_directory *rd, uint64_t j)
+{
+    /** the first dirty L1 block >= j, or num_l1 if there is none **/
+
+    uint64_t w = j >> LOG_WORD_SIZE, nwords = (rd->num_l1 + WORD_SIZE - 1) >> LOG_WORD_SIZE;
+    uint64_t word = (j < rd->num_l1) ? rd->dirty[w] & (ALL_ONES_MASK << (j & (WORD_SIZE - 1))) : 0;
+
+    while (word == 0)
+    {
+        if (++w >= nwords)
+            return rd->num_l1;
+        word = rd->dirty[w];
+    }
+    return (w << LOG_WORD_SIZE) + __builtin_ctzll(word);
+}
+
+static void repair_rank(bitvector *bv)
+{
+    /**
+     * One pass from the first dirty L1 block: recount each dirty block from the data, and shift every later
+     * L1 and L0 count by the change accumulated so far.
+     * `base` is the part of that change already folded into the L0 entry of the current L0 block,
+     * so the clean L1 entries between two dirty blocks move by (delta - base) in a tight loop,
+     * and whole L0 blocks are skipped when that is zero.
+     **/
+
+    rank_directory *rd = bv->rank;
+    uint64_t j, b, end, dirty, entry, old_total, new_total, next_abs, nwords = bv_num_words(bv);
+    int64_t delta = 0, base = 0;
+
+    for (j = rd->dirty_from; j < rd->num_l1;)
+    {
+        dirty = (rd->num_dirty > 0) ? next_dirty(rd, j) : rd->num_l1;
+        while (j <= dirty && j < rd->num_l1)
+        {
+            b = j / L1_PER_L0;
+            if (j % L1_PER_L0 == 0)
+            {
+                rd->l0[b] += delta;
+                base = delta;
+            }
+            if (j == dirty)
+                break;
+            end = (b + 1) * L1_PER_L0;
+            end = (end < dirty) ? end : dirty;
+            if (delta == base)
+                j = end;
+            else
+                for (; j < end; j++)
+                    rd->l1l2[j] += delta - base;
+        }
+        if (j >= rd->num_l1)
+            break;
+
+        b = j / L1_PER_L0;
+        entry = rd->l1l2[j];
+        if (j + 1 == rd->num_l1)
+            next_abs = rd->ones;
+        else if ((j + 1) % L1_PER_L0 == 0)
+            next_abs = rd->l0[b + 1];
+        else
+            next_abs = rd->l0[b] - base + l1_count(rd->l1l2[j + 1]);
+        old_total = next_abs - (rd->l0[b] - base + l1_count(entry));
+        rd->l1l2[j] = l2_fields(bv->data, nwords, j, &new_total) | (l1_count(entry) + delta - base);
+        delta += (int64_t)new_total - (int64_t)old_total;
+        rd->dirty[j >> LOG_WORD_SIZE] &= ~(BIT << (j & (WORD_SIZE - 1)));
+        rd->num_dirty--;
+        j++;
+    }
+    rd->ones += delta;
+}
+
+static inline void sync_rank(bitvector *bv)
+{
+    if (bv->rank != NULL && bv->rank->num_dirty > 0)
+        repair_rank(bv);
+}
+
+void bv_sync_rank(bitvector *bv)
+{
+    BV_CHECK_NONNULL(bv);
+    sync_rank(bv);
+    if (bv->select != NULL && bv->select->stale)
+        bv_build_select(bv);
+}
+
+void bv_set_rank_policy(bitvector *bv, bv_rank_policy policy)
+{
+    BV_CHECK_NONNULL(bv);
+    bv_sync_rank(bv);
+    bv->rank_policy = policy;
+}
+
+static void mark_dirty(rank_directory *rd, uint64_t j0, uint64_t j1)
+{
+    /** mark the L1 blocks j0..j1 (inclusive) dirty, a word of the bitmap at a time **/
+
+    uint64_t w, mask, w1 = j1 >> LOG_WORD_SIZE;
+
+    if (rd->dirty == NULL)
+    {
+        rd->dirty = calloc((rd->num_l1 + WORD_SIZE - 1) >> LOG_WORD_SIZE, sizeof(uint64_t));
+        if (rd->dirty == NULL)
+        {
+            BV_REPORT_ERROR_AND_EXIT(rd->dirty == NULL, __FILE__, __PRETTY_FUNCTION__, __LINE__,
+                                     "could not allocate dirty blocks");
+        }
+    }
+    rd->dirty_from = (rd->num_dirty == 0 || j0 < rd->dirty_from) ? j0 : rd->dirty_from;
+    for (w = j0 >> LOG_WORD_SIZE; w <= w1; w++)
+    {
+        mask = ALL_ONES_MASK;
+        if (w == j0 >> LOG_WORD_SIZE)
+            mask &= ALL_ONES_MASK << (j0 & (WORD_SIZE - 1));
+        if (w == w1)
+            mask &= ALL_ONES_MASK >> (WORD_SIZE - 1 - (j1 & (WORD_SIZE - 1)));
+        rd->num_dirty += popcnt(mask & ~rd->dirty[w]);
+        rd->dirty[w] |= mask;
+    }
+}
+
+void bv_rank_update(bitvector *bv, uint64_t pos, bool bit)
+{
+    /** mark the L1 block dirty under BV_RANK_LAZY, otherwise add the change to every counter covering pos **/
+
+    rank_directory *rd = bv->rank;
+    uint64_t i, j = pos >> LOG_L1_BLOCK_SIZE, k = (pos >> LOG_BASIC_BLOCK_SIZE) & 3, end, delta;
+
+    if (rd == NULL)
+        return;
+    if (bv->rank_policy == BV_RANK_SNAPSHOT)
+    {
+        rd->stale = true;
+        return;
+    }
+    if (bv->select != NULL)
+        bv->select->stale = true;
+
+    if (bv->rank_policy == BV_RANK_LAZY)
+    {
+        mark_dirty(rd, j, j);
+        return;
+    }
+
+    /* adding the two's complement of 1 decrements without borrowing: every counter covering a cleared bit is >= 1 */
+    delta = bit ? 1 : (uint64_t)-1;
+    if (k < 3)
+        rd->l1l2[j] += delta << (32 + L2_FIELD_WIDTH * k);
+    end = (j / L1_PER_L0 + 1) * L1_PER_L0;
+    end = (end < rd->num_l1) ? end : rd->num_l1;
+    for (i = j + 1; i < end; i++)
+        rd->l1l2[i] += delta;
+    for (i = j / L1_PER_L0 + 1; i < rd->num_l0; i++)
+        rd->l0[i] += delta;
+    rd->ones += delta;
+}
+
+void bv_rank_update_range(bitvector *bv, uint64_t from, uint64_t to)
+{
+    /** mark every L1 block overlapping [from, to) dirty; eager repairs them right away in one pass **/
+
+    rank_directory *rd = bv->rank;
+
+    if (rd == NULL || from >= to)
+        return;
+    if (bv->rank_policy == BV_RANK_SNAPSHOT)
+    {
+        rd->stale = true;
+        return;
+    }
+    if (bv->select != NULL)
+        bv->select->stale = true;
+
+    mark_dirty(rd, from >> LOG_L1_BLOCK_SIZE, (to - 1) >> LOG_L1_BLOCK_SIZE);
+    if (bv->rank_policy == BV_RANK_EAGER)
+        repair_rank(bv);
+}
+
+/**
+ * @brief Find the kth (0-indexed) `bit` at or after word data[from] among the first `size` bits, or -1 if there
+ * are no more than k of them
+ *
+ * The words normally hold the bit, as the directory says. The bound is what keeps a directory that disagrees with
+ * the data, e.g. the unvalidated L1/L2 entries of a corrupted file, from reading or answering past the vector.
+ */
+static inline int64_t select_words(const uint64_t *data, uint64_t from, uint64_t size, uint64_t k, bool bit)
+{
+    uint64_t count, word, pos, end = (size + WORD_SIZE - 1) >> LOG_WORD_SIZE;
+
+    for (; from < end; from++)
+    {
+        word = bit ? data[from] : ~data[from];
+        if ((count = popcnt(word)) > k)
+        {
+            pos = (from << LOG_WORD_SIZE) + word_select(word, k);
+            return (pos < size) ? (int64_t)pos : -1;
+        }
+        k -= count;
+    }
+    return -1;
+}
+
+static int64_t select_bit(bitvector *bv, uint64_t k, bool bit)
+{
+    /** find the position of the k'th `bit` **/
+
+    uint64_t r, s, lo, hi, mid, b, count, entry, total, num_samples;
+    uint32_t *samples;
+    rank_directory *rd;
+
+    if (k == 0)
+        return -1;
+    bv_sync_rank(bv);
+    r = k - 1;
+
+    total = bit ? bv_rank(bv, bv_len(bv)) : bv_len(bv) - bv_rank(bv, bv_len(bv));
+    if (r >= total)
+        return -1;
+    if (bv->rank == NULL)
+        return select_words(bv->data, 0, bv_len(bv), r, bit);
+
+    /* the L1 block holding the bit lies between two consecutive samples, or anywhere without samples */
+    rd = bv->rank;
+    samples = (bv->select == NULL) ? NULL : (bit ? bv->select->samples : bv->select->samples0);
+    num_samples = (bv->select == NULL) ? 0 : (bit ? bv->select->num_samples : bv->select->num_samples0);
+    s = r >> LOG_SELECT_SAMPLE_RATE;
+    lo = (samples == NULL) ? 0 : samples[s];
+    hi = (samples != NULL && s + 1 < num_samples) ? samples[s + 1] : rd->num_l1 - 1;
+    while (lo < hi)
+    {
+        mid = lo + ((hi - lo + 1) >> 1);
+        if (l1_rank_bit(rd, mid, bit) <= r)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+
+    r -= l1_rank_bit(rd, lo, bit);
+    entry = rd->l1l2[lo];
+    for (b = 0; b < 3; b++)
+    {
+        count = bit ? l2_count(entry, b) : (BIT << LOG_BASIC_BLOCK_SIZE) - l2_count(entry, b);
+        if (r < count)
+            break;
+        r -= count;
+    }
+    return select_words(bv->data, lo * WORDS_PER_L1_BLOCK + b * WORDS_PER_BASIC_BLOCK, bv_len(bv), r, bit);
+}
+
+int64_t bv_select(bitvector *bv, uint64_t k)
+{
+    return select_bit(bv, k, true);
+}
+
+int64_t bv_select0(bitvector *bv, uint64_t k)
+{
+    return select_bit(bv, k, false);
+}
+
+static inline bool rank_is_current(const bitvector *bv)
+{
+    /** pending BV_RANK_LAZY repairs are applied by the queries themselves **/
+
+    return bv->rank != NULL && !bv->rank->stale;
+}
+
+int64_t bv_next_set(bitvector *bv, uint64_t pos)
+{
+    /** scan to the end of the L1 block holding pos, then let select find the next one past it if rank is current **/
+
+    uint64_t w, end, word, rank;
+
+    BV_CHECK_NONNULL(bv);
+    if (pos >= bv_len(bv))
+        return -1;
+
+    w = pos >> LOG_WORD_SIZE;
+    word = bv->data[w] & (ALL_ONES_MASK << (pos & (WORD_SIZE - 1)));
+    end = ((pos >> LOG_L1_BLOCK_SIZE) + 1) * WORDS_PER_L1_BLOCK;
+    end = (end < bv_num_words(bv)) ? end : bv_num_words(bv);
+    for (;;)
+    {
+        if (word != 0)
+            return (int64_t)((w << LOG_WORD_SIZE) + __builtin_ctzll(word));
+        if (++w >= bv_num_words(bv))
+            return -1;
+        if (w >= end && rank_is_current(bv))
+        {
+            rank = bv_rank(bv, w << LOG_WORD_SIZE);
+            return (rank < bv->rank->ones) ? bv_select(bv, rank + 1) : -1;
+        }
+        word = bv->data[w];
+    }
+}
+
+int64_t bv_prev_set(bitvector *bv, uint64_t pos)
+{
+    /** scan back to the start of the L1 block holding pos, then let select find the last one before it if rank is current **/
+
+    uint64_t w, start, word, rank;
+
+    BV_CHECK_NONNULL(bv);
+    if (bv_len(bv) == 0)
+        return -1;
+    if (pos >= bv_len(bv))
+        pos = bv_len(bv) - 1;
+
+    w = pos >> LOG_WORD_SIZE;
+    word = bv->data[w] & (ALL_ONES_MASK >> (WORD_SIZE - 1 - (pos & (WORD_SIZE - 1))));
+    start = (pos >> LOG_L1_BLOCK_SIZE) * WORDS_PER_L1_BLOCK;
+    for (;;)
+    {
+        if (word != 0)
+            return (int64_t)((w << LOG_WORD_SIZE) + WORD_SIZE - 1 - __builtin_clzll(word));
+        if (w-- == 0)
+            return -1;
+        if (w < start && rank_is_current(bv))
+        {
+            rank = bv_rank(bv, (w + 1) << LOG_WORD_SIZE);
+            return (rank > 0) ? bv_select(bv, rank) : -1;
+        }
+        word = bv->data[w];
+    }
+}
+
+size_t bv_decode_positions(bitvector *bv, uint64_t from, uint64_t to, uint32_t *out)
+{
+    /** mask the first and last words, and hand the whole words between them to the decode kernel **/
+
+    uint64_t first, last, head, tail;
+    uint32_t base;
+    size_t count;
+
+    BV_CHECK_NONNULL(bv);
+    if (to > bv_len(bv))
+        to = bv_len(bv);
+    if (from >= to)
+        return 0;
+
+    first = from >> LOG_WORD_SIZE;
+    last = (to - 1) >> LOG_WORD_SIZE;
+    head = ALL_ONES_MASK << (from & (WORD_SIZE - 1));
+    tail = ALL_ONES_MASK >> ((WORD_SIZE - (to & (WORD_SIZE - 1))) & (WORD_SIZE - 1));
+    /* the offset of bit 0 of the first word, wrapping below zero when from is not word-aligned */
+    base = (uint32_t)((first << LOG_WORD_SIZE) - from);
+
+    if (first == last)
+        return words_decode(out, (uint64_t[]){bv->data[first] & head & tail}, 1, base);
+
+    count = words_decode(out, (uint64_t[]){bv->data[first] & head}, 1, base);
+    count += words_decode(out + count, bv->data + first + 1, last - first - 1, base + WORD_SIZE);
+    count += words_decode(out + count, (uint64_t[]){bv->data[last] & tail}, 1,
+                          base + (uint32_t)((last - first) << LOG_WORD_SIZE));
+    return count;
+}
+
+uint64_t bv_rank(bitvector *bv, uint64_t pos)
+{
+    /** number of ones in bv[:pos] **/
+
+    uint64_t entry, card, k, word_index, remainder;
+
+    if (pos > bv_len(bv))
+        pos = bv_len(bv);
+    sync_rank(bv);
+
+    word_index = pos >> LOG_WORD_SIZE;
+    remainder = pos % WORD_SIZE;
+
+    if (bv->rank == NULL)
+    {
+        card = popcnt_words(bv->data, 0, word_index);
+    }
+    else
+    {
+        entry = bv->rank->l1l2[pos >> LOG_L1_BLOCK_SIZE];
+        card = bv->rank->l0[pos >> LOG_L0_BLOCK_SIZE] + l1_count(entry);
+        for (k = 0; k < ((pos >> LOG_BASIC_BLOCK_SIZE) & 3); k++)
+            card += l2_count(entry, k);
+        card += popcnt_words(bv->data, (pos >> LOG_BASIC_BLOCK_SIZE) * WORDS_PER_BASIC_BLOCK, word_index);
+    }
+
+    if (remainder > 0)
+        card += popcnt(bv->data[word_index] & ~(ALL_ONES_MASK << remainder));
+    return card;
+}
+
+uint64_t bv_rank_range(bitvector *bv, uint64_t from, uint64_t to)
+{
+    /** number of ones in bv[from:to] **/
+
+    if (to > bv_len(bv))
+        to = bv_len(bv);
+    if (from >= to)
+        return 0;
+    return bv_rank(bv, to) - bv_rank(bv, from);
+}
+
+typedef struct
+{
+    bitvector *bv;
+    const uint64_t *queries;
+    const uint64_t *order; // the order in which to evaluate the queries, NULL for 0, 1, ..., n - 1
+    void *out;             // uint64_t * for ranks, int64_t * for selects
+} batch_job;
+
+#define RADIX_BITS (11UL)
+#define RADIX_BUCKETS (BIT << RADIX_BITS)
+
+static uint64_t *batch_order(const uint64_t *queries, size_t n, uint64_t shift)
+{
+    /**
+     * The permutation that sorts the queries by query >> shift, enough to make consecutive queries touch
+     * the same or neighbouring directory entries. An LSD radix sort over only the significant bits of the key.
+     **/
+
+    uint64_t *order = malloc(n * sizeof(uint64_t));
+    uint64_t *scratch = malloc(n * sizeof(uint64_t));
+    uint64_t *counts = malloc(RADIX_BUCKETS * sizeof(uint64_t));
+    uint64_t *tmp, max_key = 0, pass, i, sum, c, bucket;
+
+    if (order == NULL || scratch == NULL || counts == NULL)
+    {
+        BV_REPORT_ERROR_AND_EXIT(order == NULL, __FILE__, __PRETTY_FUNCTION__, __LINE__, "could not allocate batch order");
+    }
+    for (i = 0; i < n; i++)
+    {
+        order[i] = i;
+        if ((queries[i] >> shift) > max_key)
+            max_key = queries[i] >> shift;
+    }
+
+    for (pass = 0; pass < WORD_SIZE && (max_key >> pass) > 0; pass += RADIX_BITS)
+    {
+        memset(counts, 0, RADIX_BUCKETS * sizeof(uint64_t));
+        for (i = 0; i < n; i++)
+            counts[((queries[order[i]] >> shift) >> pass) & (RADIX_BUCKETS - 1)]++;
+        for (bucket = 0, sum = 0; bucket < RADIX_BUCKETS; bucket++)
+        {
+            c = counts[bucket];
+            counts[bucket] = sum;
+            sum += c;
+        }
+        for (i = 0; i < n; i++)
+            scratch[counts[((queries[order[i]] >> shift) >> pass) & (RADIX_BUCKETS - 1)]++] = order[i];
+        tmp = order;
+        order = scratch;
+        scratch = tmp;
+    }
+    free(scratch);
+    free(counts);
+    return order;
+}
+
+static inline uint64_t batch_index(batch_job *job, size_t i)
+{
+    return (job->order == NULL) ? i : job->order[i];
+}
+
+static inline void prefetch_rank(bitvector *bv, uint64_t pos)
+{
+    /** the L1/L2 entry, the start of the basic block and the last word that bv_rank reads **/
+
+    if (pos > bv_len(bv))
+        pos = bv_len(bv);
+    __builtin_prefetch(&bv->rank->l1l2[pos >> LOG_L1_BLOCK_SIZE]);
+    __builtin_prefetch(&bv->data[(pos >> LOG_BASIC_BLOCK_SIZE) * WORDS_PER_BASIC_BLOCK]);
+    __builtin_prefetch(&bv->data[pos >> LOG_WORD_SIZE]);
+}
+
+static void rank_batch_task(void *arg, size_t begin, size_t end)
+{
+    batch_job *job = arg;
+    uint64_t *out = job->out;
+    size_t i, q;
+
+    for (i = begin; i < begin + BATCH_PREFETCH_DISTANCE && i < end; i++)
+        prefetch_rank(job->bv, job->queries[batch_index(job, i)]);
+    for (i = begin; i < end; i++)
+    {
+        if (i + BATCH_PREFETCH_DISTANCE < end)
+            prefetch_rank(job->bv, job->queries[batch_index(job, i + BATCH_PREFETCH_DISTANCE)]);
+        q = batch_index(job, i);
+        out[q] = bv_rank(job->bv, job->queries[q]);
+    }
+}
+
+typedef struct
+{
+    uint64_t index; // where the answer goes
+    uint64_t r;     // the number of ones still to skip
+    uint64_t lo, hi; // the L1 blocks to search, then lo is the word to start scanning from
+} select_state;
+
+static void select_batch_task(void *arg, size_t begin, size_t end)
+{
+    /**
+     * Resolve the queries SELECT_GROUP at a time in stages: look up the samples, binary search the L1 entries,
+     * walk the L2 counts, then scan the words. Each stage prefetches what the next stage reads for every query
+     * of the group, so the dependent misses of one query overlap with those of the others.
+     **/
+
+    batch_job *job = arg;
+    bitvector *bv = job->bv;
+    rank_directory *rd = bv->rank;
+    select_directory *sd = bv->select;
+    int64_t *out = job->out;
+    select_state group[SELECT_GROUP];
+    uint64_t k, s, mid, b, count, entry;
+    size_t g, i, m;
+
+    for (g = begin; g < end; g += SELECT_GROUP)
+    {
+        /* the samples */
+        for (i = 0, m = 0; i < SELECT_GROUP && g + i < end; i++)
+        {
+            group[m].index = batch_index(job, g + i);
+            k = job->queries[group[m].index];
+            if (k == 0 || k > rd->ones)
+            {
+                out[group[m].index] = -1;
+                continue;
+            }
+            group[m].r = k - 1;
+            __builtin_prefetch(&sd->samples[group[m].r >> LOG_SELECT_SAMPLE_RATE]);
+            m++;
+        }
+        /* the L1 range between two samples */
+        for (i = 0; i < m; i++)
+        {
+            s = group[i].r >> LOG_SELECT_SAMPLE_RATE;
+            group[i].lo = sd->samples[s];
+            group[i].hi = (s + 1 < sd->num_samples) ? sd->samples[s + 1] : rd->num_l1 - 1;
+            __builtin_prefetch(&rd->l1l2[group[i].lo]);
+            __builtin_prefetch(&rd->l0[group[i].lo / L1_PER_L0]);
+        }
+        /* the L1 block and basic block, then the first word to scan */
+        for (i = 0; i < m; i++)
+        {
+            while (group[i].lo < group[i].hi)
+            {
+                mid = group[i].lo + ((group[i].hi - group[i].lo + 1) >> 1);
+                if (l1_rank(rd, mid) <= group[i].r)
+                    group[i].lo = mid;
+                else
+                    group[i].hi = mid - 1;
+            }
+            group[i].r -= l1_rank(rd, group[i].lo);
+            entry = rd->l1l2[group[i].lo];
+            for (b = 0; b < 3; b++)
+            {
+                count = l2_count(entry, b);
+                if (group[i].r < count)
+                    break;
+                group[i].r -= count;
+            }
+            group[i].lo = group[i].lo * WORDS_PER_L1_BLOCK + b * WORDS_PER_BASIC_BLOCK;
+            __builtin_prefetch(&bv->data[group[i].lo]);
+            __builtin_prefetch(&bv->data[group[i].lo + WORDS_PER_BASIC_BLOCK - 1]);
+        }
+        /* the words */
+        for (i = 0; i < m; i++)
+            out[group[i].index] = select_words(bv->data, group[i].lo, bv_len(bv), group[i].r, true);
+    }
+}
+
+static void batch_run(bitvector *bv, const uint64_t *queries, void *out, size_t n, unsigned flags, bv_task task,
+                      uint64_t sort_shift)
+{
+    batch_job job = {bv, queries, NULL, out};
+
+    if (n == 0)
+        return;
+    BV_CHECK_NONNULL(queries);
+    BV_CHECK_NONNULL(out);
+
+    if (flags & BV_BATCH_SORT)
+        job.order = batch_order(queries, n, sort_shift);
+    if (flags & BV_BATCH_SERIAL)
+        task(&job, 0, n);
+    else
+        bv_parallel_for(n, BATCH_GRAIN, task, &job);
+    free((void *)job.order);
+}
+
+void bv_rank_batch(bitvector *bv, const uint64_t *positions, uint64_t *out, size_t n, unsigned flags)
+{
+    BV_CHECK_NONNULL(bv);
+    if (bv->rank == NULL)
+        bv_build_rank(bv);
+    sync_rank(bv);
+    batch_run(bv, positions, out, n, flags, rank_batch_task, LOG_L1_BLOCK_SIZE);
+}
+
+void bv_select_batch(bitvector *bv, const uint64_t *ks, int64_t *out, size_t n, unsigned flags)
+{
+    BV_CHECK_NONNULL(bv);
+    if (bv->select == NULL)
+        bv_build_select(bv);
+    bv_sync_rank(bv);
+    batch_run(bv, ks, out, n, flags, select_batch_task, LOG_SELECT_SAMPLE_RATE);
+}
+
+size_t bv_index_bytes(bitvector *bv)
+{
+    size_t bytes = 0;
+
+    if (bv->rank != NULL)
+        bytes += sizeof(rank_directory) + (bv->rank->num_l0 + bv->rank->num_l1) * sizeof(uint64_t);
+    if (bv->rank != NULL && bv->rank->dirty != NULL)
+        bytes += ((bv->rank->num_l1 + WORD_SIZE - 1) >> LOG_WORD_SIZE) * sizeof(uint64_t);
+    if (bv->select != NULL)
+        bytes += sizeof(select_directory) + (bv->select->num_samples + bv->select->num_samples0 + 2) * sizeof(uint32_t);
+    return bytes;
+}
@@ -0,0 +1,829 @@
+#include "roaring.h"
+#include "word_kernels.h"
+#include "word_ops.h"
+#include <stdio.h>
+#include <string.h>
+
+#define RB_CHUNK_MASK (RB_CHUNK_BITS - 1)
+
+typedef enum
+{
+    OP_AND,
+    OP_OR,
+    OP_XOR,
+    OP_ANDNOT
+} rb_op;
+
+typedef void (*binary_kernel)(uint64_t *, const uint64_t *, const uint64_t *, size_t);
+
+static const binary_kernel op_kernels[] = {
+    [OP_AND] = words_and, [OP_OR] = words_or, [OP_XOR] = words_xor, [OP_ANDNOT] = words_andnot};
+
+static inline uint64_t min(uint64_t a, uint64_t b)
+{
+    return (a < b) ? a : b;
+}
+
+static inline uint64_t max(uint64_t a, uint64_t b)
+{
+    return (a > b) ? a : b;
+}
+
+static void *rb_malloc(size_t bytes)
+{
+    void *p = malloc(bytes ? bytes : 1);
+    if (p == NULL)
+    {
+        BV_REPORT_ERROR_AND_EXIT(p == NULL, __FILE__, __PRETTY_FUNCTION__, __LINE__, "could not allocate %zu bytes",
+                                 bytes);
+    }
+    return p;
+}
+
+static void *rb_realloc(void *p, size_t bytes)
+{
+    void *q = realloc(p, bytes ? bytes : 1);
+    if (q == NULL)
+    {
+        BV_REPORT_ERROR_AND_EXIT(q == NULL, __FILE__, __PRETTY_FUNCTION__, __LINE__, "could not reallocate %zu bytes",
+                                 bytes);
+    }
+    return q;
+}
+
+/* ------------------------------------------------ word helpers ------------------------------------------------ */
+
+static inline bool words_test(const uint64_t *words, uint64_t v)
+{
+    return (words[v >> LOG_WORD_SIZE] >> (v & (WORD_SIZE - 1))) & BIT;
+}
+
+static inline void words_set(uint64_t *words, uint64_t v)
+{
+    words[v >> LOG_WORD_SIZE] |= BIT << (v & (WORD_SIZE - 1));
+}
+
+static void words_set_range(uint64_t *words, uint64_t from, uint64_t to)
+{
+    /** set the bits [from, to), to > from **/
+
+    uint64_t i = from >> LOG_WORD_SIZE, j = (to - 1) >> LOG_WORD_SIZE, k;
+    uint64_t first = ALL_ONES_MASK << (from & (WORD_SIZE - 1));
+    uint64_t last = ALL_ONES_MASK >> ((WORD_SIZE - 1) - ((to - 1) & (WORD_SIZE - 1)));
+
+    if (i == j)
+    {
+        words[i] |= first & last;
+        return;
+    }
+    words[i] |= first;
+    for (k = i + 1; k < j; k++)
+        words[k] = ALL_ONES_MASK;
+    words[j] |= last;
+}
+
+static inline uint64_t words_next(const uint64_t *words, uint64_t from, bool set)
+{
+    /** the first bit >= from equal to `set`, or RB_CHUNK_BITS **/
+
+    uint64_t i = from >> LOG_WORD_SIZE, w;
+
+    if (from >= RB_CHUNK_BITS)
+        return RB_CHUNK_BITS;
+    w = (set ? words[i] : ~words[i]) & (ALL_ONES_MASK << (from & (WORD_SIZE - 1)));
+    while (w == 0)
+    {
+        if (++i == RB_CHUNK_WORDS)
+            return RB_CHUNK_BITS;
+        w = set ? words[i] : ~words[i];
+    }
+    return (i << LOG_WORD_SIZE) + __builtin_ctzll(w);
+}
+
+static uint64_t words_count_runs(const uint64_t *words)
+{
+    /** a run starts at every set bit whose predecessor is clear **/
+
+    uint64_t i, runs = 0, carry = 0;
+
+    for (i = 0; i < RB_CHUNK_WORDS; i++)
+    {
+        runs += popcnt(words[i] & ~((words[i] << 1) | carry));
+        carry = words[i] >> (WORD_SIZE - 1);
+    }
+    return runs;
+}
+
+/* ---------------------------------------------- container basics ---------------------------------------------- */
+
+static void container_free(rb_container *c)
+{
+    free(c->values);
+    c->values = NULL;
+}
+
+static size_t container_bytes(const rb_container *c)
+{
+    switch (c->type)
+    {
+    case RB_ARRAY:
+        return c->capacity * sizeof(uint16_t);
+    case RB_RUN:
+        return c->capacity * sizeof(rb_run);
+    default:
+        return RB_CHUNK_WORDS * sizeof(uint64_t);
+    }
+}
+
+static void container_copy(const rb_container *src, rb_container *dst)
+{
+    size_t bytes;
+
+    *dst = *src;
+    if (src->type == RB_BITMAP)
+        bytes = RB_CHUNK_WORDS * sizeof(uint64_t);
+    else
+    {
+        dst->capacity = src->n;
+        bytes = (src->type == RB_ARRAY) ? src->n * sizeof(uint16_t) : src->n * sizeof(rb_run);
+    }
+    dst->values = rb_malloc(bytes);
+    memcpy(dst->values, src->values, bytes);
+}
+
+static void container_adopt_words(uint64_t *words, uint64_t cardinality, rb_container *c)
+{
+    /** pick the smallest of the three representations for a malloc'ed bitmap, keeping the buffer if it stays a bitmap **/
+
+    uint64_t runs = words_count_runs(words), i, w, pos, start;
+    uint64_t array_bytes = (cardinality <= RB_ARRAY_MAX_CARDINALITY) ? cardinality * sizeof(uint16_t) : UINT64_MAX;
+    uint64_t bitmap_bytes = RB_CHUNK_WORDS * sizeof(uint64_t);
+    uint32_t n = 0;
+
+    c->cardinality = cardinality;
+    if (runs * sizeof(rb_run) < array_bytes && runs * sizeof(rb_run) < bitmap_bytes)
+    {
+        c->type = RB_RUN;
+        c->n = c->capacity = runs;
+        c->runs = rb_malloc(runs * sizeof(rb_run));
+        for (pos = 0; (start = words_next(words, pos, true)) < RB_CHUNK_BITS; n++)
+        {
+            pos = words_next(words, start, false);
+            c->runs[n] = (rb_run){.start = start, .length = pos - start - 1};
+        }
+        free(words);
+    }
+    else if (cardinality <= RB_ARRAY_MAX_CARDINALITY)
+    {
+        c->type = RB_ARRAY;
+        c->n = c->capacity = cardinality;
+        c->values = rb_malloc(cardinality * sizeof(uint16_t));
+        for (i = 0; i < RB_CHUNK_WORDS; i++)
+            for (w = words[i]; w; w &= w - 1)
+                c->values[n++] = (i << LOG_WORD_SIZE) + __builtin_ctzll(w);
+        free(words);
+    }
+    else
+    {
+        c->type = RB_BITMAP;
+        c->n = c->capacity = 0;
+        c->words = words;
+    }
+}
+
+static void container_from_words(const uint64_t *words, uint64_t cardinality, rb_container *c)
+{
+    uint64_t *copy = rb_malloc(RB_CHUNK_WORDS * sizeof(uint64_t));
+
+    memcpy(copy, words, RB_CHUNK_WORDS * sizeof(uint64_t));
+    container_adopt_words(copy, cardinality, c);
+}
+
+static void container_from_values(const uint16_t *values, uint64_t n, rb_container *c)
+{
+    /** values are sorted and n <= RB_ARRAY_MAX_CARDINALITY, so the choice is between an array and runs **/
+
+    uint64_t i, runs = (n > 0), r;
+
+    for (i = 1; i < n; i++)
+        runs += (values[i] != values[i - 1] + 1);
+
+    c->cardinality = n;
+    if (runs * sizeof(rb_run) < n * sizeof(uint16_t))
+    {
+        c->type = RB_RUN;
+        c->n = c->capacity = runs;
+        c->runs = rb_malloc(runs * sizeof(rb_run));
+        for (i = 0, r = 0; i < n; i++)
+        {
+            if (i > 0 && values[i] == values[i - 1] + 1)
+                c->runs[r - 1].length++;
+            else
+                c->runs[r++] = (rb_run){.start = values[i], .length = 0};
+        }
+    }
+    else
+    {
+        c->type = RB_ARRAY;
+        c->n = c->capacity = n;
+        c->values = rb_malloc(n * sizeof(uint16_t));
+        memcpy(c->values, values, n * sizeof(uint16_t));
+    }
+}
+
+static const uint64_t *container_words(const rb_container *c, uint64_t *buffer)
+{
+    /** the bitmap of a container, materialized into `buffer` unless it already is one **/
+
+    uint32_t i;
+
+    if (c->type == RB_BITMAP)
+        return c->words;
+    memset(buffer, 0, RB_CHUNK_WORDS * sizeof(uint64_t));
+    if (c->type == RB_ARRAY)
+    {
+        for (i = 0; i < c->n; i++)
+            words_set(buffer, c->values[i]);
+    }
+    else
+    {
+        for (i = 0; i < c->n; i++)
+            words_set_range(buffer, c->runs[i].start, (uint64_t)c->runs[i].start + c->runs[i].length + 1);
+    }
+    return buffer;
+}
+
+static uint32_t lower_bound16(const uint16_t *values, uint32_t n, uint16_t v)
+{
+    uint32_t lo = 0, hi = n, mid;
+
+    while (lo < hi)
+    {
+        mid = lo + (hi - lo) / 2;
+        if (values[mid] < v)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static int64_t run_index(const rb_container *c, uint16_t v)
+{
+    /** the index of the last run starting at or before v, -1 if none **/
+
+    int64_t lo = 0, hi = (int64_t)c->n - 1, mid, found = -1;
+
+    while (lo <= hi)
+    {
+        mid = lo + (hi - lo) / 2;
+        if (c->runs[mid].start <= v)
+        {
+            found = mid;
+            lo = mid + 1;
+        }
+        else
+            hi = mid - 1;
+    }
+    return found;
+}
+
+static bool container_contains(const rb_container *c, uint16_t v)
+{
+    uint32_t i;
+    int64_t r;
+
+    switch (c->type)
+    {
+    case RB_ARRAY:
+        i = lower_bound16(c->values, c->n, v);
+        return i < c->n && c->values[i] == v;
+    case RB_RUN:
+        r = run_index(c, v);
+        return r >= 0 && v <= (uint64_t)c->runs[r].start + c->runs[r].length;
+    default:
+        return words_test(c->words, v);
+    }
+}
+
+static uint64_t container_rank(const rb_container *c, uint64_t v)
+{
+    /** the number of values < v, 0 <= v <= RB_CHUNK_BITS **/
+
+    uint64_t rank = 0, i, w;
+
+    switch (c->type)
+    {
+    case RB_ARRAY:
+        return (v >= RB_CHUNK_BITS) ? c->n : lower_bound16(c->values, c->n, v);
+    case RB_RUN:
+        for (i = 0; i < c->n && c->runs[i].start < v; i++)
+            rank += min((uint64_t)c->runs[i].length + 1, v - c->runs[i].start);
+        return rank;
+    default:
+        w = v >> LOG_WORD_SIZE;
+        rank = popcnt_words(c->words, 0, w);
+        if (v & (WORD_SIZE - 1))
+            rank += popcnt(c->words[w] & ((BIT << (v & (WORD_SIZE - 1))) - 1));
+        return rank;
+    }
+}
+
+static uint64_t container_select(const rb_container *c, uint64_t k)
+{
+    /** the kth (0-indexed) value, k < c->cardinality **/
+
+    uint64_t i, count;
+
+    switch (c->type)
+    {
+    case RB_ARRAY:
+        return c->values[k];
+    case RB_RUN:
+        for (i = 0; k > c->runs[i].length; i++)
+            k -= (uint64_t)c->runs[i].length + 1;
+        return c->runs[i].start + k;
+    default:
+        for (i = 0; k >= (count = popcnt(c->words[i])); i++)
+            k -= count;
+        return (i << LOG_WORD_SIZE) + word_select(c->words[i], k);
+    }
+}
+
+static void container_runs_to_bitmap(rb_container *c)
+{
+    uint64_t *words = rb_malloc(RB_CHUNK_WORDS * sizeof(uint64_t));
+    uint32_t r;
+
+    memset(words, 0, RB_CHUNK_WORDS * sizeof(uint64_t));
+    for (r = 0; r < c->n; r++)
+        words_set_range(words, c->runs[r].start, (uint64_t)c->runs[r].start + c->runs[r].length + 1);
+    free(c->runs);
+    *c = (rb_container){.type = RB_BITMAP, .cardinality = c->cardinality, .words = words};
+}
+
+static bool container_add(rb_container *c, uint16_t v)
+{
+    /**
+     * insert v, returns false if v was already present. A full array and a run container that would outgrow
+     * a bitmap become bitmaps
+     **/
+
+    uint32_t i;
+    int64_t r;
+    uint64_t *words;
+    bool extends_prev, extends_next;
+
+    switch (c->type)
+    {
+    case RB_ARRAY:
+        i = lower_bound16(c->values, c->n, v);
+        if (i < c->n && c->values[i] == v)
+            return false;
+        if (c->n == RB_ARRAY_MAX_CARDINALITY)
+        {
+            words = calloc(RB_CHUNK_WORDS, sizeof(uint64_t));
+            if (words == NULL)
+            {
+                BV_REPORT_ERROR_AND_EXIT(words == NULL, __FILE__, __PRETTY_FUNCTION__, __LINE__,
+                                         "could not allocate bitmap container");
+            }
+            for (i = 0; i < c->n; i++)
+                words_set(words, c->values[i]);
+            words_set(words, v);
+            free(c->values);
+            *c = (rb_container){.type = RB_BITMAP, .cardinality = c->cardinality + 1, .words = words};
+            return true;
+        }
+        if (c->n == c->capacity)
+        {
+            c->capacity = min(max(2 * c->capacity, 4U), RB_ARRAY_MAX_CARDINALITY);
+            c->values = rb_realloc(c->values, c->capacity * sizeof(uint16_t));
+        }
+        memmove(c->values + i + 1, c->values + i, (c->n - i) * sizeof(uint16_t));
+        c->values[i] = v;
+        c->n++;
+        break;
+    case RB_RUN:
+        r = run_index(c, v);
+        if (r >= 0 && v <= (uint64_t)c->runs[r].start + c->runs[r].length)
+            return false;
+        extends_prev = r >= 0 && (uint64_t)c->runs[r].start + c->runs[r].length + 1 == v;
+        extends_next = r + 1 < (int64_t)c->n && c->runs[r + 1].start == (uint64_t)v + 1;
+        if (extends_prev && extends_next)
+        {
+            c->runs[r].length += c->runs[r + 1].length + 2;
+            memmove(c->runs + r + 1, c->runs + r + 2, (c->n - r - 2) * sizeof(rb_run));
+            c->n--;
+        }
+        else if (extends_prev)
+            c->runs[r].length++;
+        else if (extends_next)
+        {
+            c->runs[r + 1].start--;
+            c->runs[r + 1].length++;
+        }
+        else if ((c->n + 1) * sizeof(rb_run) > RB_CHUNK_WORDS * sizeof(uint64_t))
+        {
+            container_runs_to_bitmap(c);
+            words_set(c->words, v);
+        }
+        else
+        {
+            if (c->n == c->capacity)
+            {
+                c->capacity = max(2 * c->capacity, 4U);
+                c->runs = rb_realloc(c->runs, c->capacity * sizeof(rb_run));
+            }
+            memmove(c->runs + r + 2, c->runs + r + 1, (c->n - r - 1) * sizeof(rb_run));
+            c->runs[r + 1] = (rb_run){.start = v, .length = 0};
+            c->n++;
+        }
+        break;
+    default:
+        if (words_test(c->words, v))
+            return false;
+        words_set(c->words, v);
+        break;
+    }
+    c->cardinality++;
+    return true;
+}
+
+/* ---------------------------------------------- container algebra ---------------------------------------------- */
+
+static void merge_arrays(const rb_container *a, const rb_container *b, rb_op op, rb_container *out)
+{
+    uint16_t merged[2 * RB_ARRAY_MAX_CARDINALITY];
+    uint64_t words[RB_CHUNK_WORDS];
+    uint32_t i = 0, j = 0, n = 0;
+
+    while (i < a->n && j < b->n)
+    {
+        if (a->values[i] == b->values[j])
+        {
+            if (op == OP_AND || op == OP_OR)
+                merged[n++] = a->values[i];
+            i++;
+            j++;
+        }
+        else if (a->values[i] < b->values[j])
+        {
+            if (op != OP_AND)
+                merged[n++] = a->values[i];
+            i++;
+        }
+        else
+        {
+            if (op == OP_OR || op == OP_XOR)
+                merged[n++] = b->values[j];
+            j++;
+        }
+    }
+    if (op != OP_AND)
+        for (; i < a->n; i++)
+            merged[n++] = a->values[i];
+    if (op == OP_OR || op == OP_XOR)
+        for (; j < b->n; j++)
+            merged[n++] = b->values[j];
+
+    if (n == 0)
+        out->cardinality = 0;
+    else if (n <= RB_ARRAY_MAX_CARDINALITY)
+        container_from_values(merged, n, out);
+    else
+    {
+        memset(words, 0, sizeof(words));
+        for (i = 0; i < n; i++)
+            words_set(words, merged[i]);
+        container_from_words(words, n, out);
+    }
+}
+
+static void filter_array(const rb_container *a, const rb_container *b, bool keep_members, rb_container *out)
+{
+    /** the values of array container a that are (or are not) in b **/
+
+    uint16_t kept[RB_ARRAY_MAX_CARDINALITY];
+    uint32_t i, n = 0;
+
+    for (i = 0; i < a->n; i++)
+        if (container_contains(b, a->values[i]) == keep_members)
+            kept[n++] = a->values[i];
+
+    if (n == 0)
+        out->cardinality = 0;
+    else
+        container_from_values(kept, n, out);
+}
+
+static void container_op(const rb_container *a, const rb_container *b, rb_op op, rb_container *out)
+{
+    uint64_t a_buffer[RB_CHUNK_WORDS], b_buffer[RB_CHUNK_WORDS];
+    uint64_t *result, cardinality;
+
+    if (a->type == RB_ARRAY && b->type == RB_ARRAY)
+        merge_arrays(a, b, op, out);
+    else if (a->type == RB_ARRAY && (op == OP_AND || op == OP_ANDNOT))
+        filter_array(a, b, op == OP_AND, out);
+    else if (b->type == RB_ARRAY && op == OP_AND)
+        filter_array(b, a, true, out);
+    else
+    {
+        result = rb_malloc(RB_CHUNK_WORDS * sizeof(uint64_t));
+        op_kernels[op](result, container_words(a, a_buffer), container_words(b, b_buffer), RB_CHUNK_WORDS);
+        cardinality = words_popcount(result, RB_CHUNK_WORDS);
+        if (cardinality == 0)
+        {
+            free(result);
+            out->cardinality = 0;
+        }
+        else
+            container_adopt_words(result, cardinality, out);
+    }
+}
+
+/* ------------------------------------------------- the bitmap -------------------------------------------------- */
+
+roaring_bitmap *rb_new(uint64_t size)
+{
+    roaring_bitmap *rb = rb_malloc(sizeof(roaring_bitmap));
+
+    *rb = (roaring_bitmap){.size = size, .prefix = rb_malloc(sizeof(uint64_t))};
+    rb->prefix[0] = 0;
+    return rb;
+}
+
+void rb_free(roaring_bitmap *rb)
+{
+    uint64_t i;
+
+    if (rb == NULL)
+        return;
+    for (i = 0; i < rb->num_containers; i++)
+        container_free(&rb->containers[i]);
+    free(rb->keys);
+    free(rb->containers);
+    free(rb->prefix);
+    free(rb);
+}
+
+static void rb_reserve(roaring_bitmap *rb, uint64_t n)
+{
+    if (n <= rb->capacity)
+        return;
+    rb->capacity = max(n, 2 * rb->capacity);
+    rb->keys = rb_realloc(rb->keys, rb->capacity * sizeof(uint64_t));
+    rb->containers = rb_realloc(rb->containers, rb->capacity * sizeof(rb_container));
+    rb->prefix = rb_realloc(rb->prefix, (rb->capacity + 1) * sizeof(uint64_t));
+}
+
+static void rb_append(roaring_bitmap *rb, uint64_t key, const rb_container *c)
+{
+    /** take ownership of c and place it after every other container **/
+
+    rb_reserve(rb, rb->num_containers + 1);
+    rb->keys[rb->num_containers] = key;
+    rb->containers[rb->num_containers] = *c;
+    rb->prefix[rb->num_containers + 1] = rb->prefix[rb->num_containers] + c->cardinality;
+    rb->num_containers++;
+}
+
+static uint64_t rb_find(roaring_bitmap *rb, uint64_t key)
+{
+    /** the index of the first container whose key is >= key **/
+
+    uint64_t lo = 0, hi = rb->num_containers, mid;
+
+    while (lo < hi)
+    {
+        mid = lo + (hi - lo) / 2;
+        if (rb->keys[mid] < key)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static void rb_check_index(roaring_bitmap *rb, uint64_t pos)
+{
+    BV_CHECK_NONNULL(rb);
+    if (pos >= rb->size)
+    {
+        BV_REPORT_ERROR_AND_EXIT(pos >= rb->size, __FILE__, __PRETTY_FUNCTION__, __LINE__,
+                                 "index %lu out of range [0, %lu)", pos, rb->size);
+    }
+}
+
+roaring_bitmap *rb_from_bitvector(bitvector *bv)
+{
+    roaring_bitmap *rb;
+    uint64_t chunk, num_chunks, num_words, from, count, cardinality;
+    uint64_t buffer[RB_CHUNK_WORDS];
+    const uint64_t *words;
+    rb_container c;
+
+    BV_CHECK_NONNULL(bv);
+    rb = rb_new(bv_len(bv));
+    num_words = (bv_len(bv) >> LOG_WORD_SIZE) + BIT;
+    num_chunks = (bv_len(bv) + RB_CHUNK_BITS - 1) >> RB_LOG_CHUNK_BITS;
+
+    for (chunk = 0; chunk < num_chunks; chunk++)
+    {
+        from = chunk * RB_CHUNK_WORDS;
+        count = min(RB_CHUNK_WORDS, num_words - from);
+        cardinality = words_popcount(bv->data + from, count);
+        if (cardinality == 0)
+            continue;
+
+        words = bv->data + from;
+        if (count < RB_CHUNK_WORDS)
+        {
+            memcpy(buffer, words, count * sizeof(uint64_t));
+            memset(buffer + count, 0, (RB_CHUNK_WORDS - count) * sizeof(uint64_t));
+            words = buffer;
+        }
+        container_from_words(words, cardinality, &c);
+        rb_append(rb, chunk, &c);
+    }
+    return rb;
+}
+
+bitvector *rb_to_bitvector(roaring_bitmap *rb)
+{
+    bitvector *bv;
+    uint64_t i, from, num_words;
+    uint64_t buffer[RB_CHUNK_WORDS];
+
+    BV_CHECK_NONNULL(rb);
+    bv = bv_new(rb->size);
+    num_words = (rb->size >> LOG_WORD_SIZE) + BIT;
+    for (i = 0; i < rb->num_containers; i++)
+    {
+        from = rb->keys[i] * RB_CHUNK_WORDS;
+        memcpy(bv->data + from, container_words(&rb->containers[i], buffer),
+               min(RB_CHUNK_WORDS, num_words - from) * sizeof(uint64_t));
+    }
+    return bv;
+}
+
+uint64_t rb_len(roaring_bitmap *rb)
+{
+    BV_CHECK_NONNULL(rb);
+    return rb->size;
+}
+
+uint64_t rb_count(roaring_bitmap *rb)
+{
+    BV_CHECK_NONNULL(rb);
+    return rb->prefix[rb->num_containers];
+}
+
+void rb_set(roaring_bitmap *rb, uint64_t pos)
+{
+    /** find or insert the container of pos, then shift the prefix counts after it if the bit was clear **/
+
+    uint64_t key = pos >> RB_LOG_CHUNK_BITS, i, j;
+
+    rb_check_index(rb, pos);
+    i = rb_find(rb, key);
+    if (i == rb->num_containers || rb->keys[i] != key)
+    {
+        rb_reserve(rb, rb->num_containers + 1);
+        memmove(rb->keys + i + 1, rb->keys + i, (rb->num_containers - i) * sizeof(uint64_t));
+        memmove(rb->containers + i + 1, rb->containers + i, (rb->num_containers - i) * sizeof(rb_container));
+        memmove(rb->prefix + i + 1, rb->prefix + i, (rb->num_containers - i + 1) * sizeof(uint64_t));
+        rb->keys[i] = key;
+        rb->containers[i] = (rb_container){.type = RB_ARRAY};
+        rb->num_containers++;
+    }
+    if (container_add(&rb->containers[i], pos & RB_CHUNK_MASK))
+        for (j = i + 1; j <= rb->num_containers; j++)
+            rb->prefix[j]++;
+}
+
+bool rb_isset(roaring_bitmap *rb, uint64_t pos)
+{
+    uint64_t key = pos >> RB_LOG_CHUNK_BITS, i;
+
+    rb_check_index(rb, pos);
+    i = rb_find(rb, key);
+    return i < rb->num_containers && rb->keys[i] == key && container_contains(&rb->containers[i], pos & RB_CHUNK_MASK);
+}
+
+uint64_t rb_rank(roaring_bitmap *rb, uint64_t pos)
+{
+    uint64_t key, i;
+
+    BV_CHECK_NONNULL(rb);
+    if (pos >= rb->size)
+        return rb_count(rb);
+
+    key = pos >> RB_LOG_CHUNK_BITS;
+    i = rb_find(rb, key);
+    if (i < rb->num_containers && rb->keys[i] == key)
+        return rb->prefix[i] + container_rank(&rb->containers[i], pos & RB_CHUNK_MASK);
+    return rb->prefix[i];
+}
+
+int64_t rb_select(roaring_bitmap *rb, uint64_t k)
+{
+    /** binary search the prefix counts for the container holding the kth one **/
+
+    uint64_t lo, hi, mid;
+
+    BV_CHECK_NONNULL(rb);
+    if (k == 0 || k > rb_count(rb))
+        return -1;
+
+    lo = 0;
+    hi = rb->num_containers - 1;
+    while (lo < hi)
+    {
+        mid = lo + (hi - lo + 1) / 2;
+        if (rb->prefix[mid] < k)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    return (int64_t)((rb->keys[lo] << RB_LOG_CHUNK_BITS) +
+                     container_select(&rb->containers[lo], k - rb->prefix[lo] - 1));
+}
+
+static roaring_bitmap *rb_binary_op(roaring_bitmap *a, roaring_bitmap *b, rb_op op)
+{
+    /** merge the sorted chunk keys; a chunk present in one operand only is copied if op(x, 0) == x for it **/
+
+    roaring_bitmap *rb;
+    uint64_t i = 0, j = 0;
+    rb_container c;
+
+    BV_CHECK_NONNULL(a);
+    BV_CHECK_NONNULL(b);
+    rb = rb_new(max(a->size, b->size));
+
+    while (i < a->num_containers || j < b->num_containers)
+    {
+        if (j == b->num_containers || (i < a->num_containers && a->keys[i] < b->keys[j]))
+        {
+            if (op != OP_AND)
+            {
+                container_copy(&a->containers[i], &c);
+                rb_append(rb, a->keys[i], &c);
+            }
+            i++;
+        }
+        else if (i == a->num_containers || b->keys[j] < a->keys[i])
+        {
+            if (op == OP_OR || op == OP_XOR)
+            {
+                container_copy(&b->containers[j], &c);
+                rb_append(rb, b->keys[j], &c);
+            }
+            j++;
+        }
+        else
+        {
+            container_op(&a->containers[i], &b->containers[j], op, &c);
+            if (c.cardinality > 0)
+                rb_append(rb, a->keys[i], &c);
+            i++;
+            j++;
+        }
+    }
+    return rb;
+}
+
+roaring_bitmap *rb_union(roaring_bitmap *a, roaring_bitmap *b)
+{
+    return rb_binary_op(a, b, OP_OR);
+}
+
+roaring_bitmap *rb_intersection(roaring_bitmap *a, roaring_bitmap *b)
+{
+    return rb_binary_op(a, b, OP_AND);
+}
+
+roaring_bitmap *rb_xor(roaring_bitmap *a, roaring_bitmap *b)
+{
+    return rb_binary_op(a, b, OP_XOR);
+}
+
+roaring_bitmap *rb_difference(roaring_bitmap *a, roaring_bitmap *b)
+{
+    return rb_binary_op(a, b, OP_ANDNOT);
+}
+
+size_t rb_bytes(roaring_bitmap *rb)
+{
+    size_t bytes;
+    uint64_t i;
+
+    BV_CHECK_NONNULL(rb);
+    bytes = sizeof(roaring_bitmap) + rb->capacity * (sizeof(uint64_t) + sizeof(rb_container)) +
+            (rb->capacity + 1) * sizeof(uint64_t);
+    for (i = 0; i < rb->num_containers; i++)
+        bytes += container_bytes(&rb->containers[i]);
+    return bytes;
+}
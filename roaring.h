@@ -0,0 +1,130 @@
+/**
+ * @file roaring.h
+ * @brief Roaring-style bitmap with array, bitmap and run containers per 64K chunk
+ */
+
+#ifndef POPPY_ROARING_H
+#define POPPY_ROARING_H
+
+#include "bitvector.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RB_LOG_CHUNK_BITS (16UL)
+#define RB_CHUNK_BITS (BIT << RB_LOG_CHUNK_BITS)
+#define RB_CHUNK_WORDS (RB_CHUNK_BITS >> LOG_WORD_SIZE)
+#define RB_ARRAY_MAX_CARDINALITY (4096UL) // an array container holding more values would outgrow a bitmap container
+
+typedef enum
+{
+    RB_ARRAY,  // sorted 16-bit values
+    RB_BITMAP, // RB_CHUNK_WORDS words, operated on by the kernels of word_kernels.h
+    RB_RUN     // sorted, disjoint, non-adjacent runs
+} rb_container_type;
+
+typedef struct
+{
+    uint16_t start;
+    uint16_t length; // the run covers [start, start + length]
+} rb_run;
+
+/**
+ * @brief The set bits of one 64K chunk, in whichever of the three representations is smallest
+ */
+typedef struct
+{
+    rb_container_type type;
+    uint32_t cardinality; // 1 <= cardinality <= RB_CHUNK_BITS
+    uint32_t n;           // values of an array container, runs of a run container
+    uint32_t capacity;    // allocated entries of an array or run container
+    union
+    {
+        uint16_t *values;
+        uint64_t *words;
+        rb_run *runs;
+    };
+} rb_container;
+
+/**
+ * @brief A bitvector of `size` bits split into 64K-bit chunks, storing a container only for non-empty chunks
+ *
+ * Chunks whose bits are mostly clear become array containers, chunks made of a few long runs become run containers
+ * and the rest become bitmap containers. Set operations pick a merge for array/array pairs, a filter for
+ * array/other intersections and the bulk kernels of word_kernels.h otherwise, then re-pick the representation of
+ * every resulting container. prefix[] keeps the number of ones before each container, so rank and select
+ * binary search the chunk keys or the prefix and answer inside a single container.
+ */
+typedef struct
+{
+    uint64_t size;                 // the number of bits
+    uint64_t num_containers;
+    uint64_t capacity;             // allocated entries of keys, containers and prefix
+    uint64_t *keys;                // the chunk index of every container, increasing
+    rb_container *containers;
+    uint64_t *prefix;              // prefix[i] = the number of ones in containers[0:i], num_containers + 1 entries
+} roaring_bitmap;
+
+/**
+ * @brief Create an empty bitmap of `size` bits
+ */
+roaring_bitmap *rb_new(uint64_t size);
+
+void rb_free(roaring_bitmap *rb);
+
+/**
+ * @brief Convert a bitvector, choosing the best container for every chunk
+ */
+roaring_bitmap *rb_from_bitvector(bitvector *bv);
+
+/**
+ * @brief Convert back into a plain bitvector of the same size
+ */
+bitvector *rb_to_bitvector(roaring_bitmap *rb);
+
+uint64_t rb_len(roaring_bitmap *rb);
+
+/**
+ * @brief The number of set bits
+ */
+uint64_t rb_count(roaring_bitmap *rb);
+
+/**
+ * @brief Set the bit at `pos`
+ *
+ * An array container past RB_ARRAY_MAX_CARDINALITY values and a run container whose runs would take more bytes
+ * than a bitmap become bitmap containers; nothing is ever converted back.
+ */
+void rb_set(roaring_bitmap *rb, uint64_t pos);
+
+bool rb_isset(roaring_bitmap *rb, uint64_t pos);
+
+/**
+ * @brief The number of set bits in [0, pos), the counterpart of `bv_rank`
+ */
+uint64_t rb_rank(roaring_bitmap *rb, uint64_t pos);
+
+/**
+ * @brief The position of the kth (1-indexed) set bit, or -1 if there are fewer than k, the counterpart of `bv_select`
+ */
+int64_t rb_select(roaring_bitmap *rb, uint64_t k);
+
+/**
+ * @brief The set operations below return a new bitmap of max(rb_len(a), rb_len(b)) bits, like their bv_ counterparts
+ */
+roaring_bitmap *rb_union(roaring_bitmap *a, roaring_bitmap *b);
+roaring_bitmap *rb_intersection(roaring_bitmap *a, roaring_bitmap *b);
+roaring_bitmap *rb_xor(roaring_bitmap *a, roaring_bitmap *b);
+roaring_bitmap *rb_difference(roaring_bitmap *a, roaring_bitmap *b);
+
+/**
+ * @brief The number of bytes used by the bitmap and its containers
+ */
+size_t rb_bytes(roaring_bitmap *rb);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // POPPY_ROARING_H
@@ -0,0 +1,360 @@
+#include "rrr.h"
+#include "word_ops.h"
+#include <pthread.h>
+#include <stdio.h>
+
+#define BINOMIAL_ROWS (RRR_MAX_BLOCK_BITS + 1)
+
+static uint64_t binomial[BINOMIAL_ROWS][BINOMIAL_ROWS];    // binomial[n][k] = n choose k
+static uint8_t offset_width[BINOMIAL_ROWS][BINOMIAL_ROWS]; // offset_width[n][k] = ceil(log2(n choose k))
+static pthread_once_t tables_once = PTHREAD_ONCE_INIT;
+
+static void build_tables(void)
+{
+    /** Pascal's triangle; 63 choose 31 < 2^60 so every entry fits in a word **/
+
+    uint64_t n, k;
+
+    for (n = 0; n < BINOMIAL_ROWS; n++)
+    {
+        binomial[n][0] = 1;
+        for (k = 1; k <= n; k++)
+            binomial[n][k] = binomial[n - 1][k - 1] + ((k < n) ? binomial[n - 1][k] : 0);
+        for (k = 0; k <= n; k++)
+            offset_width[n][k] = (binomial[n][k] == 1) ? 0 : WORD_SIZE - __builtin_clzll(binomial[n][k] - 1);
+    }
+}
+
+static inline uint64_t get_bits(const uint64_t *words, uint64_t offset, uint32_t width)
+{
+    /** read `width` < 64 bits starting at bit `offset`; the caller guarantees a readable spare word **/
+
+    uint64_t word = offset >> LOG_WORD_SIZE, shift = offset & (WORD_SIZE - 1);
+    uint64_t value = words[word] >> shift;
+
+    if (shift + width > WORD_SIZE)
+        value |= words[word + 1] << (WORD_SIZE - shift);
+    return value & ((BIT << width) - 1);
+}
+
+static inline void put_bits(uint64_t *words, uint64_t offset, uint32_t width, uint64_t value)
+{
+    /** or `width` < 64 bits into zero-initialized words at bit `offset` **/
+
+    uint64_t word = offset >> LOG_WORD_SIZE, shift = offset & (WORD_SIZE - 1);
+
+    if (width == 0)
+        return;
+    words[word] |= value << shift;
+    if (shift + width > WORD_SIZE)
+        words[word + 1] |= value >> (WORD_SIZE - shift);
+}
+
+static inline uint64_t read_block(bitvector *bv, uint64_t num_words, uint64_t offset, uint32_t width)
+{
+    /** like get_bits, but the last block of a bitvector may run past its spare word **/
+
+    uint64_t word = offset >> LOG_WORD_SIZE, shift = offset & (WORD_SIZE - 1);
+    uint64_t value = bv->data[word] >> shift;
+
+    if (shift + width > WORD_SIZE && word + 1 < num_words)
+        value |= bv->data[word + 1] << (WORD_SIZE - shift);
+    return value & ((BIT << width) - 1);
+}
+
+static inline uint64_t encode_block(uint64_t x, uint32_t n, uint64_t c)
+{
+    /** the rank of x among the n-bit words with c set bits, in the combinatorial number system **/
+
+    uint64_t offset = 0;
+    int64_t i;
+
+    for (i = n - 1; i >= 0 && c > 0; i--)
+    {
+        if ((x >> i) & BIT)
+        {
+            offset += binomial[i][c];
+            c--;
+        }
+    }
+    return offset;
+}
+
+static inline uint64_t decode_block(uint64_t offset, uint32_t n, uint64_t c)
+{
+    /** inverse of encode_block **/
+
+    uint64_t x = 0;
+    int64_t i;
+
+    if (c == n)
+        return (BIT << n) - 1;
+    for (i = n - 1; i >= 0 && c > 0; i--)
+    {
+        if (offset >= binomial[i][c])
+        {
+            offset -= binomial[i][c];
+            x |= BIT << i;
+            c--;
+        }
+    }
+    return x;
+}
+
+static inline uint64_t decode_rank(uint64_t offset, uint32_t n, uint64_t c, uint64_t j)
+{
+    /** the number of set bits below bit j, decoding only the bits at and above j **/
+
+    int64_t i;
+
+    for (i = n - 1; i >= (int64_t)j && c > 0; i--)
+    {
+        if (offset >= binomial[i][c])
+        {
+            offset -= binomial[i][c];
+            c--;
+        }
+    }
+    return c;
+}
+
+static inline uint64_t get_class(rrr_vector *rrr, uint64_t block)
+{
+    return get_bits(rrr->classes, block * rrr->class_bits, rrr->class_bits);
+}
+
+static void *rrr_calloc(uint64_t count, size_t item_bytes)
+{
+    void *p = calloc(count, item_bytes);
+    if (p == NULL)
+    {
+        BV_REPORT_ERROR_AND_EXIT(p == NULL, __FILE__, __PRETTY_FUNCTION__, __LINE__, "could not allocate rrr arrays");
+    }
+    return p;
+}
+
+rrr_vector *rrr_from_bitvector(bitvector *bv, uint32_t block_bits, uint32_t sample_rate)
+{
+    /**
+     * Two passes over the blocks: the first stores the classes and sizes the offsets,
+     * the second writes the offsets and the rank samples.
+     **/
+
+    rrr_vector *rrr;
+    uint64_t num_words, block, c, total_offset_bits, ones, offset, s, j, target;
+
+    BV_CHECK_NONNULL(bv);
+    if (block_bits == 0 || block_bits > RRR_MAX_BLOCK_BITS || sample_rate == 0)
+    {
+        BV_REPORT_ERROR_AND_EXIT(block_bits == 0 || block_bits > RRR_MAX_BLOCK_BITS || sample_rate == 0, __FILE__,
+                                 __PRETTY_FUNCTION__, __LINE__, "invalid block size %u or sample rate %u", block_bits,
+                                 sample_rate);
+    }
+    pthread_once(&tables_once, build_tables);
+
+    rrr = rrr_calloc(1, sizeof(rrr_vector));
+    num_words = (bv_len(bv) >> LOG_WORD_SIZE) + BIT;
+    rrr->size = bv_len(bv);
+    rrr->block_bits = block_bits;
+    rrr->sample_rate = sample_rate;
+    rrr->class_bits = WORD_SIZE - __builtin_clzll(block_bits);
+    rrr->num_blocks = (rrr->size + block_bits - 1) / block_bits;
+    rrr->classes = rrr_calloc(((rrr->num_blocks * rrr->class_bits) >> LOG_WORD_SIZE) + 2, sizeof(uint64_t));
+
+    total_offset_bits = 0;
+    ones = 0;
+    for (block = 0; block < rrr->num_blocks; block++)
+    {
+        c = popcnt(read_block(bv, num_words, block * block_bits, block_bits));
+        put_bits(rrr->classes, block * rrr->class_bits, rrr->class_bits, c);
+        total_offset_bits += offset_width[block_bits][c];
+        ones += c;
+    }
+    rrr->ones = ones;
+    rrr->offset_words = (total_offset_bits >> LOG_WORD_SIZE) + 2;
+    rrr->offsets = rrr_calloc(rrr->offset_words, sizeof(uint64_t));
+
+    rrr->num_samples = rrr->num_blocks / sample_rate + 1;
+    rrr->rank_samples = rrr_calloc(rrr->num_samples, sizeof(uint64_t));
+    rrr->offset_samples = rrr_calloc(rrr->num_samples, sizeof(uint64_t));
+
+    ones = 0;
+    offset = 0;
+    for (block = 0; block <= rrr->num_blocks; block++)
+    {
+        if (block % sample_rate == 0)
+        {
+            rrr->rank_samples[block / sample_rate] = ones;
+            rrr->offset_samples[block / sample_rate] = offset;
+        }
+        if (block == rrr->num_blocks)
+            break;
+        c = get_class(rrr, block);
+        put_bits(rrr->offsets, offset, offset_width[block_bits][c],
+                 encode_block(read_block(bv, num_words, block * block_bits, block_bits), block_bits, c));
+        offset += offset_width[block_bits][c];
+        ones += c;
+    }
+
+    rrr->num_select_samples = (ones + (BIT << LOG_SELECT_SAMPLE_RATE) - 1) >> LOG_SELECT_SAMPLE_RATE;
+    rrr->select_samples = rrr_calloc(rrr->num_select_samples + 1, sizeof(uint64_t));
+    for (j = 0, s = 0; j < rrr->num_select_samples; j++)
+    {
+        target = (j << LOG_SELECT_SAMPLE_RATE) + 1;
+        while (s + 1 < rrr->num_samples && rrr->rank_samples[s + 1] < target)
+            s++;
+        rrr->select_samples[j] = s;
+    }
+    return rrr;
+}
+
+static inline uint64_t scan_to_block(rrr_vector *rrr, uint64_t block, uint64_t *offset)
+{
+    /** the number of ones before `block`, and the bit position of its offset, starting from the nearest sample **/
+
+    uint64_t s = block / rrr->sample_rate, i, c, ones;
+
+    ones = rrr->rank_samples[s];
+    *offset = rrr->offset_samples[s];
+    for (i = s * rrr->sample_rate; i < block; i++)
+    {
+        c = get_class(rrr, i);
+        ones += c;
+        *offset += offset_width[rrr->block_bits][c];
+    }
+    return ones;
+}
+
+static inline uint64_t block_bits_at(rrr_vector *rrr, uint64_t block, uint64_t offset)
+{
+    uint64_t c = get_class(rrr, block);
+
+    if (c == 0)
+        return 0;
+    return decode_block(get_bits(rrr->offsets, offset, offset_width[rrr->block_bits][c]), rrr->block_bits, c);
+}
+
+bitvector *rrr_to_bitvector(rrr_vector *rrr)
+{
+    bitvector *bv;
+    uint64_t block, offset, c, num_words, start, word, shift, x;
+
+    BV_CHECK_NONNULL(rrr);
+    bv = bv_new(rrr->size);
+    num_words = (rrr->size >> LOG_WORD_SIZE) + BIT;
+
+    for (block = 0, offset = 0; block < rrr->num_blocks; block++)
+    {
+        c = get_class(rrr, block);
+        x = block_bits_at(rrr, block, offset);
+        offset += offset_width[rrr->block_bits][c];
+
+        start = block * rrr->block_bits;
+        word = start >> LOG_WORD_SIZE;
+        shift = start & (WORD_SIZE - 1);
+        bv->data[word] |= x << shift;
+        if (shift + rrr->block_bits > WORD_SIZE && word + 1 < num_words)
+            bv->data[word + 1] |= x >> (WORD_SIZE - shift);
+    }
+    return bv;
+}
+
+void rrr_free(rrr_vector *rrr)
+{
+    if (rrr == NULL)
+        return;
+    free(rrr->classes);
+    free(rrr->offsets);
+    free(rrr->rank_samples);
+    free(rrr->offset_samples);
+    free(rrr->select_samples);
+    free(rrr);
+}
+
+uint64_t rrr_len(rrr_vector *rrr)
+{
+    BV_CHECK_NONNULL(rrr);
+    return rrr->size;
+}
+
+bool rrr_isset(rrr_vector *rrr, uint64_t pos)
+{
+    uint64_t block, offset;
+
+    BV_CHECK_NONNULL(rrr);
+    if (pos >= rrr->size)
+    {
+        BV_REPORT_ERROR_AND_EXIT(pos >= rrr->size, __FILE__, __PRETTY_FUNCTION__, __LINE__,
+                                 "index %lu out of range [0, %lu)", pos, rrr->size);
+    }
+    block = pos / rrr->block_bits;
+    scan_to_block(rrr, block, &offset);
+    return (block_bits_at(rrr, block, offset) >> (pos - block * rrr->block_bits)) & BIT;
+}
+
+uint64_t rrr_rank(rrr_vector *rrr, uint64_t pos)
+{
+    uint64_t block, offset, ones, j, c;
+
+    BV_CHECK_NONNULL(rrr);
+    if (pos >= rrr->size)
+        return rrr->ones;
+
+    block = pos / rrr->block_bits;
+    ones = scan_to_block(rrr, block, &offset);
+    j = pos - block * rrr->block_bits;
+    c = get_class(rrr, block);
+    if (j == 0 || c == 0)
+        return ones;
+    if (c == rrr->block_bits)
+        return ones + j;
+    return ones + decode_rank(get_bits(rrr->offsets, offset, offset_width[rrr->block_bits][c]), rrr->block_bits, c, j);
+}
+
+uint64_t rrr_pop_count(rrr_vector *rrr, uint64_t pos)
+{
+    return rrr_rank(rrr, pos + 1);
+}
+
+int64_t rrr_select(rrr_vector *rrr, uint64_t k)
+{
+    /** find the last rank sample with fewer than k ones, then walk the classes to the block holding the kth one **/
+
+    uint64_t j, lo, hi, mid, block, ones, offset, c;
+
+    BV_CHECK_NONNULL(rrr);
+    if (k == 0 || k > rrr->ones)
+        return -1;
+
+    j = (k - 1) >> LOG_SELECT_SAMPLE_RATE;
+    lo = rrr->select_samples[j];
+    hi = (j + 1 < rrr->num_select_samples) ? rrr->select_samples[j + 1] : rrr->num_samples - 1;
+    while (lo < hi)
+    {
+        mid = lo + (hi - lo + 1) / 2;
+        if (rrr->rank_samples[mid] < k)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+
+    block = lo * rrr->sample_rate;
+    ones = rrr->rank_samples[lo];
+    offset = rrr->offset_samples[lo];
+    while (ones + (c = get_class(rrr, block)) < k)
+    {
+        ones += c;
+        offset += offset_width[rrr->block_bits][c];
+        block++;
+    }
+    return (int64_t)(block * rrr->block_bits + word_select(block_bits_at(rrr, block, offset), k - ones - 1));
+}
+
+size_t rrr_bytes(rrr_vector *rrr)
+{
+    BV_CHECK_NONNULL(rrr);
+    return sizeof(rrr_vector) +
+           (((rrr->num_blocks * rrr->class_bits) >> LOG_WORD_SIZE) + 2 + rrr->offset_words + 2 * rrr->num_samples +
+            rrr->num_select_samples + 1) *
+               sizeof(uint64_t);
+}
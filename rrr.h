@@ -0,0 +1,100 @@
+/**
+ * @file rrr.h
+ * @brief RRR compressed bitvector with sampled rank/select directories
+ */
+
+#ifndef POPPY_RRR_H
+#define POPPY_RRR_H
+
+#include "bitvector.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RRR_MAX_BLOCK_BITS (63U)
+#define RRR_DEFAULT_BLOCK_BITS (63U)
+#define RRR_DEFAULT_SAMPLE_RATE (32U)
+
+/**
+ * @brief An RRR (Raman, Raman & Rao, 2002) encoding of a bitvector
+ *
+ * The bits are cut into blocks of `block_bits` bits. Each block is stored as its class, the number of set bits,
+ * in a fixed-width field, and its offset, the rank of the block among all blocks of that class,
+ * in ceil(log2(binomial(block_bits, class))) bits. Sparse, dense or locally skewed blocks therefore take few bits.
+ *
+ * Every `sample_rate` blocks the number of ones so far and the position of the next offset are sampled,
+ * so rank decodes at most `sample_rate` classes and one block.
+ * select binary searches the rank samples between two select samples, taken every 2^LOG_SELECT_SAMPLE_RATE ones,
+ * as in the CS-Poppy select directory of the plain layout.
+ * Larger blocks and sparser samples give a smaller encoding and slower queries.
+ */
+typedef struct
+{
+    uint64_t size;            // the number of bits of the encoded bitvector
+    uint64_t ones;            // the number of set bits
+    uint32_t block_bits;      // bits per block, 1 <= block_bits <= RRR_MAX_BLOCK_BITS
+    uint32_t sample_rate;     // blocks per rank sample
+    uint32_t class_bits;      // width of a class field, ceil(log2(block_bits + 1))
+    uint64_t num_blocks;
+    uint64_t *classes;        // num_blocks packed class fields
+    uint64_t *offsets;        // variable-width packed offsets
+    uint64_t offset_words;
+    uint64_t num_samples;
+    uint64_t *rank_samples;   // rank_samples[s] = the number of ones before block s * sample_rate
+    uint64_t *offset_samples; // offset_samples[s] = the bit position of the offset of block s * sample_rate
+    uint64_t num_select_samples;
+    uint64_t *select_samples; // select_samples[j] = the rank sample holding the (j * 2^LOG_SELECT_SAMPLE_RATE + 1)th one
+} rrr_vector;
+
+/**
+ * @brief Compress a bitvector
+ *
+ * @param bv the bitvector to compress, left unchanged
+ * @param block_bits bits per block, 1 <= block_bits <= RRR_MAX_BLOCK_BITS
+ * @param sample_rate blocks per rank sample, at least 1
+ */
+rrr_vector *rrr_from_bitvector(bitvector *bv, uint32_t block_bits, uint32_t sample_rate);
+
+/**
+ * @brief Decompress into a plain bitvector
+ */
+bitvector *rrr_to_bitvector(rrr_vector *rrr);
+
+void rrr_free(rrr_vector *rrr);
+
+/**
+ * @brief The number of bits of the encoded bitvector
+ */
+uint64_t rrr_len(rrr_vector *rrr);
+
+/**
+ * @brief Check if the bit at position `pos` is set
+ */
+bool rrr_isset(rrr_vector *rrr, uint64_t pos);
+
+/**
+ * @brief The number of set bits in [0, pos), the counterpart of `bv_rank`
+ */
+uint64_t rrr_rank(rrr_vector *rrr, uint64_t pos);
+
+/**
+ * @brief The number of set bits in [0, pos], the counterpart of `bv_pop_count`
+ */
+uint64_t rrr_pop_count(rrr_vector *rrr, uint64_t pos);
+
+/**
+ * @brief The position of the kth (1-indexed) set bit, or -1 if there are fewer than k, the counterpart of `bv_select`
+ */
+int64_t rrr_select(rrr_vector *rrr, uint64_t k);
+
+/**
+ * @brief The number of bytes used by the encoding and its directories
+ */
+size_t rrr_bytes(rrr_vector *rrr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // POPPY_RRR_H
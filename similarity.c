@@ -0,0 +1,177 @@
+#include "similarity.h"
+#include "thread_pool.h"
+#include "word_kernels.h"
+#include <stdio.h>
+
+#define L2_CACHE_BYTES (256UL * 1024)
+#define QUERY_TILE (8UL)
+#define MIN_GRAIN (64UL)
+
+typedef enum
+{
+    METRIC_HAMMING,
+    METRIC_JACCARD
+} metric;
+
+typedef struct
+{
+    bitvector **queries;
+    size_t nq;
+    bitvector **candidates;
+    size_t nc;
+    metric m;
+    void *out; // uint64_t * for METRIC_HAMMING, double * for METRIC_JACCARD
+} similarity_job;
+
+static inline uint64_t num_words(bitvector *bv)
+{
+    return (bv_len(bv) >> LOG_WORD_SIZE) + BIT;
+}
+
+static inline double jaccard(bitvector *a, bitvector *b)
+{
+    bitvector *longer = (bv_len(a) >= bv_len(b)) ? a : b;
+    uint64_t common = (num_words(a) < num_words(b)) ? num_words(a) : num_words(b);
+    uint64_t intersection, union_;
+
+    intersection = words_and_popcount(a->data, b->data, common);
+    union_ = words_or_popcount(a->data, b->data, common) +
+             words_popcount(longer->data + common, num_words(longer) - common);
+    return union_ ? (double)intersection / (double)union_ : 1.0;
+}
+
+static void similarity_task(void *arg, size_t begin, size_t end)
+{
+    /** compare the candidates [begin, end) against every query, QUERY_TILE queries at a time **/
+
+    similarity_job *job = arg;
+    size_t q, q_end, c, i;
+
+    for (q = 0; q < job->nq; q += QUERY_TILE)
+    {
+        q_end = (q + QUERY_TILE < job->nq) ? q + QUERY_TILE : job->nq;
+        for (c = begin; c < end; c++)
+        {
+            for (i = q; i < q_end; i++)
+            {
+                if (job->m == METRIC_HAMMING)
+                    ((uint64_t *)job->out)[i * job->nc + c] = bv_hamming_distance(job->queries[i], job->candidates[c]);
+                else
+                    ((double *)job->out)[i * job->nc + c] = jaccard(job->queries[i], job->candidates[c]);
+            }
+        }
+    }
+}
+
+static void similarity_run(bitvector **queries, size_t nq, bitvector **candidates, size_t nc, metric m, void *out)
+{
+    similarity_job job = {queries, nq, candidates, nc, m, out};
+    size_t grain;
+
+    if (nq == 0 || nc == 0)
+        return;
+    BV_CHECK_NONNULL(queries);
+    BV_CHECK_NONNULL(candidates);
+    BV_CHECK_NONNULL(out);
+
+    /* size a candidate tile to fit in L2, assuming the candidates are about as long as the first one */
+    grain = L2_CACHE_BYTES / (num_words(candidates[0]) * sizeof(uint64_t));
+    if (grain < MIN_GRAIN)
+        grain = MIN_GRAIN;
+    bv_parallel_for(nc, grain, similarity_task, &job);
+}
+
+void bv_hamming_batch(bitvector *query, bitvector **candidates, size_t n, uint64_t *distances)
+{
+    similarity_run(&query, 1, candidates, n, METRIC_HAMMING, distances);
+}
+
+void bv_jaccard_batch(bitvector *query, bitvector **candidates, size_t n, double *similarities)
+{
+    similarity_run(&query, 1, candidates, n, METRIC_JACCARD, similarities);
+}
+
+void bv_hamming_matrix(bitvector **queries, size_t nq, bitvector **candidates, size_t nc, uint64_t *distances)
+{
+    similarity_run(queries, nq, candidates, nc, METRIC_HAMMING, distances);
+}
+
+void bv_jaccard_matrix(bitvector **queries, size_t nq, bitvector **candidates, size_t nc, double *similarities)
+{
+    similarity_run(queries, nq, candidates, nc, METRIC_JACCARD, similarities);
+}
+
+/**
+ * @brief heap order: larger distance first, then larger index, so the root is the worst of the current top-k
+ */
+static inline bool worse(uint64_t *dist, size_t a, size_t b)
+{
+    return dist[a] > dist[b] || (dist[a] == dist[b] && a > b);
+}
+
+static void sift_down(size_t *heap, size_t size, size_t i, uint64_t *dist)
+{
+    size_t child, tmp;
+
+    while ((child = 2 * i + 1) < size)
+    {
+        if (child + 1 < size && worse(dist, heap[child + 1], heap[child]))
+            child++;
+        if (!worse(dist, heap[child], heap[i]))
+            break;
+        tmp = heap[i];
+        heap[i] = heap[child];
+        heap[child] = tmp;
+        i = child;
+    }
+}
+
+size_t bv_hamming_top_k(bitvector *query, bitvector **candidates, size_t n, size_t k, size_t *indices,
+                        uint64_t *distances)
+{
+    /** compute every distance in parallel, then keep the k best in a max-heap **/
+
+    uint64_t *all;
+    size_t i, size, tmp;
+
+    if (k > n)
+        k = n;
+    if (k == 0)
+        return 0;
+    BV_CHECK_NONNULL(indices);
+
+    all = malloc(n * sizeof(uint64_t));
+    if (all == NULL)
+    {
+        BV_REPORT_ERROR_AND_EXIT(all == NULL, __FILE__, __PRETTY_FUNCTION__, __LINE__, "could not allocate distances");
+    }
+    bv_hamming_batch(query, candidates, n, all);
+
+    for (i = 0; i < k; i++)
+        indices[i] = i;
+    for (i = k / 2; i-- > 0;)
+        sift_down(indices, k, i, all);
+    for (i = k; i < n; i++)
+    {
+        if (worse(all, indices[0], i))
+        {
+            indices[0] = i;
+            sift_down(indices, k, 0, all);
+        }
+    }
+
+    /* heap sort in place: repeatedly move the worst to the back */
+    for (size = k; size > 1; size--)
+    {
+        tmp = indices[0];
+        indices[0] = indices[size - 1];
+        indices[size - 1] = tmp;
+        sift_down(indices, size - 1, 0, all);
+    }
+
+    if (distances != NULL)
+        for (i = 0; i < k; i++)
+            distances[i] = all[indices[i]];
+    free(all);
+    return k;
+}
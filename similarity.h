@@ -0,0 +1,63 @@
+/**
+ * @file similarity.h
+ * @brief Batched hamming distance and Jaccard similarity between bitvector fingerprints
+ */
+
+#ifndef POPPY_SIMILARITY_H
+#define POPPY_SIMILARITY_H
+
+#include "bitvector.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * All functions below treat the shorter of two fingerprints as if it were padded with 0's,
+ * count bits with the fused popcount kernels of word_kernels.h and spread the candidates over the
+ * worker pool of thread_pool.h.
+ * The Jaccard similarity of two empty fingerprints is defined as 1.
+ */
+
+/**
+ * @brief distances[i] = bv_hamming_distance(query, candidates[i]) for 0 <= i < n
+ */
+void bv_hamming_batch(bitvector *query, bitvector **candidates, size_t n, uint64_t *distances);
+
+/**
+ * @brief similarities[i] = |query & candidates[i]| / |query | candidates[i]| for 0 <= i < n
+ */
+void bv_jaccard_batch(bitvector *query, bitvector **candidates, size_t n, double *similarities);
+
+/**
+ * @brief distances[i * nc + j] = bv_hamming_distance(queries[i], candidates[j])
+ *
+ * The candidates are processed in tiles that fit in the L2 cache, each tile being compared against all queries
+ * before moving on.
+ */
+void bv_hamming_matrix(bitvector **queries, size_t nq, bitvector **candidates, size_t nc, uint64_t *distances);
+
+/**
+ * @brief similarities[i * nc + j] = the Jaccard similarity of queries[i] and candidates[j]
+ */
+void bv_jaccard_matrix(bitvector **queries, size_t nq, bitvector **candidates, size_t nc, double *similarities);
+
+/**
+ * @brief Find the k candidates closest to query in hamming distance
+ *
+ * @param query the query fingerprint
+ * @param candidates the candidate fingerprints
+ * @param n the number of candidates
+ * @param k the number of neighbours to find
+ * @param indices receives the indices of the min(k, n) nearest candidates, closest first, ties broken by index
+ * @param distances receives their hamming distances, may be NULL
+ * @return size_t min(k, n)
+ */
+size_t bv_hamming_top_k(bitvector *query, bitvector **candidates, size_t n, size_t k, size_t *indices,
+                        uint64_t *distances);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // POPPY_SIMILARITY_H
@@ -0,0 +1,204 @@
+#include "test_utils.h"
+#include <thread>
+
+/**
+ * Pluggable allocators: vectors made under the aligned, page and pool allocators, and under a counting wrapper,
+ * hold zeroed, aligned words that survive resizing and answer queries like any other vector; every vector frees
+ * through the allocator that made it, and the pool hands recycled chunks back zeroed, also across threads.
+ */
+
+/** forwards to bv_aligned_allocator, counting live allocations and bytes */
+struct counting
+{
+    long live = 0, allocs = 0;
+    size_t bytes = 0;
+    bv_allocator allocator = {alloc, realloc, free, this};
+
+    static void *alloc(void *ctx, size_t bytes)
+    {
+        auto *self = static_cast<counting *>(ctx);
+        self->live++, self->allocs++, self->bytes += bytes;
+        return bv_aligned_allocator.alloc(bv_aligned_allocator.ctx, bytes);
+    }
+
+    static void *realloc(void *ctx, void *ptr, size_t old_bytes, size_t new_bytes)
+    {
+        auto *self = static_cast<counting *>(ctx);
+        self->bytes += new_bytes - old_bytes;
+        return bv_aligned_allocator.realloc(bv_aligned_allocator.ctx, ptr, old_bytes, new_bytes);
+    }
+
+    static void free(void *ctx, void *ptr, size_t bytes)
+    {
+        auto *self = static_cast<counting *>(ctx);
+        self->live--, self->bytes -= bytes;
+        bv_aligned_allocator.free(bv_aligned_allocator.ctx, ptr, bytes);
+    }
+};
+
+/** restores the allocator in use when the test started */
+struct allocator_guard
+{
+    const bv_allocator *saved = bv_get_allocator();
+
+    ~allocator_guard() { bv_set_allocator(saved); }
+};
+
+static void expect_usable(bitvector *bv, uint64_t seed)
+{
+    std::vector<bool> bits = test::random_bits(bv_len(bv), 300, seed);
+    std::vector<uint64_t> ranks;
+
+    ASSERT_EQ((uintptr_t)bv->data % BV_DATA_ALIGNMENT, 0UL);
+    ASSERT_EQ(bv_count_range(bv, 1, 0, bv_len(bv)), 0UL) << "fresh words must be zeroed";
+    for (uint64_t i = 0; i < bits.size(); i++)
+    {
+        if (bits[i])
+            bv_set(bv, i);
+    }
+
+    /* growing keeps the bits and zeroes the new ones */
+    bv_resize(bv, bits.size() * 2 + 100);
+    bits.resize(bits.size() * 2 + 100);
+    ASSERT_EQ((uintptr_t)bv->data % BV_DATA_ALIGNMENT, 0UL);
+    bv_build_select(bv);
+    ranks = test::naive_ranks(bits);
+    for (uint64_t pos = 0; pos <= bits.size(); pos += 1 + bits.size() / 500)
+        ASSERT_EQ(bv_rank(bv, pos), ranks[pos]) << "pos " << pos;
+    ASSERT_EQ(bv_rank(bv, bits.size()), ranks.back());
+    if (ranks.back() > 0)
+        ASSERT_EQ(bv_select(bv, ranks.back()), test::naive_select(bits, ranks.back()));
+}
+
+TEST(Allocator, CountingAllocatorSeesEveryAllocation)
+{
+    allocator_guard guard;
+    counting counter;
+
+    bv_set_allocator(&counter.allocator);
+    EXPECT_EQ(bv_get_allocator(), &counter.allocator);
+    {
+        bitvector *a = bv_new(100000), *b = bv_new(5000), *x;
+
+        expect_usable(a, 1);
+        expect_usable(b, 2);
+        x = bv_xor(a, b);
+        EXPECT_EQ(x->allocator, &counter.allocator);
+        EXPECT_GT(counter.live, 2);
+
+        /* vectors keep their allocator after the setting changes */
+        bv_set_allocator(NULL);
+        EXPECT_EQ(bv_get_allocator(), &bv_aligned_allocator);
+        bv_resize(a, 300000);
+        bitvector *plain = bv_new(100);
+        EXPECT_EQ(plain->allocator, &bv_aligned_allocator);
+        EXPECT_EQ(a->allocator, &counter.allocator);
+
+        /* so does the scratch buffer of an in-place rotation */
+        long allocs = counter.allocs, live = counter.live;
+        bv_rotate_inplace(a, 12345);
+        EXPECT_EQ(counter.allocs, allocs + 1);
+        EXPECT_EQ(counter.live, live);
+
+        bv_free(plain);
+        bv_free(a);
+        bv_free(b);
+        bv_free(x);
+    }
+    EXPECT_EQ(counter.live, 0);
+    EXPECT_EQ(counter.bytes, 0UL);
+    EXPECT_GT(counter.allocs, 3);
+}
+
+TEST(Allocator, PageAllocator)
+{
+    allocator_guard guard;
+    bv_page_options options = {false, -1, false};
+    const bv_allocator *pages = bv_page_allocator_new(&options);
+
+    /* the allocator keeps its own copy of the options */
+    options = {true, 0, true};
+    bv_set_allocator(pages);
+    for (uint64_t bits : {1000UL, 8 * BV_HUGE_PAGE_BYTES - 1, 8 * BV_HUGE_PAGE_BYTES + 12345})
+    {
+        bitvector *bv = bv_new(bits);
+
+        if (bits / 8 >= BV_HUGE_PAGE_BYTES)
+            EXPECT_EQ((uintptr_t)bv->data % BV_HUGE_PAGE_BYTES, 0UL);
+        expect_usable(bv, bits);
+        bv_free(bv);
+    }
+
+    /* best-effort placement options must not fail */
+    const bv_allocator *placed = bv_page_allocator_new(&options);
+    bv_set_allocator(placed);
+    bitvector *bv = bv_new(8 * BV_HUGE_PAGE_BYTES);
+    expect_usable(bv, 3);
+    bv_free(bv);
+    bv_set_allocator(NULL);
+    bv_page_allocator_free(placed);
+    bv_page_allocator_free(pages);
+}
+
+TEST(Allocator, PoolRecyclesZeroedChunks)
+{
+    allocator_guard guard;
+    bv_pool *pool = bv_pool_new();
+
+    bv_set_allocator(bv_pool_allocator(pool));
+    for (int round = 0; round < 3; round++)
+    {
+        std::vector<bitvector *> vectors;
+
+        /* every size class, and sizes past BV_POOL_MAX_BYTES */
+        for (uint64_t bits = 1; bits <= 16 * BV_POOL_MAX_BYTES; bits = bits * 3 + 1)
+        {
+            vectors.push_back(bv_new(bits));
+            expect_usable(vectors.back(), bits + round);
+            bv_range_set(vectors.back(), 1, 0, bv_len(vectors.back()));
+        }
+        for (bitvector *bv : vectors)
+            bv_free(bv);
+    }
+    bv_set_allocator(NULL);
+    bv_pool_free(pool);
+}
+
+TEST(Allocator, PoolAcrossThreads)
+{
+    bv_pool *pool = bv_pool_new();
+    const bv_allocator &allocator = *bv_pool_allocator(pool);
+    std::vector<std::thread> threads;
+
+    /* the allocator setting is process-wide, so the threads call the pool directly */
+    for (int t = 0; t < 4; t++)
+    {
+        threads.emplace_back([&, t] {
+            std::mt19937_64 rng(t);
+            std::vector<std::pair<uint64_t *, size_t>> held;
+
+            for (int i = 0; i < 20000; i++)
+            {
+                if (held.size() < 64 && rng() % 2)
+                {
+                    size_t bytes = 8 << (rng() % 9);
+                    auto *words = static_cast<uint64_t *>(allocator.alloc(allocator.ctx, bytes));
+                    for (size_t w = 0; w < bytes / 8; w++)
+                        ASSERT_EQ(words[w], 0UL);
+                    std::fill(words, words + bytes / 8, ~0UL);
+                    held.push_back({words, bytes});
+                }
+                else if (!held.empty())
+                {
+                    allocator.free(allocator.ctx, held.back().first, held.back().second);
+                    held.pop_back();
+                }
+            }
+            for (auto [words, bytes] : held)
+                allocator.free(allocator.ctx, words, bytes);
+        });
+    }
+    for (std::thread &thread : threads)
+        thread.join();
+    bv_pool_free(pool);
+}
@@ -0,0 +1,107 @@
+#include "test_utils.h"
+#include "thread_pool.h"
+#include <tuple>
+
+/**
+ * bv_rank_batch and bv_select_batch against prefix counts, under every combination of flags, on one thread and on
+ * several, for batch sizes from empty to large enough to be split, with duplicate, unsorted and out-of-range queries.
+ */
+
+class Batch : public ::testing::TestWithParam<std::tuple<size_t, unsigned>>
+{
+protected:
+    size_t saved_threads = bv_get_num_threads();
+    unsigned flags = std::get<1>(GetParam());
+
+    void SetUp() override { bv_set_num_threads(std::get<0>(GetParam())); }
+    void TearDown() override { bv_set_num_threads(saved_threads); }
+};
+
+static std::vector<uint64_t> random_queries(size_t n, uint64_t bound, uint64_t seed)
+{
+    std::mt19937_64 rng(seed);
+    std::vector<uint64_t> queries(n);
+
+    for (uint64_t &query : queries)
+        query = rng() % bound;
+    return queries;
+}
+
+TEST_P(Batch, Rank)
+{
+    std::vector<bool> bits = test::random_bits(1UL << 21, 300, 1);
+    std::vector<uint64_t> ranks = test::naive_ranks(bits);
+
+    for (size_t n : {0UL, 1UL, 7UL, 1000UL, 200000UL})
+    {
+        bitvector *bv = test::to_bitvector(bits);
+        std::vector<uint64_t> positions = random_queries(n, bits.size() + 1, n), out(n + 1, UINT64_MAX);
+
+        const uint64_t edges[] = {0, bits.size(), bits.size() - 1, bits.size()}; // and a duplicate
+
+        for (size_t i = 0; i < n && i < 4; i++)
+            positions[i] = edges[i];
+
+        bv_rank_batch(bv, positions.data(), out.data(), n, flags);
+        for (size_t i = 0; i < n; i++)
+            ASSERT_EQ(out[i], ranks[positions[i]]) << "query " << i << " position " << positions[i];
+        ASSERT_EQ(out[n], UINT64_MAX);
+        EXPECT_NE(bv->rank, nullptr);
+        bv_free(bv);
+    }
+}
+
+TEST_P(Batch, Select)
+{
+    std::vector<bool> bits = test::random_bits(1UL << 21, 300, 2);
+    std::vector<uint64_t> ones = test::naive_positions(bits, true);
+
+    for (size_t n : {0UL, 1UL, 7UL, 1000UL, 200000UL})
+    {
+        bitvector *bv = test::to_bitvector(bits);
+        std::vector<uint64_t> ks = random_queries(n, ones.size() + 10, n + 1);
+        std::vector<int64_t> out(n + 1, -2);
+
+        const uint64_t edges[] = {0, 1, ones.size(), ones.size() + 1};
+
+        for (size_t i = 0; i < n && i < 4; i++)
+            ks[i] = edges[i];
+
+        bv_select_batch(bv, ks.data(), out.data(), n, flags);
+        for (size_t i = 0; i < n; i++)
+        {
+            int64_t expected = (ks[i] == 0 || ks[i] > ones.size()) ? -1 : (int64_t)ones[ks[i] - 1];
+            ASSERT_EQ(out[i], expected) << "query " << i << " k " << ks[i];
+        }
+        ASSERT_EQ(out[n], -2);
+        bv_free(bv);
+    }
+}
+
+TEST_P(Batch, MatchesSingleQueriesAfterWrites)
+{
+    std::vector<bool> bits = test::random_bits(100000, 500, 3);
+    bitvector *bv = test::to_bitvector(bits);
+    std::vector<uint64_t> positions = random_queries(5000, bits.size() + 1, 4), ranks(positions.size());
+    std::vector<uint64_t> ks = random_queries(5000, bits.size() / 4, 5);
+    std::vector<int64_t> selects(ks.size());
+
+    bv_build_rank(bv);
+    bv_build_select(bv);
+    bv_set(bv, 12345);
+    bv_clear(bv, 54321);
+    bv_sync_rank(bv);
+
+    bv_rank_batch(bv, positions.data(), ranks.data(), positions.size(), flags);
+    bv_select_batch(bv, ks.data(), selects.data(), ks.size(), flags);
+    for (size_t i = 0; i < positions.size(); i++)
+        ASSERT_EQ(ranks[i], bv_rank(bv, positions[i]));
+    for (size_t i = 0; i < ks.size(); i++)
+        ASSERT_EQ(selects[i], bv_select(bv, ks[i]));
+    bv_free(bv);
+}
+
+INSTANTIATE_TEST_SUITE_P(ThreadsAndFlags, Batch,
+                         ::testing::Combine(::testing::Values(1, 4),
+                                            ::testing::Values(0U, BV_BATCH_SORT, BV_BATCH_SERIAL,
+                                                              BV_BATCH_SORT | BV_BATCH_SERIAL)));
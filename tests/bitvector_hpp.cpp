@@ -0,0 +1,171 @@
+#include "test_utils.h"
+#include "bitvector.hpp"
+
+/**
+ * The C++ interface: rs::bitset<N> evaluated entirely in constant expressions, rs::bitvector ownership and bounds
+ * checks, and fused expressions over operands of different lengths against bit-by-bit references.
+ */
+
+template <size_t N>
+constexpr rs::bitset<N> every_third()
+{
+    rs::bitset<N> b;
+
+    for (size_t i = 0; i < N; i += 3)
+        b.set(i);
+    return b;
+}
+
+/* every member used here must be usable in a constant expression */
+static_assert(rs::bitset<0>().none() && rs::bitset<0>().all() && rs::bitset<0>::num_words == 1, "");
+static_assert(rs::bitset<64>(~0UL).all() && rs::bitset<64>(~0UL).count() == 64, "");
+static_assert(rs::bitset<10>(~0UL).count() == 10, "a value is truncated to N bits");
+static_assert(every_third<130>().count() == 44, "");
+static_assert(every_third<130>().rank(0) == 0 && every_third<130>().rank(64) == 22 && every_third<130>().rank(130) == 44,
+              "");
+static_assert(every_third<130>().select(1) == 0 && every_third<130>().select(23) == 66 &&
+                  every_third<130>().select(44) == 129 && every_third<130>().select(45) == -1 &&
+                  every_third<130>().select(0) == -1,
+              "");
+static_assert(every_third<130>()[129] && !every_third<130>()[128] && every_third<130>().test(3), "");
+static_assert((~every_third<130>()).count() == 86 && rs::bitset<130>().set().count() == 130, "spare bits stay 0");
+static_assert((every_third<130>() & ~every_third<130>()).none(), "");
+static_assert((every_third<130>() | ~every_third<130>()).all(), "");
+static_assert((every_third<130>() ^ every_third<130>()) == rs::bitset<130>(), "");
+static_assert(every_third<130>().flip(0).count() == 43 && every_third<130>().reset(3).rank(130) == 43, "");
+static_assert(rs::bitset<130>().set(127).set(127, false).none() && every_third<130>() != rs::bitset<130>(), "");
+
+template <size_t N>
+static void expect_bitset_matches_naive(uint64_t seed)
+{
+    std::vector<bool> bits = test::random_bits(N, 400, seed);
+    rs::bitset<N> b;
+
+    for (size_t i = 0; i < N; i++)
+        b.set(i, bits[i]);
+    ASSERT_EQ(b.count(), test::naive_rank(bits, N));
+    for (size_t pos = 0; pos <= N; pos++)
+        ASSERT_EQ(b.rank(pos), test::naive_rank(bits, pos)) << "N " << N << " pos " << pos;
+    for (size_t k = 0; k <= b.count() + 1; k++)
+        ASSERT_EQ(b.select(k), k ? test::naive_select(bits, k) : -1) << "N " << N << " k " << k;
+
+    rs::bitvector bv = b.to_bitvector();
+    EXPECT_EQ(test::to_bits(bv.get()), bits);
+    EXPECT_THROW(b.test(N), std::out_of_range);
+}
+
+TEST(BitvectorHpp, BitsetAtRuntime)
+{
+    expect_bitset_matches_naive<1>(1);
+    expect_bitset_matches_naive<63>(2);
+    expect_bitset_matches_naive<64>(3);
+    expect_bitset_matches_naive<65>(4);
+    expect_bitset_matches_naive<512>(5);
+    expect_bitset_matches_naive<1000>(6);
+}
+
+TEST(BitvectorHpp, Ownership)
+{
+    rs::bitvector empty(0), sized(100);
+    ::bitvector *raw = bv_new(300);
+
+    EXPECT_EQ(empty.size(), 0UL);
+    EXPECT_EQ(sized.size(), 100UL);
+
+    bv_set(raw, 7);
+    rs::bitvector adopted = rs::bitvector::adopt(raw), copy = adopted.clone();
+    EXPECT_EQ(adopted.get(), raw);
+    EXPECT_NE(copy.get(), raw);
+    EXPECT_TRUE(copy == adopted);
+    copy.set(8);
+    EXPECT_TRUE(copy != adopted);
+
+    rs::bitvector moved(std::move(adopted));
+    EXPECT_EQ(moved.get(), raw);
+    EXPECT_EQ(adopted.get(), nullptr);
+    adopted = std::move(copy);
+    EXPECT_TRUE(adopted[8]);
+
+    ::bitvector *released = moved.release();
+    EXPECT_EQ(released, raw);
+    EXPECT_EQ(moved.get(), nullptr);
+    bv_free(released);
+}
+
+TEST(BitvectorHpp, AccessorsAndBoundsChecks)
+{
+    std::vector<bool> bits = test::random_bits(5000, 300, 7);
+    rs::bitvector bv(bits.size());
+
+    for (size_t i = 0; i < bits.size(); i++)
+        bv.assign(i, bits[i]);
+    bv.build_select();
+    for (size_t pos = 0; pos < bits.size(); pos++)
+        ASSERT_EQ(bv[pos], bits[pos]);
+    for (size_t pos = 0; pos <= bits.size(); pos += 7)
+        ASSERT_EQ(bv.rank(pos), test::naive_rank(bits, pos));
+    for (size_t k = 1; k <= bv.count(); k += 5)
+        ASSERT_EQ(bv.select(k), test::naive_select(bits, k));
+
+    EXPECT_THROW(bv.test(bits.size()), std::out_of_range);
+    EXPECT_THROW(bv.set(bits.size()), std::out_of_range);
+    EXPECT_THROW(bv.reset(bits.size() + 100), std::out_of_range);
+    EXPECT_THROW(bv.flip(SIZE_MAX), std::out_of_range);
+    EXPECT_EQ(test::to_bits(bv.get()), bits);
+
+    /* the unchecked writes keep the directory current, like the checked ones */
+    bv.flip_unchecked(10), bits[10] = !bits[10];
+    bv.set_unchecked(20), bits[20] = true;
+    bv.reset_unchecked(30), bits[30] = false;
+    bv_sync_rank(bv.get());
+    EXPECT_EQ(bv.count(), test::naive_rank(bits, bits.size()));
+    EXPECT_EQ(test::to_bits(bv.get()), bits);
+}
+
+static std::vector<bool> padded(const std::vector<bool> &bits, size_t size)
+{
+    std::vector<bool> result(bits);
+
+    result.resize(size, false);
+    return result;
+}
+
+TEST(BitvectorHpp, Expressions)
+{
+    for (auto sizes : {std::make_tuple(1000UL, 1000UL, 1000UL), std::make_tuple(64UL, 4097UL, 300UL),
+                       std::make_tuple(0UL, 129UL, 5000UL)})
+    {
+        size_t n = std::max({std::get<0>(sizes), std::get<1>(sizes), std::get<2>(sizes)});
+        std::vector<bool> a = test::random_bits(std::get<0>(sizes), 500, 1),
+                          b = test::random_bits(std::get<1>(sizes), 500, 2),
+                          c = test::random_bits(std::get<2>(sizes), 500, 3);
+        std::vector<bool> pa = padded(a, n), pb = padded(b, n), pc = padded(c, n), fused(n), nested(n);
+        rs::bitvector va = rs::bitvector::adopt(test::to_bitvector(a)), vb = rs::bitvector::adopt(test::to_bitvector(b)),
+                      vc = rs::bitvector::adopt(test::to_bitvector(c)), into(17);
+
+        for (size_t i = 0; i < n; i++)
+        {
+            fused[i] = (pa[i] && pb[i]) != pc[i];
+            nested[i] = !(pa[i] || pb[i]) || (pc[i] && !pa[i]);
+        }
+
+        rs::bitvector result = (va & vb) ^ vc;
+        EXPECT_EQ(result.size(), n);
+        EXPECT_EQ(test::to_bits(result.get()), fused);
+        EXPECT_EQ(rs::count((va & vb) ^ vc), test::naive_rank(fused, n));
+
+        /* an expression with no rs::bitvector at its top, into an existing vector */
+        into = ~(va | vb) | (vc & ~va);
+        EXPECT_EQ(test::to_bits(into.get()), nested);
+        EXPECT_EQ(rs::count(~(va | vb) | (vc & ~va)), test::naive_rank(nested, n));
+
+        /* assigning an expression over the destination itself */
+        va = va ^ vb;
+        for (size_t i = 0; i < n; i++)
+            pa[i] = pa[i] != pb[i];
+        EXPECT_EQ(test::to_bits(va.get()), padded(pa, va.size()));
+
+        vb ^= vb;
+        EXPECT_EQ(vb.count(), 0UL);
+    }
+}
@@ -0,0 +1,247 @@
+#include "test_utils.h"
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+/**
+ * bv_save and bv_mmap: a view answers every query like the vector it was saved from, and files that are missing,
+ * truncated or have a corrupted header, L0 entries or select samples are rejected with EINVAL instead of being mapped,
+ * and corrupted L1/L2 entries, which are not checked at open, never make select answer past the vector.
+ */
+
+/* byte offsets of the header fields, as laid out by bitvector_io.c */
+static const size_t kMagicOffset = 0, kVersionOffset = 8, kHeaderBytesOffset = 12, kByteOrderOffset = 16,
+                    kSizeOffset = 24, kOnesOffset = 32, kDataOffset = 40, kL0Offset = 56, kL1L2Offset = 72,
+                    kNumL1Offset = 80,
+                    kSamplesOffset = 88, kSamples0Offset = 104, kNumSamples0Offset = 112, kHeaderBytes = 128;
+
+static std::string temp_path(const char *name)
+{
+    return ::testing::TempDir() + "rank_select_io_" + name + ".bv";
+}
+
+static std::vector<char> read_file(const std::string &path)
+{
+    std::ifstream in(path, std::ios::binary);
+
+    return std::vector<char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+static void write_file(const std::string &path, const std::vector<char> &bytes)
+{
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+
+    out.write(bytes.data(), bytes.size());
+}
+
+template <class T>
+static T peek(const std::vector<char> &bytes, size_t offset)
+{
+    T value;
+
+    std::memcpy(&value, bytes.data() + offset, sizeof(value));
+    return value;
+}
+
+template <class T>
+static void poke(std::vector<char> &bytes, size_t offset, T value)
+{
+    std::memcpy(bytes.data() + offset, &value, sizeof(value));
+}
+
+static void expect_rejected(const std::string &path, const std::vector<char> &bytes, const char *what)
+{
+    write_file(path, bytes);
+    errno = 0;
+    bitvector *bv = bv_mmap(path.c_str());
+    EXPECT_EQ(bv, nullptr) << what;
+    EXPECT_EQ(errno, EINVAL) << what;
+    if (bv != nullptr)
+        bv_free(bv);
+}
+
+TEST(BitvectorIo, RoundTrip)
+{
+    for (uint64_t size : {0UL, 1UL, 2048UL, 100000UL, 1UL << 20})
+    {
+        std::vector<bool> bits = test::random_bits(size, 300, size);
+        std::vector<uint64_t> ones = test::naive_positions(bits, true), zeros = test::naive_positions(bits, false);
+        std::string path = temp_path("round_trip");
+        bitvector *bv = test::to_bitvector(bits), *view;
+
+        ASSERT_EQ(bv_save(bv, path.c_str()), 0);
+        view = bv_mmap(path.c_str());
+        ASSERT_NE(view, nullptr);
+        ASSERT_EQ(bv_len(view), size);
+        EXPECT_TRUE(bv_equal(view, bv));
+        EXPECT_EQ(test::to_bits(view), bits);
+        for (uint64_t pos = 0; pos <= size; pos += 997)
+            ASSERT_EQ(bv_rank(view, pos), test::naive_rank(bits, pos));
+        ASSERT_EQ(bv_rank(view, size), ones.size());
+        for (uint64_t k = 1; k <= ones.size(); k += 101)
+            ASSERT_EQ(bv_select(view, k), (int64_t)ones[k - 1]);
+        for (uint64_t k = 1; k <= zeros.size(); k += 101)
+            ASSERT_EQ(bv_select0(view, k), (int64_t)zeros[k - 1]);
+        EXPECT_EQ(bv_select(view, ones.size() + 1), -1);
+        bv_free(view);
+        bv_free(bv);
+        std::remove(path.c_str());
+    }
+}
+
+TEST(BitvectorIo, MissingFile)
+{
+    errno = 0;
+    EXPECT_EQ(bv_mmap(temp_path("does_not_exist").c_str()), nullptr);
+    EXPECT_EQ(errno, ENOENT);
+}
+
+TEST(BitvectorIo, RejectsTruncatedFiles)
+{
+    std::string path = temp_path("truncated");
+    bitvector *bv = test::to_bitvector(test::random_bits(50000, 500, 1));
+    std::vector<char> bytes;
+
+    ASSERT_EQ(bv_save(bv, path.c_str()), 0);
+    bytes = read_file(path);
+    for (size_t length : {(size_t)0, (size_t)1, kHeaderBytes - 1, kHeaderBytes, kHeaderBytes + 64, bytes.size() / 2,
+                          bytes.size() - 1})
+        expect_rejected(path, std::vector<char>(bytes.begin(), bytes.begin() + length), "truncated");
+    bv_free(bv);
+    std::remove(path.c_str());
+}
+
+TEST(BitvectorIo, RejectsCorruptedHeaders)
+{
+    std::string path = temp_path("corrupted");
+    bitvector *bv = test::to_bitvector(test::random_bits(50000, 500, 2));
+    std::vector<char> bytes, corrupted;
+
+    ASSERT_EQ(bv_save(bv, path.c_str()), 0);
+    bytes = read_file(path);
+
+    corrupted = bytes, corrupted[kMagicOffset] = 'X';
+    expect_rejected(path, corrupted, "magic");
+    corrupted = bytes, poke<uint32_t>(corrupted, kVersionOffset, BV_FILE_VERSION + 1);
+    expect_rejected(path, corrupted, "future version");
+    corrupted = bytes, poke<uint32_t>(corrupted, kHeaderBytesOffset, 64);
+    expect_rejected(path, corrupted, "header size");
+    corrupted = bytes, poke<uint64_t>(corrupted, kByteOrderOffset, 0x0807060504030201UL);
+    expect_rejected(path, corrupted, "byte order");
+    corrupted = bytes, poke<uint64_t>(corrupted, kSizeOffset, 1UL << 40);
+    expect_rejected(path, corrupted, "size past the file");
+    corrupted = bytes, poke<uint64_t>(corrupted, kOnesOffset, 50001);
+    expect_rejected(path, corrupted, "more ones than bits");
+    corrupted = bytes, poke<uint64_t>(corrupted, kDataOffset, kHeaderBytes + 8);
+    expect_rejected(path, corrupted, "misaligned data");
+    corrupted = bytes, poke<uint64_t>(corrupted, kNumL1Offset, 3);
+    expect_rejected(path, corrupted, "L1 count");
+    corrupted = bytes, poke<uint64_t>(corrupted, kSamplesOffset, 1UL << 50);
+    expect_rejected(path, corrupted, "samples past the file");
+    corrupted = bytes, poke<uint64_t>(corrupted, kNumSamples0Offset, 1000);
+    expect_rejected(path, corrupted, "select0 sample count");
+
+    /* the pristine bytes still open */
+    write_file(path, bytes);
+    bitvector *view = bv_mmap(path.c_str());
+    ASSERT_NE(view, nullptr);
+    EXPECT_TRUE(bv_equal(view, bv));
+    bv_free(view);
+    bv_free(bv);
+    std::remove(path.c_str());
+}
+
+TEST(BitvectorIo, RejectsCorruptedDirectories)
+{
+    std::string path = temp_path("corrupted_directories");
+    bitvector *bv = test::to_bitvector(test::random_bits(50000, 500, 3));
+    std::vector<char> bytes, corrupted;
+
+    ASSERT_EQ(bv_save(bv, path.c_str()), 0);
+    bytes = read_file(path);
+    size_t l0 = peek<uint64_t>(bytes, kL0Offset), samples = peek<uint64_t>(bytes, kSamplesOffset),
+           samples0 = peek<uint64_t>(bytes, kSamples0Offset);
+    uint64_t ones = peek<uint64_t>(bytes, kOnesOffset), num_l1 = peek<uint64_t>(bytes, kNumL1Offset);
+    ASSERT_GE(bv->select->num_samples, 3UL);
+    ASSERT_GE(bv->select->num_samples0, 3UL);
+
+    corrupted = bytes, poke<uint64_t>(corrupted, l0, ones + 1);
+    expect_rejected(path, corrupted, "L0 past the number of ones");
+    corrupted = bytes, poke<uint32_t>(corrupted, samples + 4, num_l1);
+    expect_rejected(path, corrupted, "sample past the L1 blocks");
+    corrupted = bytes, poke<uint32_t>(corrupted, samples + 8, 0);
+    expect_rejected(path, corrupted, "decreasing samples");
+    corrupted = bytes, poke<uint32_t>(corrupted, samples0 + 4, UINT32_MAX);
+    expect_rejected(path, corrupted, "select0 sample past the L1 blocks");
+    corrupted = bytes, poke<uint32_t>(corrupted, samples0 + 8, 0);
+    expect_rejected(path, corrupted, "decreasing select0 samples");
+
+    bv_free(bv);
+    std::remove(path.c_str());
+}
+
+TEST(BitvectorIo, CorruptedL1L2StaysInBounds)
+{
+    /* the L1/L2 entries are not validated at open; inflated counts must still keep select inside the vector */
+    std::string path = temp_path("corrupted_l1l2");
+    bitvector *bv = test::to_bitvector(test::random_bits(50000, 500, 5)), *view;
+    std::vector<char> bytes;
+
+    ASSERT_EQ(bv_save(bv, path.c_str()), 0);
+    bytes = read_file(path);
+    size_t l1l2 = peek<uint64_t>(bytes, kL1L2Offset);
+    uint64_t num_l1 = peek<uint64_t>(bytes, kNumL1Offset);
+    for (uint64_t j = 0; j < num_l1; j++)
+        poke<uint64_t>(bytes, l1l2 + 8 * j, (1023UL << 32) | (1023UL << 42) | (1023UL << 52) | (j << 12));
+    write_file(path, bytes);
+
+    view = bv_mmap(path.c_str());
+    ASSERT_NE(view, nullptr);
+    for (uint64_t k = 1; k <= 2 * bv_len(view); k += 97)
+    {
+        int64_t one = bv_select(view, k), zero = bv_select0(view, k);
+        ASSERT_LT(one, (int64_t)bv_len(view)) << "k " << k;
+        ASSERT_LT(zero, (int64_t)bv_len(view)) << "k " << k;
+    }
+    for (uint64_t pos = 0; pos < bv_len(view); pos += 97)
+        ASSERT_LT(bv_next_set(view, pos), (int64_t)bv_len(view)) << "pos " << pos;
+
+    bv_free(view);
+    bv_free(bv);
+    std::remove(path.c_str());
+}
+
+TEST(BitvectorIo, SaveRebuildsSnapshotDirectory)
+{
+    std::vector<bool> bits = test::random_bits(100000, 300, 4);
+    std::string path = temp_path("snapshot");
+    bitvector *bv = test::to_bitvector(bits), *view;
+
+    /* a BV_RANK_SNAPSHOT directory goes stale under writes; the file must describe the bits it holds */
+    bv_build_rank(bv);
+    bv_build_select(bv);
+    bv_set_rank_policy(bv, BV_RANK_SNAPSHOT);
+    for (uint64_t pos = 0; pos < bits.size(); pos += 7)
+    {
+        ASSERT_EQ(bv_set(bv, pos), BV_OK);
+        bits[pos] = true;
+    }
+
+    ASSERT_EQ(bv_save(bv, path.c_str()), 0);
+    view = bv_mmap(path.c_str());
+    ASSERT_NE(view, nullptr);
+    std::vector<uint64_t> ranks = test::naive_ranks(bits), ones = test::naive_positions(bits, true),
+                          zeros = test::naive_positions(bits, false);
+    for (uint64_t pos = 0; pos <= bits.size(); pos += 11)
+        ASSERT_EQ(bv_rank(view, pos), ranks[pos]) << "pos " << pos;
+    for (uint64_t k = 0; k < ones.size(); k += 17)
+        ASSERT_EQ(bv_select(view, k + 1), (int64_t)ones[k]) << "k " << k;
+    for (uint64_t k = 0; k < zeros.size(); k += 17)
+        ASSERT_EQ(bv_select0(view, k + 1), (int64_t)zeros[k]) << "k " << k;
+
+    bv_free(view);
+    bv_free(bv);
+    std::remove(path.c_str());
+}
@@ -0,0 +1,91 @@
+#include "test_utils.h"
+#include "bloom_filter.h"
+#include <algorithm>
+#include <memory>
+#include <unordered_set>
+
+/**
+ * The blocked Bloom filter: every inserted key is reported present, through single and batched calls alike, and the
+ * measured false-positive rate on keys never inserted stays close to bf_expected_fpr for a range of targets.
+ */
+
+static std::vector<uint64_t> random_keys(size_t n, uint64_t seed)
+{
+    std::mt19937_64 rng(seed);
+    std::vector<uint64_t> keys(n);
+
+    for (uint64_t &key : keys)
+        key = rng();
+    return keys;
+}
+
+TEST(BloomFilter, NoFalseNegatives)
+{
+    for (size_t n : {1UL, 100UL, 10000UL, 300000UL})
+    {
+        std::vector<uint64_t> keys = random_keys(n, n);
+        bloom_filter *single = bf_new_for(n, 0.01), *batched = bf_new_for(n, 0.01);
+        std::unique_ptr<bool[]> out(new bool[n]);
+
+        /* sequential keys too, which a weak hash would cluster */
+        for (size_t i = 0; i < n / 2; i++)
+            keys[i] = i;
+        for (uint64_t key : keys)
+            bf_insert(single, key);
+        bf_insert_batch(batched, keys.data(), keys.size());
+
+        EXPECT_EQ(single->num_keys, n);
+        EXPECT_EQ(batched->num_keys, n);
+        for (uint64_t key : keys)
+        {
+            ASSERT_TRUE(bf_contains(single, key)) << "key " << key;
+            ASSERT_TRUE(bf_contains(batched, key)) << "key " << key;
+        }
+        EXPECT_EQ(bf_contains_batch(single, keys.data(), n, out.get()), n);
+        for (size_t i = 0; i < n; i++)
+            ASSERT_TRUE(out[i]) << "key " << keys[i];
+
+        /* single and batched inserts set the same bits */
+        ASSERT_EQ(single->num_blocks, batched->num_blocks);
+        EXPECT_TRUE(std::equal(single->blocks, single->blocks + single->num_blocks * BF_BLOCK_WORDS, batched->blocks));
+        bf_free(single);
+        bf_free(batched);
+    }
+}
+
+TEST(BloomFilter, FalsePositiveRateNearModel)
+{
+    for (double target : {0.1, 0.01, 0.001})
+    {
+        size_t n = 100000, probes = 1000000;
+        std::vector<uint64_t> keys = random_keys(n, 1), others = random_keys(probes, 2);
+        std::unordered_set<uint64_t> inserted(keys.begin(), keys.end());
+        bloom_filter *bf = bf_new_for(n, target);
+        std::unique_ptr<bool[]> out(new bool[probes]);
+        size_t positives = 0, batched;
+        double expected = bf_expected_fpr(bf->num_blocks * BF_BLOCK_SIZE, n), measured;
+
+        bf_insert_batch(bf, keys.data(), n);
+        for (uint64_t key : others)
+            positives += !inserted.count(key) && bf_contains(bf, key);
+        batched = bf_contains_batch(bf, others.data(), probes, out.get());
+        measured = (double)positives / probes;
+
+        SCOPED_TRACE(testing::Message() << "target " << target << " expected " << expected << " measured " << measured);
+        EXPECT_LE(expected, target);
+        EXPECT_EQ(batched, positives);
+        EXPECT_LT(measured, 1.5 * expected + 1e-4);
+        EXPECT_GT(measured, expected / 1.5 - 1e-4);
+        EXPECT_GE(bf_bytes(bf), bf->num_blocks * BF_BLOCK_BYTES);
+        bf_free(bf);
+    }
+}
+
+TEST(BloomFilter, SizingIsMonotone)
+{
+    EXPECT_LT(bf_bits_for(1000, 0.1), bf_bits_for(1000, 0.01));
+    EXPECT_LT(bf_bits_for(1000, 0.01), bf_bits_for(10000, 0.01));
+    EXPECT_LE(bf_expected_fpr(bf_bits_for(5000, 0.02), 5000), 0.02);
+    EXPECT_GT(bf_expected_fpr(1 << 20, 100000), bf_expected_fpr(1 << 21, 100000));
+    EXPECT_EQ(bf_expected_fpr(1 << 20, 0), 0.0);
+}
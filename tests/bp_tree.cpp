@@ -0,0 +1,195 @@
+#include "test_utils.h"
+#include "bp_tree.h"
+
+/**
+ * The balanced-parentheses tree against a stack-based parse of the same parentheses: findclose, findopen and enclose
+ * at every parenthesis, the navigation functions at every node, and LCA of random pairs, for random trees, forests,
+ * paths deeper than a block and wide stars, and the errors for unbalanced input and misplaced positions.
+ */
+
+struct parsed
+{
+    std::vector<int64_t> match, parent, depth, id;
+    std::vector<uint64_t> preorder;
+};
+
+static parsed parse(const std::vector<bool> &parens)
+{
+    parsed p{std::vector<int64_t>(parens.size(), -1), std::vector<int64_t>(parens.size(), -1),
+             std::vector<int64_t>(parens.size(), 0), std::vector<int64_t>(parens.size(), -1), {}};
+    std::vector<uint64_t> stack;
+
+    for (uint64_t i = 0; i < parens.size(); i++)
+    {
+        if (parens[i])
+        {
+            p.parent[i] = stack.empty() ? -1 : (int64_t)stack.back();
+            p.depth[i] = (int64_t)stack.size() + 1;
+            p.id[i] = (int64_t)p.preorder.size();
+            p.preorder.push_back(i);
+            stack.push_back(i);
+        }
+        else
+        {
+            p.match[i] = (int64_t)stack.back();
+            p.match[stack.back()] = (int64_t)i;
+            stack.pop_back();
+        }
+    }
+    return p;
+}
+
+static int64_t naive_lca(const parsed &p, int64_t u, int64_t v)
+{
+    while (u != v && u >= 0 && v >= 0)
+    {
+        if (p.depth[u] >= p.depth[v])
+            u = p.parent[u];
+        else
+            v = p.parent[v];
+    }
+    return (u == v) ? u : -1;
+}
+
+/** a random forest of n nodes; `wrap` makes it a single tree */
+static std::vector<bool> random_forest(uint64_t n, uint64_t seed, bool wrap)
+{
+    std::mt19937_64 rng(seed);
+    std::vector<bool> parens;
+    uint64_t opened = 0, excess = 0;
+
+    if (wrap)
+        parens.push_back(true), n--;
+    while (opened < n || excess > 0)
+    {
+        if (opened < n && (excess == 0 || rng() % 2 == 0))
+            parens.push_back(true), opened++, excess++;
+        else
+            parens.push_back(false), excess--;
+    }
+    if (wrap)
+        parens.push_back(false);
+    return parens;
+}
+
+static std::vector<bool> path(uint64_t depth)
+{
+    std::vector<bool> parens(2 * depth, false);
+
+    std::fill(parens.begin(), parens.begin() + depth, true);
+    return parens;
+}
+
+static std::vector<bool> star(uint64_t leaves)
+{
+    std::vector<bool> parens = {true};
+
+    for (uint64_t i = 0; i < leaves; i++)
+        parens.push_back(true), parens.push_back(false);
+    parens.push_back(false);
+    return parens;
+}
+
+static void expect_tree(const std::vector<bool> &parens, uint64_t seed)
+{
+    parsed p = parse(parens);
+    bitvector *bv = test::to_bitvector(parens);
+    bp_tree *bp = bp_from_bitvector(bv);
+    std::mt19937_64 rng(seed);
+
+    bv_free(bv);
+    ASSERT_EQ(bp_num_nodes(bp), p.preorder.size());
+    for (uint64_t i = 0; i < parens.size(); i++)
+    {
+        if (!parens[i])
+        {
+            ASSERT_EQ(bp_find_open(bp, i), p.match[i]) << "close " << i;
+            continue;
+        }
+        int64_t close = p.match[i];
+
+        ASSERT_EQ(bp_find_close(bp, i), close) << "open " << i;
+        ASSERT_EQ(bp_enclose(bp, i), p.parent[i]) << "open " << i;
+        ASSERT_EQ(bp_parent(bp, i), p.parent[i]) << "open " << i;
+        ASSERT_EQ(bp_first_child(bp, i), parens[i + 1] ? (int64_t)i + 1 : -1) << "open " << i;
+        ASSERT_EQ(bp_next_sibling(bp, i),
+                  ((uint64_t)close + 1 < parens.size() && parens[close + 1]) ? close + 1 : -1) << "open " << i;
+        ASSERT_EQ(bp_subtree_size(bp, i), (uint64_t)(close - (int64_t)i + 1) / 2) << "open " << i;
+        ASSERT_EQ(bp_depth(bp, i), (uint64_t)p.depth[i]) << "open " << i;
+        ASSERT_EQ(bp_node_id(bp, i), (uint64_t)p.id[i]) << "open " << i;
+    }
+    for (uint64_t id = 0; id < p.preorder.size(); id++)
+        ASSERT_EQ(bp_node_pos(bp, id), (int64_t)p.preorder[id]) << "id " << id;
+    EXPECT_EQ(bp_node_pos(bp, p.preorder.size()), -1);
+
+    for (int i = 0; i < 2000 && !p.preorder.empty(); i++)
+    {
+        uint64_t u = p.preorder[rng() % p.preorder.size()], v = p.preorder[rng() % p.preorder.size()];
+
+        /* a node and its own ancestors, as well as unrelated pairs */
+        if (i % 4 == 0 && p.parent[v] >= 0)
+            u = (uint64_t)p.parent[v];
+        ASSERT_EQ(bp_lca(bp, u, v), naive_lca(p, (int64_t)u, (int64_t)v)) << "u " << u << " v " << v;
+        ASSERT_EQ(bp_lca(bp, v, u), naive_lca(p, (int64_t)u, (int64_t)v)) << "u " << u << " v " << v;
+    }
+    bp_free(bp);
+}
+
+TEST(BpTree, RandomTrees)
+{
+    for (uint64_t n : {1UL, 2UL, 100UL, 5000UL, 60000UL})
+    {
+        SCOPED_TRACE(testing::Message() << "nodes " << n);
+        expect_tree(random_forest(n, n, true), n);
+    }
+}
+
+TEST(BpTree, RandomForests)
+{
+    for (uint64_t n : {3UL, 1000UL, 40000UL})
+    {
+        SCOPED_TRACE(testing::Message() << "nodes " << n);
+        expect_tree(random_forest(n, n + 1, false), n);
+    }
+}
+
+TEST(BpTree, DeepAndWide)
+{
+    for (uint64_t n : {1UL, 63UL, 64UL, 65UL, 3000UL, 20000UL})
+    {
+        SCOPED_TRACE(testing::Message() << "n " << n);
+        expect_tree(path(n), n);
+        expect_tree(star(n), n);
+    }
+}
+
+TEST(BpTree, BracketedSubtrees)
+{
+    /* a long path whose nodes each hang a star, so searches leave and re-enter blocks at every level */
+    std::vector<bool> parens;
+
+    for (int i = 0; i < 500; i++)
+    {
+        std::vector<bool> leaves = star(i % 37);
+        parens.push_back(true);
+        parens.insert(parens.end(), leaves.begin(), leaves.end());
+    }
+    parens.insert(parens.end(), 500, false);
+    expect_tree(parens, 7);
+}
+
+TEST(BpTree, ReportsTheFailedCondition)
+{
+    /* unbalanced parentheses, and positions of the wrong kind of parenthesis, exit naming the whole check */
+    auto exits = ::testing::ExitedWithCode(EXIT_FAILURE);
+    bitvector *odd = test::to_bitvector({true, true, false});
+    EXPECT_EXIT(bp_from_bitvector(odd), exits, "n % 2 != 0 \\|\\| e != 0");
+    bv_free(odd);
+
+    bitvector *bv = test::to_bitvector({true, true, false, false});
+    bp_tree *bp = bp_from_bitvector(bv);
+    EXPECT_EXIT(bp_find_close(bp, 2), exits, "!bv_isset_unchecked");
+    EXPECT_EXIT(bp_find_open(bp, 0), exits, "\\|\\| bv_isset_unchecked");
+    bp_free(bp);
+    bv_free(bv);
+}
@@ -0,0 +1,155 @@
+#include "test_utils.h"
+#include "thread_pool.h"
+#include <atomic>
+#include <cstring>
+#include <thread>
+
+/**
+ * Rank directory construction: the parallel bv_build_rank gives the same directory on any number of threads, the
+ * streaming builder gives the directory bv_build_rank would, and both answer rank and select like prefix counts;
+ * parallel loops cover every item even while another thread changes the thread count.
+ */
+
+static void expect_same_directory(bitvector *a, bitvector *b)
+{
+    ASSERT_NE(a->rank, nullptr);
+    ASSERT_NE(b->rank, nullptr);
+    ASSERT_EQ(a->rank->ones, b->rank->ones);
+    ASSERT_EQ(a->rank->num_l0, b->rank->num_l0);
+    ASSERT_EQ(a->rank->num_l1, b->rank->num_l1);
+    EXPECT_EQ(std::memcmp(a->rank->l0, b->rank->l0, a->rank->num_l0 * sizeof(uint64_t)), 0);
+    EXPECT_EQ(std::memcmp(a->rank->l1l2, b->rank->l1l2, a->rank->num_l1 * sizeof(uint64_t)), 0);
+}
+
+static void expect_ranks(bitvector *bv, const std::vector<bool> &bits, uint64_t step)
+{
+    std::vector<uint64_t> ranks = test::naive_ranks(bits), ones = test::naive_positions(bits, true);
+
+    for (uint64_t pos = 0; pos <= bits.size(); pos += step)
+        ASSERT_EQ(bv_rank(bv, pos), ranks[pos]) << "pos " << pos;
+    ASSERT_EQ(bv_rank(bv, bits.size()), ones.size());
+    for (uint64_t k = 1; k <= ones.size(); k += step)
+        ASSERT_EQ(bv_select(bv, k), (int64_t)ones[k - 1]) << "k " << k;
+}
+
+class Build : public ::testing::Test
+{
+protected:
+    size_t saved_threads = bv_get_num_threads();
+
+    void TearDown() override { bv_set_num_threads(saved_threads); }
+};
+
+TEST_F(Build, ParallelMatchesSerial)
+{
+    /* several 1 MiB chunks and a partial one */
+    std::vector<bool> bits = test::random_bits(3 * (8UL << 20) + 12345, 400, 1);
+    bitvector *serial = test::to_bitvector(bits);
+
+    bv_set_num_threads(1);
+    bv_build_rank(serial);
+    expect_ranks(serial, bits, 997);
+    for (size_t threads : {2UL, 4UL, 7UL})
+    {
+        bitvector *parallel = test::to_bitvector(bits);
+
+        bv_set_num_threads(threads);
+        EXPECT_EQ(bv_get_num_threads(), threads);
+        bv_build_rank(parallel);
+        bv_build_select(parallel);
+        expect_same_directory(parallel, serial);
+        expect_ranks(parallel, bits, 997);
+        bv_free(parallel);
+    }
+    bv_free(serial);
+}
+
+TEST_F(Build, ParallelForCoversEveryItemOnce)
+{
+    for (size_t threads : {1UL, 3UL, 8UL})
+    {
+        bv_set_num_threads(threads);
+        for (size_t n : {0UL, 1UL, 999UL, 100000UL})
+        {
+            for (size_t grain : {1UL, 64UL, 1000000UL})
+            {
+                std::vector<std::atomic<int>> hits(n);
+
+                bv_parallel_for(n, grain, [](void *arg, size_t begin, size_t end) {
+                    auto *counts = static_cast<std::vector<std::atomic<int>> *>(arg);
+                    for (size_t i = begin; i < end; i++)
+                        (*counts)[i]++;
+                }, &hits);
+                for (size_t i = 0; i < n; i++)
+                    ASSERT_EQ(hits[i].load(), 1) << "threads " << threads << " n " << n << " grain " << grain;
+            }
+        }
+    }
+}
+
+TEST_F(Build, ParallelForWhileThreadsChange)
+{
+    /* one thread switches the thread count while others run parallel loops, each of which still covers every item */
+    std::atomic<bool> done{false};
+    std::thread changer([&] {
+        for (size_t i = 0; !done.load(); i++)
+            bv_set_num_threads(i % 4 + 1);
+    });
+    std::vector<std::thread> callers;
+
+    for (int t = 0; t < 3; t++)
+        callers.emplace_back([] {
+            for (int round = 0; round < 200; round++)
+            {
+                std::vector<std::atomic<int>> hits(5000);
+
+                bv_parallel_for(hits.size(), 16, [](void *arg, size_t begin, size_t end) {
+                    auto *counts = static_cast<std::vector<std::atomic<int>> *>(arg);
+                    for (size_t i = begin; i < end; i++)
+                        (*counts)[i]++;
+                }, &hits);
+                for (std::atomic<int> &hit : hits)
+                    ASSERT_EQ(hit.load(), 1);
+            }
+        });
+    for (std::thread &caller : callers)
+        caller.join();
+    done = true;
+    changer.join();
+}
+
+TEST_F(Build, StreamingBuilder)
+{
+    for (uint64_t size : {0UL, 1UL, 2047UL, 2048UL, 2049UL, 100000UL, (1UL << 22) + 3})
+    {
+        std::vector<bool> bits = test::random_bits(size, 300, size);
+        bv_builder *builder = bv_builder_new(size / 2);
+        std::mt19937_64 rng(size);
+        bitvector *built, *reference;
+        uint64_t i = 0;
+
+        /* alternate words of random widths with single pushes */
+        while (i < size)
+        {
+            unsigned nbits = std::min<uint64_t>(rng() % (WORD_SIZE + 1), size - i);
+            uint64_t word = (nbits < WORD_SIZE) ? rng() << nbits : 0; // bits above nbits must be ignored
+
+            for (unsigned j = 0; j < nbits; j++)
+                word |= (uint64_t)bits[i + j] << j;
+            bv_builder_append(builder, word, nbits);
+            i += nbits;
+            if (i < size)
+                bv_builder_push(builder, bits[i++]);
+        }
+        built = bv_builder_finish(builder);
+        reference = test::to_bitvector(bits);
+        bv_build_rank(reference);
+
+        ASSERT_EQ(bv_len(built), size);
+        EXPECT_EQ(test::to_bits(built), bits);
+        expect_same_directory(built, reference);
+        expect_ranks(built, bits, 61);
+        bv_free(built);
+        bv_free(reference);
+    }
+}
@@ -0,0 +1,108 @@
+#include "test_utils.h"
+
+/**
+ * The bulk operations measured by benchmarks/bulk_ops.cpp, under every instruction set `bv_use_isa` accepts,
+ * against bit-by-bit references. Lengths straddle the 4- and 8-word vector widths and operands differ in length.
+ */
+
+static const std::vector<std::pair<uint64_t, uint64_t>> kLengths = {
+    {0, 0}, {1, 1}, {64, 64}, {255, 256}, {257, 511}, {512, 512}, {1000, 1}, {4099, 8191}, {100003, 70001}};
+
+template <class Op>
+static void expect_binary(bitvector *(*fn)(bitvector *, bitvector *), Op op)
+{
+    test::isa_guard guard;
+
+    for (bv_isa isa : test::kIsas)
+    {
+        bv_use_isa(isa);
+        for (auto lengths : kLengths)
+        {
+            std::vector<bool> a = test::random_bits(lengths.first, 500, lengths.first),
+                              b = test::random_bits(lengths.second, 300, lengths.second + 1);
+            bitvector *va = test::to_bitvector(a), *vb = test::to_bitvector(b), *result = fn(va, vb);
+            uint64_t size = std::max(a.size(), b.size());
+
+            ASSERT_EQ(bv_len(result), size);
+            for (uint64_t i = 0; i < size; i++)
+            {
+                bool x = i < a.size() && a[i], y = i < b.size() && b[i];
+                ASSERT_EQ(bv_isset(result, i), op(x, y)) << "isa " << isa << " size " << size << " bit " << i;
+            }
+            /* the spare bits past the end stay clear, so whole-word popcounts are exact */
+            ASSERT_EQ(result->data[size / WORD_SIZE] >> (size % WORD_SIZE), 0UL);
+            bv_free(va);
+            bv_free(vb);
+            bv_free(result);
+        }
+    }
+}
+
+TEST(BulkOps, Xor)
+{
+    expect_binary(bv_xor, [](bool x, bool y) { return x != y; });
+}
+
+TEST(BulkOps, Intersection)
+{
+    expect_binary(bv_intersection, [](bool x, bool y) { return x && y; });
+}
+
+TEST(BulkOps, Union)
+{
+    expect_binary(bv_union, [](bool x, bool y) { return x || y; });
+}
+
+TEST(BulkOps, Difference)
+{
+    expect_binary(bv_difference, [](bool x, bool y) { return x && !y; });
+}
+
+TEST(BulkOps, ComplementAndHamming)
+{
+    test::isa_guard guard;
+
+    for (bv_isa isa : test::kIsas)
+    {
+        bv_use_isa(isa);
+        for (auto lengths : kLengths)
+        {
+            std::vector<bool> a = test::random_bits(lengths.first, 200, 3), b = test::random_bits(lengths.second, 700, 4);
+            bitvector *va = test::to_bitvector(a), *vb = test::to_bitvector(b), *complement = bv_complement(va);
+            uint64_t distance = 0;
+
+            ASSERT_EQ(bv_len(complement), a.size());
+            for (uint64_t i = 0; i < a.size(); i++)
+                ASSERT_EQ(bv_isset(complement, i), !a[i]) << "isa " << isa << " bit " << i;
+            ASSERT_EQ(complement->data[a.size() / WORD_SIZE] >> (a.size() % WORD_SIZE), 0UL);
+
+            for (uint64_t i = 0; i < std::max(a.size(), b.size()); i++)
+                distance += (i < a.size() && a[i]) != (i < b.size() && b[i]);
+            ASSERT_EQ(bv_hamming_distance(va, vb), distance) << "isa " << isa;
+            ASSERT_TRUE(bv_equal(va, va));
+            bv_free(va);
+            bv_free(vb);
+            bv_free(complement);
+        }
+    }
+}
+
+TEST(BulkOps, IsasAgree)
+{
+    test::isa_guard guard;
+    bitvector *a = test::to_bitvector(test::random_bits(1 << 16, 500, 5)),
+              *b = test::to_bitvector(test::random_bits((1 << 16) - 13, 500, 6)), *scalar, *other;
+
+    bv_use_isa(BV_ISA_SCALAR);
+    scalar = bv_xor(a, b);
+    for (bv_isa isa : test::kIsas)
+    {
+        bv_use_isa(isa);
+        other = bv_xor(a, b);
+        EXPECT_TRUE(bv_equal(scalar, other)) << "isa " << isa;
+        bv_free(other);
+    }
+    bv_free(a);
+    bv_free(b);
+    bv_free(scalar);
+}
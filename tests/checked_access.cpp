@@ -0,0 +1,220 @@
+#include "test_utils.h"
+#include "bitvector.hpp"
+#include <cstdio>
+
+/**
+ * The checked point, range and whole-vector writers: the status they return for positions out of range and for
+ * read-only views opened by bv_mmap, which must be left untouched, and the unchecked writers doing exactly what the checked ones do,
+ * rank directory included, under every rank policy.
+ */
+
+static std::string temp_path(const char *name)
+{
+    return ::testing::TempDir() + "rank_select_checked_" + name + ".bv";
+}
+
+TEST(CheckedAccess, OutOfRange)
+{
+    std::vector<bool> bits = test::random_bits(1000, 500, 1);
+    bitvector *bv = test::to_bitvector(bits), *other = bv_new(10);
+
+    for (uint64_t pos : {1000UL, 1001UL, 4096UL, UINT64_MAX})
+    {
+        EXPECT_EQ(bv_set(bv, pos), RS_CHECKED ? BV_EINDEX : BV_OK);
+        EXPECT_EQ(bv_clear(bv, pos), RS_CHECKED ? BV_EINDEX : BV_OK);
+        EXPECT_EQ(bv_toggle_checked(bv, pos), RS_CHECKED ? BV_EINDEX : BV_OK);
+        EXPECT_EQ(bv_toggle(bv, pos), !RS_CHECKED);
+        EXPECT_FALSE(bv_isset(bv, pos));
+        EXPECT_EQ(bv_check_index(bv, pos), BV_EINDEX);
+    }
+    EXPECT_EQ(bv_check_index(bv, 999), BV_OK);
+
+    EXPECT_EQ(bv_range_set(bv, 1, 10, 1001), BV_EINDEX);
+    EXPECT_EQ(bv_range_set(bv, 0, 20, 10), BV_EINDEX);
+    EXPECT_EQ(bv_range_flip(bv, 0, 1001), BV_EINDEX);
+    EXPECT_EQ(bv_range_flip(bv, 5, UINT64_MAX), BV_EINDEX);
+    EXPECT_EQ(bv_copy_range(bv, 995, other, 0, 10), BV_EINDEX);
+    EXPECT_EQ(bv_copy_range(other, 0, bv, 995, 10), BV_EINDEX);
+    EXPECT_EQ(bv_copy_range(bv, 0, other, 1, UINT64_MAX), BV_EINDEX);
+    EXPECT_EQ(test::to_bits(bv), bits);
+
+    EXPECT_EQ(bv_range_set(bv, 1, 1000, 1000), BV_OK);
+    EXPECT_EQ(bv_range_flip(bv, 0, 0), BV_OK);
+    EXPECT_EQ(bv_copy_range(bv, 1000, other, 10, 0), BV_OK);
+    EXPECT_EQ(test::to_bits(bv), bits);
+    bv_free(other);
+    bv_free(bv);
+}
+
+TEST(CheckedAccess, ReadOnlyView)
+{
+    std::vector<bool> bits = test::random_bits(100000, 300, 2);
+    std::string path = temp_path("read_only");
+    bitvector *bv = test::to_bitvector(bits), *view, *scratch = bv_new(1000);
+
+    ASSERT_EQ(bv_save(bv, path.c_str()), 0);
+    view = bv_mmap(path.c_str());
+    ASSERT_NE(view, nullptr);
+
+    if (RS_CHECKED)
+    {
+        for (uint64_t pos : {0UL, 1UL, 64UL, 99999UL})
+        {
+            EXPECT_EQ(bv_set(view, pos), BV_EREADONLY);
+            EXPECT_EQ(bv_clear(view, pos), BV_EREADONLY);
+            EXPECT_EQ(bv_toggle_checked(view, pos), BV_EREADONLY);
+            EXPECT_FALSE(bv_toggle(view, pos));
+        }
+        /* a bad position is reported before the view */
+        EXPECT_EQ(bv_set(view, 100000), BV_EINDEX);
+    }
+    EXPECT_EQ(bv_range_set(view, 1, 0, 100000), BV_EREADONLY);
+    EXPECT_EQ(bv_range_set(view, 0, 10, 11), BV_EREADONLY);
+    EXPECT_EQ(bv_range_flip(view, 0, 100000), BV_EREADONLY);
+    EXPECT_EQ(bv_range_flip(view, 7, 0), BV_EINDEX);
+    EXPECT_EQ(bv_copy_range(view, 0, scratch, 0, 1000), BV_EREADONLY);
+    EXPECT_EQ(test::to_bits(view), bits);
+    EXPECT_EQ(bv_rank(view, 100000), test::naive_rank(bits, 100000));
+
+    /* a view is a fine source */
+    EXPECT_EQ(bv_copy_range(scratch, 0, view, 500, 1000), BV_OK);
+    for (uint64_t i = 0; i < 1000; i++)
+        ASSERT_EQ(bv_isset(scratch, i), bits[500 + i]);
+
+    if (RS_CHECKED)
+    {
+        rs::bitvector wrapped = rs::bitvector::adopt(view);
+        EXPECT_THROW(wrapped.set(0), std::logic_error);
+        EXPECT_THROW(wrapped.flip(0), std::logic_error);
+        EXPECT_THROW(wrapped.set(100000), std::out_of_range);
+        EXPECT_TRUE(wrapped.test(bits.size() - 1) == bits.back());
+    }
+    else
+        bv_free(view);
+    bv_free(scratch);
+    bv_free(bv);
+    std::remove(path.c_str());
+}
+
+TEST(CheckedAccess, MappedDestination)
+{
+    std::vector<bool> bits = test::random_bits(10000, 400, 4);
+    std::string path = temp_path("mapped_destination");
+    bitvector *bv = test::to_bitvector(bits), *view, *other = test::to_bitvector(test::random_bits(5000, 500, 5));
+
+    ASSERT_EQ(bv_save(bv, path.c_str()), 0);
+    view = bv_mmap(path.c_str());
+    ASSERT_NE(view, nullptr);
+
+    /* every writer of a whole destination refuses the view before touching it, even when dst is its own operand */
+    EXPECT_EQ(bv_xor_into(view, bv, other), BV_EREADONLY);
+    EXPECT_EQ(bv_intersection_into(view, bv, other), BV_EREADONLY);
+    EXPECT_EQ(bv_union_into(view, bv, other), BV_EREADONLY);
+    EXPECT_EQ(bv_difference_into(view, bv, other), BV_EREADONLY);
+    EXPECT_EQ(bv_xor_inplace(view, other), BV_EREADONLY);
+    EXPECT_EQ(bv_intersection_inplace(view, other), BV_EREADONLY);
+    EXPECT_EQ(bv_union_inplace(view, other), BV_EREADONLY);
+    EXPECT_EQ(bv_difference_inplace(view, other), BV_EREADONLY);
+    EXPECT_EQ(bv_complement_into(view, bv), BV_EREADONLY);
+    EXPECT_EQ(bv_complement_inplace(view), BV_EREADONLY);
+    EXPECT_EQ(bv_copy_into(view, bv), BV_EREADONLY);
+    EXPECT_EQ(bv_copy_into(view, view), BV_EREADONLY);
+    EXPECT_EQ(bv_reverse_into(view, bv), BV_EREADONLY);
+    EXPECT_EQ(bv_reverse_inplace(view), BV_EREADONLY);
+    EXPECT_EQ(bv_lshift_into(view, bv, 3), BV_EREADONLY);
+    EXPECT_EQ(bv_lshift_inplace(view, 3), BV_EREADONLY);
+    EXPECT_EQ(bv_rshift_into(view, bv, 3), BV_EREADONLY);
+    EXPECT_EQ(bv_rshift_inplace(view, 3), BV_EREADONLY);
+    EXPECT_EQ(bv_rotate_into(view, bv, 3), BV_EREADONLY);
+    EXPECT_EQ(bv_rotate_inplace(view, 3), BV_EREADONLY);
+    EXPECT_EQ(bv_extend_into(view, bv, other), BV_EREADONLY);
+    EXPECT_EQ(bv_extend_inplace(view, other), BV_EREADONLY);
+    EXPECT_EQ(bv_resize(view, 5000), BV_EREADONLY);
+    EXPECT_EQ(bv_resize(view, bits.size()), BV_OK);
+
+    bv_expr leaf = {BV_EXPR_LEAF, other, 0, nullptr};
+    EXPECT_EQ(bv_eval_into(view, &leaf), BV_EREADONLY);
+    EXPECT_EQ(test::to_bits(view), bits);
+
+    /* on a writable destination they succeed */
+    bitvector *scratch = bv_new(0);
+    EXPECT_EQ(bv_xor_into(scratch, bv, other), BV_OK);
+    EXPECT_EQ(bv_rotate_inplace(scratch, 3), BV_OK);
+    EXPECT_EQ(bv_eval_into(scratch, &leaf), BV_OK);
+    EXPECT_EQ(bv_resize(scratch, 7), BV_OK);
+    bv_free(scratch);
+
+    /* the C++ assignments and resize throw instead, and the view stays usable */
+    rs::bitvector wrapped = rs::bitvector::adopt(view), operand = rs::bitvector::adopt(bv_copy(other));
+    EXPECT_THROW(wrapped = operand & operand, std::logic_error);
+    EXPECT_THROW(wrapped = ~wrapped, std::logic_error);
+    EXPECT_THROW(wrapped &= operand, std::logic_error);
+    EXPECT_THROW(wrapped |= operand, std::logic_error);
+    EXPECT_THROW(wrapped ^= operand, std::logic_error);
+    EXPECT_THROW(wrapped.resize(7), std::logic_error);
+    EXPECT_EQ(test::to_bits(wrapped.get()), bits);
+    EXPECT_EQ(bv_rank(wrapped.get(), 10000), test::naive_rank(bits, 10000));
+
+    bv_free(other);
+    bv_free(bv);
+    std::remove(path.c_str());
+}
+
+class CheckedAccessPolicy : public ::testing::TestWithParam<bv_rank_policy>
+{
+};
+
+TEST_P(CheckedAccessPolicy, UncheckedMatchesChecked)
+{
+    std::vector<bool> bits = test::random_bits(70000, 500, 3);
+    bitvector *checked = test::to_bitvector(bits), *unchecked = test::to_bitvector(bits);
+    uint64_t state = 3;
+
+    bv_build_rank(checked);
+    bv_build_rank(unchecked);
+    bv_set_rank_policy(checked, GetParam());
+    bv_set_rank_policy(unchecked, GetParam());
+    for (int i = 0; i < 20000; i++)
+    {
+        state = state * 6364136223846793005UL + 1442695040888963407UL;
+        uint64_t pos = (state >> 20) % bits.size();
+
+        switch ((state >> 60) % 3)
+        {
+        case 0:
+            ASSERT_EQ(bv_set(checked, pos), BV_OK);
+            bv_set_unchecked(unchecked, pos);
+            bits[pos] = true;
+            break;
+        case 1:
+            ASSERT_EQ(bv_clear(checked, pos), BV_OK);
+            bv_clear_unchecked(unchecked, pos);
+            bits[pos] = false;
+            break;
+        default:
+            ASSERT_TRUE(bv_toggle(checked, pos));
+            bv_toggle_unchecked(unchecked, pos);
+            bits[pos] = !bits[pos];
+            break;
+        }
+        ASSERT_EQ(bv_isset_unchecked(unchecked, pos), bits[pos]);
+    }
+
+    if (GetParam() == BV_RANK_SNAPSHOT)
+    {
+        bv_build_rank(checked);
+        bv_build_rank(unchecked);
+    }
+    std::vector<uint64_t> ranks = test::naive_ranks(bits);
+    EXPECT_TRUE(bv_equal(checked, unchecked));
+    EXPECT_EQ(test::to_bits(unchecked), bits);
+    for (uint64_t pos = 0; pos <= bits.size(); pos += 13)
+    {
+        ASSERT_EQ(bv_rank(checked, pos), ranks[pos]) << "pos " << pos;
+        ASSERT_EQ(bv_rank(unchecked, pos), ranks[pos]) << "pos " << pos;
+    }
+    bv_free(checked);
+    bv_free(unchecked);
+}
+
+INSTANTIATE_TEST_SUITE_P(Policies, CheckedAccessPolicy, ::testing::Values(BV_RANK_SNAPSHOT, BV_RANK_EAGER, BV_RANK_LAZY));
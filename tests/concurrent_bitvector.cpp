@@ -0,0 +1,266 @@
+#include "test_utils.h"
+#include "concurrent_bitvector.h"
+#include <atomic>
+#include <set>
+#include <thread>
+
+/**
+ * The concurrent bitvector under threads writing at once: concurrent sets, toggles and clears leave exactly the bits
+ * a serial replay would and a count equal to them, exactly one racing test-and-set wins each bit, the count never
+ * decreases while threads only set bits, it stays within the moves of every thread, it stays exact with more writer
+ * threads than counters, and out-of-range positions are refused.
+ */
+
+static const unsigned kThreads = 4;
+static const uint64_t kSize = 200000;
+
+template <class Body>
+static void run_threads(Body body)
+{
+    std::vector<std::thread> threads;
+
+    for (unsigned t = 0; t < kThreads; t++)
+        threads.emplace_back(body, t);
+    for (std::thread &thread : threads)
+        thread.join();
+}
+
+class ConcurrentBitvector : public ::testing::TestWithParam<cbv_order>
+{
+};
+
+TEST_P(ConcurrentBitvector, OverlappingSets)
+{
+    concurrent_bitvector *cbv = cbv_new(kSize);
+    std::vector<std::vector<uint64_t>> positions(kThreads);
+    std::set<uint64_t> all;
+
+    for (unsigned t = 0; t < kThreads; t++)
+    {
+        std::mt19937_64 rng(t);
+
+        /* neighbouring bits of one word, and the same bits from several threads */
+        for (int i = 0; i < 50000; i++)
+            positions[t].push_back((i % 2) ? rng() % kSize : rng() % 1000);
+        all.insert(positions[t].begin(), positions[t].end());
+    }
+    run_threads([&](unsigned t) {
+        for (uint64_t pos : positions[t])
+            ASSERT_EQ(cbv_set(cbv, pos, GetParam()), BV_OK);
+    });
+
+    EXPECT_EQ(cbv_count(cbv), all.size());
+    EXPECT_EQ(cbv_count_exact(cbv), all.size());
+    for (uint64_t pos : all)
+        ASSERT_TRUE(cbv_isset(cbv, pos, GetParam())) << "pos " << pos;
+    cbv_free(cbv);
+}
+
+TEST_P(ConcurrentBitvector, SharedToggles)
+{
+    /* thread t toggles every bit whose position is a multiple of t + 2, so threads share most words and many bits */
+    std::vector<bool> bits = test::random_bits(kSize, 500, 1);
+    bitvector *initial = test::to_bitvector(bits);
+    concurrent_bitvector *cbv = cbv_from_bitvector(initial);
+
+    bv_free(initial);
+    run_threads([&](unsigned t) {
+        for (uint64_t pos = 0; pos < kSize; pos += t + 2)
+            ASSERT_EQ(cbv_toggle(cbv, pos, GetParam()), BV_OK);
+    });
+
+    for (uint64_t pos = 0; pos < kSize; pos++)
+    {
+        for (unsigned t = 0; t < kThreads; t++)
+        {
+            if (pos % (t + 2) == 0)
+                bits[pos] = !bits[pos];
+        }
+    }
+    bitvector *result = cbv_to_bitvector(cbv);
+    EXPECT_EQ(test::to_bits(result), bits);
+    EXPECT_EQ(cbv_count(cbv), test::naive_rank(bits, kSize));
+    bv_free(result);
+    cbv_free(cbv);
+}
+
+TEST_P(ConcurrentBitvector, SetsAndClearsKeepTheCountExact)
+{
+    concurrent_bitvector *cbv = cbv_new(kSize);
+
+    /* each thread owns every kThreads-th word but sets and clears bits all over it */
+    run_threads([&](unsigned t) {
+        std::mt19937_64 rng(t + 10);
+        for (int i = 0; i < 100000; i++)
+        {
+            uint64_t word = (rng() % (kSize / WORD_SIZE / kThreads)) * kThreads + t, pos = word * WORD_SIZE + rng() % 64;
+            if (rng() % 3)
+                cbv_set(cbv, pos, GetParam());
+            else
+                cbv_clear(cbv, pos, GetParam());
+        }
+    });
+    EXPECT_EQ(cbv_count(cbv), cbv_count_exact(cbv));
+    cbv_free(cbv);
+}
+
+TEST_P(ConcurrentBitvector, OneTestAndSetWinsEachBit)
+{
+    concurrent_bitvector *cbv = cbv_new(kSize);
+    std::atomic<uint64_t> wins{0}, losses{0};
+
+    run_threads([&](unsigned t) {
+        uint64_t won = 0, lost = 0;
+        for (uint64_t i = 0; i < kSize; i++)
+        {
+            /* threads walk the bits in different orders */
+            uint64_t pos = (t % 2) ? i : kSize - 1 - i;
+            bool old = false;
+            ASSERT_EQ(cbv_test_and_set(cbv, pos, GetParam(), &old), BV_OK);
+            if (old)
+                lost++;
+            else
+                won++;
+        }
+        wins += won;
+        losses += lost;
+    });
+    EXPECT_EQ(wins.load(), kSize);
+    EXPECT_EQ(losses.load(), (kThreads - 1) * kSize);
+    EXPECT_EQ(cbv_count(cbv), kSize);
+    EXPECT_EQ(cbv_count_exact(cbv), kSize);
+
+    /* and one test-and-clear clears it */
+    wins = 0;
+    run_threads([&](unsigned) {
+        uint64_t won = 0;
+        for (uint64_t pos = 0; pos < kSize; pos++)
+        {
+            bool old = false;
+            ASSERT_EQ(cbv_test_and_clear(cbv, pos, GetParam(), &old), BV_OK);
+            won += old;
+        }
+        wins += won;
+    });
+    EXPECT_EQ(wins.load(), kSize);
+    EXPECT_EQ(cbv_count(cbv), 0UL);
+    EXPECT_EQ(cbv_count_exact(cbv), 0UL);
+    cbv_free(cbv);
+}
+
+TEST_P(ConcurrentBitvector, CountNeverDecreasesUnderSets)
+{
+    concurrent_bitvector *cbv = cbv_new(kSize);
+    std::atomic<bool> done{false};
+    std::thread reader([&] {
+        uint64_t last = 0;
+        while (!done.load())
+        {
+            uint64_t now = cbv_count(cbv);
+            ASSERT_GE(now, last);
+            last = now;
+        }
+    });
+
+    run_threads([&](unsigned t) {
+        for (uint64_t pos = t; pos < kSize; pos += kThreads)
+            cbv_set(cbv, pos, GetParam());
+    });
+    done = true;
+    reader.join();
+    EXPECT_EQ(cbv_count(cbv), kSize);
+    cbv_free(cbv);
+}
+
+TEST_P(ConcurrentBitvector, CountFollowsEachThreadsWrites)
+{
+    /*
+     * each thread moves one bit back and forth between the two ends of the vector, setting the new bit before
+     * clearing the old, so at any instant kThreads to 2 * kThreads bits are set; every count lands in that range,
+     * snapshot or not, because the changes of a thread reach its counter in order
+     */
+    const uint64_t kFar = kSize - kThreads;
+    concurrent_bitvector *cbv = cbv_new(kSize);
+    std::atomic<bool> done{false};
+
+    run_threads([&](unsigned t) { cbv_set(cbv, t, GetParam()); });
+    std::thread reader([&] {
+        while (!done.load())
+        {
+            uint64_t now = cbv_count(cbv);
+            ASSERT_GE(now, kThreads);
+            ASSERT_LE(now, 2 * kThreads);
+        }
+    });
+
+    run_threads([&](unsigned t) {
+        for (int i = 0; i < 100000; i++)
+        {
+            cbv_set(cbv, kFar + t, GetParam());
+            cbv_clear(cbv, t, GetParam());
+            cbv_set(cbv, t, GetParam());
+            cbv_clear(cbv, kFar + t, GetParam());
+        }
+    });
+    done = true;
+    reader.join();
+    EXPECT_EQ(cbv_count(cbv), kThreads);
+    EXPECT_EQ(cbv_count_exact(cbv), kThreads);
+    cbv_free(cbv);
+}
+
+TEST_P(ConcurrentBitvector, MoreThreadsThanCounters)
+{
+    /* threads past CBV_NUM_COUNTERS share a counter, and the counters of exited threads pass to later ones */
+    const uint64_t kWriters = CBV_NUM_COUNTERS + 36, kBitsPerWriter = 500;
+    concurrent_bitvector *cbv = cbv_new(kSize);
+
+    for (uint64_t wave = 0; wave < 3; wave++)
+    {
+        std::vector<std::thread> threads;
+
+        for (uint64_t t = 0; t < kWriters; t++)
+            threads.emplace_back([&, t] {
+                for (uint64_t k = 0; k < kBitsPerWriter; k++)
+                {
+                    uint64_t pos = t * kBitsPerWriter + k;
+                    if (wave == 1)
+                        cbv_clear(cbv, pos, GetParam());
+                    else
+                        cbv_toggle(cbv, pos, GetParam());
+                }
+            });
+        for (std::thread &thread : threads)
+            thread.join();
+        EXPECT_EQ(cbv_count(cbv), (wave == 1) ? 0 : kWriters * kBitsPerWriter) << "wave " << wave;
+    }
+    EXPECT_EQ(cbv_count_exact(cbv), kWriters * kBitsPerWriter);
+    cbv_free(cbv);
+}
+
+INSTANTIATE_TEST_SUITE_P(Orders, ConcurrentBitvector, ::testing::Values(CBV_RELAXED, CBV_ACQ_REL));
+
+TEST(ConcurrentBitvectorErrors, OutOfRange)
+{
+    concurrent_bitvector *cbv = cbv_new(100);
+
+    EXPECT_EQ(cbv_set(cbv, 100, CBV_RELAXED), BV_EINDEX);
+    EXPECT_EQ(cbv_clear(cbv, 1000, CBV_RELAXED), BV_EINDEX);
+    EXPECT_EQ(cbv_toggle(cbv, UINT64_MAX, CBV_ACQ_REL), BV_EINDEX);
+    EXPECT_FALSE(cbv_isset(cbv, 100, CBV_ACQ_REL));
+    EXPECT_EQ(cbv_count(cbv), 0UL);
+    EXPECT_EQ(cbv_set(cbv, 99, CBV_RELAXED), BV_OK);
+    EXPECT_EQ(cbv_count(cbv), 1UL);
+    EXPECT_EQ(cbv_count_exact(cbv), 1UL);
+
+    /* a refused test-and-modify leaves its out-parameter alone */
+    bool old = true;
+    EXPECT_EQ(cbv_test_and_set(cbv, 100, CBV_RELAXED, &old), RS_CHECKED ? BV_EINDEX : BV_OK);
+    EXPECT_EQ(cbv_test_and_clear(cbv, UINT64_MAX, CBV_ACQ_REL, &old), RS_CHECKED ? BV_EINDEX : BV_OK);
+    EXPECT_TRUE(old);
+    EXPECT_EQ(cbv_test_and_clear(cbv, 99, CBV_ACQ_REL, &old), BV_OK);
+    EXPECT_TRUE(old);
+    EXPECT_EQ(cbv_test_and_set(cbv, 99, CBV_RELAXED, &old), BV_OK);
+    EXPECT_FALSE(old);
+    cbv_free(cbv);
+}
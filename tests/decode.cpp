@@ -0,0 +1,126 @@
+#include "test_utils.h"
+#include "word_kernels.h"
+
+/**
+ * Set-bit iteration and bulk decoding against the positions of the set bits: bv_next_set and bv_prev_set at every
+ * position with and without a rank directory, also after writes that leave a snapshot directory stale, and bv_decode_positions and words_decode under every instruction set
+ * over ranges that start and end anywhere inside a word.
+ */
+
+TEST(Decode, NextAndPrevSet)
+{
+    for (uint64_t density : {0UL, 1UL, 100UL, 999UL})
+    {
+        /* long gaps cross several L1 blocks, so the select jumps are taken */
+        std::vector<bool> bits = test::random_bits(50000, density, density);
+        std::vector<uint64_t> ranks = test::naive_ranks(bits), ones = test::naive_positions(bits, true);
+        bitvector *bv = test::to_bitvector(bits);
+
+        for (bool indexed : {false, true})
+        {
+            if (indexed)
+                bv_build_select(bv);
+            for (uint64_t pos = 0; pos < bits.size(); pos++)
+            {
+                int64_t next = (ranks[pos] < ones.size()) ? (int64_t)ones[ranks[pos]] : -1,
+                        prev = (ranks[pos + 1] > 0) ? (int64_t)ones[ranks[pos + 1] - 1] : -1;
+
+                ASSERT_EQ(bv_next_set(bv, pos), next) << "pos " << pos << " indexed " << indexed;
+                ASSERT_EQ(bv_prev_set(bv, pos), prev) << "pos " << pos << " indexed " << indexed;
+            }
+            EXPECT_EQ(bv_next_set(bv, bits.size()), -1);
+            EXPECT_EQ(bv_prev_set(bv, bits.size() + 1000), ones.empty() ? -1 : (int64_t)ones.back());
+        }
+        bv_free(bv);
+    }
+}
+
+TEST(Decode, NextAndPrevSetAfterSnapshotWrites)
+{
+    /* the writes leave the BV_RANK_SNAPSHOT directory behind the data, so the jumps must not trust it */
+    bitvector *bv = bv_new(10000);
+
+    bv_set(bv, 100);
+    bv_set(bv, 9000);
+    bv_build_rank(bv);
+    bv_clear(bv, 9000);
+    EXPECT_EQ(bv_next_set(bv, 101), -1);
+    EXPECT_EQ(bv_prev_set(bv, 9999), 100);
+
+    bv_set(bv, 5000);
+    EXPECT_EQ(bv_next_set(bv, 101), 5000);
+    EXPECT_EQ(bv_next_set(bv, 5001), -1);
+    EXPECT_EQ(bv_prev_set(bv, 9999), 5000);
+    EXPECT_EQ(bv_prev_set(bv, 4999), 100);
+
+    bv_range_set(bv, 1, 7000, 7100);
+    EXPECT_EQ(bv_next_set(bv, 5001), 7000);
+    EXPECT_EQ(bv_prev_set(bv, 9999), 7099);
+
+    /* a rebuild makes the directory current again */
+    bv_build_rank(bv);
+    EXPECT_EQ(bv_next_set(bv, 101), 5000);
+    EXPECT_EQ(bv_next_set(bv, 7100), -1);
+    EXPECT_EQ(bv_prev_set(bv, 6999), 5000);
+    bv_free(bv);
+}
+
+TEST(Decode, DecodePositions)
+{
+    test::isa_guard guard;
+    std::vector<bool> bits = test::random_bits(20000, 400, 1);
+    std::vector<uint64_t> ranks = test::naive_ranks(bits), ones = test::naive_positions(bits, true);
+    bitvector *bv = test::to_bitvector(bits);
+    std::vector<uint32_t> out(bits.size() + 1);
+
+    for (bv_isa isa : test::kIsas)
+    {
+        bv_use_isa(isa);
+        for (uint64_t from : {0UL, 1UL, 63UL, 64UL, 1000UL, 19999UL, 20000UL})
+        {
+            for (uint64_t length : {0UL, 1UL, 63UL, 64UL, 65UL, 640UL, 5000UL, 30000UL})
+            {
+                uint64_t to = from + length, end = std::min<uint64_t>(to, bits.size());
+                size_t n = bv_decode_positions(bv, from, to, out.data());
+
+                ASSERT_EQ(n, ranks[std::max(from, end)] - ranks[from]) << "isa " << isa << " from " << from;
+                for (size_t i = 0; i < n; i++)
+                    ASSERT_EQ(from + out[i], ones[ranks[from] + i]) << "isa " << isa << " from " << from;
+            }
+        }
+    }
+    bv_free(bv);
+}
+
+TEST(Decode, WordsDecode)
+{
+    test::isa_guard guard;
+    std::mt19937_64 rng(2);
+
+    for (bv_isa isa : test::kIsas)
+    {
+        bv_use_isa(isa);
+        for (size_t n = 0; n <= 40; n++)
+        {
+            std::vector<uint64_t> words(n + 1);
+            std::vector<uint32_t> out(64 * n + 1), expected;
+            uint32_t base = (n % 3 == 2) ? UINT32_MAX - 100 : (uint32_t)(n * 1000);
+
+            /* empty, full and random words */
+            for (size_t i = 1; i <= n; i++)
+                words[i] = (i % 5 == 0) ? 0 : (i % 7 == 0) ? ~0UL : rng() & rng();
+            for (size_t i = 1; i <= n; i++)
+            {
+                for (uint32_t j = 0; j < 64; j++)
+                {
+                    if (words[i] >> j & 1)
+                        expected.push_back(base + 64 * (uint32_t)(i - 1) + j);
+                }
+            }
+            ASSERT_EQ(words_decode(out.data(), words.data() + 1, n, base), expected.size()) << "isa " << isa;
+            out.resize(expected.size());
+            ASSERT_EQ(out, expected) << "isa " << isa << " n " << n;
+            out.resize(64 * n + 1);
+        }
+    }
+}
@@ -0,0 +1,124 @@
+#include "test_utils.h"
+#include "dynamic_bitvector.h"
+
+/**
+ * The B+-tree dynamic bitvector against a std::vector<bool> receiving the same insertions, deletions and writes:
+ * trees deep enough for inner nodes to split, borrow and merge, checked after every batch of updates with rank,
+ * select and select0 at every position.
+ */
+
+static void expect_holds(dynamic_bitvector *dbv, const std::vector<bool> &bits)
+{
+    std::vector<uint64_t> ranks = test::naive_ranks(bits), ones = test::naive_positions(bits, true),
+                          zeros = test::naive_positions(bits, false);
+    bitvector *bv;
+
+    ASSERT_EQ(dbv_len(dbv), bits.size());
+    ASSERT_EQ(dbv_count(dbv), ones.size());
+    for (uint64_t pos = 0; pos < bits.size(); pos++)
+        ASSERT_EQ(dbv_isset(dbv, pos), bits[pos]) << "pos " << pos;
+    for (uint64_t pos = 0; pos <= bits.size(); pos++)
+        ASSERT_EQ(dbv_rank(dbv, pos), ranks[pos]) << "pos " << pos;
+    EXPECT_EQ(dbv_rank(dbv, bits.size() + 100), ones.size());
+    for (uint64_t k = 1; k <= ones.size(); k++)
+        ASSERT_EQ(dbv_select(dbv, k), (int64_t)ones[k - 1]) << "k " << k;
+    for (uint64_t k = 1; k <= zeros.size(); k++)
+        ASSERT_EQ(dbv_select0(dbv, k), (int64_t)zeros[k - 1]) << "k " << k;
+    EXPECT_EQ(dbv_select(dbv, 0), -1);
+    EXPECT_EQ(dbv_select(dbv, ones.size() + 1), -1);
+    EXPECT_EQ(dbv_select0(dbv, zeros.size() + 1), -1);
+
+    bv = dbv_to_bitvector(dbv);
+    EXPECT_EQ(test::to_bits(bv), bits);
+    bv_free(bv);
+}
+
+TEST(DynamicBitvector, Empty)
+{
+    dynamic_bitvector *dbv = dbv_new();
+
+    expect_holds(dbv, {});
+    dbv_insert(dbv, 0, true);
+    expect_holds(dbv, {true});
+    EXPECT_TRUE(dbv_delete(dbv, 0));
+    expect_holds(dbv, {});
+    dbv_free(dbv);
+}
+
+TEST(DynamicBitvector, RandomUpdates)
+{
+    /* 300K bits are three inner levels deep */
+    std::vector<bool> bits = test::random_bits(300000, 500, 1);
+    bitvector *bv = test::to_bitvector(bits);
+    dynamic_bitvector *dbv = dbv_from_bitvector(bv);
+    std::mt19937_64 rng(2);
+
+    bv_free(bv);
+    expect_holds(dbv, bits);
+    EXPECT_GE(dbv->height, 3UL);
+    for (int batch = 0; batch < 6; batch++)
+    {
+        for (int op = 0; op < 2000; op++)
+        {
+            bool bit = rng() & 1;
+            uint64_t pos = rng() % (bits.size() + 1);
+
+            switch (rng() % 4)
+            {
+            case 0:
+                dbv_insert(dbv, pos, bit);
+                bits.insert(bits.begin() + pos, bit);
+                break;
+            case 1:
+                if (pos == bits.size())
+                    break;
+                ASSERT_EQ(dbv_delete(dbv, pos), bits[pos]);
+                bits.erase(bits.begin() + pos);
+                break;
+            case 2:
+                if (pos == bits.size())
+                    break;
+                dbv_assign(dbv, pos, bit);
+                bits[pos] = bit;
+                break;
+            default:
+                dbv_push(dbv, bit);
+                bits.push_back(bit);
+            }
+        }
+        expect_holds(dbv, bits);
+    }
+    dbv_free(dbv);
+}
+
+TEST(DynamicBitvector, GrowThenShrinkToEmpty)
+{
+    /* inserting at the front and in the middle splits leaves and inner nodes; deleting everything merges them */
+    dynamic_bitvector *dbv = dbv_new();
+    std::vector<bool> bits;
+    std::mt19937_64 rng(3);
+
+    for (uint64_t i = 0; i < 40000; i++)
+    {
+        bool bit = rng() % 3 == 0;
+        uint64_t pos = (i % 2) ? 0 : bits.size() / 2;
+
+        dbv_insert(dbv, pos, bit);
+        bits.insert(bits.begin() + pos, bit);
+    }
+    expect_holds(dbv, bits);
+    EXPECT_GE(dbv->height, 1UL);
+    EXPECT_GE(dbv_bytes(dbv), bits.size() / 8);
+
+    while (!bits.empty())
+    {
+        uint64_t pos = rng() % bits.size();
+
+        ASSERT_EQ(dbv_delete(dbv, pos), bits[pos]);
+        bits.erase(bits.begin() + pos);
+        if (bits.size() % 10000 == 0)
+            expect_holds(dbv, bits);
+    }
+    EXPECT_EQ(dbv->height, 0UL);
+    dbv_free(dbv);
+}
@@ -0,0 +1,87 @@
+#include "test_utils.h"
+#include "elias_fano.h"
+
+/**
+ * The Elias-Fano encoding against the plain bits it encodes: rank, select, successor, predecessor and isset at every
+ * position, for densities that give anywhere from zero to a dozen low bits per position, built from positions,
+ * from a bitvector and one push at a time.
+ */
+
+static void expect_encodes(elias_fano *ef, const std::vector<bool> &bits)
+{
+    std::vector<uint64_t> ones = test::naive_positions(bits, true), ranks = test::naive_ranks(bits);
+    bitvector *decoded;
+
+    ASSERT_EQ(ef_len(ef), bits.size());
+    ASSERT_EQ(ef_count(ef), ones.size());
+    for (uint64_t pos = 0; pos <= bits.size(); pos++)
+        ASSERT_EQ(ef_rank(ef, pos), ranks[pos]) << "pos " << pos;
+    for (uint64_t pos = 0; pos < bits.size(); pos++)
+    {
+        ASSERT_EQ(ef_isset(ef, pos), bits[pos]) << "pos " << pos;
+        ASSERT_EQ(ef_successor(ef, pos), (ranks[pos] < ones.size()) ? (int64_t)ones[ranks[pos]] : -1) << "pos " << pos;
+        ASSERT_EQ(ef_predecessor(ef, pos), (ranks[pos + 1] > 0) ? (int64_t)ones[ranks[pos + 1] - 1] : -1) << "pos " << pos;
+    }
+    for (uint64_t k = 1; k <= ones.size(); k++)
+        ASSERT_EQ(ef_select(ef, k), (int64_t)ones[k - 1]) << "k " << k;
+    EXPECT_EQ(ef_select(ef, 0), -1);
+    EXPECT_EQ(ef_select(ef, ones.size() + 1), -1);
+
+    decoded = ef_to_bitvector(ef);
+    EXPECT_EQ(test::to_bits(decoded), bits);
+    bv_free(decoded);
+}
+
+TEST(EliasFano, FromPositions)
+{
+    for (uint64_t size : {1UL, 64UL, 1000UL, 70000UL})
+    {
+        for (uint64_t density : {0UL, 1UL, 30UL, 500UL, 1000UL})
+        {
+            std::vector<bool> bits = test::random_bits(size, density, size + density);
+            std::vector<uint64_t> ones = test::naive_positions(bits, true);
+            elias_fano *ef = ef_from_positions(ones.data(), ones.size(), size);
+
+            expect_encodes(ef, bits);
+            ef_free(ef);
+        }
+    }
+}
+
+TEST(EliasFano, FromBitvectorAndPush)
+{
+    std::vector<bool> bits = test::random_bits(200000, 5, 7);
+    std::vector<uint64_t> ones = test::naive_positions(bits, true);
+    bitvector *bv = test::to_bitvector(bits);
+    elias_fano *from_bv = ef_from_bitvector(bv), *pushed = ef_new(ones.size(), bits.size());
+
+    for (uint64_t pos : ones)
+        ef_push(pushed, pos);
+    ef_seal(pushed);
+
+    expect_encodes(from_bv, bits);
+    expect_encodes(pushed, bits);
+    EXPECT_LT(ef_bytes(from_bv), bits.size() / 8);
+    ef_free(from_bv);
+    ef_free(pushed);
+    bv_free(bv);
+}
+
+TEST(EliasFano, ClusteredPositions)
+{
+    /* long gaps followed by dense runs, so whole high buckets are empty or full */
+    std::vector<bool> bits(300000);
+
+    for (uint64_t start : {0UL, 8191UL, 65536UL, 299000UL})
+    {
+        for (uint64_t i = start; i < start + 1000; i++)
+            bits[i] = true;
+    }
+    bits.back() = true;
+
+    std::vector<uint64_t> ones = test::naive_positions(bits, true);
+    elias_fano *ef = ef_from_positions(ones.data(), ones.size(), bits.size());
+
+    expect_encodes(ef, bits);
+    ef_free(ef);
+}
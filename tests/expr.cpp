@@ -0,0 +1,168 @@
+#include "test_utils.h"
+#include <algorithm>
+#include <deque>
+
+/**
+ * Expression evaluation against a recursive bit-by-bit evaluation of the same tree: random AND/OR/ANDNOT trees over
+ * operands of different lengths spanning several tiles, some empty over whole tiles so the early exits are taken,
+ * through bv_eval, bv_eval_into (including into an operand) and bv_eval_count under every instruction set.
+ */
+
+static const uint64_t kTileBits = BV_EXPR_TILE_WORDS * WORD_SIZE;
+
+/** owns the nodes and child arrays of random expression trees */
+struct forest
+{
+    std::vector<std::vector<bool>> bits;
+    std::vector<bitvector *> vectors;
+    std::deque<bv_expr> nodes;
+    std::deque<std::vector<const bv_expr *>> children;
+
+    explicit forest(uint64_t seed)
+    {
+        std::mt19937_64 rng(seed);
+
+        for (int i = 0; i < 8; i++)
+        {
+            uint64_t size = (i == 0) ? 0 : rng() % (3 * kTileBits) + 1;
+            std::vector<bool> b = test::random_bits(size, (i % 3 == 0) ? 2 : 500, seed + i);
+
+            /* clear whole tiles of some operands */
+            if (i % 2 == 1 && size > kTileBits)
+                std::fill(b.begin(), b.begin() + kTileBits, false);
+            bits.push_back(b);
+            vectors.push_back(test::to_bitvector(b));
+        }
+    }
+
+    ~forest()
+    {
+        for (bitvector *bv : vectors)
+            bv_free(bv);
+    }
+
+    const bv_expr *leaf(size_t i)
+    {
+        nodes.push_back({BV_EXPR_LEAF, vectors[i], 0, nullptr});
+        return &nodes.back();
+    }
+
+    const bv_expr *random_tree(std::mt19937_64 &rng, int depth)
+    {
+        if (depth == 0 || rng() % 4 == 0)
+            return leaf(rng() % vectors.size());
+
+        std::vector<const bv_expr *> kids(1 + rng() % 4);
+        for (const bv_expr *&kid : kids)
+            kid = random_tree(rng, depth - 1);
+        children.push_back(kids);
+        nodes.push_back({(bv_expr_op)(BV_EXPR_AND + rng() % 3), nullptr, kids.size(), children.back().data()});
+        return &nodes.back();
+    }
+
+    /** the length of the longest leaf under expr */
+    uint64_t length(const bv_expr *expr) const
+    {
+        uint64_t longest = 0;
+
+        if (expr->op == BV_EXPR_LEAF)
+            return bv_len(expr->bv);
+        for (size_t i = 0; i < expr->num_children; i++)
+            longest = std::max(longest, length(expr->children[i]));
+        return longest;
+    }
+
+    bool naive(const bv_expr *expr, uint64_t pos) const
+    {
+        if (expr->op == BV_EXPR_LEAF)
+        {
+            size_t i = std::find(vectors.begin(), vectors.end(), expr->bv) - vectors.begin();
+            return pos < bits[i].size() && bits[i][pos];
+        }
+        bool result = naive(expr->children[0], pos);
+        for (size_t i = 1; i < expr->num_children; i++)
+        {
+            bool operand = naive(expr->children[i], pos);
+            result = (expr->op == BV_EXPR_AND) ? result && operand
+                     : (expr->op == BV_EXPR_OR) ? result || operand
+                                                : result && !operand;
+        }
+        return result;
+    }
+
+    std::vector<bool> naive(const bv_expr *expr) const
+    {
+        std::vector<bool> result(length(expr));
+
+        for (uint64_t pos = 0; pos < result.size(); pos++)
+            result[pos] = naive(expr, pos);
+        return result;
+    }
+};
+
+TEST(Expr, RandomTrees)
+{
+    test::isa_guard guard;
+    forest f(1);
+    std::mt19937_64 rng(2);
+
+    for (int tree = 0; tree < 60; tree++)
+    {
+        const bv_expr *expr = f.random_tree(rng, 3);
+        std::vector<bool> expected = f.naive(expr);
+
+        for (bv_isa isa : test::kIsas)
+        {
+            bv_use_isa(isa);
+            bitvector *result = bv_eval(expr), *dst = bv_new(77);
+
+            SCOPED_TRACE(testing::Message() << "tree " << tree << " isa " << isa);
+            ASSERT_EQ(test::to_bits(result), expected);
+            ASSERT_EQ(bv_count_range(result, 1, 0, bv_len(result)), test::naive_rank(expected, expected.size()));
+            ASSERT_EQ(bv_eval_count(expr), test::naive_rank(expected, expected.size()));
+            bv_eval_into(dst, expr);
+            ASSERT_EQ(test::to_bits(dst), expected);
+            bv_free(result);
+            bv_free(dst);
+        }
+    }
+}
+
+TEST(Expr, IntoAnOperand)
+{
+    forest f(3);
+
+    for (bv_expr_op op : {BV_EXPR_AND, BV_EXPR_OR, BV_EXPR_ANDNOT})
+    {
+        for (size_t target = 1; target < f.vectors.size(); target++)
+        {
+            const bv_expr *kids[] = {f.leaf(target), f.leaf((target + 1) % f.vectors.size()), f.leaf(target)};
+            bv_expr expr = {op, nullptr, 3, kids};
+            std::vector<bool> expected = f.naive(&expr);
+
+            /* the operand is overwritten, so compare before and restore after */
+            bv_eval_into(f.vectors[target], &expr);
+            ASSERT_EQ(test::to_bits(f.vectors[target]), expected) << "op " << op << " target " << target;
+            bv_free(f.vectors[target]);
+            f.vectors[target] = test::to_bitvector(f.bits[target]);
+        }
+    }
+}
+
+TEST(Expr, SingleLeafAndSingleChild)
+{
+    forest f(4);
+
+    for (size_t i = 0; i < f.vectors.size(); i++)
+    {
+        const bv_expr *leaf = f.leaf(i), *kids[] = {leaf};
+        bv_expr expr = {BV_EXPR_ANDNOT, nullptr, 1, kids};
+        bitvector *copy = bv_eval(leaf), *same = bv_eval(&expr);
+
+        EXPECT_TRUE(bv_equal(copy, f.vectors[i]));
+        EXPECT_TRUE(bv_equal(same, f.vectors[i]));
+        EXPECT_EQ(bv_eval_count(leaf), test::naive_rank(f.bits[i], f.bits[i].size()));
+        bv_free(copy);
+        bv_free(same);
+    }
+}
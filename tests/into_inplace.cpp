@@ -0,0 +1,105 @@
+#include "test_utils.h"
+
+/**
+ * The `_into` and `_inplace` forms of the set operations against bit-by-bit references: into fresh destinations of
+ * every length, into destinations aliasing either operand, and in place, with a rank directory to drop.
+ */
+
+typedef bv_status (*into_fn)(bitvector *, bitvector *, bitvector *);
+typedef bv_status (*inplace_fn)(bitvector *, bitvector *);
+
+struct binary_case
+{
+    into_fn into;
+    inplace_fn inplace;
+    bool (*op)(bool, bool);
+};
+
+static const binary_case kCases[] = {
+    {bv_xor_into, bv_xor_inplace, [](bool x, bool y) { return x != y; }},
+    {bv_intersection_into, bv_intersection_inplace, [](bool x, bool y) { return x && y; }},
+    {bv_union_into, bv_union_inplace, [](bool x, bool y) { return x || y; }},
+    {bv_difference_into, bv_difference_inplace, [](bool x, bool y) { return x && !y; }},
+};
+
+static std::vector<bool> naive(const std::vector<bool> &a, const std::vector<bool> &b, bool (*op)(bool, bool))
+{
+    std::vector<bool> result(std::max(a.size(), b.size()));
+
+    for (uint64_t i = 0; i < result.size(); i++)
+        result[i] = op(i < a.size() && a[i], i < b.size() && b[i]);
+    return result;
+}
+
+TEST(IntoInplace, FreshDestination)
+{
+    for (const binary_case &c : kCases)
+    {
+        for (uint64_t dst_size : {0UL, 100UL, 5000UL, 100000UL})
+        {
+            std::vector<bool> a = test::random_bits(3001, 500, 1), b = test::random_bits(4097, 400, 2);
+            bitvector *va = test::to_bitvector(a), *vb = test::to_bitvector(b), *dst = bv_new(dst_size);
+
+            bv_build_rank(dst);
+            c.into(dst, va, vb);
+            EXPECT_EQ(dst->rank, nullptr);
+            EXPECT_EQ(test::to_bits(dst), naive(a, b, c.op)) << "dst size " << dst_size;
+            EXPECT_EQ(dst->data[bv_len(dst) / WORD_SIZE] >> (bv_len(dst) % WORD_SIZE), 0UL);
+            EXPECT_EQ(test::to_bits(va), a);
+            EXPECT_EQ(test::to_bits(vb), b);
+            bv_free(va);
+            bv_free(vb);
+            bv_free(dst);
+        }
+    }
+}
+
+TEST(IntoInplace, AliasedDestination)
+{
+    for (const binary_case &c : kCases)
+    {
+        for (auto sizes : {std::make_pair(3001UL, 4097UL), std::make_pair(4097UL, 3001UL), std::make_pair(640UL, 640UL)})
+        {
+            std::vector<bool> a = test::random_bits(sizes.first, 500, 3), b = test::random_bits(sizes.second, 600, 4);
+            bitvector *va = test::to_bitvector(a), *vb = test::to_bitvector(b);
+
+            c.into(va, va, vb);
+            EXPECT_EQ(test::to_bits(va), naive(a, b, c.op));
+            bv_free(va);
+
+            va = test::to_bitvector(a);
+            c.into(vb, va, vb);
+            EXPECT_EQ(test::to_bits(vb), naive(a, b, c.op));
+            bv_free(vb);
+
+            vb = test::to_bitvector(b);
+            c.inplace(va, vb);
+            EXPECT_EQ(test::to_bits(va), naive(a, b, c.op));
+            EXPECT_EQ(test::to_bits(vb), b);
+            bv_free(va);
+            bv_free(vb);
+        }
+    }
+}
+
+TEST(IntoInplace, ComplementAndCopy)
+{
+    for (uint64_t size : {0UL, 1UL, 64UL, 65UL, 3001UL})
+    {
+        std::vector<bool> a = test::random_bits(size, 300, size), expected(a);
+        bitvector *va = test::to_bitvector(a), *dst = bv_new(17);
+
+        expected.flip();
+        bv_complement_into(dst, va);
+        EXPECT_EQ(test::to_bits(dst), expected);
+        EXPECT_EQ(dst->data[size / WORD_SIZE] >> (size % WORD_SIZE), 0UL);
+
+        bv_copy_into(dst, va);
+        EXPECT_TRUE(bv_equal(dst, va));
+
+        bv_complement_inplace(va);
+        EXPECT_EQ(test::to_bits(va), expected);
+        bv_free(va);
+        bv_free(dst);
+    }
+}
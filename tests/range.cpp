@@ -0,0 +1,148 @@
+#include "test_utils.h"
+
+/**
+ * The range writers and counters against bit-by-bit loops: bv_range_set, bv_range_flip and bv_copy_range over ranges
+ * that start and end anywhere in a word, including overlapping copies within one bitvector, bv_count_range and
+ * bv_rank_range over the same ranges, and BV_EINDEX with nothing written for ranges outside the bitvector.
+ */
+
+static const uint64_t kSize = 5000;
+
+static std::vector<std::pair<uint64_t, uint64_t>> ranges()
+{
+    std::vector<std::pair<uint64_t, uint64_t>> result;
+
+    for (uint64_t from : {0UL, 1UL, 63UL, 64UL, 65UL, 127UL, 1000UL, kSize - 1, kSize})
+    {
+        for (uint64_t length : {0UL, 1UL, 2UL, 62UL, 63UL, 64UL, 65UL, 128UL, 129UL, 2000UL})
+        {
+            if (from + length <= kSize)
+                result.push_back({from, from + length});
+        }
+    }
+    result.push_back({0, kSize});
+    return result;
+}
+
+TEST(Range, SetAndFlip)
+{
+    std::vector<bool> bits = test::random_bits(kSize, 500, 1);
+    bitvector *bv = test::to_bitvector(bits);
+
+    for (auto [from, to] : ranges())
+    {
+        for (uint8_t bit : {0, 1})
+        {
+            ASSERT_EQ(bv_range_set(bv, bit, from, to), BV_OK);
+            for (uint64_t i = from; i < to; i++)
+                bits[i] = bit;
+            ASSERT_EQ(test::to_bits(bv), bits) << "set " << (int)bit << " [" << from << ", " << to << ")";
+        }
+        ASSERT_EQ(bv_range_flip(bv, from / 2, to), BV_OK);
+        for (uint64_t i = from / 2; i < to; i++)
+            bits[i] = !bits[i];
+        ASSERT_EQ(test::to_bits(bv), bits) << "flip [" << from / 2 << ", " << to << ")";
+    }
+    /* the spare bits past the end stay clear */
+    EXPECT_EQ(bv_count_range(bv, 1, 0, bv_len(bv)), test::naive_rank(bits, kSize));
+    bv_free(bv);
+}
+
+TEST(Range, Counts)
+{
+    std::vector<bool> bits = test::random_bits(kSize, 300, 2);
+    std::vector<uint64_t> ranks = test::naive_ranks(bits);
+    bitvector *bv = test::to_bitvector(bits);
+
+    bv_build_rank(bv);
+    for (auto [from, to] : ranges())
+    {
+        uint64_t ones = ranks[to] - ranks[from];
+
+        ASSERT_EQ(bv_count_range(bv, 1, from, to), ones) << "[" << from << ", " << to << ")";
+        ASSERT_EQ(bv_count_range(bv, 0, from, to), to - from - ones) << "[" << from << ", " << to << ")";
+        ASSERT_EQ(bv_rank_range(bv, from, to), ones) << "[" << from << ", " << to << ")";
+    }
+    /* ends past the bitvector are clamped, empty and reversed ranges count nothing */
+    EXPECT_EQ(bv_count_range(bv, 1, 100, kSize + 1000), ranks[kSize] - ranks[100]);
+    EXPECT_EQ(bv_rank_range(bv, 100, kSize + 1000), ranks[kSize] - ranks[100]);
+    EXPECT_EQ(bv_rank_range(bv, 300, 200), 0UL);
+    bv_free(bv);
+}
+
+TEST(Range, CopyBetweenBitvectors)
+{
+    std::vector<bool> src_bits = test::random_bits(kSize, 500, 3);
+    bitvector *src = test::to_bitvector(src_bits);
+
+    for (auto [from, end] : ranges())
+    {
+        for (uint64_t to : {0UL, 1UL, 64UL, 100UL, 4000UL})
+        {
+            uint64_t n = end - from;
+            std::vector<bool> dst_bits = test::random_bits(kSize, 400, to);
+            bitvector *dst = test::to_bitvector(dst_bits);
+
+            if (to + n > kSize)
+            {
+                ASSERT_EQ(bv_copy_range(dst, to, src, from, n), BV_EINDEX);
+            }
+            else
+            {
+                ASSERT_EQ(bv_copy_range(dst, to, src, from, n), BV_OK);
+                for (uint64_t i = 0; i < n; i++)
+                    dst_bits[to + i] = src_bits[from + i];
+            }
+            ASSERT_EQ(test::to_bits(dst), dst_bits) << "from " << from << " to " << to << " n " << n;
+            bv_free(dst);
+        }
+    }
+    EXPECT_EQ(test::to_bits(src), src_bits);
+    bv_free(src);
+}
+
+TEST(Range, CopyOverlapping)
+{
+    std::vector<bool> original = test::random_bits(kSize, 500, 4);
+
+    for (uint64_t from : {0UL, 3UL, 64UL, 70UL})
+    {
+        for (uint64_t to : {0UL, 1UL, 5UL, 64UL, 130UL})
+        {
+            for (uint64_t n : {1UL, 63UL, 64UL, 200UL, 3000UL})
+            {
+                std::vector<bool> bits(original), window(original.begin() + from, original.begin() + from + n);
+                bitvector *bv = test::to_bitvector(original);
+
+                ASSERT_EQ(bv_copy_range(bv, to, bv, from, n), BV_OK);
+                for (uint64_t i = 0; i < n; i++)
+                    bits[to + i] = window[i];
+                ASSERT_EQ(test::to_bits(bv), bits) << "from " << from << " to " << to << " n " << n;
+                bv_free(bv);
+            }
+        }
+    }
+}
+
+TEST(Range, OutOfBoundsWritesNothing)
+{
+    std::vector<bool> bits = test::random_bits(kSize, 500, 5);
+    bitvector *bv = test::to_bitvector(bits), *other = bv_new(10);
+
+    EXPECT_EQ(bv_range_set(bv, 1, 0, kSize + 1), BV_EINDEX);
+    EXPECT_EQ(bv_range_set(bv, 0, 10, 9), BV_EINDEX);
+    EXPECT_EQ(bv_range_flip(bv, kSize + 1, kSize + 2), BV_EINDEX);
+    EXPECT_EQ(bv_range_flip(bv, 100, 50), BV_EINDEX);
+    EXPECT_EQ(bv_copy_range(bv, 0, other, 5, 6), BV_EINDEX);
+    EXPECT_EQ(bv_copy_range(other, 5, bv, 0, 6), BV_EINDEX);
+    EXPECT_EQ(bv_copy_range(bv, 0, bv, 1, UINT64_MAX), BV_EINDEX);
+    EXPECT_EQ(test::to_bits(bv), bits);
+    EXPECT_EQ(bv_count_range(other, 1, 0, 10), 0UL);
+
+    EXPECT_EQ(bv_range_set(bv, 1, kSize, kSize), BV_OK);
+    EXPECT_EQ(bv_range_flip(bv, 0, 0), BV_OK);
+    EXPECT_EQ(bv_copy_range(other, 10, bv, kSize, 0), BV_OK);
+    EXPECT_EQ(test::to_bits(bv), bits);
+    bv_free(bv);
+    bv_free(other);
+}
@@ -0,0 +1,97 @@
+#include "test_utils.h"
+#include <algorithm>
+
+/**
+ * bv_rank, with and without the Poppy directory, against a bit-by-bit count: at every position of small vectors,
+ * around basic-block and L1-block boundaries, and across the first L0 boundary at 2^32 bits.
+ */
+
+static void expect_ranks(bitvector *bv, const std::vector<bool> &bits, uint64_t pos)
+{
+    uint64_t ones = test::naive_rank(bits, pos), clamped = std::min<uint64_t>(pos, bits.size());
+
+    ASSERT_EQ(bv_rank(bv, pos), ones) << "pos " << pos;
+    ASSERT_EQ(clamped - bv_rank(bv, pos), test::naive_rank(bits, pos, false)) << "pos " << pos;
+}
+
+TEST(Rank, EmptyVector)
+{
+    bitvector *bv = bv_new(0);
+
+    EXPECT_EQ(bv_rank(bv, 0), 0UL);
+    bv_build_rank(bv);
+    EXPECT_EQ(bv_rank(bv, 0), 0UL);
+    EXPECT_EQ(bv_rank(bv, 100), 0UL);
+    bv_free(bv);
+}
+
+TEST(Rank, EveryPositionMatchesNaive)
+{
+    for (uint64_t size : {1UL, 63UL, 64UL, 65UL, 511UL, 512UL, 513UL, 2047UL, 2048UL, 2049UL, 10000UL})
+    {
+        for (uint64_t density : {0UL, 1UL, 500UL, 999UL, 1000UL})
+        {
+            std::vector<bool> bits = test::random_bits(size, density, size + density);
+            bitvector *bv = test::to_bitvector(bits);
+
+            /* the linear fallback, then the directory */
+            for (uint64_t pos = 0; pos <= size + 1; pos++)
+                expect_ranks(bv, bits, pos);
+            bv_build_rank(bv);
+            for (uint64_t pos = 0; pos <= size + 1; pos++)
+                expect_ranks(bv, bits, pos);
+            EXPECT_EQ(bv_pop_count(bv, size - 1), test::naive_rank(bits, size));
+            bv_free(bv);
+        }
+    }
+}
+
+TEST(Rank, BlockBoundaries)
+{
+    const uint64_t size = 1UL << 20;
+    std::vector<bool> bits = test::random_bits(size, 500, 7);
+    bitvector *bv = test::to_bitvector(bits);
+    std::vector<uint64_t> prefix(size + 1, 0);
+
+    for (uint64_t i = 0; i < size; i++)
+        prefix[i + 1] = prefix[i] + bits[i];
+    bv_build_rank(bv);
+    for (uint64_t block = 0; block <= size; block += BIT << LOG_BASIC_BLOCK_SIZE)
+    {
+        for (uint64_t pos = (block > 0) ? block - 1 : 0; pos <= std::min(block + 1, size); pos++)
+            ASSERT_EQ(bv_rank(bv, pos), prefix[pos]) << "pos " << pos;
+    }
+    for (uint64_t from = 0; from < size; from += 4093)
+        ASSERT_EQ(bv_rank_range(bv, from, from + 5000), prefix[std::min(from + 5000, size)] - prefix[from]);
+    EXPECT_EQ(bv_rank(bv, size), prefix[size]);
+    EXPECT_GT(bv_index_bytes(bv), 0UL);
+    bv_free(bv);
+}
+
+TEST(Rank, AcrossL0Boundary)
+{
+    /** 2^32 + a few L1 blocks of bits, sparse except for a dense run straddling the L0 boundary **/
+
+    const uint64_t l0 = BIT << LOG_L0_BLOCK_SIZE, size = l0 + 3 * (BIT << LOG_L1_BLOCK_SIZE) + 17;
+    bitvector *bv = bv_new(size);
+    std::vector<uint64_t> ones;
+
+    for (uint64_t pos = 5; pos < size; pos += 1000003)
+        ones.push_back(pos);
+    for (uint64_t pos = l0 - 3000; pos < l0 + 3000; pos += 3)
+        ones.push_back(pos);
+    ones.push_back(size - 1);
+    std::sort(ones.begin(), ones.end());
+    ones.erase(std::unique(ones.begin(), ones.end()), ones.end());
+    for (uint64_t pos : ones)
+        bv_set(bv, pos);
+
+    bv_build_rank(bv);
+    for (uint64_t pos : {0UL, 1UL, l0 - 2049, l0 - 2048, l0 - 1, l0, l0 + 1, l0 + 2047, l0 + 2048, l0 + 2049, size - 1, size})
+    {
+        uint64_t expected = std::lower_bound(ones.begin(), ones.end(), pos) - ones.begin();
+        EXPECT_EQ(bv_rank(bv, pos), expected) << "pos " << pos;
+        EXPECT_EQ(std::min(pos, size) - bv_rank(bv, pos), std::min(pos, size) - expected) << "pos " << pos;
+    }
+    bv_free(bv);
+}
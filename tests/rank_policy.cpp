@@ -0,0 +1,180 @@
+#include "test_utils.h"
+#include <algorithm>
+
+/**
+ * The three rank policies under interleaved point writes, range writes and queries: BV_RANK_EAGER and BV_RANK_LAZY
+ * keep rank, select and select0 equal to prefix counts of the current bits after every write, and BV_RANK_SNAPSHOT
+ * does once the directory is rebuilt.
+ */
+
+static void expect_current(bitvector *bv, const std::vector<bool> &bits, uint64_t seed)
+{
+    std::vector<uint64_t> ranks = test::naive_ranks(bits), ones = test::naive_positions(bits, true),
+                          zeros = test::naive_positions(bits, false);
+    std::mt19937_64 rng(seed);
+
+    ASSERT_EQ(bv_rank(bv, bits.size()), ones.size());
+    for (int i = 0; i < 200; i++)
+    {
+        uint64_t pos = rng() % (bits.size() + 1);
+        ASSERT_EQ(bv_rank(bv, pos), ranks[pos]) << "pos " << pos;
+    }
+    for (int i = 0; i < 50 && !ones.empty(); i++)
+    {
+        uint64_t k = rng() % ones.size() + 1;
+        ASSERT_EQ(bv_select(bv, k), (int64_t)ones[k - 1]) << "k " << k;
+    }
+    for (int i = 0; i < 50 && !zeros.empty(); i++)
+    {
+        uint64_t k = rng() % zeros.size() + 1;
+        ASSERT_EQ(bv_select0(bv, k), (int64_t)zeros[k - 1]) << "k " << k;
+    }
+    ASSERT_EQ(bv_select(bv, ones.size() + 1), -1);
+}
+
+/** one random point, direct or range write, applied to both bv and bits */
+static void random_write(bitvector *bv, std::vector<bool> &bits, std::mt19937_64 &rng)
+{
+    uint64_t pos = rng() % bits.size(), to = std::min<uint64_t>(pos + rng() % 5000, bits.size());
+
+    switch (rng() % 6)
+    {
+    case 0:
+        bv_set(bv, pos);
+        bits[pos] = true;
+        break;
+    case 1:
+        bv_clear(bv, pos);
+        bits[pos] = false;
+        break;
+    case 2:
+        bv_toggle(bv, pos);
+        bits[pos] = !bits[pos];
+        break;
+    case 3:
+        /* a direct write, reported by the caller */
+        bv->data[pos >> LOG_WORD_SIZE] ^= BIT << (pos & (WORD_SIZE - 1));
+        bits[pos] = !bits[pos];
+        bv_rank_update(bv, pos, bits[pos]);
+        break;
+    case 4:
+    {
+        uint8_t bit = rng() & 1;
+        bv_range_set(bv, bit, pos, to);
+        for (uint64_t i = pos; i < to; i++)
+            bits[i] = bit;
+        break;
+    }
+    default:
+        bv_range_flip(bv, pos, to);
+        for (uint64_t i = pos; i < to; i++)
+            bits[i] = !bits[i];
+    }
+}
+
+class RankPolicy : public ::testing::TestWithParam<bv_rank_policy>
+{
+};
+
+TEST_P(RankPolicy, InterleavedWritesAndQueries)
+{
+    std::vector<bool> bits = test::random_bits((1UL << 20) + 777, 500, 1);
+    bitvector *bv = test::to_bitvector(bits);
+    std::mt19937_64 rng(2);
+
+    bv_build_select(bv);
+    bv_set_rank_policy(bv, GetParam());
+    for (int round = 0; round < 40; round++)
+    {
+        /* bursts of writes of growing length between queries */
+        for (int write = 0; write < round * round; write++)
+            random_write(bv, bits, rng);
+        if (GetParam() == BV_RANK_SNAPSHOT)
+            bv_build_rank(bv);
+        expect_current(bv, bits, round);
+    }
+
+    bv_sync_rank(bv);
+    EXPECT_EQ(test::to_bits(bv), bits);
+    bv_free(bv);
+}
+
+TEST_P(RankPolicy, MatchesRebuiltDirectory)
+{
+    std::vector<bool> bits = test::random_bits(300000, 300, 3);
+    bitvector *bv = test::to_bitvector(bits), *rebuilt;
+    std::mt19937_64 rng(4);
+
+    bv_build_rank(bv);
+    bv_set_rank_policy(bv, GetParam());
+    for (int write = 0; write < 3000; write++)
+        random_write(bv, bits, rng);
+    bv_sync_rank(bv);
+    if (GetParam() == BV_RANK_SNAPSHOT)
+        bv_build_rank(bv);
+
+    rebuilt = test::to_bitvector(bits);
+    bv_build_rank(rebuilt);
+    ASSERT_EQ(bv->rank->ones, rebuilt->rank->ones);
+    ASSERT_EQ(bv->rank->num_l1, rebuilt->rank->num_l1);
+    for (uint64_t j = 0; j < bv->rank->num_l1; j++)
+        ASSERT_EQ(bv->rank->l1l2[j], rebuilt->rank->l1l2[j]) << "L1 entry " << j;
+    bv_free(rebuilt);
+    bv_free(bv);
+}
+
+TEST_P(RankPolicy, SwitchingPolicies)
+{
+    std::vector<bool> bits = test::random_bits(100000, 500, 5);
+    bitvector *bv = test::to_bitvector(bits);
+    std::mt19937_64 rng(6);
+
+    bv_build_select(bv);
+    bv_set_rank_policy(bv, BV_RANK_LAZY);
+    for (int write = 0; write < 500; write++)
+        random_write(bv, bits, rng);
+    /* switching applies the pending repairs */
+    bv_set_rank_policy(bv, GetParam());
+    if (GetParam() != BV_RANK_SNAPSHOT)
+    {
+        for (int write = 0; write < 500; write++)
+            random_write(bv, bits, rng);
+    }
+    expect_current(bv, bits, 7);
+    bv_free(bv);
+}
+
+INSTANTIATE_TEST_SUITE_P(Policies, RankPolicy,
+                         ::testing::Values(BV_RANK_SNAPSHOT, BV_RANK_EAGER, BV_RANK_LAZY));
+
+TEST(RankPolicyL0, WritesAcrossL0Boundary)
+{
+    /* eager writes below 2^32 shift the second L0 counter; lazy repairs must shift it too */
+    uint64_t l0 = BIT << LOG_L0_BLOCK_SIZE, size = l0 + 4096;
+    std::vector<uint64_t> positions = {5, l0 - 2049, l0 - 1, l0, l0 + 1, l0 + 2048, size - 1};
+
+    for (bv_rank_policy policy : {BV_RANK_EAGER, BV_RANK_LAZY})
+    {
+        bitvector *bv = bv_new(size);
+
+        bv_build_select(bv);
+        bv_set_rank_policy(bv, policy);
+        for (uint64_t i = 0; i < positions.size(); i++)
+        {
+            bv_set(bv, positions[i]);
+            for (uint64_t j = 0; j < positions.size(); j++)
+                ASSERT_EQ(bv_rank(bv, positions[j] + 1), std::min(i, j) + 1) << "policy " << policy;
+            ASSERT_EQ(bv_select(bv, i + 1), (int64_t)positions[i]);
+
+            /* l0 + 2 is never set, so it is the zero following the l0 + 2 - (set bits below it) zeros before it */
+            uint64_t below = std::count_if(positions.begin(), positions.begin() + i + 1,
+                                           [&](uint64_t p) { return p < l0 + 2; });
+            ASSERT_EQ(bv_select0(bv, l0 + 2 - below + 1), (int64_t)(l0 + 2)) << "policy " << policy;
+        }
+        bv_clear(bv, l0);
+        bv_toggle(bv, 5);
+        EXPECT_EQ(bv_rank(bv, size), positions.size() - 2);
+        EXPECT_EQ(bv_rank(bv, l0 + 1), 2UL);
+        bv_free(bv);
+    }
+}
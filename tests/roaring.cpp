@@ -0,0 +1,199 @@
+#include "test_utils.h"
+#include "roaring.h"
+#include <set>
+
+/**
+ * Roaring bitmaps against the plain bits they hold. Every chunk of the operands is filled with one of a handful of
+ * patterns that land in array, bitmap and run containers, so each set operation meets every pair of container kinds,
+ * including a missing container on either side and a partial last chunk.
+ */
+
+enum chunk_pattern
+{
+    EMPTY,
+    SPARSE, // an array container
+    DENSE,  // a bitmap container
+    RUNS,   // a run container
+    FULL,   // a single run covering the chunk
+    NUM_PATTERNS
+};
+
+static void fill_chunk(std::vector<bool> &bits, uint64_t chunk, chunk_pattern pattern, uint64_t seed)
+{
+    std::mt19937_64 rng(seed);
+    uint64_t start = chunk * RB_CHUNK_BITS, end = std::min<uint64_t>(start + RB_CHUNK_BITS, bits.size());
+
+    for (uint64_t i = start; i < end; i++)
+    {
+        switch (pattern)
+        {
+        case SPARSE:
+            bits[i] = rng() % 1000 < 20;
+            break;
+        case DENSE:
+            bits[i] = rng() % 1000 < 500;
+            break;
+        case RUNS:
+            bits[i] = (i - start + seed * 1000) % 9000 < 3000;
+            break;
+        case FULL:
+            bits[i] = true;
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+/** a.size() bits whose chunk i follows pattern i % NUM_PATTERNS, b's chunk i pattern (i / NUM_PATTERNS) */
+static std::pair<std::vector<bool>, std::vector<bool>> every_pair(uint64_t a_size, uint64_t b_size)
+{
+    std::vector<bool> a(a_size), b(b_size);
+
+    for (uint64_t chunk = 0; chunk * RB_CHUNK_BITS < std::max(a_size, b_size); chunk++)
+    {
+        fill_chunk(a, chunk, (chunk_pattern)(chunk % NUM_PATTERNS), chunk);
+        fill_chunk(b, chunk, (chunk_pattern)(chunk / NUM_PATTERNS % NUM_PATTERNS), chunk + 1000);
+    }
+    return {a, b};
+}
+
+static std::vector<bool> naive(const std::vector<bool> &a, const std::vector<bool> &b, bool (*op)(bool, bool))
+{
+    std::vector<bool> result(std::max(a.size(), b.size()));
+
+    for (uint64_t i = 0; i < result.size(); i++)
+        result[i] = op(i < a.size() && a[i], i < b.size() && b[i]);
+    return result;
+}
+
+static void expect_holds(roaring_bitmap *rb, const std::vector<bool> &bits)
+{
+    std::vector<uint64_t> ones = test::naive_positions(bits, true), ranks = test::naive_ranks(bits);
+    bitvector *bv = rb_to_bitvector(rb);
+
+    ASSERT_EQ(rb_len(rb), bits.size());
+    ASSERT_EQ(rb_count(rb), ones.size());
+    ASSERT_EQ(test::to_bits(bv), bits);
+    for (uint64_t i = 0; i < rb->num_containers; i++)
+        ASSERT_GE(rb->containers[i].cardinality, 1U);
+    for (uint64_t pos = 0; pos <= bits.size(); pos += 61)
+        ASSERT_EQ(rb_rank(rb, pos), ranks[pos]) << "pos " << pos;
+    ASSERT_EQ(rb_rank(rb, bits.size()), ones.size());
+    for (uint64_t pos = 0; pos < bits.size(); pos += 59)
+        ASSERT_EQ(rb_isset(rb, pos), bits[pos]) << "pos " << pos;
+    for (uint64_t k = 1; k <= ones.size(); k += 37)
+        ASSERT_EQ(rb_select(rb, k), (int64_t)ones[k - 1]) << "k " << k;
+    if (!ones.empty())
+        ASSERT_EQ(rb_select(rb, ones.size()), (int64_t)ones.back());
+    EXPECT_EQ(rb_select(rb, 0), -1);
+    EXPECT_EQ(rb_select(rb, ones.size() + 1), -1);
+    bv_free(bv);
+}
+
+static roaring_bitmap *from_bits(const std::vector<bool> &bits)
+{
+    bitvector *bv = test::to_bitvector(bits);
+    roaring_bitmap *rb = rb_from_bitvector(bv);
+
+    bv_free(bv);
+    return rb;
+}
+
+TEST(Roaring, ConvertsEveryPattern)
+{
+    std::vector<bool> bits = every_pair(NUM_PATTERNS * RB_CHUNK_BITS + 1234, 0).first;
+    roaring_bitmap *rb = from_bits(bits);
+    std::set<rb_container_type> kinds;
+
+    for (uint64_t i = 0; i < rb->num_containers; i++)
+        kinds.insert(rb->containers[i].type);
+    EXPECT_EQ(kinds, (std::set<rb_container_type>{RB_ARRAY, RB_BITMAP, RB_RUN}));
+    expect_holds(rb, bits);
+    EXPECT_LT(rb_bytes(rb), bits.size() / 8);
+    rb_free(rb);
+}
+
+TEST(Roaring, SetOperationsAcrossContainerKinds)
+{
+    struct
+    {
+        roaring_bitmap *(*op)(roaring_bitmap *, roaring_bitmap *);
+        bool (*naive)(bool, bool);
+        const char *name;
+    } cases[] = {
+        {rb_union, [](bool x, bool y) { return x || y; }, "union"},
+        {rb_intersection, [](bool x, bool y) { return x && y; }, "intersection"},
+        {rb_xor, [](bool x, bool y) { return x != y; }, "xor"},
+        {rb_difference, [](bool x, bool y) { return x && !y; }, "difference"},
+    };
+    uint64_t full = NUM_PATTERNS * NUM_PATTERNS * RB_CHUNK_BITS;
+
+    for (auto sizes : {std::make_pair(full, full), std::make_pair(full + 777, full - 5000)})
+    {
+        auto [a, b] = every_pair(sizes.first, sizes.second);
+        roaring_bitmap *ra = from_bits(a), *rb = from_bits(b);
+
+        for (const auto &c : cases)
+        {
+            SCOPED_TRACE(c.name);
+            roaring_bitmap *forward = c.op(ra, rb), *backward = c.op(rb, ra);
+
+            expect_holds(forward, naive(a, b, c.naive));
+            expect_holds(backward, naive(b, a, c.naive));
+            rb_free(forward);
+            rb_free(backward);
+        }
+        expect_holds(ra, a);
+        expect_holds(rb, b);
+        rb_free(ra);
+        rb_free(rb);
+    }
+}
+
+TEST(Roaring, SetGrowsContainers)
+{
+    /* enough values in one chunk to outgrow an array container, plus runs and stray values elsewhere */
+    std::vector<bool> bits(3 * RB_CHUNK_BITS + 10);
+    roaring_bitmap *rb = rb_new(bits.size());
+    std::mt19937_64 rng(5);
+
+    expect_holds(rb, bits);
+    for (uint64_t i = 0; i < 2 * RB_ARRAY_MAX_CARDINALITY; i++)
+    {
+        uint64_t pos = rng() % RB_CHUNK_BITS;
+        bits[pos] = true;
+        rb_set(rb, pos);
+    }
+    for (uint64_t pos = 2 * RB_CHUNK_BITS; pos < 2 * RB_CHUNK_BITS + 5000; pos++)
+    {
+        bits[pos] = true;
+        rb_set(rb, pos);
+    }
+    bits.back() = true;
+    rb_set(rb, bits.size() - 1);
+    rb_set(rb, bits.size() - 1);
+    expect_holds(rb, bits);
+    rb_free(rb);
+}
+
+TEST(Roaring, SetTurnsLargeRunContainersIntoBitmaps)
+{
+    /* one long run converts to a run container; stray values then add a run each until runs outgrow a bitmap */
+    std::vector<bool> bits(RB_CHUNK_BITS);
+    std::fill(bits.begin(), bits.begin() + 1000, true);
+    bitvector *bv = test::to_bitvector(bits);
+    roaring_bitmap *rb = rb_from_bitvector(bv);
+
+    ASSERT_EQ(rb->containers[0].type, RB_RUN);
+    for (uint64_t pos = 2000; pos < RB_CHUNK_BITS; pos += 3)
+    {
+        bits[pos] = true;
+        rb_set(rb, pos);
+        ASSERT_LE(rb_bytes(rb), sizeof(roaring_bitmap) + 2 * RB_CHUNK_BITS / 8 + 64) << "pos " << pos;
+    }
+    EXPECT_EQ(rb->containers[0].type, RB_BITMAP);
+    expect_holds(rb, bits);
+    rb_free(rb);
+    bv_free(bv);
+}
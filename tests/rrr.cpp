@@ -0,0 +1,84 @@
+#include "test_utils.h"
+#include "rrr.h"
+
+/**
+ * The RRR encoding against the plain bits it compresses: isset, rank, pop_count and select at every position, for
+ * block sizes from one bit to RRR_MAX_BLOCK_BITS and sample rates from every block to more blocks than there are.
+ */
+
+static void expect_encodes(rrr_vector *rrr, const std::vector<bool> &bits)
+{
+    std::vector<uint64_t> ones = test::naive_positions(bits, true), ranks = test::naive_ranks(bits);
+    bitvector *decoded;
+
+    ASSERT_EQ(rrr_len(rrr), bits.size());
+    for (uint64_t pos = 0; pos <= bits.size(); pos++)
+        ASSERT_EQ(rrr_rank(rrr, pos), ranks[pos]) << "pos " << pos;
+    for (uint64_t pos = 0; pos < bits.size(); pos++)
+    {
+        ASSERT_EQ(rrr_isset(rrr, pos), bits[pos]) << "pos " << pos;
+        ASSERT_EQ(rrr_pop_count(rrr, pos), ranks[pos + 1]) << "pos " << pos;
+    }
+    for (uint64_t k = 1; k <= ones.size(); k++)
+        ASSERT_EQ(rrr_select(rrr, k), (int64_t)ones[k - 1]) << "k " << k;
+    EXPECT_EQ(rrr_select(rrr, 0), -1);
+    EXPECT_EQ(rrr_select(rrr, ones.size() + 1), -1);
+
+    decoded = rrr_to_bitvector(rrr);
+    EXPECT_EQ(test::to_bits(decoded), bits);
+    bv_free(decoded);
+}
+
+TEST(Rrr, BlockSizesAndSampleRates)
+{
+    for (uint32_t block_bits : {1U, 7U, 15U, 31U, 32U, RRR_MAX_BLOCK_BITS})
+    {
+        for (uint32_t sample_rate : {1U, 3U, RRR_DEFAULT_SAMPLE_RATE, 100000U})
+        {
+            for (uint64_t density : {0UL, 20UL, 500UL, 1000UL})
+            {
+                std::vector<bool> bits = test::random_bits(20000 + block_bits, density, block_bits * density);
+                bitvector *bv = test::to_bitvector(bits);
+                rrr_vector *rrr = rrr_from_bitvector(bv, block_bits, sample_rate);
+
+                SCOPED_TRACE(testing::Message() << "block bits " << block_bits << " sample rate " << sample_rate
+                                                << " density " << density);
+                expect_encodes(rrr, bits);
+                EXPECT_EQ(test::to_bits(bv), bits);
+                rrr_free(rrr);
+                bv_free(bv);
+            }
+        }
+    }
+}
+
+TEST(Rrr, SmallVectors)
+{
+    for (uint64_t size = 0; size <= 130; size++)
+    {
+        std::vector<bool> bits = test::random_bits(size, 400, size);
+        bitvector *bv = test::to_bitvector(bits);
+        rrr_vector *rrr = rrr_from_bitvector(bv, RRR_DEFAULT_BLOCK_BITS, RRR_DEFAULT_SAMPLE_RATE);
+
+        expect_encodes(rrr, bits);
+        rrr_free(rrr);
+        bv_free(bv);
+    }
+}
+
+TEST(Rrr, SparseVectorsCompress)
+{
+    /* select samples are spaced 8192 ones apart, so sparse runs between dense ones cross several of them */
+    std::vector<bool> bits = test::random_bits(1UL << 20, 2, 9);
+
+    for (uint64_t i = 100000; i < 130000; i++)
+        bits[i] = true;
+
+    bitvector *bv = test::to_bitvector(bits);
+    rrr_vector *rrr = rrr_from_bitvector(bv, RRR_DEFAULT_BLOCK_BITS, RRR_DEFAULT_SAMPLE_RATE);
+
+    expect_encodes(rrr, bits);
+    EXPECT_LT(rrr_bytes(rrr), bv_len(bv) / 8 / 2);
+    rrr_free(rrr);
+    bv_free(bv);
+}
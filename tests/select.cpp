@@ -0,0 +1,108 @@
+#include "test_utils.h"
+#include <algorithm>
+
+/**
+ * bv_select and bv_select0, with and without samples, against a bit-by-bit scan: for every k of small vectors,
+ * around every multiple of the 8192-bit sample rate, past the last bit and across the first L0 boundary.
+ */
+
+TEST(Select, OutOfRangeRanks)
+{
+    std::vector<bool> bits = test::random_bits(1000, 500, 1);
+    bitvector *bv = test::to_bitvector(bits);
+    uint64_t ones = test::naive_rank(bits, bits.size());
+
+    bv_build_select(bv);
+    EXPECT_EQ(bv_select(bv, 0), -1);
+    EXPECT_EQ(bv_select0(bv, 0), -1);
+    EXPECT_EQ(bv_select(bv, ones + 1), -1);
+    EXPECT_EQ(bv_select0(bv, bits.size() - ones + 1), -1);
+    EXPECT_EQ(bv_select(bv, bits.size() + 1), -1);
+    bv_free(bv);
+
+    bv = bv_new(0);
+    EXPECT_EQ(bv_select(bv, 1), -1);
+    EXPECT_EQ(bv_select0(bv, 1), -1);
+    bv_free(bv);
+}
+
+TEST(Select, EveryRankMatchesNaive)
+{
+    for (uint64_t size : {1UL, 64UL, 65UL, 2048UL, 2049UL, 10000UL})
+    {
+        for (uint64_t density : {0UL, 1UL, 500UL, 999UL, 1000UL})
+        {
+            std::vector<bool> bits = test::random_bits(size, density, size * 31 + density);
+            std::vector<uint64_t> ones = test::naive_positions(bits, true), zeros = test::naive_positions(bits, false);
+            bitvector *bv = test::to_bitvector(bits);
+
+            for (int built = 0; built < 2; built++)
+            {
+                for (uint64_t k = 1; k <= ones.size(); k++)
+                    ASSERT_EQ(bv_select(bv, k), (int64_t)ones[k - 1]) << "size " << size << " k " << k;
+                for (uint64_t k = 1; k <= zeros.size(); k++)
+                    ASSERT_EQ(bv_select0(bv, k), (int64_t)zeros[k - 1]) << "size " << size << " k " << k;
+                bv_build_select(bv);
+            }
+            bv_free(bv);
+        }
+    }
+}
+
+TEST(Select, SampleBoundaries)
+{
+    const uint64_t size = 1UL << 21, rate = BIT << LOG_SELECT_SAMPLE_RATE;
+
+    for (uint64_t density : {3UL, 500UL, 997UL})
+    {
+        std::vector<bool> bits = test::random_bits(size, density, density);
+        std::vector<uint64_t> ones = test::naive_positions(bits, true), zeros = test::naive_positions(bits, false);
+        bitvector *bv = test::to_bitvector(bits);
+
+        bv_build_select(bv);
+        for (uint64_t sample = 0; sample <= ones.size() + rate; sample += rate)
+        {
+            for (uint64_t k = (sample > 0) ? sample - 1 : 1; k <= sample + 1; k++)
+                ASSERT_EQ(bv_select(bv, k), (k <= ones.size()) ? (int64_t)ones[k - 1] : -1) << "k " << k;
+        }
+        for (uint64_t sample = 0; sample <= zeros.size() + rate; sample += rate)
+        {
+            for (uint64_t k = (sample > 0) ? sample - 1 : 1; k <= sample + 1; k++)
+                ASSERT_EQ(bv_select0(bv, k), (k <= zeros.size()) ? (int64_t)zeros[k - 1] : -1) << "k " << k;
+        }
+        ASSERT_EQ(bv_select(bv, ones.size()), ones.empty() ? -1 : (int64_t)ones.back());
+        ASSERT_EQ(bv_select0(bv, zeros.size()), zeros.empty() ? -1 : (int64_t)zeros.back());
+        bv_free(bv);
+    }
+}
+
+TEST(Select, AcrossL0Boundary)
+{
+    const uint64_t l0 = BIT << LOG_L0_BLOCK_SIZE, size = l0 + 5000;
+    bitvector *bv = bv_new(size);
+    std::vector<uint64_t> ones;
+
+    for (uint64_t pos = 11; pos < size; pos += 999983)
+        ones.push_back(pos);
+    for (uint64_t pos = l0 - 2500; pos < l0 + 2500; pos++)
+        ones.push_back(pos);
+    std::sort(ones.begin(), ones.end());
+    ones.erase(std::unique(ones.begin(), ones.end()), ones.end());
+    for (uint64_t pos : ones)
+        bv_set(bv, pos);
+
+    bv_build_select(bv);
+    for (uint64_t k = 1; k <= ones.size(); k++)
+    {
+        if (ones[k - 1] + 3000 > l0 || k % 97 == 0 || k == 1)
+            ASSERT_EQ(bv_select(bv, k), (int64_t)ones[k - 1]) << "k " << k;
+    }
+    /* the zeros on either side of the dense run */
+    for (uint64_t pos : {l0 - 2501, l0 + 2500})
+    {
+        uint64_t k = pos - (std::lower_bound(ones.begin(), ones.end(), pos) - ones.begin()) + 1;
+        ASSERT_FALSE(std::binary_search(ones.begin(), ones.end(), pos));
+        EXPECT_EQ(bv_select0(bv, k), (int64_t)pos);
+    }
+    bv_free(bv);
+}
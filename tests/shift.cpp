@@ -0,0 +1,178 @@
+#include "test_utils.h"
+#include "word_kernels.h"
+
+/**
+ * Shifts, rotations, reversal and concatenation against bit-by-bit references, in their allocating, `_into` and
+ * `_inplace` forms, for lengths and shift amounts on both sides of word boundaries; and the funnel-shift kernels
+ * words_shr and words_shl under every instruction set, including in place.
+ */
+
+static const uint64_t kSizes[] = {0, 1, 63, 64, 65, 1000, 4097};
+
+struct shift_case
+{
+    bitvector *(*make)(bitvector *, uint64_t);
+    bv_status (*into)(bitvector *, bitvector *, uint64_t);
+    bv_status (*inplace)(bitvector *, uint64_t);
+    std::vector<bool> (*naive)(const std::vector<bool> &, uint64_t);
+    const char *name;
+};
+
+static std::vector<bool> naive_lshift(const std::vector<bool> &bits, uint64_t k)
+{
+    std::vector<bool> result(bits.size());
+
+    for (uint64_t i = k; i < bits.size(); i++)
+        result[i] = bits[i - k];
+    return result;
+}
+
+static std::vector<bool> naive_rshift(const std::vector<bool> &bits, uint64_t k)
+{
+    std::vector<bool> result(bits.size());
+
+    for (uint64_t i = 0; i + k < bits.size(); i++)
+        result[i] = bits[i + k];
+    return result;
+}
+
+static std::vector<bool> naive_rotate(const std::vector<bool> &bits, uint64_t k)
+{
+    std::vector<bool> result(bits.size());
+
+    for (uint64_t i = 0; i < bits.size(); i++)
+        result[(i + k) % bits.size()] = bits[i];
+    return result;
+}
+
+static const shift_case kCases[] = {
+    {bv_lshift, bv_lshift_into, bv_lshift_inplace, naive_lshift, "lshift"},
+    {bv_rshift, bv_rshift_into, bv_rshift_inplace, naive_rshift, "rshift"},
+    {bv_rotate, bv_rotate_into, bv_rotate_inplace, naive_rotate, "rotate"},
+};
+
+/** bits of bv must match, and the spare bits past the end must be clear */
+static void expect_bits(bitvector *bv, const std::vector<bool> &bits)
+{
+    ASSERT_EQ(test::to_bits(bv), bits);
+    ASSERT_EQ(bv_count_range(bv, 1, 0, bv_len(bv)), test::naive_rank(bits, bits.size()));
+}
+
+TEST(Shift, ShiftsAndRotations)
+{
+    for (const shift_case &c : kCases)
+    {
+        for (uint64_t size : kSizes)
+        {
+            for (uint64_t k : {0UL, 1UL, 63UL, 64UL, 65UL, size / 2, size - 1, size, size + 5})
+            {
+                std::vector<bool> bits = test::random_bits(size, 500, size + k), expected = c.naive(bits, k);
+                bitvector *bv = test::to_bitvector(bits), *made, *dst = bv_new(3);
+
+                SCOPED_TRACE(testing::Message() << c.name << " size " << size << " k " << k);
+                made = c.make(bv, k);
+                expect_bits(made, expected);
+                c.into(dst, bv, k);
+                expect_bits(dst, expected);
+                expect_bits(bv, bits);
+                c.inplace(bv, k);
+                expect_bits(bv, expected);
+                bv_free(made);
+                bv_free(dst);
+                bv_free(bv);
+            }
+        }
+    }
+}
+
+TEST(Shift, Reverse)
+{
+    for (uint64_t size : kSizes)
+    {
+        std::vector<bool> bits = test::random_bits(size, 300, size), expected(bits.rbegin(), bits.rend());
+        bitvector *bv = test::to_bitvector(bits), *made = bv_reverse(bv), *dst = bv_new(7);
+
+        expect_bits(made, expected);
+        bv_reverse_into(dst, bv);
+        expect_bits(dst, expected);
+        bv_reverse_inplace(bv);
+        expect_bits(bv, expected);
+        bv_free(made);
+        bv_free(dst);
+        bv_free(bv);
+    }
+}
+
+TEST(Shift, Extend)
+{
+    for (uint64_t la : kSizes)
+    {
+        for (uint64_t lb : {0UL, 1UL, 64UL, 127UL, 3000UL})
+        {
+            std::vector<bool> a = test::random_bits(la, 500, la), b = test::random_bits(lb, 500, lb + 1), ab(a), aa(a);
+            bitvector *va = test::to_bitvector(a), *vb = test::to_bitvector(b), *made, *dst = bv_new(100);
+
+            SCOPED_TRACE(testing::Message() << "a " << la << " b " << lb);
+            ab.insert(ab.end(), b.begin(), b.end());
+            aa.insert(aa.end(), a.begin(), a.end());
+            made = bv_extend(va, vb);
+            expect_bits(made, ab);
+            bv_extend_into(dst, va, vb);
+            expect_bits(dst, ab);
+
+            /* dst aliasing b, then a, then both operands */
+            bv_extend_into(vb, va, vb);
+            expect_bits(vb, ab);
+            bv_free(vb);
+            vb = test::to_bitvector(b);
+            bv_extend_inplace(va, vb);
+            expect_bits(va, ab);
+            bv_free(va);
+            va = test::to_bitvector(a);
+            bv_extend_into(va, va, va);
+            expect_bits(va, aa);
+
+            bv_free(made);
+            bv_free(dst);
+            bv_free(va);
+            bv_free(vb);
+        }
+    }
+}
+
+TEST(Shift, FunnelShiftKernels)
+{
+    test::isa_guard guard;
+    std::mt19937_64 rng(1);
+
+    for (bv_isa isa : test::kIsas)
+    {
+        bv_use_isa(isa);
+        for (size_t n = 0; n <= 40; n++)
+        {
+            for (unsigned sh : {1U, 7U, 31U, 32U, 33U, 63U})
+            {
+                /* a[-1] and a[n] are read by the shifts, so pad a word on each side */
+                std::vector<uint64_t> a(n + 2), dst(n + 2, 0), in_place;
+
+                for (uint64_t &word : a)
+                    word = rng();
+                words_shr(dst.data() + 1, a.data() + 1, n, sh);
+                for (size_t i = 1; i <= n; i++)
+                    ASSERT_EQ(dst[i], (a[i] >> sh) | (a[i + 1] << (64 - sh))) << "isa " << isa << " n " << n;
+                words_shl(dst.data() + 1, a.data() + 1, n, sh);
+                for (size_t i = 1; i <= n; i++)
+                    ASSERT_EQ(dst[i], (a[i] << sh) | (a[i - 1] >> (64 - sh))) << "isa " << isa << " n " << n;
+
+                in_place = a;
+                words_shr(in_place.data(), in_place.data(), n + 1, sh);
+                for (size_t i = 0; i <= n; i++)
+                    ASSERT_EQ(in_place[i], (a[i] >> sh) | (a[i + 1] << (64 - sh))) << "isa " << isa << " n " << n;
+                in_place = a;
+                words_shl(in_place.data() + 1, in_place.data() + 1, n + 1, sh);
+                for (size_t i = 1; i <= n + 1; i++)
+                    ASSERT_EQ(in_place[i], (a[i] << sh) | (a[i - 1] >> (64 - sh))) << "isa " << isa << " n " << n;
+            }
+        }
+    }
+}
@@ -0,0 +1,128 @@
+#include "test_utils.h"
+#include "similarity.h"
+#include "thread_pool.h"
+#include <algorithm>
+
+/**
+ * The batched hamming and Jaccard functions of similarity.h against bit-by-bit counts, on one thread and on
+ * several, with fingerprints of different lengths and enough candidates to span several tiles.
+ */
+
+struct fingerprints
+{
+    std::vector<std::vector<bool>> bits;
+    std::vector<bitvector *> vectors;
+
+    fingerprints(size_t n, uint64_t seed)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            /* a few lengths, and a few empty fingerprints */
+            bits.push_back(test::random_bits((i % 7 == 6) ? 0 : 1000 + (i % 3) * 517, 100 + i % 5 * 100, seed + i));
+            vectors.push_back(test::to_bitvector(bits.back()));
+        }
+    }
+
+    ~fingerprints()
+    {
+        for (bitvector *bv : vectors)
+            bv_free(bv);
+    }
+};
+
+static uint64_t naive_hamming(const std::vector<bool> &a, const std::vector<bool> &b)
+{
+    uint64_t distance = 0;
+
+    for (size_t i = 0; i < std::max(a.size(), b.size()); i++)
+        distance += (i < a.size() && a[i]) != (i < b.size() && b[i]);
+    return distance;
+}
+
+static double naive_jaccard(const std::vector<bool> &a, const std::vector<bool> &b)
+{
+    uint64_t both = 0, either = 0;
+
+    for (size_t i = 0; i < std::max(a.size(), b.size()); i++)
+    {
+        bool x = i < a.size() && a[i], y = i < b.size() && b[i];
+        both += x && y;
+        either += x || y;
+    }
+    return either ? (double)both / either : 1.0;
+}
+
+class Similarity : public ::testing::TestWithParam<size_t>
+{
+protected:
+    size_t saved_threads = bv_get_num_threads();
+
+    void SetUp() override { bv_set_num_threads(GetParam()); }
+    void TearDown() override { bv_set_num_threads(saved_threads); }
+};
+
+TEST_P(Similarity, Batch)
+{
+    fingerprints queries(3, 1), candidates(300, 100);
+    std::vector<uint64_t> distances(candidates.vectors.size());
+    std::vector<double> similarities(candidates.vectors.size());
+
+    for (size_t q = 0; q < queries.vectors.size(); q++)
+    {
+        bv_hamming_batch(queries.vectors[q], candidates.vectors.data(), candidates.vectors.size(), distances.data());
+        bv_jaccard_batch(queries.vectors[q], candidates.vectors.data(), candidates.vectors.size(), similarities.data());
+        for (size_t c = 0; c < candidates.vectors.size(); c++)
+        {
+            ASSERT_EQ(distances[c], naive_hamming(queries.bits[q], candidates.bits[c])) << "candidate " << c;
+            ASSERT_DOUBLE_EQ(similarities[c], naive_jaccard(queries.bits[q], candidates.bits[c])) << "candidate " << c;
+        }
+    }
+}
+
+TEST_P(Similarity, Matrix)
+{
+    fingerprints queries(9, 2), candidates(2000, 200);
+    size_t nq = queries.vectors.size(), nc = candidates.vectors.size();
+    std::vector<uint64_t> distances(nq * nc);
+    std::vector<double> similarities(nq * nc);
+
+    bv_hamming_matrix(queries.vectors.data(), nq, candidates.vectors.data(), nc, distances.data());
+    bv_jaccard_matrix(queries.vectors.data(), nq, candidates.vectors.data(), nc, similarities.data());
+    for (size_t q = 0; q < nq; q++)
+    {
+        for (size_t c = 0; c < nc; c++)
+        {
+            ASSERT_EQ(distances[q * nc + c], naive_hamming(queries.bits[q], candidates.bits[c]));
+            ASSERT_DOUBLE_EQ(similarities[q * nc + c], naive_jaccard(queries.bits[q], candidates.bits[c]));
+        }
+    }
+}
+
+TEST_P(Similarity, TopK)
+{
+    fingerprints queries(1, 3), candidates(500, 300);
+    std::vector<size_t> order(candidates.vectors.size()), indices(candidates.vectors.size());
+    std::vector<uint64_t> reference(candidates.vectors.size()), distances(candidates.vectors.size());
+
+    for (size_t c = 0; c < order.size(); c++)
+    {
+        order[c] = c;
+        reference[c] = naive_hamming(queries.bits[0], candidates.bits[c]);
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t x, size_t y) { return reference[x] < reference[y]; });
+
+    for (size_t k : {0UL, 1UL, 10UL, 499UL, 500UL, 1000UL})
+    {
+        size_t found = bv_hamming_top_k(queries.vectors[0], candidates.vectors.data(), order.size(), k, indices.data(),
+                                        distances.data());
+
+        ASSERT_EQ(found, std::min(k, order.size()));
+        for (size_t i = 0; i < found; i++)
+        {
+            ASSERT_EQ(indices[i], order[i]) << "k " << k << " i " << i;
+            ASSERT_EQ(distances[i], reference[order[i]]);
+        }
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(Threads, Similarity, ::testing::Values(1, 4));
@@ -0,0 +1,118 @@
+/**
+ * @file test_utils.h
+ * @brief Naive bit-by-bit references shared by the unit tests
+ */
+
+#ifndef POPPY_TEST_UTILS_H
+#define POPPY_TEST_UTILS_H
+
+#include "gtest/gtest.h"
+#include <cstdint>
+#include <random>
+#include <vector>
+#include "bitvector.h"
+
+namespace test
+{
+    /** the instruction sets every dispatched kernel is checked under; unsupported ones fall back and repeat a check */
+    static const std::vector<bv_isa> kIsas = {BV_ISA_SCALAR, BV_ISA_AVX2, BV_ISA_AVX512};
+
+    /**
+     * @brief Random bits with roughly `density` set bits per thousand, as a std::vector<bool>
+     */
+    inline std::vector<bool> random_bits(uint64_t size, uint64_t density, uint64_t seed)
+    {
+        std::mt19937_64 rng(seed);
+        std::vector<bool> bits(size);
+
+        for (uint64_t i = 0; i < size; i++)
+            bits[i] = rng() % 1000 < density;
+        return bits;
+    }
+
+    /**
+     * @brief A bitvector holding `bits`, written one bit at a time
+     */
+    inline bitvector *to_bitvector(const std::vector<bool> &bits)
+    {
+        bitvector *bv = bv_new(bits.size());
+
+        for (uint64_t i = 0; i < bits.size(); i++)
+        {
+            if (bits[i])
+                bv_set(bv, i);
+        }
+        return bv;
+    }
+
+    /**
+     * @brief The bits of a bitvector, read one bit at a time
+     */
+    inline std::vector<bool> to_bits(bitvector *bv)
+    {
+        std::vector<bool> bits(bv_len(bv));
+
+        for (uint64_t i = 0; i < bits.size(); i++)
+            bits[i] = bv_isset(bv, i);
+        return bits;
+    }
+
+    /** the number of bits equal to `bit` in bits[:pos] */
+    inline uint64_t naive_rank(const std::vector<bool> &bits, uint64_t pos, bool bit = true)
+    {
+        uint64_t count = 0;
+
+        for (uint64_t i = 0; i < pos && i < bits.size(); i++)
+            count += bits[i] == bit;
+        return count;
+    }
+
+    /** naive_rank(bits, pos) for every pos in [0, bits.size()], for the tests that check every position */
+    inline std::vector<uint64_t> naive_ranks(const std::vector<bool> &bits)
+    {
+        std::vector<uint64_t> ranks(bits.size() + 1, 0);
+
+        for (uint64_t i = 0; i < bits.size(); i++)
+            ranks[i + 1] = ranks[i] + bits[i];
+        return ranks;
+    }
+
+    /** the position of the kth (1-indexed) bit equal to `bit`, or -1 */
+    inline int64_t naive_select(const std::vector<bool> &bits, uint64_t k, bool bit = true)
+    {
+        for (uint64_t i = 0; i < bits.size() && k > 0; i++)
+        {
+            if (bits[i] == bit && --k == 0)
+                return (int64_t)i;
+        }
+        return -1;
+    }
+
+    /** the positions of the bits equal to `bit`, in increasing order */
+    inline std::vector<uint64_t> naive_positions(const std::vector<bool> &bits, bool bit = true)
+    {
+        std::vector<uint64_t> positions;
+
+        for (uint64_t i = 0; i < bits.size(); i++)
+        {
+            if (bits[i] == bit)
+                positions.push_back(i);
+        }
+        return positions;
+    }
+
+    /**
+     * @brief Restores the instruction set in use when the test started
+     */
+    struct isa_guard
+    {
+        bv_isa saved = bv_current_isa();
+
+        ~isa_guard()
+        {
+            bv_use_isa(saved);
+        }
+    };
+} // namespace test
+
+#endif // POPPY_TEST_UTILS_H
@@ -0,0 +1,110 @@
+#include "test_utils.h"
+#include "thread_pool.h"
+#include "wavelet_matrix.h"
+#include <algorithm>
+#include <map>
+
+/**
+ * The wavelet matrix against the plain symbol sequence: access at every position, rank and select of every symbol,
+ * quantiles and range counts over random ranges, for alphabets from a single symbol to 2^32 and on one thread and
+ * on several.
+ */
+
+class WaveletMatrix : public ::testing::TestWithParam<size_t>
+{
+protected:
+    size_t saved_threads = bv_get_num_threads();
+
+    void SetUp() override { bv_set_num_threads(GetParam()); }
+    void TearDown() override { bv_set_num_threads(saved_threads); }
+};
+
+static std::vector<uint32_t> random_symbols(uint64_t n, uint64_t sigma, uint64_t seed)
+{
+    std::mt19937_64 rng(seed);
+    std::vector<uint32_t> symbols(n);
+
+    /* skewed, so some symbols are frequent and some never occur */
+    for (uint32_t &symbol : symbols)
+        symbol = (rng() % 4 == 0) ? (uint32_t)(sigma - 1) : (uint32_t)(rng() % sigma / (1 + rng() % 3));
+    return symbols;
+}
+
+TEST_P(WaveletMatrix, AccessRankSelect)
+{
+    for (uint64_t sigma : {1UL, 2UL, 5UL, 256UL, 1000UL, 1UL << 32})
+    {
+        for (uint64_t n : {1UL, 1000UL, 70000UL})
+        {
+            std::vector<uint32_t> symbols = random_symbols(n, sigma, sigma + n);
+            wavelet_matrix *wm = wm_new(symbols.data(), n, sigma);
+            std::map<uint32_t, std::vector<uint64_t>> occurrences;
+            std::mt19937_64 rng(n);
+
+            SCOPED_TRACE(testing::Message() << "sigma " << sigma << " n " << n);
+            ASSERT_EQ(wm_len(wm), n);
+            for (uint64_t pos = 0; pos < n; pos++)
+            {
+                ASSERT_EQ(wm_access(wm, pos), symbols[pos]) << "pos " << pos;
+                occurrences[symbols[pos]].push_back(pos);
+            }
+            for (const auto &[c, positions] : occurrences)
+            {
+                for (uint64_t k = 1; k <= positions.size(); k += 1 + positions.size() / 200)
+                    ASSERT_EQ(wm_select(wm, c, k), (int64_t)positions[k - 1]) << "c " << c << " k " << k;
+                ASSERT_EQ(wm_select(wm, c, positions.size() + 1), -1) << "c " << c;
+                for (int i = 0; i < 20; i++)
+                {
+                    uint64_t pos = rng() % (n + 1);
+                    uint64_t expected = std::lower_bound(positions.begin(), positions.end(), pos) - positions.begin();
+                    ASSERT_EQ(wm_rank(wm, c, pos), expected) << "c " << c << " pos " << pos;
+                }
+                ASSERT_EQ(wm_rank(wm, c, n + 100), positions.size());
+            }
+
+            /* a symbol that never occurs */
+            if (sigma > 2 && occurrences.count(1) == 0)
+            {
+                EXPECT_EQ(wm_rank(wm, 1, n), 0UL);
+                EXPECT_EQ(wm_select(wm, 1, 1), -1);
+            }
+            wm_free(wm);
+        }
+    }
+}
+
+TEST_P(WaveletMatrix, QuantileAndRangeCount)
+{
+    for (uint64_t sigma : {1UL, 7UL, 300UL, 1UL << 32})
+    {
+        uint64_t n = 20000;
+        std::vector<uint32_t> symbols = random_symbols(n, sigma, sigma);
+        wavelet_matrix *wm = wm_new(symbols.data(), n, sigma);
+        std::mt19937_64 rng(sigma);
+
+        SCOPED_TRACE(testing::Message() << "sigma " << sigma);
+        for (int query = 0; query < 300; query++)
+        {
+            uint64_t from = rng() % n, to = from + rng() % (n - from + 1);
+            std::vector<uint32_t> sorted(symbols.begin() + from, symbols.begin() + to);
+
+            std::sort(sorted.begin(), sorted.end());
+            for (uint64_t k : {0UL, sorted.size() / 2, sorted.size() - 1, sorted.size()})
+            {
+                int64_t expected = (k < sorted.size()) ? (int64_t)sorted[k] : -1;
+                ASSERT_EQ(wm_quantile(wm, from, to, k), expected) << "[" << from << ", " << to << ") k " << k;
+            }
+
+            uint64_t lo = rng() % sigma, hi = lo + rng() % (sigma - lo + 1);
+            uint64_t expected = std::lower_bound(sorted.begin(), sorted.end(), hi) -
+                                std::lower_bound(sorted.begin(), sorted.end(), lo);
+            ASSERT_EQ(wm_range_count(wm, from, to, lo, hi), expected)
+                << "[" << from << ", " << to << ") [" << lo << ", " << hi << ")";
+            ASSERT_EQ(wm_range_count(wm, from, to, 0, sigma), to - from);
+        }
+        EXPECT_GT(wm_bytes(wm), 0UL);
+        wm_free(wm);
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(Threads, WaveletMatrix, ::testing::Values(1, 4));
@@ -0,0 +1,155 @@
+#include "test_utils.h"
+#include "word_kernels.h"
+#include <atomic>
+#include <thread>
+
+/**
+ * The word kernels of word_kernels.h under the scalar, AVX2 and AVX-512 paths, against one-word-at-a-time loops.
+ * Lengths run through every remainder of the vector widths, operands start off a cache line, and dst aliases a.
+ */
+
+static const size_t kMaxWords = 70;
+
+static std::vector<uint64_t> random_words(size_t n, uint64_t seed)
+{
+    std::mt19937_64 rng(seed);
+    std::vector<uint64_t> words(n);
+
+    for (uint64_t &word : words)
+        word = rng();
+    return words;
+}
+
+template <class Op>
+static void expect_kernel(void (*kernel)(uint64_t *, const uint64_t *, const uint64_t *, size_t), Op op)
+{
+    test::isa_guard guard;
+
+    for (bv_isa isa : test::kIsas)
+    {
+        bv_use_isa(isa);
+        for (size_t n = 0; n <= kMaxWords; n++)
+        {
+            /* one word in, so the kernels see unaligned operands */
+            std::vector<uint64_t> a = random_words(n + 1, n), b = random_words(n + 1, n + 100), dst(n + 1, 0), in_place;
+
+            kernel(dst.data() + 1, a.data() + 1, b.data() + 1, n);
+            for (size_t i = 1; i <= n; i++)
+                ASSERT_EQ(dst[i], op(a[i], b[i])) << "isa " << isa << " n " << n << " word " << i;
+            ASSERT_EQ(dst[0], 0UL);
+
+            in_place = a;
+            kernel(in_place.data() + 1, in_place.data() + 1, b.data() + 1, n);
+            for (size_t i = 1; i <= n; i++)
+                ASSERT_EQ(in_place[i], op(a[i], b[i])) << "isa " << isa << " n " << n << " word " << i;
+        }
+    }
+}
+
+template <class Op>
+static void expect_popcount(uint64_t (*kernel)(const uint64_t *, const uint64_t *, size_t), Op op)
+{
+    test::isa_guard guard;
+
+    for (bv_isa isa : test::kIsas)
+    {
+        bv_use_isa(isa);
+        for (size_t n = 0; n <= kMaxWords; n++)
+        {
+            std::vector<uint64_t> a = random_words(n + 1, n + 7), b = random_words(n + 1, n + 8);
+            uint64_t expected = 0;
+
+            for (size_t i = 1; i <= n; i++)
+                expected += __builtin_popcountll(op(a[i], b[i]));
+            ASSERT_EQ(kernel(a.data() + 1, b.data() + 1, n), expected) << "isa " << isa << " n " << n;
+        }
+    }
+}
+
+TEST(WordKernels, And)
+{
+    expect_kernel(words_and, [](uint64_t x, uint64_t y) { return x & y; });
+}
+
+TEST(WordKernels, Or)
+{
+    expect_kernel(words_or, [](uint64_t x, uint64_t y) { return x | y; });
+}
+
+TEST(WordKernels, Xor)
+{
+    expect_kernel(words_xor, [](uint64_t x, uint64_t y) { return x ^ y; });
+}
+
+TEST(WordKernels, AndNot)
+{
+    expect_kernel(words_andnot, [](uint64_t x, uint64_t y) { return x & ~y; });
+}
+
+TEST(WordKernels, NotAndPopcount)
+{
+    test::isa_guard guard;
+
+    for (bv_isa isa : test::kIsas)
+    {
+        bv_use_isa(isa);
+        for (size_t n = 0; n <= kMaxWords; n++)
+        {
+            std::vector<uint64_t> a = random_words(n + 1, n + 3), dst(n + 1, 0);
+            uint64_t expected = 0;
+
+            words_not(dst.data() + 1, a.data() + 1, n);
+            for (size_t i = 1; i <= n; i++)
+            {
+                ASSERT_EQ(dst[i], ~a[i]) << "isa " << isa << " n " << n;
+                expected += __builtin_popcountll(a[i]);
+            }
+            ASSERT_EQ(words_popcount(a.data() + 1, n), expected) << "isa " << isa << " n " << n;
+        }
+    }
+}
+
+TEST(WordKernels, FusedPopcounts)
+{
+    expect_popcount(words_and_popcount, [](uint64_t x, uint64_t y) { return x & y; });
+    expect_popcount(words_or_popcount, [](uint64_t x, uint64_t y) { return x | y; });
+    expect_popcount(words_xor_popcount, [](uint64_t x, uint64_t y) { return x ^ y; });
+}
+
+TEST(WordKernels, UnsupportedIsaFallsBack)
+{
+    test::isa_guard guard;
+    bv_isa widest = bv_use_isa(BV_ISA_AUTO);
+
+    EXPECT_NE(widest, BV_ISA_AUTO);
+    EXPECT_EQ(bv_use_isa(BV_ISA_SCALAR), BV_ISA_SCALAR);
+    EXPECT_LE(bv_use_isa(BV_ISA_AVX512), widest);
+    EXPECT_EQ(bv_current_isa(), bv_use_isa(bv_current_isa()));
+}
+
+static void first_use_from_many_threads()
+{
+    /* every thread races to be the first caller; each must see a complete table, and the same one */
+    std::vector<uint64_t> words = random_words(kMaxWords, 7);
+    uint64_t expected = 0;
+    std::atomic<bool> agree(true);
+    std::vector<std::thread> threads;
+
+    for (uint64_t word : words)
+        expected += __builtin_popcountll(word);
+    for (int t = 0; t < 8; t++)
+        threads.emplace_back([&] {
+            if (words_popcount(words.data(), words.size()) != expected)
+                agree = false;
+        });
+    for (std::thread &thread : threads)
+        thread.join();
+    exit(agree && bv_current_isa() == bv_use_isa(BV_ISA_AUTO) ? 0 : 1);
+}
+
+TEST(WordKernels, ConcurrentFirstUse)
+{
+    /* a threadsafe death test re-runs the binary, so the kernels are first used inside it */
+    GTEST_FLAG_SET(death_test_style, "threadsafe");
+    EXPECT_EXIT(first_use_from_many_threads(), ::testing::ExitedWithCode(0), "");
+}
@@ -0,0 +1,182 @@
+#include "thread_pool.h"
+#include "bitvector.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <unistd.h>
+
+typedef struct
+{
+    pthread_mutex_t lock;
+    pthread_cond_t work_ready;
+    pthread_cond_t work_done;
+    pthread_t *workers;
+    size_t num_workers;    // threads besides the caller
+    uint64_t generation;   // bumped every time a new job is posted
+    size_t active;         // workers that have not finished the current job
+    bool shutdown;
+
+    /* the current job */
+    bv_task task;
+    void *arg;
+    size_t n;
+    size_t grain;
+    atomic_size_t next;    // first item of the next unclaimed chunk
+} thread_pool;
+
+static thread_pool *pool = NULL;
+static atomic_size_t requested_threads = 0; // written under pool_call_lock, read without it
+static pthread_mutex_t pool_call_lock = PTHREAD_MUTEX_INITIALIZER;
+static _Thread_local bool in_task = false;
+
+static void run_chunks(thread_pool *tp)
+{
+    size_t begin, end;
+
+    in_task = true;
+    while ((begin = atomic_fetch_add(&tp->next, tp->grain)) < tp->n)
+    {
+        end = (begin + tp->grain < tp->n) ? begin + tp->grain : tp->n;
+        tp->task(tp->arg, begin, end);
+    }
+    in_task = false;
+}
+
+static void *worker_main(void *arg)
+{
+    thread_pool *tp = arg;
+    uint64_t seen = 0;
+
+    for (;;)
+    {
+        pthread_mutex_lock(&tp->lock);
+        while (tp->generation == seen && !tp->shutdown)
+            pthread_cond_wait(&tp->work_ready, &tp->lock);
+        if (tp->shutdown)
+        {
+            pthread_mutex_unlock(&tp->lock);
+            return NULL;
+        }
+        seen = tp->generation;
+        pthread_mutex_unlock(&tp->lock);
+
+        run_chunks(tp);
+
+        pthread_mutex_lock(&tp->lock);
+        if (--tp->active == 0)
+            pthread_cond_signal(&tp->work_done);
+        pthread_mutex_unlock(&tp->lock);
+    }
+}
+
+static size_t default_num_threads(void)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return (cpus > 0) ? (size_t)cpus : 1;
+}
+
+static thread_pool *pool_new(size_t num_threads)
+{
+    size_t i;
+    thread_pool *tp = calloc(1, sizeof(thread_pool));
+    if (tp == NULL)
+    {
+        BV_REPORT_ERROR_AND_EXIT(tp == NULL, __FILE__, __PRETTY_FUNCTION__, __LINE__, "could not allocate thread pool");
+    }
+    pthread_mutex_init(&tp->lock, NULL);
+    pthread_cond_init(&tp->work_ready, NULL);
+    pthread_cond_init(&tp->work_done, NULL);
+
+    tp->num_workers = num_threads - 1;
+    tp->workers = malloc((tp->num_workers + 1) * sizeof(pthread_t));
+    if (tp->workers == NULL)
+    {
+        BV_REPORT_ERROR_AND_EXIT(tp->workers == NULL, __FILE__, __PRETTY_FUNCTION__, __LINE__, "could not allocate workers");
+    }
+    for (i = 0; i < tp->num_workers; i++)
+    {
+        if (pthread_create(&tp->workers[i], NULL, worker_main, tp) != 0)
+        {
+            BV_REPORT_ERROR_AND_EXIT(pthread_create, __FILE__, __PRETTY_FUNCTION__, __LINE__, "could not start worker thread");
+        }
+    }
+    return tp;
+}
+
+static void pool_free(thread_pool *tp)
+{
+    size_t i;
+
+    pthread_mutex_lock(&tp->lock);
+    tp->shutdown = true;
+    pthread_cond_broadcast(&tp->work_ready);
+    pthread_mutex_unlock(&tp->lock);
+    for (i = 0; i < tp->num_workers; i++)
+        pthread_join(tp->workers[i], NULL);
+
+    pthread_mutex_destroy(&tp->lock);
+    pthread_cond_destroy(&tp->work_ready);
+    pthread_cond_destroy(&tp->work_done);
+    free(tp->workers);
+    free(tp);
+}
+
+void bv_set_num_threads(size_t num_threads)
+{
+    pthread_mutex_lock(&pool_call_lock);
+    atomic_store(&requested_threads, num_threads);
+    if (pool != NULL)
+    {
+        pool_free(pool);
+        pool = NULL;
+    }
+    pthread_mutex_unlock(&pool_call_lock);
+}
+
+size_t bv_get_num_threads(void)
+{
+    size_t requested = atomic_load(&requested_threads);
+    return requested ? requested : default_num_threads();
+}
+
+void bv_parallel_for(size_t n, size_t grain, bv_task task, void *arg)
+{
+    /* read the thread count once; a pool left over from a racing bv_set_num_threads is rebuilt to match it */
+    size_t threads = bv_get_num_threads();
+
+    if (grain == 0)
+        grain = 1;
+    if (n <= grain || in_task || threads < 2)
+    {
+        task(arg, 0, n);
+        return;
+    }
+
+    pthread_mutex_lock(&pool_call_lock);
+    if (pool != NULL && pool->num_workers != threads - 1)
+    {
+        pool_free(pool);
+        pool = NULL;
+    }
+    if (pool == NULL)
+        pool = pool_new(threads);
+
+    pthread_mutex_lock(&pool->lock);
+    pool->task = task;
+    pool->arg = arg;
+    pool->n = n;
+    pool->grain = grain;
+    atomic_store(&pool->next, 0);
+    pool->active = pool->num_workers;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->work_ready);
+    pthread_mutex_unlock(&pool->lock);
+
+    run_chunks(pool);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->active > 0)
+        pthread_cond_wait(&pool->work_done, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+    pthread_mutex_unlock(&pool_call_lock);
+}
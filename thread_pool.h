@@ -0,0 +1,50 @@
+/**
+ * @file thread_pool.h
+ * @brief A persistent worker pool for the data-parallel bitvector operations
+ */
+
+#ifndef POPPY_THREAD_POOL_H
+#define POPPY_THREAD_POOL_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief A unit of parallel work: process the items [begin, end) of a range
+ */
+typedef void (*bv_task)(void *arg, size_t begin, size_t end);
+
+/**
+ * @brief Run `task` over [0, n) split into chunks of `grain` items, spread across the worker pool
+ *
+ * The calling thread takes part in the work and returns once every chunk has been processed.
+ * Small ranges, single-threaded pools and calls made from inside a task run serially on the calling thread.
+ * Concurrent calls from different threads are serialized.
+ *
+ * @param n the number of items
+ * @param grain the number of items per chunk, at least 1
+ * @param task the function to run on each chunk
+ * @param arg passed through to task
+ */
+void bv_parallel_for(size_t n, size_t grain, bv_task task, void *arg);
+
+/**
+ * @brief Set the number of threads (including the caller) used by bv_parallel_for
+ *
+ * @param num_threads the number of threads, or 0 for one per online CPU
+ */
+void bv_set_num_threads(size_t num_threads);
+
+/**
+ * @brief Get the number of threads (including the caller) used by bv_parallel_for
+ */
+size_t bv_get_num_threads(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // POPPY_THREAD_POOL_H
@@ -0,0 +1,341 @@
+#include "wavelet_matrix.h"
+#include "thread_pool.h"
+#include "word_ops.h"
+#include <stdio.h>
+#include <string.h>
+
+#define WM_BUILD_CHUNK (1UL << 16) // symbols partitioned per task, a multiple of WORD_SIZE
+
+typedef struct
+{
+    const uint32_t *symbols; // the symbols in the order of the level being built
+    uint32_t *next;          // receives them in the order of the next level
+    uint64_t *data;          // the words of the level being built
+    uint64_t n;
+    uint32_t shift;           // the bit of the symbols this level holds
+    uint64_t *chunk_zeros;    // the zeros in each chunk, then where its first zero goes in `next`
+    uint64_t *chunk_ones;     // where the first one of each chunk goes in `next`
+} level_job;
+
+static void split_chunks_task(void *arg, size_t begin, size_t end)
+{
+    /** write the level bits of chunks [begin, end) a word at a time and count their zeros **/
+
+    level_job *job = arg;
+    uint64_t c, i, i_end, w, w_end, word, zeros;
+
+    for (c = begin; c < end; c++)
+    {
+        i_end = (c + 1) * WM_BUILD_CHUNK;
+        i_end = (i_end < job->n) ? i_end : job->n;
+        for (zeros = 0, i = c * WM_BUILD_CHUNK; i < i_end; i += WORD_SIZE)
+        {
+            /* a fixed trip count for whole words lets the compiler vectorize the bit gathering */
+            w_end = (i + WORD_SIZE <= i_end) ? WORD_SIZE : i_end - i;
+            for (word = 0, w = 0; w < w_end; w++)
+                word |= (uint64_t)((job->symbols[i + w] >> job->shift) & 1) << w;
+            job->data[i >> LOG_WORD_SIZE] = word;
+            zeros += w_end - popcnt(word);
+        }
+        job->chunk_zeros[c] = zeros;
+    }
+}
+
+static void scatter_chunks_task(void *arg, size_t begin, size_t end)
+{
+    /**
+     * stably move the symbols of chunks [begin, end) to the zero or one side of the next level,
+     * indexing the two cursors by the bit instead of branching on it, since the bits are often random
+     **/
+
+    level_job *job = arg;
+    uint64_t c, i, i_end, bit, cursor[2];
+
+    for (c = begin; c < end; c++)
+    {
+        i_end = (c + 1) * WM_BUILD_CHUNK;
+        i_end = (i_end < job->n) ? i_end : job->n;
+        cursor[0] = job->chunk_zeros[c];
+        cursor[1] = job->chunk_ones[c];
+        for (i = c * WM_BUILD_CHUNK; i < i_end; i++)
+        {
+            bit = (job->symbols[i] >> job->shift) & 1;
+            job->next[cursor[bit]++] = job->symbols[i];
+        }
+    }
+}
+
+wavelet_matrix *wm_new(const uint32_t *symbols, uint64_t n, uint64_t sigma)
+{
+    /**
+     * Build the levels top down. Each level is a two-pass parallel counting sort on one bit:
+     * count the zeros of every chunk while packing the level's bits, turn the counts into output offsets,
+     * then scatter the chunks independently into the order of the next level
+     **/
+
+    wavelet_matrix *wm;
+    uint32_t *cur, *next, *tmp;
+    uint64_t i, c, l, zeros, ones, num_chunks = (n + WM_BUILD_CHUNK - 1) / WM_BUILD_CHUNK;
+    level_job job;
+
+    if (sigma > (BIT << 32))
+    {
+        BV_REPORT_ERROR_AND_EXIT(sigma > (BIT << 32), __FILE__, __PRETTY_FUNCTION__, __LINE__,
+                                 "alphabet of %lu symbols does not fit in 32 bits", sigma);
+    }
+    for (i = 0; i < n; i++)
+    {
+        if (symbols[i] >= sigma)
+        {
+            BV_REPORT_ERROR_AND_EXIT(symbols[i] >= sigma, __FILE__, __PRETTY_FUNCTION__, __LINE__,
+                                     "symbol %u at position %lu is not below sigma = %lu", symbols[i], i, sigma);
+        }
+    }
+
+    wm = calloc(1, sizeof(wavelet_matrix));
+    if (wm == NULL)
+    {
+        BV_REPORT_ERROR_AND_EXIT(wm == NULL, __FILE__, __PRETTY_FUNCTION__, __LINE__, "could not allocate wavelet matrix");
+    }
+    wm->size = n;
+    wm->sigma = sigma;
+    wm->num_levels = (sigma > 1) ? WORD_SIZE - __builtin_clzll(sigma - 1) : 0;
+
+    cur = malloc((n + 1) * sizeof(uint32_t));
+    next = malloc((n + 1) * sizeof(uint32_t));
+    job = (level_job){.n = n,
+                      .chunk_zeros = malloc((num_chunks + 1) * sizeof(uint64_t)),
+                      .chunk_ones = malloc((num_chunks + 1) * sizeof(uint64_t))};
+    if (cur == NULL || next == NULL || job.chunk_zeros == NULL || job.chunk_ones == NULL)
+    {
+        BV_REPORT_ERROR_AND_EXIT(cur == NULL, __FILE__, __PRETTY_FUNCTION__, __LINE__, "could not allocate build buffers");
+    }
+    memcpy(cur, symbols, n * sizeof(uint32_t));
+
+    for (l = 0; l < wm->num_levels; l++)
+    {
+        wm->levels[l] = bv_new(n);
+        job.symbols = cur;
+        job.next = next;
+        job.data = wm->levels[l]->data;
+        job.shift = wm->num_levels - 1 - l;
+        bv_parallel_for(num_chunks, 1, split_chunks_task, &job);
+
+        for (zeros = 0, c = 0; c < num_chunks; c++)
+            zeros += job.chunk_zeros[c];
+        wm->zeros[l] = zeros;
+        for (zeros = 0, ones = wm->zeros[l], c = 0; c < num_chunks; c++)
+        {
+            job.chunk_ones[c] = ones;
+            ones += ((c + 1) * WM_BUILD_CHUNK < n ? WM_BUILD_CHUNK : n - c * WM_BUILD_CHUNK) - job.chunk_zeros[c];
+            i = job.chunk_zeros[c];
+            job.chunk_zeros[c] = zeros;
+            zeros += i;
+        }
+
+        /* the last level is never scattered: no query looks past it */
+        if (l + 1 < wm->num_levels)
+        {
+            bv_parallel_for(num_chunks, 1, scatter_chunks_task, &job);
+            tmp = cur, cur = next, next = tmp;
+        }
+        bv_build_rank(wm->levels[l]);
+        bv_build_select(wm->levels[l]);
+    }
+
+    free(cur);
+    free(next);
+    free(job.chunk_zeros);
+    free(job.chunk_ones);
+    return wm;
+}
+
+void wm_free(wavelet_matrix *wm)
+{
+    uint32_t l;
+
+    if (wm == NULL)
+        return;
+    for (l = 0; l < wm->num_levels; l++)
+        bv_free(wm->levels[l]);
+    free(wm);
+}
+
+uint64_t wm_len(wavelet_matrix *wm)
+{
+    BV_CHECK_NONNULL(wm);
+    return wm->size;
+}
+
+static inline uint64_t rank0(bitvector *bv, uint64_t pos)
+{
+    return pos - bv_rank(bv, pos);
+}
+
+static inline uint64_t descend(wavelet_matrix *wm, uint32_t l, uint64_t pos, bool bit)
+{
+    /** where position pos of level l lands in level l + 1 if its bit at level l is `bit` **/
+
+    return bit ? wm->zeros[l] + bv_rank(wm->levels[l], pos) : rank0(wm->levels[l], pos);
+}
+
+uint32_t wm_access(wavelet_matrix *wm, uint64_t pos)
+{
+    uint32_t l, c = 0;
+    bool bit;
+
+    BV_CHECK_NONNULL(wm);
+    if (pos >= wm->size)
+    {
+        BV_REPORT_ERROR_AND_EXIT(pos >= wm->size, __FILE__, __PRETTY_FUNCTION__, __LINE__,
+                                 "position %lu out of range for %lu symbols", pos, wm->size);
+    }
+
+    for (l = 0; l < wm->num_levels; l++)
+    {
+        bit = bv_isset_unchecked(wm->levels[l], pos);
+        c = (c << 1) | bit;
+        pos = descend(wm, l, pos, bit);
+    }
+    return c;
+}
+
+uint64_t wm_rank(wavelet_matrix *wm, uint32_t c, uint64_t pos)
+{
+    /** follow both ends of [0, pos) down the path of c; its occurrences are what is left between them **/
+
+    uint64_t from = 0;
+    uint32_t l;
+    bool bit;
+
+    BV_CHECK_NONNULL(wm);
+    if (c >= wm->sigma)
+        return 0;
+    if (pos > wm->size)
+        pos = wm->size;
+
+    for (l = 0; l < wm->num_levels; l++)
+    {
+        bit = (c >> (wm->num_levels - 1 - l)) & 1;
+        from = descend(wm, l, from, bit);
+        pos = descend(wm, l, pos, bit);
+    }
+    return pos - from;
+}
+
+int64_t wm_select(wavelet_matrix *wm, uint32_t c, uint64_t k)
+{
+    /** find where the occurrences of c start on the last level, then climb back up with select **/
+
+    uint64_t from = 0, to, pos;
+    uint32_t l;
+    bool bit;
+
+    BV_CHECK_NONNULL(wm);
+    if (c >= wm->sigma || k == 0)
+        return -1;
+
+    to = wm->size;
+    for (l = 0; l < wm->num_levels; l++)
+    {
+        bit = (c >> (wm->num_levels - 1 - l)) & 1;
+        from = descend(wm, l, from, bit);
+        to = descend(wm, l, to, bit);
+    }
+    if (to - from < k)
+        return -1;
+
+    for (pos = from + k - 1, l = wm->num_levels; l-- > 0;)
+    {
+        if ((c >> (wm->num_levels - 1 - l)) & 1)
+            pos = bv_select(wm->levels[l], pos - wm->zeros[l] + 1);
+        else
+            pos = bv_select0(wm->levels[l], pos + 1);
+    }
+    return (int64_t)pos;
+}
+
+int64_t wm_quantile(wavelet_matrix *wm, uint64_t from, uint64_t to, uint64_t k)
+{
+    /** at each level, go to the zero side if it holds more than k of the range's symbols **/
+
+    uint64_t zeros;
+    uint32_t l, c = 0;
+
+    BV_CHECK_NONNULL(wm);
+    if (to > wm->size)
+        to = wm->size;
+    if (from >= to || k >= to - from)
+        return -1;
+
+    for (l = 0; l < wm->num_levels; l++)
+    {
+        zeros = rank0(wm->levels[l], to) - rank0(wm->levels[l], from);
+        c <<= 1;
+        if (k < zeros)
+        {
+            from = descend(wm, l, from, false);
+            to = descend(wm, l, to, false);
+        }
+        else
+        {
+            k -= zeros;
+            c |= 1;
+            from = descend(wm, l, from, true);
+            to = descend(wm, l, to, true);
+        }
+    }
+    return (int64_t)c;
+}
+
+static uint64_t count_less(wavelet_matrix *wm, uint64_t from, uint64_t to, uint64_t value)
+{
+    /**
+     * the symbols below `value` in [from, to): follow the path of value, and wherever it takes the one side,
+     * everything that went to the zero side is smaller
+     **/
+
+    uint64_t count = 0;
+    uint32_t l;
+
+    if (value >= (BIT << wm->num_levels))
+        return to - from;
+    for (l = 0; l < wm->num_levels && from < to; l++)
+    {
+        if ((value >> (wm->num_levels - 1 - l)) & 1)
+        {
+            count += rank0(wm->levels[l], to) - rank0(wm->levels[l], from);
+            from = descend(wm, l, from, true);
+            to = descend(wm, l, to, true);
+        }
+        else
+        {
+            from = descend(wm, l, from, false);
+            to = descend(wm, l, to, false);
+        }
+    }
+    return count;
+}
+
+uint64_t wm_range_count(wavelet_matrix *wm, uint64_t from, uint64_t to, uint64_t lo, uint64_t hi)
+{
+    BV_CHECK_NONNULL(wm);
+    if (to > wm->size)
+        to = wm->size;
+    if (from >= to || lo >= hi)
+        return 0;
+    return count_less(wm, from, to, hi) - count_less(wm, from, to, lo);
+}
+
+size_t wm_bytes(wavelet_matrix *wm)
+{
+    size_t bytes;
+    uint32_t l;
+
+    BV_CHECK_NONNULL(wm);
+    bytes = sizeof(wavelet_matrix);
+    for (l = 0; l < wm->num_levels; l++)
+        bytes += sizeof(bitvector) + ((bv_len(wm->levels[l]) >> LOG_WORD_SIZE) + BIT) * sizeof(uint64_t) +
+                 bv_index_bytes(wm->levels[l]);
+    return bytes;
+}
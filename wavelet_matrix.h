@@ -0,0 +1,90 @@
+/**
+ * @file wavelet_matrix.h
+ * @brief Wavelet matrix over integer sequences, layered on the rank/select bitvector
+ */
+
+#ifndef POPPY_WAVELET_MATRIX_H
+#define POPPY_WAVELET_MATRIX_H
+
+#include "bitvector.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define WM_MAX_LEVELS (32U) // symbols are uint32_t, so at most one level per bit
+
+/**
+ * @brief A wavelet matrix (Claude, Navarro & Ordóñez, 2015) of n symbols drawn from [0, sigma)
+ *
+ * Level l holds, for every symbol, bit (num_levels - 1 - l) of it, most significant bit first.
+ * Between levels the symbols are stably partitioned by that bit, zeros first, so that a range of positions
+ * at one level maps to two ranges at the next: [rank0(from), rank0(to)) and [zeros + rank1(from), zeros + rank1(to)).
+ * Every level is a plain bitvector with its rank and select directories, and every query descends or climbs
+ * num_levels = ceil(log2(sigma)) levels with O(1) rank or select per level.
+ */
+typedef struct
+{
+    uint64_t size;                   // the number of symbols
+    uint64_t sigma;                  // every symbol is < sigma
+    uint32_t num_levels;             // ceil(log2(sigma))
+    bitvector *levels[WM_MAX_LEVELS]; // levels[l] holds bit (num_levels - 1 - l) of the symbols in level-l order
+    uint64_t zeros[WM_MAX_LEVELS];   // the number of unset bits in levels[l]
+} wavelet_matrix;
+
+/**
+ * @brief Build a wavelet matrix of n symbols
+ *
+ * Each level is split into chunks that are partitioned by the worker pool of `bv_parallel_for`,
+ * then its rank and select directories are built.
+ *
+ * @param symbols n symbols, each < sigma
+ * @param n the number of symbols
+ * @param sigma the size of the alphabet, at most 2^32
+ */
+wavelet_matrix *wm_new(const uint32_t *symbols, uint64_t n, uint64_t sigma);
+
+void wm_free(wavelet_matrix *wm);
+
+/**
+ * @brief The number of symbols
+ */
+uint64_t wm_len(wavelet_matrix *wm);
+
+/**
+ * @brief The symbol at position `pos`
+ */
+uint32_t wm_access(wavelet_matrix *wm, uint64_t pos);
+
+/**
+ * @brief The number of occurrences of `c` strictly before pos, clamped to wm_len(wm)
+ */
+uint64_t wm_rank(wavelet_matrix *wm, uint32_t c, uint64_t pos);
+
+/**
+ * @brief The position of the kth (1-indexed) occurrence of `c`, or -1 if there are fewer than k
+ */
+int64_t wm_select(wavelet_matrix *wm, uint32_t c, uint64_t k);
+
+/**
+ * @brief The kth (0-indexed) smallest symbol among positions [from, to), or -1 if k >= to - from
+ *
+ * wm_quantile(wm, from, to, (to - from) / 2) is the median of the range.
+ */
+int64_t wm_quantile(wavelet_matrix *wm, uint64_t from, uint64_t to, uint64_t k);
+
+/**
+ * @brief The number of symbols c with lo <= c < hi among positions [from, to)
+ */
+uint64_t wm_range_count(wavelet_matrix *wm, uint64_t from, uint64_t to, uint64_t lo, uint64_t hi);
+
+/**
+ * @brief The number of bytes used by the levels and their directories
+ */
+size_t wm_bytes(wavelet_matrix *wm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // POPPY_WAVELET_MATRIX_H
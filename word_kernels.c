@@ -0,0 +1,585 @@
+#include "word_kernels.h"
+#include "word_ops.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+/**
+ * Every kernel has a scalar, an AVX2 and an AVX-512 variant.
+ * The vector variants are compiled with function-level target attributes so the binary runs on any x86-64 machine,
+ * and the widest variant the running CPU supports is picked the first time a kernel is called, unless `bv_use_isa`
+ * picked one before.
+ */
+
+typedef void (*binary_kernel)(uint64_t *, const uint64_t *, const uint64_t *, size_t);
+typedef void (*unary_kernel)(uint64_t *, const uint64_t *, size_t);
+typedef uint64_t (*binary_count_kernel)(const uint64_t *, const uint64_t *, size_t);
+typedef uint64_t (*unary_count_kernel)(const uint64_t *, size_t);
+typedef size_t (*decode_kernel)(uint32_t *, const uint64_t *, size_t, uint32_t);
+typedef void (*shift_kernel)(uint64_t *, const uint64_t *, size_t, unsigned);
+
+typedef struct
+{
+    binary_kernel and_, or_, xor_, andnot;
+    unary_kernel not_;
+    unary_count_kernel popcount;
+    binary_count_kernel and_popcount, or_popcount, xor_popcount;
+    decode_kernel decode;
+    shift_kernel shr, shl;
+} kernel_table;
+
+#define SCALAR_BINARY_KERNEL(NAME, EXPR)                                               \
+    static void NAME##_scalar(uint64_t *dst, const uint64_t *a, const uint64_t *b, size_t n) \
+    {                                                                                  \
+        size_t i;                                                                      \
+        for (i = 0; i < n; i++)                                                        \
+            dst[i] = EXPR;                                                             \
+    }
+
+SCALAR_BINARY_KERNEL(and, a[i] & b[i])
+SCALAR_BINARY_KERNEL(or, a[i] | b[i])
+SCALAR_BINARY_KERNEL(xor, a[i] ^ b[i])
+SCALAR_BINARY_KERNEL(andnot, a[i] & ~b[i])
+
+static void not_scalar(uint64_t *dst, const uint64_t *a, size_t n)
+{
+    size_t i;
+    for (i = 0; i < n; i++)
+        dst[i] = ~a[i];
+}
+
+#define SCALAR_COUNT_KERNEL(NAME, EXPR)                                                     \
+    static uint64_t NAME##_popcount_scalar(const uint64_t *a, const uint64_t *b, size_t n) \
+    {                                                                                     \
+        size_t i;                                                                         \
+        uint64_t card = 0;                                                                \
+        for (i = 0; i < n; i++)                                                           \
+            card += popcnt(EXPR);                                                         \
+        return card;                                                                      \
+    }
+
+SCALAR_COUNT_KERNEL(and, a[i] & b[i])
+SCALAR_COUNT_KERNEL(or, a[i] | b[i])
+SCALAR_COUNT_KERNEL(xor, a[i] ^ b[i])
+
+static uint64_t popcount_scalar(const uint64_t *a, size_t n)
+{
+    return popcnt_words(a, 0, n);
+}
+
+static size_t decode_scalar(uint32_t *out, const uint64_t *a, size_t n, uint32_t base)
+{
+    /** tzcnt finds the lowest set bit, blsr (w & (w - 1)) clears it **/
+
+    size_t i, count = 0;
+    uint64_t w;
+    for (i = 0; i < n; i++, base += WORD_SIZE)
+        for (w = a[i]; w != 0; w &= w - 1)
+            out[count++] = base + __builtin_ctzll(w);
+    return count;
+}
+
+static void shr_scalar(uint64_t *dst, const uint64_t *a, size_t n, unsigned sh)
+{
+    size_t i;
+    for (i = 0; i < n; i++)
+        dst[i] = (a[i] >> sh) | (a[i + 1] << (WORD_SIZE - sh));
+}
+
+static void shl_scalar(uint64_t *dst, const uint64_t *a, size_t n, unsigned sh)
+{
+    size_t i;
+    for (i = n; i-- > 0;)
+        dst[i] = (a[i] << sh) | (a[i - 1] >> (WORD_SIZE - sh));
+}
+
+#if defined(__x86_64__)
+
+/* _mm256_andnot_si256(x, y) computes ~x & y, hence the swapped operands for andnot */
+#define AVX2_BINARY_KERNEL(NAME, INTRINSIC, X, Y, EXPR)                                                      \
+    __attribute__((target("avx2"))) static void NAME##_avx2(uint64_t *dst, const uint64_t *a, const uint64_t *b, \
+                                                            size_t n)                                        \
+    {                                                                                                        \
+        size_t i;                                                                                            \
+        __m256i va, vb;                                                                                      \
+        for (i = 0; i + 4 <= n; i += 4)                                                                      \
+        {                                                                                                    \
+            va = _mm256_loadu_si256((const __m256i *)(a + i));                                               \
+            vb = _mm256_loadu_si256((const __m256i *)(b + i));                                               \
+            _mm256_storeu_si256((__m256i *)(dst + i), INTRINSIC(X, Y));                                      \
+        }                                                                                                    \
+        for (; i < n; i++)                                                                                   \
+            dst[i] = EXPR;                                                                                   \
+    }
+
+AVX2_BINARY_KERNEL(and, _mm256_and_si256, va, vb, a[i] & b[i])
+AVX2_BINARY_KERNEL(or, _mm256_or_si256, va, vb, a[i] | b[i])
+AVX2_BINARY_KERNEL(xor, _mm256_xor_si256, va, vb, a[i] ^ b[i])
+AVX2_BINARY_KERNEL(andnot, _mm256_andnot_si256, vb, va, a[i] & ~b[i])
+
+__attribute__((target("avx2"))) static void not_avx2(uint64_t *dst, const uint64_t *a, size_t n)
+{
+    size_t i;
+    const __m256i ones = _mm256_set1_epi64x(-1);
+    for (i = 0; i + 4 <= n; i += 4)
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(a + i)), ones));
+    for (; i < n; i++)
+        dst[i] = ~a[i];
+}
+
+/* the AVX-512 variants finish the tail with a masked load/store instead of a scalar loop */
+#define AVX512_BINARY_KERNEL(NAME, INTRINSIC, X, Y)                                                              \
+    __attribute__((target("avx512f"))) static void NAME##_avx512(uint64_t *dst, const uint64_t *a, const uint64_t *b, \
+                                                                 size_t n)                                       \
+    {                                                                                                            \
+        size_t i;                                                                                                \
+        __m512i va, vb;                                                                                          \
+        __mmask8 tail;                                                                                           \
+        for (i = 0; i + 8 <= n; i += 8)                                                                          \
+        {                                                                                                        \
+            va = _mm512_loadu_si512((const void *)(a + i));                                                      \
+            vb = _mm512_loadu_si512((const void *)(b + i));                                                      \
+            _mm512_storeu_si512((void *)(dst + i), INTRINSIC(X, Y));                                             \
+        }                                                                                                        \
+        if (i < n)                                                                                               \
+        {                                                                                                        \
+            tail = (__mmask8)((1U << (n - i)) - 1);                                                              \
+            va = _mm512_maskz_loadu_epi64(tail, a + i);                                                          \
+            vb = _mm512_maskz_loadu_epi64(tail, b + i);                                                          \
+            _mm512_mask_storeu_epi64(dst + i, tail, INTRINSIC(X, Y));                                            \
+        }                                                                                                        \
+    }
+
+AVX512_BINARY_KERNEL(and, _mm512_and_si512, va, vb)
+AVX512_BINARY_KERNEL(or, _mm512_or_si512, va, vb)
+AVX512_BINARY_KERNEL(xor, _mm512_xor_si512, va, vb)
+AVX512_BINARY_KERNEL(andnot, _mm512_andnot_si512, vb, va)
+
+__attribute__((target("avx512f"))) static void not_avx512(uint64_t *dst, const uint64_t *a, size_t n)
+{
+    size_t i;
+    __mmask8 tail;
+    const __m512i ones = _mm512_set1_epi64(-1);
+    for (i = 0; i + 8 <= n; i += 8)
+        _mm512_storeu_si512((void *)(dst + i), _mm512_xor_si512(_mm512_loadu_si512((const void *)(a + i)), ones));
+    if (i < n)
+    {
+        tail = (__mmask8)((1U << (n - i)) - 1);
+        _mm512_mask_storeu_epi64(dst + i, tail, _mm512_xor_si512(_mm512_maskz_loadu_epi64(tail, a + i), ones));
+    }
+}
+
+/**
+ * AVX2 popcounts use the Harley-Seal carry-save adder network of Mula, Kurz & Lemire (2018):
+ * 16 vectors are reduced to one "sixteens" vector with carry-save adders, so the nibble-lookup popcount
+ * only runs once per 16 vectors.
+ */
+
+__attribute__((target("avx2"))) static inline __m256i popcount256(__m256i v)
+{
+    const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low_mask = _mm256_set1_epi8(0x0f);
+    __m256i lo = _mm256_and_si256(v, low_mask);
+    __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask);
+    __m256i counts = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo), _mm256_shuffle_epi8(lookup, hi));
+    return _mm256_sad_epu8(counts, _mm256_setzero_si256());
+}
+
+__attribute__((target("avx2"))) static inline void csa256(__m256i *h, __m256i *l, __m256i a, __m256i b, __m256i c)
+{
+    __m256i u = _mm256_xor_si256(a, b);
+    *h = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(u, c));
+    *l = _mm256_xor_si256(u, c);
+}
+
+__attribute__((target("avx2"))) static inline uint64_t hsum256(__m256i v)
+{
+    return (uint64_t)_mm256_extract_epi64(v, 0) + (uint64_t)_mm256_extract_epi64(v, 1) +
+           (uint64_t)_mm256_extract_epi64(v, 2) + (uint64_t)_mm256_extract_epi64(v, 3);
+}
+
+/* LOAD(k) yields the kth 256-bit vector of the operand, EXPR the ith word for the scalar tail */
+#define HARLEY_SEAL_KERNEL(NAME, LOAD, EXPR)                                                                    \
+    __attribute__((target("avx2"))) static uint64_t NAME##_avx2(const uint64_t *a, const uint64_t *b, size_t n) \
+    {                                                                                                           \
+        size_t i, k, nvec = n / 4;                                                                              \
+        uint64_t card = 0;                                                                                      \
+        __m256i total = _mm256_setzero_si256(), ones = total, twos = total, fours = total, eights = total;     \
+        __m256i sixteens, twos_a, twos_b, fours_a, fours_b, eights_a, eights_b;                                 \
+        (void)b;                                                                                                \
+        for (k = 0; k + 16 <= nvec; k += 16)                                                                    \
+        {                                                                                                       \
+            csa256(&twos_a, &ones, ones, LOAD(k), LOAD(k + 1));                                                 \
+            csa256(&twos_b, &ones, ones, LOAD(k + 2), LOAD(k + 3));                                             \
+            csa256(&fours_a, &twos, twos, twos_a, twos_b);                                                      \
+            csa256(&twos_a, &ones, ones, LOAD(k + 4), LOAD(k + 5));                                             \
+            csa256(&twos_b, &ones, ones, LOAD(k + 6), LOAD(k + 7));                                             \
+            csa256(&fours_b, &twos, twos, twos_a, twos_b);                                                      \
+            csa256(&eights_a, &fours, fours, fours_a, fours_b);                                                 \
+            csa256(&twos_a, &ones, ones, LOAD(k + 8), LOAD(k + 9));                                             \
+            csa256(&twos_b, &ones, ones, LOAD(k + 10), LOAD(k + 11));                                           \
+            csa256(&fours_a, &twos, twos, twos_a, twos_b);                                                      \
+            csa256(&twos_a, &ones, ones, LOAD(k + 12), LOAD(k + 13));                                           \
+            csa256(&twos_b, &ones, ones, LOAD(k + 14), LOAD(k + 15));                                           \
+            csa256(&fours_b, &twos, twos, twos_a, twos_b);                                                      \
+            csa256(&eights_b, &fours, fours, fours_a, fours_b);                                                 \
+            csa256(&sixteens, &eights, eights, eights_a, eights_b);                                             \
+            total = _mm256_add_epi64(total, popcount256(sixteens));                                             \
+        }                                                                                                       \
+        total = _mm256_slli_epi64(total, 4);                                                                    \
+        total = _mm256_add_epi64(total, _mm256_slli_epi64(popcount256(eights), 3));                             \
+        total = _mm256_add_epi64(total, _mm256_slli_epi64(popcount256(fours), 2));                              \
+        total = _mm256_add_epi64(total, _mm256_slli_epi64(popcount256(twos), 1));                               \
+        total = _mm256_add_epi64(total, popcount256(ones));                                                     \
+        for (; k < nvec; k++)                                                                                   \
+            total = _mm256_add_epi64(total, popcount256(LOAD(k)));                                              \
+        card = hsum256(total);                                                                                  \
+        for (i = nvec * 4; i < n; i++)                                                                          \
+            card += popcnt(EXPR);                                                                               \
+        return card;                                                                                            \
+    }
+
+#define LOADU256(p, k) _mm256_loadu_si256((const __m256i *)(p) + (k))
+#define LOAD_A(k) LOADU256(a, k)
+#define LOAD_AND(k) _mm256_and_si256(LOADU256(a, k), LOADU256(b, k))
+#define LOAD_OR(k) _mm256_or_si256(LOADU256(a, k), LOADU256(b, k))
+#define LOAD_XOR(k) _mm256_xor_si256(LOADU256(a, k), LOADU256(b, k))
+
+HARLEY_SEAL_KERNEL(unary_popcount, LOAD_A, a[i])
+HARLEY_SEAL_KERNEL(and_popcount, LOAD_AND, a[i] & b[i])
+HARLEY_SEAL_KERNEL(or_popcount, LOAD_OR, a[i] | b[i])
+HARLEY_SEAL_KERNEL(xor_popcount, LOAD_XOR, a[i] ^ b[i])
+
+static uint64_t popcount_avx2(const uint64_t *a, size_t n)
+{
+    return unary_popcount_avx2(a, NULL, n);
+}
+
+/**
+ * One byte at a time: pdep spreads its bits over the bytes of a mask, pext packs the indices 0..7 selected by that
+ * mask, and the packed indices are widened to eight 32-bit lanes of which the first popcount(byte) are stored.
+ */
+__attribute__((target("avx2,bmi,bmi2"))) static size_t decode_avx2(uint32_t *out, const uint64_t *a, size_t n,
+                                                                    uint32_t base)
+{
+    size_t i, k, count = 0;
+    uint64_t w, byte, indices;
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256i v;
+
+    for (i = 0; i < n; i++, base += WORD_SIZE)
+    {
+        w = a[i];
+        /* the byte expansion only pays off once a word has a few bits per byte to emit */
+        if (popcnt(w) < 16)
+        {
+            for (; w != 0; w = _blsr_u64(w))
+                out[count++] = base + (uint32_t)_tzcnt_u64(w);
+            continue;
+        }
+        for (; w != 0; w &= ~(0xFFULL << k))
+        {
+            k = __builtin_ctzll(w) & ~7ULL;
+            byte = (w >> k) & 0xFF;
+            indices = _pext_u64(0x0706050403020100ULL, _pdep_u64(byte, 0x0101010101010101ULL) * 0xFF);
+            v = _mm256_add_epi32(_mm256_cvtepu8_epi32(_mm_cvtsi64_si128((int64_t)indices)),
+                                 _mm256_set1_epi32((int32_t)(base + k)));
+            _mm256_maskstore_epi32((int *)(out + count),
+                                   _mm256_cmpgt_epi32(_mm256_set1_epi32((int32_t)popcnt(byte)), lanes), v);
+            count += popcnt(byte);
+        }
+    }
+    return count;
+}
+
+/* with VPOPCNTDQ a 512-bit vector is counted in one instruction, so a plain accumulator suffices */
+#define VPOPCNT_KERNEL(NAME, INTRINSIC)                                                                       \
+    __attribute__((target("avx512f,avx512vpopcntdq"))) static uint64_t NAME##_avx512(const uint64_t *a,      \
+                                                                                    const uint64_t *b, size_t n) \
+    {                                                                                                         \
+        size_t i;                                                                                             \
+        __mmask8 tail;                                                                                        \
+        __m512i acc = _mm512_setzero_si512(), va, vb;                                                         \
+        for (i = 0; i + 8 <= n; i += 8)                                                                       \
+        {                                                                                                     \
+            va = _mm512_loadu_si512((const void *)(a + i));                                                   \
+            vb = _mm512_loadu_si512((const void *)(b + i));                                                   \
+            acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(INTRINSIC(va, vb)));                              \
+        }                                                                                                     \
+        if (i < n)                                                                                            \
+        {                                                                                                     \
+            tail = (__mmask8)((1U << (n - i)) - 1);                                                           \
+            va = _mm512_maskz_loadu_epi64(tail, a + i);                                                       \
+            vb = _mm512_maskz_loadu_epi64(tail, b + i);                                                       \
+            acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(INTRINSIC(va, vb)));                              \
+        }                                                                                                     \
+        return _mm512_reduce_add_epi64(acc);                                                                  \
+    }
+
+VPOPCNT_KERNEL(and_popcount, _mm512_and_si512)
+VPOPCNT_KERNEL(or_popcount, _mm512_or_si512)
+VPOPCNT_KERNEL(xor_popcount, _mm512_xor_si512)
+
+static uint64_t popcount_avx512(const uint64_t *a, size_t n)
+{
+    /* a | a == a */
+    return or_popcount_avx512(a, a, n);
+}
+
+/* 16 bits at a time: compress the selected lanes of (base + 0..15) to the front, then store exactly that many */
+__attribute__((target("avx512f"))) static size_t decode_avx512(uint32_t *out, const uint64_t *a, size_t n,
+                                                               uint32_t base)
+{
+    size_t i, k, count = 0;
+    uint64_t w;
+    __mmask16 bits;
+    __m512i v;
+    const __m512i lanes = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+
+    for (i = 0; i < n; i++, base += WORD_SIZE)
+    {
+        for (w = a[i]; w != 0; w &= ~(0xFFFFULL << k))
+        {
+            k = __builtin_ctzll(w) & ~15ULL;
+            bits = (__mmask16)(w >> k);
+            v = _mm512_add_epi32(lanes, _mm512_set1_epi32((int32_t)(base + k)));
+            _mm512_mask_storeu_epi32(out + count, (__mmask16)((1U << popcnt(bits)) - 1),
+                                     _mm512_maskz_compress_epi32(bits, v));
+            count += popcnt(bits);
+        }
+    }
+    return count;
+}
+
+/**
+ * The funnel shifts load a[i] and its neighbour as two overlapping unaligned vectors and combine them with one
+ * shift each. All loads of a block happen before its store, and blocks are visited in the order that keeps
+ * dst from overwriting words that are still to be read.
+ */
+__attribute__((target("avx2"))) static void shr_avx2(uint64_t *dst, const uint64_t *a, size_t n, unsigned sh)
+{
+    size_t i;
+    const __m128i right = _mm_cvtsi32_si128((int)sh), left = _mm_cvtsi32_si128((int)(WORD_SIZE - sh));
+    __m256i lo, hi;
+    for (i = 0; i + 4 <= n; i += 4)
+    {
+        lo = _mm256_loadu_si256((const __m256i *)(a + i));
+        hi = _mm256_loadu_si256((const __m256i *)(a + i + 1));
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_or_si256(_mm256_srl_epi64(lo, right), _mm256_sll_epi64(hi, left)));
+    }
+    for (; i < n; i++)
+        dst[i] = (a[i] >> sh) | (a[i + 1] << (WORD_SIZE - sh));
+}
+
+__attribute__((target("avx2"))) static void shl_avx2(uint64_t *dst, const uint64_t *a, size_t n, unsigned sh)
+{
+    size_t i;
+    const __m128i left = _mm_cvtsi32_si128((int)sh), right = _mm_cvtsi32_si128((int)(WORD_SIZE - sh));
+    __m256i hi, lo;
+    for (i = n; i >= 4; i -= 4)
+    {
+        hi = _mm256_loadu_si256((const __m256i *)(a + i - 4));
+        lo = _mm256_loadu_si256((const __m256i *)(a + i - 5));
+        _mm256_storeu_si256((__m256i *)(dst + i - 4), _mm256_or_si256(_mm256_sll_epi64(hi, left), _mm256_srl_epi64(lo, right)));
+    }
+    while (i-- > 0)
+        dst[i] = (a[i] << sh) | (a[i - 1] >> (WORD_SIZE - sh));
+}
+
+__attribute__((target("avx512f"))) static void shr_avx512(uint64_t *dst, const uint64_t *a, size_t n, unsigned sh)
+{
+    size_t i;
+    const __m128i right = _mm_cvtsi32_si128((int)sh), left = _mm_cvtsi32_si128((int)(WORD_SIZE - sh));
+    __m512i lo, hi;
+    __mmask8 tail;
+    for (i = 0; i + 8 <= n; i += 8)
+    {
+        lo = _mm512_loadu_si512((const void *)(a + i));
+        hi = _mm512_loadu_si512((const void *)(a + i + 1));
+        _mm512_storeu_si512((void *)(dst + i), _mm512_or_si512(_mm512_srl_epi64(lo, right), _mm512_sll_epi64(hi, left)));
+    }
+    if (i < n)
+    {
+        tail = (__mmask8)((1U << (n - i)) - 1);
+        lo = _mm512_maskz_loadu_epi64(tail, a + i);
+        hi = _mm512_maskz_loadu_epi64(tail, a + i + 1);
+        _mm512_mask_storeu_epi64(dst + i, tail, _mm512_or_si512(_mm512_srl_epi64(lo, right), _mm512_sll_epi64(hi, left)));
+    }
+}
+
+__attribute__((target("avx512f"))) static void shl_avx512(uint64_t *dst, const uint64_t *a, size_t n, unsigned sh)
+{
+    size_t i;
+    const __m128i left = _mm_cvtsi32_si128((int)sh), right = _mm_cvtsi32_si128((int)(WORD_SIZE - sh));
+    __m512i hi, lo;
+    __mmask8 head;
+    for (i = n; i >= 8; i -= 8)
+    {
+        hi = _mm512_loadu_si512((const void *)(a + i - 8));
+        lo = _mm512_loadu_si512((const void *)(a + i - 9));
+        _mm512_storeu_si512((void *)(dst + i - 8), _mm512_or_si512(_mm512_sll_epi64(hi, left), _mm512_srl_epi64(lo, right)));
+    }
+    if (i > 0)
+    {
+        head = (__mmask8)((1U << i) - 1);
+        hi = _mm512_maskz_loadu_epi64(head, a);
+        lo = _mm512_maskz_loadu_epi64(head, a - 1);
+        _mm512_mask_storeu_epi64(dst, head, _mm512_or_si512(_mm512_sll_epi64(hi, left), _mm512_srl_epi64(lo, right)));
+    }
+}
+
+#endif // __x86_64__
+
+static const kernel_table scalar_kernels = {and_scalar, or_scalar, xor_scalar, andnot_scalar, not_scalar,
+                                            popcount_scalar, and_popcount_scalar, or_popcount_scalar,
+                                            xor_popcount_scalar, decode_scalar, shr_scalar, shl_scalar};
+#if defined(__x86_64__)
+static const kernel_table avx2_kernels = {and_avx2, or_avx2, xor_avx2, andnot_avx2, not_avx2,
+                                          popcount_avx2, and_popcount_avx2, or_popcount_avx2, xor_popcount_avx2,
+                                          decode_avx2, shr_avx2, shl_avx2};
+static const kernel_table avx512_kernels = {and_avx512, or_avx512, xor_avx512, andnot_avx512, not_avx512,
+                                            popcount_avx512, and_popcount_avx512, or_popcount_avx512,
+                                            xor_popcount_avx512, decode_avx512, shr_avx512, shl_avx512};
+#endif
+
+/* one complete table per instruction set, indexed by bv_isa; filled once and only read afterwards */
+static kernel_table tables[BV_ISA_AVX512 + 1];
+static bv_isa best_isa = BV_ISA_SCALAR;
+static pthread_once_t tables_once = PTHREAD_ONCE_INIT;
+static _Atomic(const kernel_table *) kernels = NULL;
+
+static bv_isa best_supported_isa(void)
+{
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        return BV_ISA_AVX512;
+    if (__builtin_cpu_supports("avx2"))
+        return BV_ISA_AVX2;
+#endif
+    return BV_ISA_SCALAR;
+}
+
+static void build_tables(void)
+{
+    /**
+     * fill in the table of every instruction set the CPU supports, then publish the widest one unless
+     * bv_use_isa got there first. Readers only ever see a pointer to a finished table
+     **/
+
+    const kernel_table *expected = NULL;
+
+    best_isa = best_supported_isa();
+    tables[BV_ISA_SCALAR] = scalar_kernels;
+#if defined(__x86_64__)
+    if (best_isa >= BV_ISA_AVX2)
+    {
+        tables[BV_ISA_AVX2] = avx2_kernels;
+        if (!__builtin_cpu_supports("bmi2"))
+            tables[BV_ISA_AVX2].decode = decode_scalar;
+    }
+    if (best_isa >= BV_ISA_AVX512)
+    {
+        tables[BV_ISA_AVX512] = avx512_kernels;
+        if (!__builtin_cpu_supports("avx512vpopcntdq"))
+        {
+            /* AVX-512F without VPOPCNTDQ: keep the Harley-Seal popcounts */
+            tables[BV_ISA_AVX512].popcount = avx2_kernels.popcount;
+            tables[BV_ISA_AVX512].and_popcount = avx2_kernels.and_popcount;
+            tables[BV_ISA_AVX512].or_popcount = avx2_kernels.or_popcount;
+            tables[BV_ISA_AVX512].xor_popcount = avx2_kernels.xor_popcount;
+        }
+    }
+#endif
+    atomic_compare_exchange_strong_explicit(&kernels, &expected, &tables[best_isa], memory_order_release,
+                                            memory_order_relaxed);
+}
+
+bv_isa bv_use_isa(bv_isa isa)
+{
+    pthread_once(&tables_once, build_tables);
+    if (isa == BV_ISA_AUTO || isa > best_isa)
+        isa = best_isa;
+    atomic_store_explicit(&kernels, &tables[isa], memory_order_release);
+    return isa;
+}
+
+static inline const kernel_table *get_kernels(void)
+{
+    const kernel_table *table = atomic_load_explicit(&kernels, memory_order_acquire);
+
+    if (table == NULL)
+    {
+        pthread_once(&tables_once, build_tables);
+        table = atomic_load_explicit(&kernels, memory_order_acquire);
+    }
+    return table;
+}
+
+bv_isa bv_current_isa(void)
+{
+    return (bv_isa)(get_kernels() - tables);
+}
+
+void words_and(uint64_t *dst, const uint64_t *a, const uint64_t *b, size_t n)
+{
+    get_kernels()->and_(dst, a, b, n);
+}
+
+void words_or(uint64_t *dst, const uint64_t *a, const uint64_t *b, size_t n)
+{
+    get_kernels()->or_(dst, a, b, n);
+}
+
+void words_xor(uint64_t *dst, const uint64_t *a, const uint64_t *b, size_t n)
+{
+    get_kernels()->xor_(dst, a, b, n);
+}
+
+void words_andnot(uint64_t *dst, const uint64_t *a, const uint64_t *b, size_t n)
+{
+    get_kernels()->andnot(dst, a, b, n);
+}
+
+void words_not(uint64_t *dst, const uint64_t *a, size_t n)
+{
+    get_kernels()->not_(dst, a, n);
+}
+
+uint64_t words_popcount(const uint64_t *a, size_t n)
+{
+    return get_kernels()->popcount(a, n);
+}
+
+uint64_t words_and_popcount(const uint64_t *a, const uint64_t *b, size_t n)
+{
+    return get_kernels()->and_popcount(a, b, n);
+}
+
+uint64_t words_or_popcount(const uint64_t *a, const uint64_t *b, size_t n)
+{
+    return get_kernels()->or_popcount(a, b, n);
+}
+
+uint64_t words_xor_popcount(const uint64_t *a, const uint64_t *b, size_t n)
+{
+    return get_kernels()->xor_popcount(a, b, n);
+}
+
+size_t words_decode(uint32_t *out, const uint64_t *a, size_t n, uint32_t base)
+{
+    return get_kernels()->decode(out, a, n, base);
+}
+
+void words_shr(uint64_t *dst, const uint64_t *a, size_t n, unsigned sh)
+{
+    get_kernels()->shr(dst, a, n, sh);
+}
+
+void words_shl(uint64_t *dst, const uint64_t *a, size_t n, unsigned sh)
+{
+    get_kernels()->shl(dst, a, n, sh);
+}
@@ -0,0 +1,91 @@
+/**
+ * @file word_kernels.h
+ * @brief Bulk bitwise kernels over word arrays with runtime ISA dispatch
+ */
+
+#ifndef POPPY_WORD_KERNELS_H
+#define POPPY_WORD_KERNELS_H
+
+#include "bitvector.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief dst[i] = a[i] & b[i] for 0 <= i < n. dst may alias a or b.
+ */
+void words_and(uint64_t *dst, const uint64_t *a, const uint64_t *b, size_t n);
+
+/**
+ * @brief dst[i] = a[i] | b[i] for 0 <= i < n. dst may alias a or b.
+ */
+void words_or(uint64_t *dst, const uint64_t *a, const uint64_t *b, size_t n);
+
+/**
+ * @brief dst[i] = a[i] ^ b[i] for 0 <= i < n. dst may alias a or b.
+ */
+void words_xor(uint64_t *dst, const uint64_t *a, const uint64_t *b, size_t n);
+
+/**
+ * @brief dst[i] = a[i] & ~b[i] for 0 <= i < n. dst may alias a or b.
+ */
+void words_andnot(uint64_t *dst, const uint64_t *a, const uint64_t *b, size_t n);
+
+/**
+ * @brief dst[i] = ~a[i] for 0 <= i < n. dst may alias a.
+ */
+void words_not(uint64_t *dst, const uint64_t *a, size_t n);
+
+/**
+ * @brief The number of set bits in a[0:n]
+ */
+uint64_t words_popcount(const uint64_t *a, size_t n);
+
+/**
+ * @brief The number of set bits in a[i] & b[i] for 0 <= i < n
+ */
+uint64_t words_and_popcount(const uint64_t *a, const uint64_t *b, size_t n);
+
+/**
+ * @brief The number of set bits in a[i] | b[i] for 0 <= i < n
+ */
+uint64_t words_or_popcount(const uint64_t *a, const uint64_t *b, size_t n);
+
+/**
+ * @brief The number of set bits in a[i] ^ b[i] for 0 <= i < n
+ */
+uint64_t words_xor_popcount(const uint64_t *a, const uint64_t *b, size_t n);
+
+/**
+ * @brief Write base + 64 * i + j to out for every set bit j of a[i], 0 <= i < n, in increasing order
+ *
+ * Positions wrap modulo 2^32. out must have room for words_popcount(a, n) entries.
+ *
+ * @return size_t the number of positions written
+ */
+size_t words_decode(uint32_t *out, const uint64_t *a, size_t n, uint32_t base);
+
+/**
+ * @brief dst[i] = (a[i] >> sh) | (a[i + 1] << (64 - sh)) for 0 <= i < n, i.e. a[0:n + 1] funnel-shifted down
+ *
+ * Reads a[0:n + 1]. dst may alias the words of a at or below a, so this moves bits towards lower addresses.
+ *
+ * @param sh in [1, 63]
+ */
+void words_shr(uint64_t *dst, const uint64_t *a, size_t n, unsigned sh);
+
+/**
+ * @brief dst[i] = (a[i] << sh) | (a[i - 1] >> (64 - sh)) for 0 <= i < n, i.e. a[-1:n] funnel-shifted up
+ *
+ * Reads a[-1:n], from the top down. dst may alias the words of a at or above a.
+ *
+ * @param sh in [1, 63]
+ */
+void words_shl(uint64_t *dst, const uint64_t *a, size_t n, unsigned sh);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // POPPY_WORD_KERNELS_H
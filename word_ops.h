@@ -0,0 +1,63 @@
+/**
+ * @file word_ops.h
+ * @brief Word-level primitives shared by the bitvector modules
+ */
+
+#ifndef POPPY_WORD_OPS_H
+#define POPPY_WORD_OPS_H
+
+#include <stdint.h>
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
+static inline uint64_t popcnt(uint64_t i)
+{
+    return __builtin_popcountll(i);
+}
+
+/**
+ * @brief Count the set bits in the words data[from:to]
+ */
+static inline uint64_t popcnt_words(const uint64_t *data, uint64_t from, uint64_t to)
+{
+    uint64_t card = 0;
+    for (; from < to; from++)
+        card += popcnt(data[from]);
+    return card;
+}
+
+/**
+ * @brief Find the position of the kth (0-indexed) set bit of a word
+ *
+ * Uses pdep/tzcnt when BMI2 is available and a broadword byte-wise search otherwise.
+ *
+ * @param x the word to search, must have more than k set bits
+ * @param k the number of set bits to skip
+ * @return uint64_t the position 0 <= i < 64 of the kth set bit
+ */
+static inline uint64_t word_select(uint64_t x, uint64_t k)
+{
+#if defined(__BMI2__)
+    return _tzcnt_u64(_pdep_u64(1UL << k, x));
+#else
+    const uint64_t ones_step_8 = 0x0101010101010101UL;
+    const uint64_t msbs_step_8 = 0x8080808080808080UL;
+    uint64_t byte_sums, byte_index, byte;
+
+    /** byte i of byte_sums holds the number of set bits in bytes 0..i */
+    byte_sums = x - ((x >> 1) & 0x5555555555555555UL);
+    byte_sums = (byte_sums & 0x3333333333333333UL) + ((byte_sums >> 2) & 0x3333333333333333UL);
+    byte_sums = ((byte_sums + (byte_sums >> 4)) & 0x0f0f0f0f0f0f0f0fUL) * ones_step_8;
+
+    /** the target byte is the number of bytes whose running sum is <= k */
+    byte_index = popcnt((((k * ones_step_8) | msbs_step_8) - byte_sums) & msbs_step_8);
+    k -= ((byte_sums << 8) >> (byte_index << 3)) & 0xff;
+    byte = (x >> (byte_index << 3)) & 0xff;
+    for (; k > 0; k--)
+        byte &= byte - 1;
+    return (byte_index << 3) + __builtin_ctzll(byte);
+#endif
+}
+
+#endif // POPPY_WORD_OPS_H